@@ -13,6 +13,7 @@
 
 #import <TechSupport/TechSupport.h>
 #import "CrashLog.h"
+#import "PackageCache.h"
 #import "RootViewController.h"
 #import "ScriptViewController.h"
 #import "SuspectsViewController.h"
@@ -77,6 +78,10 @@ static void resetIconBadgeNumber() {
     // Reset icon badge number.
     resetIconBadgeNumber();
 
+    // Start opening the package index, which is rebuilt (in the background)
+    // if packages have changed, so that it is ready when a report is viewed.
+    [PackageCache sharedInstance];
+
     return YES;
 }
 
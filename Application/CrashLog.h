@@ -11,8 +11,6 @@
 
 #import <Foundation/Foundation.h>
 
-extern NSString * const kViewedCrashLogs;
-
 typedef enum : NSUInteger {
     CrashLogTypeUnknown,
     CrashLogTypeApp,
@@ -28,6 +26,7 @@ typedef enum : NSUInteger {
 } CrashLogBugType;
 
 @class CRBinaryImage;
+@class CrashLogGroup;
 
 @interface CrashLog : NSObject
 @property(nonatomic, readonly) NSString *filepath;
@@ -35,14 +34,26 @@ typedef enum : NSUInteger {
 @property(nonatomic, readonly) NSDate *logDate;
 @property(nonatomic, readonly) CrashLogType type;
 @property(nonatomic, readonly) CrashLogBugType bugType;
+@property(nonatomic, readonly) uint64_t fingerprint;
 @property(nonatomic, readonly) CRBinaryImage *victim;
 @property(nonatomic, readonly) NSArray *suspects;
 @property(nonatomic, readonly) NSArray *potentialSuspects;
 @property(nonatomic, readonly, getter = isLoaded) BOOL loaded;
 @property(nonatomic, readonly, getter = isSymbolicated) BOOL symbolicated;
 @property(nonatomic, assign, getter = isViewed) BOOL viewed;
+// NOTE: Set by the group that contains the log; not retained.
+@property(nonatomic, assign) CrashLogGroup *group;
 + (instancetype)crashLogWithFilepath:(NSString *)filepath;
-- (BOOL)delete;
+// NOTE: Saves the types determined for the processes of crashed logs (if any
+//       were added since the last save).
++ (void)saveProcessTypeCache;
+// NOTE: Equivalent to setting each log as viewed, but with the changes made
+//       together (see -setViewed:).
++ (void)markCrashLogsAsViewed:(NSArray *)crashLogs;
+- (instancetype)initWithFilepath:(NSString *)filepath name:(NSString *)name date:(NSDate *)date;
+- (instancetype)initWithFilepath:(NSString *)filepath name:(NSString *)name date:(NSDate *)date
+    type:(CrashLogType)type bugType:(CrashLogBugType)bugType symbolicated:(BOOL)symbolicated
+    fingerprint:(uint64_t)fingerprint;
 - (BOOL)load;
 @end
 
@@ -13,11 +13,15 @@
 
 #import <libcrashreport/libcrashreport.h>
 #import <libpackageinfo/libpackageinfo.h>
+#import "CrashLogGroup.h"
+#import "ViewedStateStore.h"
 #import "crashlog_util.h"
 
-#include <unicode/uregex.h>
-
-NSString * const kViewedCrashLogs = @"viewedCrashLogs";
+#include "crash_rate.h"
+#include "crashlog_fingerprint.h"
+#include "crashlog_name.h"
+#include "paths.h"
+#include "process_type_cache.h"
 
 static NSCalendar *calendar() {
     static NSCalendar *calendar = nil;
@@ -27,46 +31,138 @@ static NSCalendar *calendar() {
     return calendar;
 }
 
-static void deleteViewedState(NSString *filepath) {
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-    NSArray *viewedCrashLogs = [defaults arrayForKey:kViewedCrashLogs];
-    if ([viewedCrashLogs containsObject:filepath]) {
-        NSMutableArray *array = [[NSMutableArray alloc] initWithArray:viewedCrashLogs];
-        [array removeObject:filepath];
-        [defaults setObject:array forKey:kViewedCrashLogs];
-        [defaults synchronize];
-        [array release];
+static process_type_cache_t *processTypeCache$ = NULL;
+
+static process_type_cache_t *processTypeCache() {
+    if (processTypeCache$ == NULL) {
+        processTypeCache$ = process_type_cache_open(kProcessTypeCacheFilepath);
     }
+    return processTypeCache$;
 }
 
-static void saveViewedState(NSString *filepath) {
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-    NSArray *viewedCrashLogs = [defaults arrayForKey:kViewedCrashLogs];
-    if (![viewedCrashLogs containsObject:filepath]) {
-        NSMutableArray *array = [[NSMutableArray alloc] initWithArray:viewedCrashLogs];
-        [array addObject:filepath];
-        [defaults setObject:array forKey:kViewedCrashLogs];
-        [defaults synchronize];
-        [array release];
+static CrashLogType typeForBundlePath(NSString *bundlePath, NSString *processPath) {
+    CrashLogType type = CrashLogTypeService;
+
+    NSBundle *bundle = [NSBundle bundleWithPath:bundlePath];
+    if (bundle != nil) {
+        char *executablePath = realpath([[bundle executablePath] UTF8String], NULL);
+        if (executablePath != NULL) {
+            if (strcmp(executablePath, [processPath UTF8String]) == 0) {
+                NSDictionary *infoDictionary = [bundle infoDictionary];
+                id object = [infoDictionary objectForKey:@"CFBundlePackageType"];
+                if ([object isKindOfClass:[NSString class]]) {
+                    NSString *packageType = object;
+                    if ([packageType isEqualToString:@"APPL"]) {
+                        type = CrashLogTypeApp;
+                    } else if ([packageType isEqualToString:@"XPC!"]) {
+                        object = [infoDictionary objectForKey:@"NSExtension"];
+                        if (object != nil) {
+                            type = CrashLogTypeAppExtension;
+                        }
+                    }
+                }
+            }
+
+            free(executablePath);
+        }
+    } else {
+        // Bundle no longer installed; make intelligent guess.
+        // NOTE: This should always work for AppStore app bundles, but may be
+        //       incorrect for other app bundles.
+        if ([bundlePath hasSuffix:@".app"]) {
+            type = CrashLogTypeApp;
+        } else if ([bundlePath hasSuffix:@".appex"]) {
+            type = CrashLogTypeAppExtension;
+        }
     }
+
+    return type;
+}
+
+static CrashLogType typeForProcessPath(NSString *processPath) {
+    CrashLogType type = CrashLogTypeService;
+
+    // Determine bundle path.
+    // NOTE: Process may not be from a bundle.
+    NSString *bundlePath = nil;
+    NSArray *components = [processPath componentsSeparatedByString:@"/"];
+    for (NSUInteger n = [components count]; n > 0; --n) {
+        NSString *component = [components objectAtIndex:(n - 1)];
+        if (
+            [component hasSuffix:@".app"] ||
+            [component hasSuffix:@".appex"]
+           ) {
+            bundlePath = [[components subarrayWithRange:NSMakeRange(0, n)] componentsJoinedByString:@"/"];
+            break;
+        }
+    }
+
+    if (bundlePath != nil) {
+        // Use bundle path to determine type.
+        // NOTE: Examining the bundle is time consuming, and all logs of a
+        //       process share the same path; the result is cached until the
+        //       Info.plist of the bundle changes (i.e. the app is updated).
+        NSString *infoPath = [bundlePath stringByAppendingPathComponent:@"Info.plist"];
+        struct stat st;
+        if (stat([infoPath fileSystemRepresentation], &st) == 0) {
+            const char *path = [processPath UTF8String];
+            uint32_t cachedType;
+            @synchronized([CrashLog class]) {
+                process_type_cache_t *cache = processTypeCache();
+                if ((cache != NULL) && process_type_cache_lookup(cache, path, &st, &cachedType)) {
+                    return (CrashLogType)cachedType;
+                }
+            }
+
+            type = typeForBundlePath(bundlePath, processPath);
+
+            @synchronized([CrashLog class]) {
+                process_type_cache_t *cache = processTypeCache();
+                if (cache != NULL) {
+                    process_type_cache_update(cache, path, [infoPath fileSystemRepresentation], &st, type);
+                }
+            }
+        } else {
+            type = typeForBundlePath(bundlePath, processPath);
+        }
+    }
+
+    return type;
 }
 
 @interface CrashLog ()
 @property (nonatomic, readonly) CRCrashReport *report;
+- (BOOL)readHeader;
 @end
 
-@implementation CrashLog
+@implementation CrashLog {
+    BOOL symbolicated_;
+    NSLock *loadLock_;
+
+    BOOL hasFingerprint_;
+
+    BOOL hasReadHeader_;
+    BOOL hasHeader_;
+    int headerBugType_;
+    NSString *processPath_;
+
+    NSDictionary *processInfo_;
+
+    CrashLogGroup *group_;
+}
 
 @synthesize filepath = filepath_;
 @synthesize logName = logName_;
 @synthesize logDate = logDate_;
 @synthesize type = type_;
 @synthesize bugType = bugType_;
+@synthesize fingerprint = fingerprint_;
 @synthesize victim = victim_;
 @synthesize suspects = suspects_;
 @synthesize potentialSuspects = potentialSuspects_;
 @synthesize loaded = loaded_;
 @synthesize viewed = viewed_;
+@synthesize group = group_;
 
 @synthesize report = report_;
 
@@ -74,87 +170,12 @@ static void saveViewedState(NSString *filepath) {
 
 #pragma mark - Creation & Destruction
 
-// TODO: Versions of the following static functions also exist in
-//       libcrashreport. Consider combining and moving to the Common module.
-static URegularExpression *prepareRegularExpression(const char *pattern) {
-    UParseError error;
-    UErrorCode status = U_ZERO_ERROR;
-    URegularExpression *regex = uregex_openC(pattern, 0, &error, &status);
-    if (U_FAILURE(status)) {
-        fprintf(stderr, "ERROR: Failed to compile regular expression: %s\n", u_errorName(status));
-    }
-    return regex;
-}
-
-static BOOL matchesRegularExpression(URegularExpression *regex, NSString *string) {
-    BOOL result = NO;
-
-    const UChar *data = (const uint16_t *)[string cStringUsingEncoding:NSUTF16StringEncoding];
-    const size_t size = [string length];
-
-    UErrorCode status = U_ZERO_ERROR;
-    uregex_setText(regex, data, size, &status);
-    if (U_SUCCESS(status)) {
-        status = U_ZERO_ERROR;
-        UBool matches = uregex_matches(regex, 0, &status);
-        if (U_SUCCESS(status)) {
-            result = (BOOL)matches;
-        } else {
-            fprintf(stderr, "ERROR: Failed to check for match against regular expression: %s\n", u_errorName(status));
-        }
-    } else {
-        fprintf(stderr, "ERROR: Failed to set string to match against regular expression: %s\n", u_errorName(status));
-    }
-
-    return result;
-}
-
-
-static NSString *newStringFromMatch(URegularExpression *regex, unsigned groupIndex) {
-    NSString *result = nil;
-
-    UErrorCode status = U_ZERO_ERROR;
-    int32_t length = uregex_group(regex, groupIndex, NULL, 0, &status);
-    if (status == U_BUFFER_OVERFLOW_ERROR) {
-        UChar *buf = (UChar *)malloc(length * sizeof(UChar));
-        if (buf != NULL) {
-            status = U_ZERO_ERROR;
-            uregex_group(regex, groupIndex, buf, length, &status);
-            if (U_SUCCESS(status)) {
-                result = [[NSString alloc] initWithCharacters:(const unichar *)buf length:length];
-            }
-            free(buf);
++ (void)saveProcessTypeCache {
+    @synchronized([CrashLog class]) {
+        if (processTypeCache$ != NULL) {
+            process_type_cache_save(processTypeCache$);
         }
     }
-
-    return result;
-}
-
-static int intFromString(const char *string, int length) {
-    int result = 0;
-    int i;
-    for (i = 0; i < length; ++i) {
-        char c = string[i];
-        if ((c >= '0') && (c <= '9')) {
-            result = result * 10 + (c - '0');
-        } else {
-            break;
-        }
-    }
-    return result;
-}
-
-static int intFromMatch(URegularExpression *regex, unsigned groupIndex) {
-    int result = 0;
-
-    NSString *string = newStringFromMatch(regex, groupIndex);
-    if (string != nil) {
-        const char *cstr = [string UTF8String];
-        result = intFromString(cstr, strlen(cstr));
-        [string release];
-    }
-
-    return result;
 }
 
 + (instancetype)crashLogWithFilepath:(NSString *)filepath {
@@ -162,57 +183,78 @@ static int intFromMatch(URegularExpression *regex, unsigned groupIndex) {
 
     // NOTE: For iOS < 9.3, the format of the filename is appname_datetime_devicename.
     //       For iOS >= 9.3, the format of the filename is appname-datetime.
-    static const char * const kRegexLogNameDatePre93 = "(.+)_(\\d{4})-(\\d{2})-(\\d{2})-(\\d{2})(\\d{2})(\\d{2})_[^_]+";
-    static const char * const kRegexLogNameDate = "(.+)-(\\d{4})-(\\d{2})-(\\d{2})-(\\d{2})(\\d{2})(\\d{2})";
-
-    const char * const pattern = IOS_LT(9_3) ? kRegexLogNameDatePre93 : kRegexLogNameDate;
-    URegularExpression *regex = prepareRegularExpression(pattern);
-    if (regex != NULL) {
-        NSString *basename = [filepath lastPathComponent];
-        while ([[basename pathExtension] length] > 0) {
-            basename = [basename stringByDeletingPathExtension];
-        }
-        if (matchesRegularExpression(regex, basename)) {
-            // Determine the log name.
-            NSString *name = newStringFromMatch(regex, 1);
-            if (name != nil) {
-                // Parse the log date.
-                NSDateComponents *components = [[NSDateComponents alloc] init];
-                [components setYear:intFromMatch(regex, 2)];
-                [components setMonth:intFromMatch(regex, 3)];
-                [components setDay:intFromMatch(regex, 4)];
-                [components setHour:intFromMatch(regex, 5)];
-                [components setMinute:intFromMatch(regex, 6)];
-                [components setSecond:intFromMatch(regex, 7)];
-                NSDate *date = [calendar() dateFromComponents:components];
-                [components release];
-
-                object = [[[self alloc] initWithFilepath:filepath name:name date:date] autorelease];
-
-                [name release];
-            }
+    static crashlog_name_format_t format;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        format = IOS_LT(9_3) ? CRASHLOG_NAME_FORMAT_PRE_9_3 : CRASHLOG_NAME_FORMAT_9_3;
+    });
+
+    const char *filename = [[filepath lastPathComponent] UTF8String];
+    crashlog_name_t parsed;
+    if (crashlog_name_parse(filename, format, &parsed)) {
+        // Determine the log name.
+        NSString *name = [[NSString alloc] initWithBytes:filename length:parsed.name_length encoding:NSUTF8StringEncoding];
+        if (name != nil) {
+            // Parse the log date.
+            const uint64_t timestamp = parsed.timestamp;
+            NSDateComponents *components = [[NSDateComponents alloc] init];
+            [components setYear:CRASHLOG_NAME_TIMESTAMP_YEAR(timestamp)];
+            [components setMonth:CRASHLOG_NAME_TIMESTAMP_MONTH(timestamp)];
+            [components setDay:CRASHLOG_NAME_TIMESTAMP_DAY(timestamp)];
+            [components setHour:CRASHLOG_NAME_TIMESTAMP_HOUR(timestamp)];
+            [components setMinute:CRASHLOG_NAME_TIMESTAMP_MINUTE(timestamp)];
+            [components setSecond:CRASHLOG_NAME_TIMESTAMP_SECOND(timestamp)];
+            NSDate *date = [calendar() dateFromComponents:components];
+            [components release];
+
+            object = [[[self alloc] initWithFilepath:filepath name:name date:date] autorelease];
+
+            [name release];
         }
-
-        uregex_close(regex);
     }
 
     return object;
 }
 
 - (instancetype)initWithFilepath:(NSString *)filepath name:(NSString *)name date:(NSDate *)date {
+    self = [self initWithFilepath:filepath name:name date:date
+        type:CrashLogTypeUnknown bugType:CrashLogBugTypeUnknown symbolicated:NO
+        fingerprint:CRASHLOG_FINGERPRINT_NONE];
+    if (self != nil) {
+        // NOTE: Fingerprint is determined from the log file on first access.
+        hasFingerprint_ = NO;
+    }
+    return self;
+}
+
+// NOTE: Used for creating crash log objects from previously cached metadata.
+//       Passing "unknown" types (or NO for symbolicated) causes the related
+//       properties to be determined from the log file on first access.
+// NOTE: The fingerprint is always taken as given, as "none" is a valid result
+//       (e.g. for low memory reports).
+- (instancetype)initWithFilepath:(NSString *)filepath name:(NSString *)name date:(NSDate *)date
+        type:(CrashLogType)type bugType:(CrashLogBugType)bugType symbolicated:(BOOL)symbolicated
+        fingerprint:(uint64_t)fingerprint {
     self = [super init];
     if (self != nil) {
         filepath_ = [filepath copy];
         logName_ = [name copy];
         logDate_ = [date retain];
-        type_ = CrashLogTypeUnknown;
-        bugType_ = CrashLogBugTypeUnknown;
+        type_ = type;
+        bugType_ = bugType;
+        symbolicated_ = symbolicated;
+        fingerprint_ = fingerprint;
+        hasFingerprint_ = YES;
+        loadLock_ = [[NSLock alloc] init];
     }
     return self;
 }
 
 - (void)dealloc {
+    [loadLock_ release];
     [report_ release];
+    [processPath_ release];
+    [processInfo_ release];
     [filepath_ release];
     [logName_ release];
     [logDate_ release];
@@ -224,35 +266,41 @@ static int intFromMatch(URegularExpression *regex, unsigned groupIndex) {
 
 #pragma mark - Loading
 
-static NSInteger compareBinaryImagePaths(CRBinaryImage *binaryImage1, CRBinaryImage *binaryImage2, void *context) {
-    NSString *name1 = [[binaryImage1 path] lastPathComponent];
-    NSString *name2 = [[binaryImage2 path] lastPathComponent];
-    return [name1 compare:name2];
-}
-
+// NOTE: Logs may be loaded from a background thread (see SymbolicationQueue).
+//       Loads are serialized, and the results are published together, only
+//       once complete, so that a partially-loaded log is never observed.
 - (BOOL)load {
-    if (!loaded_) {
-        CRCrashReport *report = [self report];
-        if (report != nil) {
-            NSString *filepath = [self filepath];
+    [loadLock_ lock];
+
+    if (![self isLoaded]) {
+        NSString *filepath = [self filepath];
+        NSString *outputFilepath = nil;
+        CRBinaryImage *victim = nil;
+        NSArray *suspects = nil;
+        NSArray *potentialSuspects = nil;
+        NSDictionary *processInfo = nil;
+
+        // Use the results saved when the log was symbolicated, if available.
+        // NOTE: This avoids loading and parsing the entire report.
+        if (!readSummaryForFile(filepath, &victim, &suspects, &potentialSuspects, &processInfo)) {
+            CRCrashReport *report = [self report];
+            if (report == nil) {
+                [loadLock_ unlock];
+                return NO;
+            }
 
             // Symbolicate (and blame) if necessary.
+            // NOTE: Symbolication also saves the results.
             if (!fileIsSymbolicated(filepath, report)) {
                 // Symbolicate.
-                NSString *outputFilepath = symbolicateFile(filepath, report);
-                if (outputFilepath != nil) {
-                    // Update name used for determining viewed state.
-                    if ([self isViewed]) {
-                        deleteViewedState(filepath);
-                        saveViewedState(outputFilepath);
-                    }
-
-                    // Update path for this crash log instance.
-                    [filepath_ release];
-                    filepath_ = [outputFilepath retain];
-                } else {
+                outputFilepath = symbolicateFile(filepath, report);
+                if (outputFilepath == nil) {
+                    [loadLock_ unlock];
                     return NO;
                 }
+
+                // Update name used for determining viewed state.
+                [[ViewedStateStore sharedInstance] moveFilepath:filepath toFilepath:outputFilepath];
             } else {
                 // Reprocess blame for log files that were symbolicated with
                 // older versions of CrashReporter.
@@ -267,188 +315,285 @@ static NSInteger compareBinaryImagePaths(CRBinaryImage *binaryImage1, CRBinaryIm
                 }
             }
 
-            // Determine path for victim.
-            NSString *victimPath = [[report processInfo] objectForKey:@"Path"];
-
-            // Collect victim and potential suspects.
-            NSMutableDictionary *blamableBinaries = [[NSMutableDictionary alloc] init];
-            for (CRBinaryImage *binaryImage in [[report binaryImages] allValues]) {
-                NSString *path = [binaryImage path];
-                if ([path isEqualToString:victimPath]) {
-                    NSAssert(victim_ == nil, @"ERROR: Two binary images have the exact same path.");
-                    victim_ = [binaryImage retain];
-                } else if ([binaryImage isBlamable]) {
-                    // Filter out trusted packages.
-                    NSString *identifier = binaryImage.package.identifier;
-                    if (![identifier isEqualToString:@"mobilesubstrate"] && ![identifier isEqualToString:@"crash-reporter"]) {
-                        [blamableBinaries setObject:binaryImage forKey:path];
-                    }
-                }
+            getBlameResults(report, &victim, &suspects, &potentialSuspects);
+            processInfo = [report processInfo];
+
+            // Save results for logs symbolicated elsewhere (or before results
+            // were saved).
+            if (outputFilepath == nil) {
+                writeSummaryForFile(filepath, victim, suspects, potentialSuspects, processInfo);
             }
+        }
 
-            // Collect suspects.
-            NSMutableArray *suspects = [[NSMutableArray alloc] init];
-            NSArray *suspectPaths = [[report properties] objectForKey:kCrashReportBlame];
-            for (NSString *suspectPath in suspectPaths) {
-                CRBinaryImage *binaryImage = [blamableBinaries objectForKey:suspectPath];
-                if (binaryImage != nil) {
-                    [suspects addObject:binaryImage];
-                    [blamableBinaries removeObjectForKey:suspectPath];
-                }
+        // Publish results.
+        @synchronized(self) {
+            if (outputFilepath != nil) {
+                // Update path for this crash log instance.
+                [filepath_ release];
+                filepath_ = [outputFilepath retain];
+                symbolicated_ = YES;
             }
-            suspects_ = suspects;
+            victim_ = [victim retain];
+            suspects_ = [suspects retain];
+            potentialSuspects_ = [potentialSuspects retain];
+            processInfo_ = [processInfo retain];
+            loaded_ = YES;
+
+            // NOTE: The parsed report is large, and is not needed once the
+            //       results have been determined.
+            [report_ release];
+            report_ = nil;
+        }
+    }
 
-            // Collect potential suspects.
-            potentialSuspects_ = [[[blamableBinaries allValues] sortedArrayUsingFunction:compareBinaryImagePaths context:NULL] retain];
-            [blamableBinaries release];
+    [loadLock_ unlock];
 
-            // Ensure that we at least have information for the victim.
-            // NOTE: Some reports do not contain binary image information.
-            if (victim_ == nil) {
-                victim_ = [[CRBinaryImage alloc] initWithPath:victimPath address:0 size:0 architecture:nil uuid:nil];
+    return [self isLoaded];
+}
+
+#pragma mark - Header
+
+// NOTE: The header contains enough information to determine the bug type and
+//       the type of the crashed process; the full report is not parsed until
+//       it is actually needed (i.e. when the log is loaded).
+- (BOOL)readHeader {
+    @synchronized(self) {
+        if (!hasReadHeader_) {
+            headerBugType_ = CRASHLOG_HEADER_BUG_TYPE_UNKNOWN;
+
+            crashlog_header_t header;
+            if (headerForFile([self filepath], &header)) {
+                headerBugType_ = header.bug_type;
+                if (header.process_path[0] != '\0') {
+                    processPath_ = [[NSString alloc] initWithUTF8String:header.process_path];
+                }
+                hasHeader_ = YES;
             }
 
-            loaded_ = YES;
+            hasReadHeader_ = YES;
         }
+        return hasHeader_;
     }
-
-    return loaded_;
 }
 
 #pragma mark - Properties
 
+// NOTE: The path changes if the log is symbolicated, which may happen on a
+//       background thread.
+- (NSString *)filepath {
+    @synchronized(self) {
+        return [[filepath_ retain] autorelease];
+    }
+}
+
+- (BOOL)isLoaded {
+    @synchronized(self) {
+        return loaded_;
+    }
+}
+
 - (CRCrashReport *)report {
-    if (report_ == nil) {
+    CRCrashReport *report;
+    @synchronized(self) {
+        report = [[report_ retain] autorelease];
+    }
+
+    if (report == nil) {
+        // NOTE: The report is parsed outside of the lock; if another thread
+        //       parses it at the same time, the first result is kept.
         NSString *filepath = [self filepath];
         NSData *data = dataForFile(filepath);
         if (data != nil) {
-            report_ = [[CRCrashReport alloc] initWithData:data filterType:CRCrashReportFilterTypePackage];
+            report = [[CRCrashReport alloc] initWithData:data filterType:CRCrashReportFilterTypePackage];
+            [data release];
+
+            @synchronized(self) {
+                if (report_ == nil) {
+                    report_ = [report retain];
+                }
+                [report release];
+                report = [[report_ retain] autorelease];
+            }
         }
     }
-    return report_;
+    return report;
 }
 
+// NOTE: The report and the results are replaced by -load, which may run on a
+//       background thread; the properties derived from them are determined
+//       from a snapshot taken under the same lock, and are published under it.
 - (CrashLogType)type {
-    if (type_ == CrashLogTypeUnknown) {
-        type_ = CrashLogTypeService;
-
-        // Determine bundle path.
-        // NOTE: Process may not be from a bundle.
-        NSString *bundlePath = nil;
-        NSString *processPath = [[[self report] processInfo] objectForKey:@"Path"];
-        NSArray *components = [processPath componentsSeparatedByString:@"/"];
-        for (NSUInteger n = [components count]; n > 0; --n) {
-            NSString *component = [components objectAtIndex:(n - 1)];
-            if (
-                [component hasSuffix:@".app"] ||
-                [component hasSuffix:@".appex"]
-               ) {
-                bundlePath = [[components subarrayWithRange:NSMakeRange(0, n)] componentsJoinedByString:@"/"];
-                break;
-            }
+    CrashLogType type;
+    NSDictionary *processInfo;
+    BOOL hasReport;
+    @synchronized(self) {
+        type = type_;
+        processInfo = [[processInfo_ retain] autorelease];
+        hasReport = (report_ != nil);
+    }
+
+    if (type == CrashLogTypeUnknown) {
+        // NOTE: Use the path from the header of the log file, if available, in
+        //       order to avoid parsing the full report.
+        // NOTE: Some report types (e.g. low memory) do not include a path.
+        // NOTE: Once loaded, the path is also available from the results.
+        NSString *processPath = nil;
+        if (processInfo != nil) {
+            processPath = [processInfo objectForKey:@"Path"];
+        } else if (!hasReport && [self readHeader]) {
+            processPath = processPath_;
+        } else {
+            processPath = [[[self report] processInfo] objectForKey:@"Path"];
         }
+        type = typeForProcessPath(processPath);
 
-        if (bundlePath != nil) {
-            // Use bundle path to determine type.
-            NSBundle *bundle = [NSBundle bundleWithPath:bundlePath];
-            if (bundle != nil) {
-                char *executablePath = realpath([[bundle executablePath] UTF8String], NULL);
-                if (executablePath != NULL) {
-                    if (strcmp(executablePath, [processPath UTF8String]) == 0) {
-                        NSDictionary *infoDictionary = [bundle infoDictionary];
-                        id object = [infoDictionary objectForKey:@"CFBundlePackageType"];
-                        if ([object isKindOfClass:[NSString class]]) {
-                            NSString *packageType = object;
-                            if ([packageType isEqualToString:@"APPL"]) {
-                                type_ = CrashLogTypeApp;
-                            } else if ([packageType isEqualToString:@"XPC!"]) {
-                                object = [infoDictionary objectForKey:@"NSExtension"];
-                                if (object != nil) {
-                                    type_ = CrashLogTypeAppExtension;
-                                }
-                            }
-                        }
-                    }
+        @synchronized(self) {
+            type_ = type;
+        }
+    }
 
-                    free(executablePath);
-                }
-            } else {
-                // Bundle no longer installed; make intelligent guess.
-                // NOTE: This should always work for AppStore app bundles, but may be
-                //       incorrect for other app bundles.
-                if ([bundlePath hasSuffix:@".app"]) {
-                    type_ = CrashLogTypeApp;
-                } else if ([bundlePath hasSuffix:@".appex"]) {
-                    type_ = CrashLogTypeAppExtension;
-                }
+    return type;
+}
+
+- (CrashLogBugType)bugType {
+    CrashLogBugType bugType;
+    BOOL hasReport;
+    @synchronized(self) {
+        bugType = bugType_;
+        hasReport = (report_ != nil);
+    }
+
+    if (bugType == CrashLogBugTypeUnknown) {
+        // NOTE: Use the bug type from the header of the log file, if available,
+        //       in order to avoid parsing the full report.
+        if (!hasReport && [self readHeader]) {
+            switch (headerBugType_) {
+                case CRASHLOG_HEADER_BUG_TYPE_UNKNOWN:
+                    break;
+                case CRASHLOG_HEADER_BUG_TYPE_CRASH:
+                    bugType = CrashLogBugTypeCrash;
+                    break;
+                case CRASHLOG_HEADER_BUG_TYPE_LOW_MEMORY:
+                    bugType = CrashLogBugTypeLowMemory;
+                    break;
+                default:
+                    bugType = CrashLogBugTypeOther;
+            }
+        }
+
+        if (bugType == CrashLogBugTypeUnknown) {
+            CRCrashReportType type = [[self report] type];
+            switch (type) {
+                case CRCrashReportTypeCrash:
+                    bugType = CrashLogBugTypeCrash;
+                    break;
+                case CRCrashReportTypeLowMemory:
+                    bugType = CrashLogBugTypeLowMemory;
+                    break;
+                default:
+                    bugType = CrashLogBugTypeOther;
             }
         }
+
+        @synchronized(self) {
+            bugType_ = bugType;
+        }
     }
 
-    return type_;
+    return bugType;
 }
 
-- (CrashLogBugType)bugType {
-    if (bugType_ == CrashLogBugTypeUnknown) {
-        CRCrashReportType type = [[self report] type];
-        switch (type) {
-            case CRCrashReportTypeCrash:
-                bugType_ = CrashLogBugTypeCrash;
-                break;
-            case CRCrashReportTypeLowMemory:
-                bugType_ = CrashLogBugTypeLowMemory;
-                break;
-            default:
-                bugType_ = CrashLogBugTypeOther;
+// NOTE: Reading the fingerprint requires reading most of the log file; the
+//       result is cached in the index (see CrashLogGroup).
+// NOTE: The file is read outside of the lock; if another thread reads it at
+//       the same time, the first result is kept.
+- (uint64_t)fingerprint {
+    @synchronized(self) {
+        if (hasFingerprint_) {
+            return fingerprint_;
         }
     }
 
-    return bugType_;
+    uint64_t fingerprint = CRASHLOG_FINGERPRINT_NONE;
+    fingerprintForFile([self filepath], &fingerprint);
+
+    @synchronized(self) {
+        if (!hasFingerprint_) {
+            fingerprint_ = fingerprint;
+            hasFingerprint_ = YES;
+        }
+        return fingerprint_;
+    }
 }
 
 - (BOOL)isSymbolicated {
-    return fileIsSymbolicated([self filepath], nil);
+    BOOL symbolicated;
+    CRCrashReport *report;
+    @synchronized(self) {
+        symbolicated = symbolicated_;
+        report = [[report_ retain] autorelease];
+    }
+
+    // NOTE: Once a log has been symbolicated, it cannot be unsymbolicated.
+    if (!symbolicated) {
+        symbolicated = fileIsSymbolicated([self filepath], report);
+        if (symbolicated) {
+            @synchronized(self) {
+                symbolicated_ = YES;
+            }
+        }
+    }
+    return symbolicated;
 }
 
 - (BOOL)isViewed {
     // NOTE: Once a log has been viewed, it cannot be unviewed.
     if (!viewed_) {
-        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-        NSString *filepath = [self filepath];
-        viewed_ = [[defaults arrayForKey:kViewedCrashLogs] containsObject:filepath];
+        viewed_ = [[ViewedStateStore sharedInstance] isViewed:[self filepath]];
     }
     return viewed_;
 }
 
 - (void)setViewed:(BOOL)viewed {
-    if (viewed_ != viewed) {
-        if (!viewed_) {
-            saveViewedState([self filepath]);
-            viewed_ = YES;
-        }
+    // NOTE: Once a log has been viewed, it cannot be unviewed.
+    if (viewed && !viewed_) {
+        [CrashLog markCrashLogsAsViewed:[NSArray arrayWithObject:self]];
     }
 }
 
-#pragma mark - Other
-
-- (BOOL)delete {
-    NSString *filepath = [self filepath];
-
-    const BOOL didDelete = deleteFile(filepath);
-    if (didDelete) {
-        // Also delete the associated syslog file.
-        // TODO: Should also update any associated "Latest-" links.
-        NSString *syslogPath = syslogPathForFile(filepath);
-        if (syslogPath != nil) {
-            deleteFile(syslogPath);
+// NOTE: The viewed state of the logs is recorded together, and each process is
+//       acknowledged only once (e.g. for all occurrences of a cluster).
++ (void)markCrashLogsAsViewed:(NSArray *)crashLogs {
+    NSMutableArray *filepaths = [[NSMutableArray alloc] init];
+    NSMutableSet *names = [[NSMutableSet alloc] init];
+    for (CrashLog *crashLog in crashLogs) {
+        if (!crashLog->viewed_) {
+            [filepaths addObject:[crashLog filepath]];
+            [names addObject:[crashLog logName]];
+            crashLog->viewed_ = YES;
+
+            // Update count of unviewed logs of the containing group.
+            [crashLog->group_ crashLogWasViewed:crashLog];
         }
+    }
 
-        // Remove from list of viewed entries.
-        if ([self isViewed]) {
-            deleteViewedState(filepath);
-        }
+    if ([filepaths count] != 0) {
+        [[ViewedStateStore sharedInstance] addFilepaths:filepaths];
+
+        // NOTE: Once a log of a crash-looping process has been viewed,
+        //       notifier resumes processing crashes of that process.
+        // NOTE: Acknowledging requires locking and rewriting the crash rate
+        //       file; this is done in the background.
+        NSArray *allNames = [names allObjects];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            for (NSString *name in allNames) {
+                crash_rate_acknowledge(kCrashRateFilepath, [name UTF8String]);
+            }
+        });
     }
-    return didDelete;
+
+    [names release];
+    [filepaths release];
 }
 
 @end
@@ -0,0 +1,31 @@
+/**
+ * Name: CrashReporter
+ * Type: iOS application
+ * Desc: iOS app for viewing the details of a crash, determining the possible
+ *       cause of said crash, and reporting this information to the developer(s)
+ *       responsible.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import <Foundation/Foundation.h>
+
+@class CrashLog;
+
+// NOTE: A cluster is a set of crash logs with the same fingerprint (i.e.
+//       repeated occurrences of the same crash).
+@interface CrashLogCluster : NSObject
+@property(nonatomic, readonly) uint64_t fingerprint;
+@property(nonatomic, readonly) NSArray *crashLogs;
+@property(nonatomic, readonly) CrashLog *latestCrashLog;
+@property(nonatomic, readonly) NSDate *firstDate;
+@property(nonatomic, readonly) NSDate *lastDate;
+@property(nonatomic, readonly) NSUInteger count;
+@property(nonatomic, readonly, getter = isViewed) BOOL viewed;
++ (NSArray *)clustersForCrashLogs:(NSArray *)crashLogs;
+- (instancetype)initWithFingerprint:(uint64_t)fingerprint;
+- (void)addCrashLog:(CrashLog *)crashLog;
+@end
+
+/* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
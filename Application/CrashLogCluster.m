@@ -0,0 +1,105 @@
+/**
+ * Name: CrashReporter
+ * Type: iOS application
+ * Desc: iOS app for viewing the details of a crash, determining the possible
+ *       cause of said crash, and reporting this information to the developer(s)
+ *       responsible.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import "CrashLogCluster.h"
+
+#import "CrashLog.h"
+
+#include "crashlog_fingerprint.h"
+
+@implementation CrashLogCluster {
+    NSMutableArray *crashLogs_;
+}
+
+@synthesize fingerprint = fingerprint_;
+@synthesize crashLogs = crashLogs_;
+
+// NOTE: Crash logs are expected to be sorted from newest to oldest; clusters
+//       are returned in the same order, by their latest crash log.
++ (NSArray *)clustersForCrashLogs:(NSArray *)crashLogs {
+    NSMutableArray *clusters = [NSMutableArray array];
+    NSMutableDictionary *clustersByFingerprint = [[NSMutableDictionary alloc] init];
+
+    for (CrashLog *crashLog in crashLogs) {
+        const uint64_t fingerprint = [crashLog fingerprint];
+
+        // NOTE: Logs without a fingerprint cannot be compared, and so are
+        //       never grouped.
+        CrashLogCluster *cluster = nil;
+        NSNumber *key = nil;
+        if (fingerprint != CRASHLOG_FINGERPRINT_NONE) {
+            key = [[NSNumber alloc] initWithUnsignedLongLong:fingerprint];
+            cluster = [clustersByFingerprint objectForKey:key];
+        }
+        if (cluster == nil) {
+            cluster = [[self alloc] initWithFingerprint:fingerprint];
+            [clusters addObject:cluster];
+            if (key != nil) {
+                [clustersByFingerprint setObject:cluster forKey:key];
+            }
+            [cluster release];
+        }
+        [cluster addCrashLog:crashLog];
+        [key release];
+    }
+
+    [clustersByFingerprint release];
+    return clusters;
+}
+
+- (instancetype)initWithFingerprint:(uint64_t)fingerprint {
+    self = [super init];
+    if (self != nil) {
+        fingerprint_ = fingerprint;
+        crashLogs_ = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [crashLogs_ release];
+    [super dealloc];
+}
+
+- (void)addCrashLog:(CrashLog *)crashLog {
+    [crashLogs_ addObject:crashLog];
+}
+
+#pragma mark - Properties
+
+- (CrashLog *)latestCrashLog {
+    return ([crashLogs_ count] != 0) ? [crashLogs_ objectAtIndex:0] : nil;
+}
+
+- (NSDate *)firstDate {
+    return [[crashLogs_ lastObject] logDate];
+}
+
+- (NSDate *)lastDate {
+    return [[self latestCrashLog] logDate];
+}
+
+- (NSUInteger)count {
+    return [crashLogs_ count];
+}
+
+- (BOOL)isViewed {
+    for (CrashLog *crashLog in crashLogs_) {
+        if (![crashLog isViewed]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@end
+
+/* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
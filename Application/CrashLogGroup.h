@@ -26,15 +26,31 @@ typedef enum : NSUInteger {
 @interface CrashLogGroup : NSObject
 @property (nonatomic, readonly) NSString *name;
 @property (nonatomic, readonly) NSString *logDirectory;
+// NOTE: Sorted from newest to oldest.
 @property (nonatomic, readonly) NSArray *crashLogs;
+@property (nonatomic, readonly) NSArray *clusters;
 @property (nonatomic, readonly) CrashLogGroupType type;
+@property (nonatomic, readonly) CrashLog *latestCrashLog;
+@property (nonatomic, readonly) NSDate *latestDate;
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSUInteger unviewedCount;
 + (NSArray *)groupsForType:(CrashLogGroupType)type;
 + (void)forgetGroups;
++ (void)updateGroups;
+// NOTE: Files are deleted in the background; progress and completion are
+//       reported on the main thread. The total count includes syslog, summary
+//       and "LatestCrash-*" files.
++ (void)deleteGroups:(NSArray *)groups progress:(void (^)(NSUInteger deletedCount, NSUInteger totalCount))progress completion:(void (^)(BOOL didDelete))completion;
 + (instancetype)groupWithName:(NSString *)name logDirectory:(NSString *)logDirectory;
 - (instancetype)initWithName:(NSString *)name logDirectory:(NSString *)logDirectory;
 - (void)addCrashLog:(CrashLog *)crashLog;
-- (BOOL)delete;
-- (BOOL)deleteCrashLog:(CrashLog *)crashLog;
+// NOTE: As +deleteGroups:progress:completion:; the completion is called on the
+//       main thread, once the logs have been removed from the group.
+- (void)deleteWithCompletion:(void (^)(BOOL didDelete))completion;
+- (void)deleteCrashLog:(CrashLog *)crashLog completion:(void (^)(BOOL didDelete))completion;
+- (void)deleteCrashLogs:(NSArray *)crashLogs completion:(void (^)(BOOL didDelete))completion;
+// NOTE: Called by a crash log of the group when it is marked as viewed.
+- (void)crashLogWasViewed:(CrashLog *)crashLog;
 @end
 
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
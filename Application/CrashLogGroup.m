@@ -11,6 +11,17 @@
 
 #import "CrashLogGroup.h"
 
+#import "CrashLogCluster.h"
+#import "SymbolicationQueue.h"
+#import "ViewedStateStore.h"
+#import "crashlog_util.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include "crashlog_fingerprint.h"
+#include "crashlog_index.h"
+#include "dir_watcher.h"
+#include "log_compression.h"
 #include "paths.h"
 
 static NSMutableArray *crashLogGroups$ = nil;
@@ -19,32 +30,126 @@ static NSMutableArray *appCrashLogGroups$ = nil;
 static NSMutableArray *appExtensionCrashLogGroups$ = nil;
 static NSMutableArray *serviceCrashLogGroups$ = nil;
 
+// NOTE: Once the groups have been loaded, changes to the log directories are
+//       applied to the existing groups rather than rescanning the directories.
+static dir_watcher_t *mobileWatcher$ = NULL;
+static dir_watcher_t *rootWatcher$ = NULL;
+static BOOL needsRescan$ = NO;
+
+// NOTE: On iOS < 9.3, logs are written in place, and so a log can be seen
+//       before it has been completely written; such logs are added once they
+//       have stopped changing (see addCrashLogForFile()).
+static const time_t kLogWriteSettleInterval = 2;
+static NSMutableDictionary *pendingFileStates$ = nil;
+
+typedef struct {
+    NSString *directory;
+    crashlog_index_t *index;
+} DirectoryEventContext;
+
+@interface CrashLogGroup ()
+- (CrashLog *)crashLogWithFilepath:(NSString *)filepath;
+- (void)removeCrashLog:(CrashLog *)crashLog;
+- (void)removeCrashLogAtIndex:(NSUInteger)index;
+- (void)forgetCaches;
+@end
+
+static CrashLog *crashLogFromIndex(crashlog_index_t *index, NSString *filepath, const struct stat *st) {
+    CrashLog *crashLog = nil;
+
+    crashlog_index_info_t info;
+    if (crashlog_index_lookup(index, [[filepath lastPathComponent] UTF8String], st, &info)) {
+        NSString *name = [[NSString alloc] initWithUTF8String:info.name];
+        NSDate *date = [[NSDate alloc] initWithTimeIntervalSince1970:info.log_date];
+        crashLog = [[CrashLog alloc] initWithFilepath:filepath name:name date:date
+            type:(CrashLogType)info.type bugType:(CrashLogBugType)info.bug_type
+            symbolicated:((info.flags & CRASHLOG_INDEX_FLAG_SYMBOLICATED) != 0)
+            fingerprint:info.fingerprint];
+        [date release];
+        [name release];
+    }
+
+    return [crashLog autorelease];
+}
+
+static void addCrashLogToIndex(crashlog_index_t *index, CrashLog *crashLog, const struct stat *st) {
+    crashlog_index_info_t info;
+    info.name = [[crashLog logName] UTF8String];
+    info.log_date = (int64_t)[[crashLog logDate] timeIntervalSince1970];
+    info.bug_type = [crashLog bugType];
+    // NOTE: The type is only needed for logs that are actually listed.
+    info.type = ([crashLog bugType] != CrashLogBugTypeOther) ? [crashLog type] : CrashLogTypeUnknown;
+    info.flags = [crashLog isSymbolicated] ? CRASHLOG_INDEX_FLAG_SYMBOLICATED : 0;
+    // NOTE: Computed once, when the log is first indexed, so that grouping
+    //       identical crashes never requires reading the log files again.
+    info.fingerprint = ([crashLog bugType] != CrashLogBugTypeOther) ? [crashLog fingerprint] : CRASHLOG_FINGERPRINT_NONE;
+    crashlog_index_update(index, [[[crashLog filepath] lastPathComponent] UTF8String], st, &info);
+}
+
+// NOTE: Returns nil if the file is not a crash-related log.
+static CrashLog *crashLogForFile(NSString *filepath, crashlog_index_t *index) {
+    struct stat st;
+    BOOL hasIdentity = (index != NULL) && (stat([filepath fileSystemRepresentation], &st) == 0);
+    CrashLog *crashLog = hasIdentity ? crashLogFromIndex(index, filepath, &st) : nil;
+    if (crashLog == nil) {
+        crashLog = [CrashLog crashLogWithFilepath:filepath];
+        if ((crashLog != nil) && hasIdentity) {
+            addCrashLogToIndex(index, crashLog, &st);
+        }
+    }
+    if (crashLog != nil) {
+        // Filter out non crash-related logs.
+        // NOTE: Determining the bug type requires parsing the crash report,
+        //       which is time consuming; the result is cached in the index.
+        // NOTE: Not required on iOS versions before 9.3, where the filenames
+        //       of crash-relatd logs differ from other log types.
+        if (IOS_GTE(9_3)) {
+            if ([crashLog bugType] == CrashLogBugTypeOther) {
+                crashLog = nil;
+            }
+        }
+    }
+    return crashLog;
+}
+
+// NOTE: Results are saved (see writeSummaryForFile()) for each log that is
+//       loaded; those for logs that have since been deleted are removed here.
+static void pruneSummariesForDirectory(NSString *directory, NSArray *contents) {
+    NSFileManager *fileMan = [NSFileManager defaultManager];
+    NSString *summaryDirectory = summaryDirectoryForDirectory(directory);
+    // NOTE: The summary of a compressed log is that of the original log.
+    NSMutableSet *filenames = [[NSMutableSet alloc] initWithCapacity:[contents count]];
+    for (NSString *filename in contents) {
+        [filenames addObject:uncompressedPathForFile(filename)];
+    }
+    for (NSString *filename in [fileMan contentsOfDirectoryAtPath:summaryDirectory error:NULL]) {
+        if (![filenames containsObject:filename]) {
+            [fileMan removeItemAtPath:[summaryDirectory stringByAppendingPathComponent:filename] error:NULL];
+        }
+    }
+    [filenames release];
+}
+
 static NSArray *crashLogGroupsForDirectory(NSString *directory) {
     NSMutableDictionary *groups = [NSMutableDictionary dictionary];
-    NSMutableArray *existentFilepaths = [[NSMutableArray alloc] init];
+    NSMutableSet *existentFilepaths = [[NSMutableSet alloc] init];
 
-    // Look in path for crash log files; group logs by app name.
+    // Load index of metadata from previous scans.
+    // NOTE: Parsing a crash report is time consuming; only files that are new
+    //       or that have changed since the previous scan need to be parsed.
     NSFileManager *fileMan = [NSFileManager defaultManager];
+    [fileMan createDirectoryAtPath:@kCacheDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+    crashlog_index_t *index = crashlog_index_open([indexPathForDirectory(directory) fileSystemRepresentation]);
+
+    // Look in path for crash log files; group logs by app name.
     NSError *error = nil;
     NSArray *contents = [fileMan contentsOfDirectoryAtPath:directory error:&error];
     if (contents != nil) {
         for (NSString *filename in contents) {
-            if ([filename hasSuffix:@"ips"] || [filename hasSuffix:@"plist"] || [filename hasSuffix:@"synced"]) {
+            if (isCrashLogFilename(filename)) {
                 NSString *filepath = [directory stringByAppendingPathComponent:filename];
-                CrashLog *crashLog = [CrashLog crashLogWithFilepath:filepath];
+                CrashLog *crashLog = crashLogForFile(filepath, index);
                 if (crashLog != nil) {
-                    // Filter out non crash-related logs.
-                    // NOTE: Determining the bug type requires parsing the crash
-                    //       report, which is time consuming.
-                    // NOTE: Not required on iOS versions before 9.3, where the
-                    //       filenames of crash-relatd logs differ from other
-                    //       log types.
-                    if (IOS_GTE(9_3)) {
-                        if ([crashLog bugType] == CrashLogBugTypeOther) {
-                            continue;
-                        }
-                    }
-
                     // Store filepath for "known viewed" check below.
                     [existentFilepaths addObject:filepath];
 
@@ -64,20 +169,19 @@ static NSArray *crashLogGroupsForDirectory(NSString *directory) {
         NSLog(@"ERROR: Unable to retrieve contents of directory \"%@\": %@", directory, [error localizedDescription]);
     }
 
-    // Update list of viewed crash logs, removing entries that no longer exist.
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-    NSArray *oldViewedCrashLogs = [defaults arrayForKey:kViewedCrashLogs];
-    NSMutableArray *newViewedCrashLogs = [[NSMutableArray alloc] initWithArray:oldViewedCrashLogs];
-    for (NSString *filepath in oldViewedCrashLogs) {
-        if ([[filepath stringByDeletingLastPathComponent] isEqualToString:directory]) {
-            if (![existentFilepaths containsObject:filepath]) {
-                [newViewedCrashLogs removeObject:filepath];
-            }
+    // Save index; entries for files that no longer exist are dropped.
+    if (index != NULL) {
+        if (contents != nil) {
+            crashlog_index_save(index);
         }
+        crashlog_index_close(index);
+    }
+
+    // Update list of viewed crash logs, removing entries that no longer exist.
+    if (contents != nil) {
+        [[ViewedStateStore sharedInstance] pruneDirectory:directory existentFilepaths:existentFilepaths];
+        pruneSummariesForDirectory(directory, contents);
     }
-    [defaults setObject:newViewedCrashLogs forKey:kViewedCrashLogs];
-    [defaults synchronize];
-    [newViewedCrashLogs release];
     [existentFilepaths release];
 
     return [groups allValues];
@@ -87,12 +191,32 @@ static NSInteger compareCrashLogGroups(CrashLogGroup *a, CrashLogGroup *b, void
     return [[a name] compare:[b name] options:NSCaseInsensitiveSearch];
 }
 
+// NOTE: Logs are ordered from newest to oldest by their (numeric) date; logs
+//       with the same date are ordered by filepath.
 static NSInteger reverseCompareCrashLogs(CrashLog *a, CrashLog *b, void *context) {
+    const NSTimeInterval aTime = [[a logDate] timeIntervalSinceReferenceDate];
+    const NSTimeInterval bTime = [[b logDate] timeIntervalSinceReferenceDate];
+    if (aTime != bTime) {
+        return (aTime > bTime) ? NSOrderedAscending : NSOrderedDescending;
+    }
     return [[b filepath] compare:[a filepath]];
 }
 
+static void closeWatchers() {
+    dir_watcher_close(mobileWatcher$);
+    mobileWatcher$ = NULL;
+    dir_watcher_close(rootWatcher$);
+    rootWatcher$ = NULL;
+}
+
 static NSArray *crashLogGroups() {
     if (crashLogGroups$ == nil) {
+        // NOTE: Watchers are opened before scanning so that no change is
+        //       missed; changes that are seen by both are ignored.
+        closeWatchers();
+        mobileWatcher$ = dir_watcher_open(kCrashLogDirectoryForMobile);
+        rootWatcher$ = dir_watcher_open(kCrashLogDirectoryForRoot);
+
         NSMutableArray *groups = [[NSMutableArray alloc] init];
         [groups addObjectsFromArray:crashLogGroupsForDirectory(@kCrashLogDirectoryForMobile)];
         [groups addObjectsFromArray:crashLogGroupsForDirectory(@kCrashLogDirectoryForRoot)];
@@ -109,15 +233,432 @@ static NSArray *crashLogGroupsForType(CrashLogGroupType type) {
             [groups addObject:group];
         }
     }
+
+    // NOTE: Determining the types may have required examining app bundles.
+    [CrashLog saveProcessTypeCache];
+
     return groups;
 }
 
+static void forgetGroupsForType() {
+    [appCrashLogGroups$ release];
+    appCrashLogGroups$ = nil;
+    [appExtensionCrashLogGroups$ release];
+    appExtensionCrashLogGroups$ = nil;
+    [serviceCrashLogGroups$ release];
+    serviceCrashLogGroups$ = nil;
+}
+
+static CrashLogGroup *groupForName(NSString *name, NSString *directory) {
+    for (CrashLogGroup *group in crashLogGroups$) {
+        if ([[group name] isEqualToString:name] && [[group logDirectory] isEqualToString:directory]) {
+            return group;
+        }
+    }
+    return nil;
+}
+
+// NOTE: A file is considered to be completely written if it has not changed
+//       since it was last seen, and has not been modified recently.
+static BOOL fileHasSettled(const struct stat *st, NSData *previousState) {
+    if (previousState != nil) {
+        const struct stat *previous = (const struct stat *)[previousState bytes];
+        if ((st->st_size != previous->st_size) || (st->st_mtime != previous->st_mtime)) {
+            return NO;
+        }
+    }
+    return ((time(NULL) - st->st_mtime) >= kLogWriteSettleInterval);
+}
+
+static void addCrashLogForFile(NSString *directory, NSString *filename, crashlog_index_t *index) {
+    if (!isCrashLogFilename(filename)) {
+        return;
+    }
+
+    NSString *filepath = [directory stringByAppendingPathComponent:filename];
+    for (CrashLogGroup *group in crashLogGroups$) {
+        if ([group crashLogWithFilepath:filepath] != nil) {
+            // Already known (e.g. renamed by this app after symbolication).
+            [pendingFileStates$ removeObjectForKey:filepath];
+            return;
+        }
+    }
+
+    // Defer adding logs that may still be being written.
+    // NOTE: From iOS 9.3, logs are written to a temporary file that is renamed
+    //       once complete.
+    if (IOS_LT(9_3)) {
+        struct stat st;
+        if (stat([filepath fileSystemRepresentation], &st) != 0) {
+            [pendingFileStates$ removeObjectForKey:filepath];
+            return;
+        }
+        if (!fileHasSettled(&st, [pendingFileStates$ objectForKey:filepath])) {
+            if (pendingFileStates$ == nil) {
+                pendingFileStates$ = [[NSMutableDictionary alloc] init];
+            }
+            [pendingFileStates$ setObject:[NSData dataWithBytes:&st length:sizeof(st)] forKey:filepath];
+            return;
+        }
+        [pendingFileStates$ removeObjectForKey:filepath];
+    }
+
+    CrashLog *crashLog = crashLogForFile(filepath, index);
+    if (crashLog != nil) {
+        NSString *name = [crashLog logName];
+        CrashLogGroup *group = groupForName(name, directory);
+        if (group == nil) {
+            group = [[CrashLogGroup alloc] initWithName:name logDirectory:directory];
+
+            // Insert new group in sorted position.
+            NSUInteger index = 0;
+            const NSUInteger count = [crashLogGroups$ count];
+            while ((index < count) && (compareCrashLogGroups([crashLogGroups$ objectAtIndex:index], group, NULL) == NSOrderedAscending)) {
+                ++index;
+            }
+            [crashLogGroups$ insertObject:group atIndex:index];
+            [group release];
+
+            forgetGroupsForType();
+        }
+        [group addCrashLog:crashLog];
+    }
+}
+
+// NOTE: Logs that were still being written when last seen are checked again.
+static void addPendingCrashLogsForDirectory(NSString *directory, crashlog_index_t *index) {
+    for (NSString *filepath in [pendingFileStates$ allKeys]) {
+        if ([[filepath stringByDeletingLastPathComponent] isEqualToString:directory]) {
+            addCrashLogForFile(directory, [filepath lastPathComponent], index);
+        }
+    }
+}
+
+static void removeCrashLogForFile(NSString *directory, NSString *filename) {
+    NSString *filepath = [directory stringByAppendingPathComponent:filename];
+    [pendingFileStates$ removeObjectForKey:filepath];
+
+    CrashLogGroup *group = nil;
+    CrashLog *crashLog = nil;
+    for (group in crashLogGroups$) {
+        crashLog = [group crashLogWithFilepath:filepath];
+        if (crashLog != nil) {
+            break;
+        }
+    }
+
+    if (crashLog != nil) {
+        [group removeCrashLog:crashLog];
+
+        // NOTE: A log that was removed as it was compressed (see
+        //       compressFile()) keeps its viewed state.
+        NSString *compressedPath = [filepath stringByAppendingPathExtension:@kCompressedPathExtension];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:compressedPath]) {
+            [[ViewedStateStore sharedInstance] removeFilepath:filepath];
+        }
+
+        // Remove group if it is now empty.
+        if ([group count] == 0) {
+            [crashLogGroups$ removeObject:group];
+            forgetGroupsForType();
+        }
+    }
+}
+
+static void handleDirectoryEvent(dir_watcher_event_t event, const char *name, void *context) {
+    DirectoryEventContext *eventContext = (DirectoryEventContext *)context;
+    switch (event) {
+        case DIR_WATCHER_EVENT_ADDED:
+            addCrashLogForFile(eventContext->directory, [NSString stringWithUTF8String:name], eventContext->index);
+            break;
+        case DIR_WATCHER_EVENT_REMOVED:
+            removeCrashLogForFile(eventContext->directory, [NSString stringWithUTF8String:name]);
+            break;
+        case DIR_WATCHER_EVENT_OVERFLOW:
+        default:
+            needsRescan$ = YES;
+            break;
+    }
+}
+
+// NOTE: Added logs are looked up in, and added to, the same index that is used
+//       when scanning the whole directory. Returns NO if the directory must be
+//       rescanned.
+static BOOL applyChangesToDirectory(dir_watcher_t *watcher, NSString *directory) {
+    crashlog_index_t *index = crashlog_index_open([indexPathForDirectory(directory) fileSystemRepresentation]);
+    if (index != NULL) {
+        // NOTE: Entries for files that were not changed must be kept.
+        crashlog_index_keep_all(index);
+    }
+
+    DirectoryEventContext context = {directory, index};
+    const BOOL succeeded = (dir_watcher_poll(watcher, handleDirectoryEvent, &context) >= 0);
+    if (succeeded) {
+        addPendingCrashLogsForDirectory(directory, index);
+    }
+
+    if (index != NULL) {
+        crashlog_index_save(index);
+        crashlog_index_close(index);
+    }
+    return succeeded;
+}
+
+static void removeGroup(CrashLogGroup *group) {
+    // NOTE: Not all global arrays will contain the group.
+    [[group retain] autorelease];
+    [crashLogGroups$ removeObject:group];
+    [appCrashLogGroups$ removeObject:group];
+    [appExtensionCrashLogGroups$ removeObject:group];
+    [serviceCrashLogGroups$ removeObject:group];
+}
+
+// NOTE: Returns the newest of the given logs that is not being deleted and
+//       that has the given extension, or nil if there is none.
+static CrashLog *latestRemainingCrashLog(NSArray *crashLogs, NSSet *deletedFilepaths, NSString *pathExtension) {
+    // NOTE: Logs are sorted from newest to oldest.
+    for (CrashLog *crashLog in crashLogs) {
+        NSString *filepath = [crashLog filepath];
+        if (![deletedFilepaths containsObject:filepath] &&
+                [[uncompressedPathForFile(filepath) pathExtension] isEqualToString:pathExtension]) {
+            return crashLog;
+        }
+    }
+    return nil;
+}
+
+// NOTE: Deletes a set of logs, along with their syslog and summary files, as a
+//       single operation:
+//       * the files are collected up front and unlinked in a single pass, with
+//         any that require the as_root tool deleted in a single request;
+//       * "LatestCrash-*" links that point to deleted logs are replaced (or
+//         deleted) in the same pass, with each log directory examined once;
+//       * the viewed state and the groups are updated once, afterwards.
+// NOTE: Files are deleted by -deleteFilesWithProgress:, which may be called on
+//       any thread; the other methods must be called on the main thread.
+@interface CrashLogDeletion : NSObject
+- (instancetype)initWithCrashLogs:(NSArray *)crashLogs;
+- (BOOL)deleteFilesWithProgress:(void (^)(NSUInteger deletedCount, NSUInteger totalCount))progress;
+- (void)apply;
+@end
+
+@implementation CrashLogDeletion {
+    NSArray *crashLogs_;
+    // NOTE: The filepaths of the logs are read on the main thread, as they
+    //       change when a log is symbolicated.
+    NSArray *logFilepaths_;
+    NSSet *directories_;
+    // NOTE: Maps link path to the log that should replace a deleted log as
+    //       its destination (relative to the link), for every link that may
+    //       need replacing. Determined on the main thread, from the groups.
+    NSMutableDictionary *replacementFilenames_;
+    NSMutableArray *filepaths_;
+    // NOTE: Maps link path to new destination (relative to the link).
+    NSMutableDictionary *replacementLinks_;
+    NSMutableArray *deletedFilepaths_;
+}
+
+// NOTE: Links are named "LatestCrash.<ext>" (newest log of any process) or
+//       "LatestCrash-<process name>.<ext>", and point to a log with the same
+//       extension; only links to the groups and extensions of deleted logs can
+//       point to a deleted log.
+- (void)addReplacementsForDeletedFilepaths:(NSSet *)deletedFilepaths {
+    NSMutableSet *groups = [[NSMutableSet alloc] init];
+    NSMutableSet *pathExtensions = [[NSMutableSet alloc] init];
+    for (CrashLog *crashLog in crashLogs_) {
+        CrashLogGroup *group = [crashLog group];
+        if (group != nil) {
+            [groups addObject:group];
+        }
+        [pathExtensions addObject:[uncompressedPathForFile([crashLog filepath]) pathExtension]];
+    }
+
+    for (NSString *directory in directories_) {
+        for (NSString *pathExtension in pathExtensions) {
+            CrashLog *latestCrashLog = nil;
+            for (CrashLogGroup *group in crashLogGroups$) {
+                if (![[group logDirectory] isEqualToString:directory]) {
+                    continue;
+                }
+                CrashLog *crashLog = latestRemainingCrashLog([group crashLogs], deletedFilepaths, pathExtension);
+                if (crashLog == nil) {
+                    continue;
+                }
+
+                NSString *filename = [[crashLog filepath] lastPathComponent];
+                if ([groups containsObject:group]) {
+                    NSString *linkName = [NSString stringWithFormat:@"LatestCrash-%@.%@", [group name], pathExtension];
+                    [replacementFilenames_ setObject:filename forKey:[directory stringByAppendingPathComponent:linkName]];
+                }
+                if ((latestCrashLog == nil) || (reverseCompareCrashLogs(crashLog, latestCrashLog, NULL) == NSOrderedAscending)) {
+                    latestCrashLog = crashLog;
+                }
+            }
+            if (latestCrashLog != nil) {
+                NSString *linkName = [@"LatestCrash" stringByAppendingPathExtension:pathExtension];
+                [replacementFilenames_ setObject:[[latestCrashLog filepath] lastPathComponent]
+                    forKey:[directory stringByAppendingPathComponent:linkName]];
+            }
+        }
+    }
+
+    [pathExtensions release];
+    [groups release];
+}
+
+// NOTE: Called when the files are deleted, off the main thread.
+- (void)addLinksForDirectory:(NSString *)directory deletedFilepaths:(NSSet *)deletedFilepaths {
+    NSFileManager *fileMan = [NSFileManager defaultManager];
+    for (NSString *filename in [fileMan contentsOfDirectoryAtPath:directory error:NULL]) {
+        if (![filename hasPrefix:@"LatestCrash"]) {
+            continue;
+        }
+
+        NSString *linkPath = [directory stringByAppendingPathComponent:filename];
+        NSString *destPath = [fileMan destinationOfSymbolicLinkAtPath:linkPath error:NULL];
+        if (destPath == nil) {
+            continue;
+        }
+        if (![destPath isAbsolutePath]) {
+            destPath = [directory stringByAppendingPathComponent:destPath];
+        }
+        if (![deletedFilepaths containsObject:destPath]) {
+            continue;
+        }
+
+        // Link points to a log that is being deleted; point it at the newest
+        // remaining log, if any, else delete it.
+        // NOTE: Links are replaced in place (see createSymbolicLink()) rather
+        //       than deleted and recreated, so that a link that cannot be
+        //       replaced is kept.
+        NSString *replacementFilename = [replacementFilenames_ objectForKey:linkPath];
+        if (replacementFilename != nil) {
+            [replacementLinks_ setObject:replacementFilename forKey:linkPath];
+        } else {
+            [filepaths_ addObject:linkPath];
+        }
+    }
+}
+
+- (instancetype)initWithCrashLogs:(NSArray *)crashLogs {
+    self = [super init];
+    if (self != nil) {
+        crashLogs_ = [crashLogs copy];
+        filepaths_ = [[NSMutableArray alloc] init];
+        replacementFilenames_ = [[NSMutableDictionary alloc] init];
+        replacementLinks_ = [[NSMutableDictionary alloc] init];
+        deletedFilepaths_ = [[NSMutableArray alloc] init];
+
+        NSMutableArray *logFilepaths = [[NSMutableArray alloc] init];
+        NSMutableSet *directories = [[NSMutableSet alloc] init];
+        for (CrashLog *crashLog in crashLogs_) {
+            NSString *filepath = [crashLog filepath];
+            [logFilepaths addObject:filepath];
+            [directories addObject:[filepath stringByDeletingLastPathComponent]];
+        }
+        logFilepaths_ = logFilepaths;
+        directories_ = directories;
+
+        NSSet *deletedFilepaths = [[NSSet alloc] initWithArray:logFilepaths_];
+        [self addReplacementsForDeletedFilepaths:deletedFilepaths];
+        [deletedFilepaths release];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [crashLogs_ release];
+    [logFilepaths_ release];
+    [directories_ release];
+    [replacementFilenames_ release];
+    [filepaths_ release];
+    [replacementLinks_ release];
+    [deletedFilepaths_ release];
+    [super dealloc];
+}
+
+- (BOOL)deleteFilesWithProgress:(void (^)(NSUInteger deletedCount, NSUInteger totalCount))progress {
+    // Collect the files to delete.
+    // NOTE: Finding the syslogs and links requires examining the log
+    //       directories, and so is done here rather than on creation.
+    for (NSString *filepath in logFilepaths_) {
+        [filepaths_ addObject:filepath];
+        [filepaths_ addObject:summaryPathForFile(filepath)];
+        NSString *syslogPath = syslogPathForFile(filepath);
+        if (syslogPath != nil) {
+            [filepaths_ addObject:syslogPath];
+        }
+    }
+    NSSet *logFilepaths = [[NSSet alloc] initWithArray:logFilepaths_];
+    for (NSString *directory in directories_) {
+        [self addLinksForDirectory:directory deletedFilepaths:logFilepaths];
+    }
+    [logFilepaths release];
+
+    const NSUInteger totalCount = [filepaths_ count];
+    if (progress != nil) {
+        deleteFiles(filepaths_, ^(NSUInteger deletedCount) {
+            progress(deletedCount, totalCount);
+        });
+    } else {
+        deleteFiles(filepaths_, nil);
+    }
+
+    // Replace links to deleted logs.
+    for (NSString *linkPath in replacementLinks_) {
+        createSymbolicLink(linkPath, [replacementLinks_ objectForKey:linkPath]);
+    }
+
+    // Determine which logs were deleted.
+    // NOTE: Files that failed to delete are left in place; their logs remain.
+    for (NSString *filepath in logFilepaths_) {
+        struct stat st;
+        if ((lstat([filepath fileSystemRepresentation], &st) != 0) && (errno == ENOENT)) {
+            [deletedFilepaths_ addObject:filepath];
+        }
+    }
+    return ([deletedFilepaths_ count] == [logFilepaths_ count]);
+}
+
+- (void)apply {
+    [[ViewedStateStore sharedInstance] removeFilepaths:deletedFilepaths_];
+
+    NSSet *deletedFilepaths = [[NSSet alloc] initWithArray:deletedFilepaths_];
+    const NSUInteger count = [crashLogs_ count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        if ([deletedFilepaths containsObject:[logFilepaths_ objectAtIndex:i]]) {
+            CrashLog *crashLog = [crashLogs_ objectAtIndex:i];
+            // NOTE: The log may have already been removed from its group (e.g.
+            //       if the groups were reloaded during deletion).
+            CrashLogGroup *group = [crashLog group];
+            if (group != nil) {
+                [group removeCrashLog:crashLog];
+                if ([group count] == 0) {
+                    removeGroup(group);
+                }
+            }
+        }
+    }
+    [deletedFilepaths release];
+}
+
+@end
+
+// NOTE: The group keeps its logs sorted, along with the counts and type that
+//       are shown in the list of groups, updating them as logs are added and
+//       removed; the list can then be configured without examining every log.
 @implementation CrashLogGroup {
     NSMutableArray *crashLogs_;
+    NSArray *sortedCrashLogs_;
+    NSArray *clusters_;
+    NSUInteger unviewedCount_;
+    CrashLogGroupType type_;
+    BOOL hasType_;
 }
 
 @synthesize name = name_;
 @synthesize logDirectory = logDirectory_;
+@synthesize unviewedCount = unviewedCount_;
 
 + (NSArray *)groupsForType:(CrashLogGroupType)type {
     NSArray *groups = nil;
@@ -149,14 +690,98 @@ static NSArray *crashLogGroupsForType(CrashLogGroupType type) {
 }
 
 + (void)forgetGroups {
+    closeWatchers();
+    [pendingFileStates$ release];
+    pendingFileStates$ = nil;
     [crashLogGroups$ release];
     crashLogGroups$ = nil;
-    [appCrashLogGroups$ release];
-    appCrashLogGroups$ = nil;
-    [appExtensionCrashLogGroups$ release];
-    appExtensionCrashLogGroups$ = nil;
-    [serviceCrashLogGroups$ release];
-    serviceCrashLogGroups$ = nil;
+    forgetGroupsForType();
+}
+
++ (void)updateGroups {
+    if (crashLogGroups$ == nil) {
+        // Groups have not been loaded yet.
+        return;
+    }
+
+    if ((mobileWatcher$ == NULL) || (rootWatcher$ == NULL)) {
+        // Unable to watch for changes; must rescan.
+        [self forgetGroups];
+        return;
+    }
+
+    // NOTE: Symbolication renames log files in the background; changes are not
+    //       applied until it has finished, as a log being symbolicated would
+    //       otherwise appear to have been deleted.
+    if ([[SymbolicationQueue sharedInstance] isBusy]) {
+        return;
+    }
+
+    // Apply changes to log directories.
+    needsRescan$ = NO;
+    if (!applyChangesToDirectory(mobileWatcher$, @kCrashLogDirectoryForMobile)) {
+        needsRescan$ = YES;
+    }
+    if (!applyChangesToDirectory(rootWatcher$, @kCrashLogDirectoryForRoot)) {
+        needsRescan$ = YES;
+    }
+    if (needsRescan$) {
+        [self forgetGroups];
+    } else {
+        [CrashLog saveProcessTypeCache];
+    }
+}
+
+// NOTE: Files are deleted in the background; the deletion is applied, and
+//       progress and completion are reported, on the main thread.
+static void performDeletion(CrashLogDeletion *deletion, void (^progress)(NSUInteger deletedCount, NSUInteger totalCount), void (^completion)(BOOL didDelete)) {
+    [deletion retain];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+        // NOTE: Progress is reported at most ten times per second; the final
+        //       count is always reported, below.
+        __block CFAbsoluteTime lastReportTime = 0.0;
+        __block NSUInteger lastDeletedCount = 0;
+        __block NSUInteger lastTotalCount = 0;
+        const BOOL didDelete = [deletion deleteFilesWithProgress:^(NSUInteger deletedCount, NSUInteger totalCount) {
+            lastDeletedCount = deletedCount;
+            lastTotalCount = totalCount;
+            const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+            if ((progress != nil) && ((now - lastReportTime) >= 0.1)) {
+                lastReportTime = now;
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    progress(deletedCount, totalCount);
+                });
+            }
+        }];
+
+        const NSUInteger deletedCount = lastDeletedCount;
+        const NSUInteger totalCount = lastTotalCount;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (progress != nil) {
+                progress(deletedCount, totalCount);
+            }
+            [deletion apply];
+            [deletion release];
+            if (completion != nil) {
+                completion(didDelete);
+            }
+        });
+
+        [pool drain];
+    });
+}
+
++ (void)deleteGroups:(NSArray *)groups progress:(void (^)(NSUInteger deletedCount, NSUInteger totalCount))progress completion:(void (^)(BOOL didDelete))completion {
+    NSMutableArray *crashLogs = [NSMutableArray array];
+    for (CrashLogGroup *group in groups) {
+        [crashLogs addObjectsFromArray:[group crashLogs]];
+    }
+
+    CrashLogDeletion *deletion = [[CrashLogDeletion alloc] initWithCrashLogs:crashLogs];
+    performDeletion(deletion, progress, completion);
+    [deletion release];
 }
 
 + (instancetype)groupWithName:(NSString *)name logDirectory:(NSString *)logDirectory {
@@ -174,67 +799,150 @@ static NSArray *crashLogGroupsForType(CrashLogGroupType type) {
 }
 
 - (void)dealloc {
+    // NOTE: Logs may outlive the group (e.g. if retained by a view controller).
+    for (CrashLog *crashLog in crashLogs_) {
+        [crashLog setGroup:nil];
+    }
+
     [name_ release];
     [logDirectory_ release];
     [crashLogs_ release];
+    [sortedCrashLogs_ release];
+    [clusters_ release];
     [super dealloc];
 }
 
+// NOTE: An immutable copy is returned, so that callers may enumerate the logs
+//       while logs are being deleted; it is created once per change.
 - (NSArray *)crashLogs {
-    return [crashLogs_ sortedArrayUsingFunction:reverseCompareCrashLogs context:NULL];
+    if (sortedCrashLogs_ == nil) {
+        sortedCrashLogs_ = [crashLogs_ copy];
+    }
+    return [[sortedCrashLogs_ retain] autorelease];
+}
+
+- (CrashLog *)latestCrashLog {
+    return ([crashLogs_ count] != 0) ? [crashLogs_ objectAtIndex:0] : nil;
+}
+
+- (NSDate *)latestDate {
+    return [[self latestCrashLog] logDate];
+}
+
+- (NSUInteger)count {
+    return [crashLogs_ count];
+}
+
+// NOTE: Clusters are built from the fingerprints stored in the index, and are
+//       rebuilt only when the logs of the group change.
+- (NSArray *)clusters {
+    if (clusters_ == nil) {
+        clusters_ = [[CrashLogCluster clustersForCrashLogs:[self crashLogs]] retain];
+    }
+    return clusters_;
+}
+
+- (void)forgetCaches {
+    [clusters_ release];
+    clusters_ = nil;
+    [sortedCrashLogs_ release];
+    sortedCrashLogs_ = nil;
 }
 
 - (void)addCrashLog:(CrashLog *)crashLog {
-    [crashLogs_ addObject:crashLog];
+    // Insert in sorted position.
+    const NSUInteger index = [crashLogs_ indexOfObject:crashLog inSortedRange:NSMakeRange(0, [crashLogs_ count])
+        options:NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(id a, id b) {
+            return reverseCompareCrashLogs(a, b, NULL);
+        }];
+    [crashLogs_ insertObject:crashLog atIndex:index];
+    [crashLog setGroup:self];
+
+    if (![crashLog isViewed]) {
+        ++unviewedCount_;
+    }
+    if (index == 0) {
+        // NOTE: The type of the group is that of its latest log.
+        hasType_ = NO;
+    }
+    [self forgetCaches];
 }
 
-- (BOOL)delete {
-    // Delete contained crash logs.
-    const NSUInteger count = [crashLogs_ count];
-    for (NSInteger i = (count - 1); i >= 0; --i) {
-        CrashLog *crashLog = [crashLogs_ objectAtIndex:i];
-        if ([crashLog delete]) {
-            [crashLogs_ removeObjectAtIndex:i];
-        } else {
-            // Failed to delete a log file; stop and return.
-            return NO;
+- (CrashLog *)crashLogWithFilepath:(NSString *)filepath {
+    for (CrashLog *crashLog in crashLogs_) {
+        if ([[crashLog filepath] isEqualToString:filepath]) {
+            return crashLog;
         }
     }
+    return nil;
+}
 
-    // Remove group from global arrays.
-    // NOTE: Not all global arrays will contain the group.
-    [crashLogGroups$ removeObject:self];
-    [appCrashLogGroups$ removeObject:self];
-    [appExtensionCrashLogGroups$ removeObject:self];
-    [serviceCrashLogGroups$ removeObject:self];
+- (void)removeCrashLog:(CrashLog *)crashLog {
+    const NSUInteger index = [crashLogs_ indexOfObjectIdenticalTo:crashLog];
+    if (index != NSNotFound) {
+        [self removeCrashLogAtIndex:index];
+    }
+}
+
+- (void)removeCrashLogAtIndex:(NSUInteger)index {
+    CrashLog *crashLog = [crashLogs_ objectAtIndex:index];
+    [crashLog setGroup:nil];
+    if (![crashLog isViewed]) {
+        --unviewedCount_;
+    }
+    if (index == 0) {
+        hasType_ = NO;
+    }
+    [crashLogs_ removeObjectAtIndex:index];
+    [self forgetCaches];
+}
 
-    return YES;
+- (void)crashLogWasViewed:(CrashLog *)crashLog {
+    if (unviewedCount_ != 0) {
+        --unviewedCount_;
+    }
 }
 
-// FIXME: Update "LatestCrash-*" link, if necessary.
-- (BOOL)deleteCrashLog:(CrashLog *)crashLog {
-    if ([crashLogs_ containsObject:crashLog]) {
-        [crashLog delete];
-        if (![[NSFileManager defaultManager] fileExistsAtPath:[crashLog filepath]]) {
-            [crashLogs_ removeObject:crashLog];
-            return YES;
+- (void)deleteWithCompletion:(void (^)(BOOL didDelete))completion {
+    CrashLogDeletion *deletion = [[CrashLogDeletion alloc] initWithCrashLogs:crashLogs_];
+    performDeletion(deletion, nil, completion);
+    [deletion release];
+}
+
+- (void)deleteCrashLog:(CrashLog *)crashLog completion:(void (^)(BOOL didDelete))completion {
+    [self deleteCrashLogs:[NSArray arrayWithObject:crashLog] completion:completion];
+}
+
+- (void)deleteCrashLogs:(NSArray *)crashLogs completion:(void (^)(BOOL didDelete))completion {
+    NSMutableArray *ownCrashLogs = [NSMutableArray array];
+    for (CrashLog *crashLog in crashLogs) {
+        if ([crashLog group] == self) {
+            [ownCrashLogs addObject:crashLog];
         }
     }
-    return NO;
+
+    // NOTE: Logs that do not belong to this group are not deleted.
+    const BOOL hasOtherCrashLogs = ([ownCrashLogs count] != [crashLogs count]);
+    CrashLogDeletion *deletion = [[CrashLogDeletion alloc] initWithCrashLogs:ownCrashLogs];
+    performDeletion(deletion, nil, ^(BOOL didDelete) {
+        if (completion != nil) {
+            completion(didDelete && !hasOtherCrashLogs);
+        }
+    });
+    [deletion release];
 }
 
 #pragma mark - Type
 
+// NOTE: Determining the type of a log may require reading the log file; the
+//       type is cached until the latest log of the group changes.
 - (CrashLogGroupType)type {
-    CrashLogGroupType type = CrashLogGroupTypeUnknown;
-
-    NSArray *crashLogs = [self crashLogs];
-    if ([crashLogs count] > 0) {
-        CrashLog *crashLog = [crashLogs objectAtIndex:0];
-        type = (CrashLogGroupType)[crashLog type];
+    if (!hasType_) {
+        CrashLog *crashLog = [self latestCrashLog];
+        type_ = (crashLog != nil) ? (CrashLogGroupType)[crashLog type] : CrashLogGroupTypeUnknown;
+        hasType_ = YES;
     }
-
-    return type;
+    return type_;
 }
 
 @end
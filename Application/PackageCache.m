@@ -13,8 +13,49 @@
 
 #import <TechSupport/TechSupport.h>
 
+#include "package_index.h"
+#include "paths.h"
+
+// NOTE: Packages are kept for the most recently looked-up files; on a memory
+//       warning, only the most recent few are kept.
+static const NSUInteger kMaxEntries = 64;
+static const NSUInteger kMaxEntriesAfterMemoryWarning = 16;
+
+// NOTE: Apps installed from the App Store are not dpkg packages; they are
+//       found by file, and only within these directories.
+static NSString * const kAppStoreBundleDirectories[] = {
+    @"/var/mobile/Applications/",
+    @"/private/var/mobile/Applications/",
+    @"/var/containers/Bundle/Application/",
+    @"/private/var/containers/Bundle/Application/",
+};
+
+@interface TSPackage (PackageCache)
++ (instancetype)packageWithIdentifier:(NSString *)identifier;
+@end
+
+static BOOL isAppStoreBundlePath(NSString *filepath) {
+    const NSUInteger count = sizeof(kAppStoreBundleDirectories) / sizeof(kAppStoreBundleDirectories[0]);
+    for (NSUInteger i = 0; i < count; ++i) {
+        if ([filepath hasPrefix:kAppStoreBundleDirectories[i]]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
 @implementation PackageCache {
-    NSMutableDictionary *cache_;
+    // NOTE: Only accessed on the main thread; the index is opened (and, if
+    //       necessary, built) in the background.
+    package_index_t *index_;
+    BOOL isOpeningIndex_;
+
+    // NOTE: Keyed by package identifier or, for files that were not installed
+    //       by a dpkg package, by filepath. NSNull marks files that do not
+    //       belong to any package.
+    NSMutableDictionary *packages_;
+    // NOTE: Ordered from least to most recently used.
+    NSMutableArray *recentKeys_;
 }
 
 + (instancetype)sharedInstance {
@@ -29,10 +70,13 @@
 - (id)init {
     self = [super init];
     if (self != nil) {
-        cache_ = [[NSMutableDictionary alloc] init];
+        packages_ = [[NSMutableDictionary alloc] init];
+        recentKeys_ = [[NSMutableArray alloc] init];
 
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didReceiveMemoryWarning)
             name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+
+        [self openIndex];
     }
     return self;
 }
@@ -40,23 +84,109 @@
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
 
-    [cache_ release];
+    package_index_close(index_);
+    [packages_ release];
+    [recentKeys_ release];
     [super dealloc];
 }
 
+- (void)trimToCount:(NSUInteger)count {
+    while ([recentKeys_ count] > count) {
+        [packages_ removeObjectForKey:[recentKeys_ objectAtIndex:0]];
+        [recentKeys_ removeObjectAtIndex:0];
+    }
+}
+
 - (void)didReceiveMemoryWarning {
-    [cache_ removeAllObjects];
+    // NOTE: The index is memory-mapped from a file; its pages can be reclaimed
+    //       by the system without closing it.
+    [self trimToCount:kMaxEntriesAfterMemoryWarning];
+}
+
+// NOTE: Building the index reads the list of every installed package, which
+//       takes too long for the main thread.
+- (void)openIndex {
+    if (isOpeningIndex_) {
+        return;
+    }
+    isOpeningIndex_ = YES;
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [[NSFileManager defaultManager] createDirectoryAtPath:@kCacheDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+        package_index_t *index = package_index_open(kPackageIndexFilepath, kDpkgDirectory);
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            package_index_close(index_);
+            index_ = index;
+            isOpeningIndex_ = NO;
+
+            // NOTE: Entries cached while the index was unavailable are keyed
+            //       by filepath.
+            [self trimToCount:0];
+        });
+    });
+}
+
+// NOTE: The index is rebuilt if packages have been installed or removed since
+//       it was opened; cached packages may then be outdated as well.
+// NOTE: Returns NULL while the index is being opened.
+- (package_index_t *)index {
+    if ((index_ != NULL) && package_index_is_stale(index_)) {
+        package_index_close(index_);
+        index_ = NULL;
+        [self trimToCount:0];
+        [self openIndex];
+    }
+    return index_;
 }
 
 - (TSPackage *)packageForFile:(NSString *)filepath {
-    TSPackage *package = [cache_ objectForKey:filepath];
-    if (package == nil) {
-        package = [TSPackage packageForFile:filepath];
-        if (package != nil) {
-            [cache_ setObject:package forKey:filepath];
+    if ([filepath length] == 0) {
+        return nil;
+    }
+
+    // NOTE: Files of the same package share a single entry.
+    NSString *identifier = nil;
+    package_index_t *index = [self index];
+    if (index != NULL) {
+        const char *string = package_index_lookup(index, [filepath fileSystemRepresentation]);
+        if (string != NULL) {
+            identifier = [NSString stringWithUTF8String:string];
+        }
+    }
+    NSString *key = (identifier != nil) ? identifier : filepath;
+
+    id object = [packages_ objectForKey:key];
+    if (object != nil) {
+        // Mark as most recently used.
+        [recentKeys_ removeObject:key];
+        [recentKeys_ addObject:key];
+    } else {
+        if (identifier != nil) {
+            if ([TSPackage respondsToSelector:@selector(packageWithIdentifier:)]) {
+                object = [TSPackage packageWithIdentifier:identifier];
+            } else {
+                object = [TSPackage packageForFile:filepath];
+            }
+        } else if ((index == NULL) || isAppStoreBundlePath(filepath)) {
+            // NOTE: Without the index (while it is being opened, or if dpkg's
+            //       database cannot be read), files are searched for as before.
+            object = [TSPackage packageForFile:filepath];
+        }
+        if (object == nil) {
+            object = [NSNull null];
+        }
+
+        // NOTE: Results found without the index are not cached while it is
+        //       being opened; the cache is cleared once it is.
+        if ((index != NULL) || !isOpeningIndex_) {
+            [packages_ setObject:object forKey:key];
+            [recentKeys_ addObject:key];
+            [self trimToCount:kMaxEntries];
         }
     }
-    return package;
+
+    return (object != [NSNull null]) ? object : nil;
 }
 
 @end
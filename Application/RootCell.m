@@ -11,7 +11,6 @@
 
 #import "RootCell.h"
 
-#import "CrashLog.h"
 #import "CrashLogGroup.h"
 #import "TableViewCellLine.h"
 #include "font-awesome.h"
@@ -60,8 +59,6 @@ static const CGFloat kFontSizeCrashDate = 12.0;
     NSAssert([object isKindOfClass:[CrashLogGroup class]], @"ERROR: Incorrect class type: Expected CrashLogGroup, received %@.", [object class]);
 
     CrashLogGroup *group = object;
-    NSArray *crashLogs = [group crashLogs];
-    CrashLog *crashLog = [crashLogs objectAtIndex:0];
 
     // Name of crashed process.
     [self setName:group.name];
@@ -69,7 +66,7 @@ static const CGFloat kFontSizeCrashDate = 12.0;
     // Date of latest crash.
     NSString *string = nil;
     BOOL isRecent = NO;
-    NSDate *logDate = [crashLog logDate];
+    NSDate *logDate = [group latestDate];
     NSTimeInterval interval = [[NSDate date] timeIntervalSinceDate:logDate];
     if (interval < 86400.0) {
         if (interval < 3600.0) {
@@ -85,13 +82,9 @@ static const CGFloat kFontSizeCrashDate = 12.0;
     [self setRecent:isRecent];
 
     // Number of unviewed logs and total logs.
-    const unsigned long totalCount = [crashLogs count];
-    unsigned long unviewedCount = 0;
-    for (CrashLog *crashLog in crashLogs) {
-        if (![crashLog isViewed]) {
-            ++unviewedCount;
-        }
-    }
+    // NOTE: Counts are maintained by the group.
+    const unsigned long totalCount = [group count];
+    const unsigned long unviewedCount = [group unviewedCount];
     self.detailTextLabel.text = [NSString stringWithFormat:@"%lu/%lu", unviewedCount, totalCount];
 }
 
@@ -15,6 +15,7 @@
 
 #import "CrashLog.h"
 #import "CrashLogGroup.h"
+#import "ModalActionSheet.h"
 #import "RootCell.h"
 #import "SectionHeaderView.h"
 #import "UIImage+CrashReporter.h"
@@ -143,7 +144,7 @@ static BOOL reportCrashIsDisabled$ = YES;
     [super viewWillAppear:animated];
 
     if (hasAppeared_) {
-        [CrashLogGroup forgetGroups];
+        [CrashLogGroup updateGroups];
         [self.tableView reloadData];
     } else {
         hasAppeared_ = YES;
@@ -525,7 +526,7 @@ static UIButton *menuButton(NSUInteger position, CGRect frame, UIImage *backgrou
 }
 
 - (void)refresh:(id)sender {
-    [CrashLogGroup forgetGroups];
+    [CrashLogGroup updateGroups];
     [super refresh:sender];
 }
 
@@ -606,38 +607,42 @@ static UIButton *menuButton(NSUInteger position, CGRect frame, UIImage *backgrou
     } else if (tag == AlertViewTypeTrash) {
         // Trash.
         if (buttonIndex == 1) {
-            BOOL deleted = YES;
-
             // Delete all crash logs.
-            // NOTE: Must copy the array of groups as calling 'delete' on a group
-            //       will modify the global storage (fast-enumeration does not allow
-            //       such modifications).
+            // NOTE: Files are deleted in the background; the list is refreshed
+            //       once all have been deleted.
+            NSMutableArray *groups = [NSMutableArray array];
             CrashLogGroupType types[3] = {
                 CrashLogGroupTypeApp,
                 CrashLogGroupTypeAppExtension,
                 CrashLogGroupTypeService
             };
             for (unsigned i = 0; i < 3; ++i) {
-                NSArray *groups = [[CrashLogGroup groupsForType:types[i]] copy];
-                for (CrashLogGroup *group in groups) {
-                    if (![group delete]) {
-                        deleted = NO;
-                    }
-                }
-                [groups release];
+                [groups addObjectsFromArray:[CrashLogGroup groupsForType:types[i]]];
             }
 
-            if (!deleted) {
-                NSString *title = NSLocalizedString(@"ERROR", nil);
-                NSString *message = NSLocalizedString(@"DELETE_ALL_FAILED", nil);
-                NSString *okMessage = NSLocalizedString(@"OK", nil);
-                UIAlertView *alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
-                    cancelButtonTitle:okMessage otherButtonTitles:nil];
-                [alert show];
-                [alert release];
-            }
+            ModalActionSheet *statusPopup = [[ModalActionSheet alloc] init];
+            [statusPopup updateText:NSLocalizedString(@"PROCESSING", nil)];
+            [statusPopup show];
+
+            [CrashLogGroup deleteGroups:groups progress:^(NSUInteger deletedCount, NSUInteger totalCount) {
+                [statusPopup updateText:[NSString stringWithFormat:@"%@ (%lu/%lu)",
+                    NSLocalizedString(@"PROCESSING", nil), (unsigned long)deletedCount, (unsigned long)totalCount]];
+            } completion:^(BOOL didDelete) {
+                [statusPopup hide];
+                [statusPopup release];
+
+                if (!didDelete) {
+                    NSString *title = NSLocalizedString(@"ERROR", nil);
+                    NSString *message = NSLocalizedString(@"DELETE_ALL_FAILED", nil);
+                    NSString *okMessage = NSLocalizedString(@"OK", nil);
+                    UIAlertView *alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
+                        cancelButtonTitle:okMessage otherButtonTitles:nil];
+                    [alert show];
+                    [alert release];
+                }
 
-            [self refresh:nil];
+                [self refresh:nil];
+            }];
         }
     }
 }
@@ -665,16 +670,28 @@ static UIButton *menuButton(NSUInteger position, CGRect frame, UIImage *backgrou
     const NSUInteger count = [array count];
     if (count > 0) {
         CrashLogGroup *group = [array objectAtIndex:indexPath.row];
-        if ([group delete]) {
-            NSArray *indexPaths = [NSArray arrayWithObject:indexPath];
-            if (count == 1) {
-                [tableView reloadRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
+        // NOTE: Files are deleted in the background; the table is not edited
+        //       until the group has been removed.
+        [tableView setUserInteractionEnabled:NO];
+        [group deleteWithCompletion:^(BOOL didDelete) {
+            [tableView setUserInteractionEnabled:YES];
+
+            // NOTE: If the table has been reloaded in the meantime, the row to
+            //       animate is no longer known.
+            if (didDelete && ([tableView numberOfRowsInSection:indexPath.section] == (NSInteger)count)) {
+                NSArray *indexPaths = [NSArray arrayWithObject:indexPath];
+                if (count == 1) {
+                    [tableView reloadRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
+                } else {
+                    [tableView deleteRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
+                }
             } else {
-                [tableView deleteRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
+                if (!didDelete) {
+                    NSLog(@"ERROR: Failed to delete logs for group \"%@\".", [group name]);
+                }
+                [tableView reloadData];
             }
-        } else {
-            NSLog(@"ERROR: Failed to delete logs for group \"%@\".", [group name]);
-        }
+        }];
     }
 }
 
@@ -22,7 +22,9 @@
 #import "Button.h"
 #import "BinaryImageCell.h"
 #import "SectionHeaderView.h"
+#import "SymbolicationQueue.h"
 #import "UIImage+CrashReporter.h"
+#import "crashlog_util.h"
 
 #include "font-awesome.h"
 #include "paths.h"
@@ -49,6 +51,10 @@
     TSPackage *lastSelectedPackage_;
     NSString *lastSelectedPath_;
     NSIndexPath *lastSelectedIndexPath_;
+
+    // NOTE: Decompressed copies of attachments; removed once the controller
+    //       (and thus any mail composed from it) is gone.
+    NSMutableArray *temporaryFilepaths_;
 }
 
 - (id)initWithCrashLog:(CrashLog *)crashLog {
@@ -78,6 +84,12 @@
 }
 
 - (void)dealloc {
+    NSFileManager *fileMan = [NSFileManager defaultManager];
+    for (NSString *filepath in temporaryFilepaths_) {
+        [fileMan removeItemAtPath:filepath error:NULL];
+    }
+    [temporaryFilepaths_ release];
+
     [statusPopup_ release];
     [crashLog_ release];
     [lastSelectedLinkInstructions_ release];
@@ -133,7 +145,7 @@
 }
 
 - (void)viewWillAppear:(BOOL)animated {
-    if (![crashLog_ isLoaded]) {
+    if (![crashLog_ isLoaded] && (statusPopup_ == nil)) {
         statusPopup_ = [[ModalActionSheet alloc] init];
         [statusPopup_ updateText:NSLocalizedString(@"PROCESSING", nil)];
         [statusPopup_ show];
@@ -143,10 +155,10 @@
 - (void)viewDidAppear:(BOOL)animated {
     if (![crashLog_ isLoaded]) {
         [self load];
+    } else {
+        // Mark log as viewed.
+        [crashLog_ setViewed:YES];
     }
-
-    // Mark log as viewed.
-    [crashLog_ setViewed:YES];
 }
 
 #pragma mark - Other
@@ -185,37 +197,42 @@
     return array;
 }
 
+// NOTE: The log is loaded (and, if necessary, symbolicated) in the background;
+//       the main thread remains free while it is processed.
 - (void)load {
-#if !TARGET_IPHONE_SIMULATOR
-    [crashLog_ load];
-#endif
-
-    [statusPopup_ hide];
-    [statusPopup_ release];
-    statusPopup_ = nil;
-
-    [self.tableView reloadData];
+    [[SymbolicationQueue sharedInstance] loadCrashLog:crashLog_ completion:^(BOOL didLoad) {
+        // Mark log as viewed.
+        // NOTE: This is done after loading as symbolication changes the path
+        //       of the log file.
+        [crashLog_ setViewed:YES];
+
+        [statusPopup_ hide];
+        [statusPopup_ release];
+        statusPopup_ = nil;
+
+        [self.tableView reloadData];
+    }];
 }
 
 - (NSString *)syslogPath {
-    NSString *syslogPath = [[crashLog_ filepath] stringByDeletingPathExtension];
-    if ([syslogPath hasSuffix:@"symbolicated"]) {
-        syslogPath = [syslogPath stringByDeletingPathExtension];
-    }
-    return [syslogPath stringByAppendingPathExtension:@"syslog"];
+    return syslogPathForFile([crashLog_ filepath]);
 }
 
 #pragma mark - Button Actions
 
+- (void)presentViewerWithContent:(NSString *)content title:(NSString *)title {
+    TSHTMLViewController *controller = [[TSHTMLViewController alloc] initWithHTMLContent:content];
+    controller.title = title ?: NSLocalizedString(@"INCLUDE_UNTITLED", nil);
+    [self.navigationController pushViewController:controller animated:YES];
+    [controller release];
+}
+
 - (void)presentViewerWithString:(NSString *)string {
     TSIncludeInstruction *instruction = (TSIncludeInstruction *)[TSInstruction instructionWithString:string];
     if (instruction != nil) {
         NSString *content = [[NSString alloc] initWithData:[instruction content] encoding:NSUTF8StringEncoding];
         if (content != nil) {
-            TSHTMLViewController *controller = [[TSHTMLViewController alloc] initWithHTMLContent:content];
-            controller.title = [instruction title] ?: NSLocalizedString(@"INCLUDE_UNTITLED", nil);
-            [self.navigationController pushViewController:controller animated:YES];
-            [controller release];
+            [self presentViewerWithContent:content title:[instruction title]];
             [content release];
         } else {
             NSLog(@"ERROR: Content could not be interpreted as a string.");
@@ -223,9 +240,34 @@
     }
 }
 
-static NSString *createIncludeLineForFilepath(NSString *filepath, NSString *name) {
+// NOTE: Aged logs may have been compressed (see compressFile()); attachments
+//       must be readable by the developer.
+static NSString *decompressedCopyOfFile(NSString *filepath) {
+    NSString *copyPath = nil;
+
+    NSData *data = dataForFile(filepath);
+    if (data != nil) {
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[uncompressedPathForFile(filepath) lastPathComponent]];
+        if ([data writeToFile:path atomically:YES]) {
+            copyPath = path;
+        } else {
+            NSLog(@"ERROR: Unable to write decompressed copy of \"%@\".", filepath);
+        }
+        [data release];
+    }
+
+    return copyPath;
+}
+
+// NOTE: Paths of temporary copies are added to the given array; the caller is
+//       responsible for removing the copies.
+static NSString *createIncludeLineForFilepath(NSString *filepath, NSString *name, NSMutableArray *temporaryFilepaths) {
     NSString *string = [NSString alloc];
-    if ([filepath hasPrefix:@kCrashLogDirectoryForRoot]) {
+    NSString *copyPath = fileIsCompressed(filepath) ? decompressedCopyOfFile(filepath) : nil;
+    if (copyPath != nil) {
+        [temporaryFilepaths addObject:copyPath];
+        string = [string initWithFormat:@"include as \"%@\" file \"%@\"", name, copyPath];
+    } else if ([filepath hasPrefix:@kCrashLogDirectoryForRoot]) {
         string = [string initWithFormat:@"include as \"%@\" command %@ read \"%@\"",
              name, [[NSBundle mainBundle] pathForResource:@"as_root" ofType:nil], filepath];
     } else {
@@ -234,16 +276,36 @@ static NSString *createIncludeLineForFilepath(NSString *filepath, NSString *name
     return string;
 }
 
+- (void)presentViewerForFilepath:(NSString *)filepath name:(NSString *)name {
+    if ([filepath hasPrefix:@kCrashLogDirectoryForRoot] || fileIsCompressed(filepath)) {
+        // NOTE: File may not be readable by mobile; load the data directly,
+        //       which uses a file descriptor opened by the as_root tool rather
+        //       than a temporary copy of the file.
+        // NOTE: Compressed (aged) files are decompressed when loaded.
+        NSData *data = dataForFile(filepath);
+        if (data != nil) {
+            NSString *content = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+            if (content != nil) {
+                [self presentViewerWithContent:content title:name];
+                [content release];
+            } else {
+                NSLog(@"ERROR: Content could not be interpreted as a string.");
+            }
+            [data release];
+        }
+    } else {
+        NSString *string = createIncludeLineForFilepath(filepath, name, nil);
+        [self presentViewerWithString:string];
+        [string release];
+    }
+}
+
 - (void)crashlogTapped {
-    NSString *string = createIncludeLineForFilepath([crashLog_ filepath], @"Crash log");
-    [self presentViewerWithString:string];
-    [string release];
+    [self presentViewerForFilepath:[crashLog_ filepath] name:@"Crash log"];
 }
 
 - (void)syslogTapped {
-    NSString *string = createIncludeLineForFilepath([self syslogPath], @"syslog");
-    [self presentViewerWithString:string];
-    [string release];
+    [self presentViewerForFilepath:[self syslogPath] name:@"syslog"];
 }
 
 - (void)helpButtonTapped {
@@ -304,11 +366,14 @@ static NSString *createIncludeLineForFilepath(NSString *filepath, NSString *name
             TSLinkInstruction *linkInstruction = [lastSelectedLinkInstructions_ objectAtIndex:(buttonIndex - 1)];
             if (linkInstruction.isSupport) {
                 // Determine attachments.
-                NSString *crashlogLine = createIncludeLineForFilepath([crashLog_ filepath], @"Crash log");
+                if (temporaryFilepaths_ == nil) {
+                    temporaryFilepaths_ = [[NSMutableArray alloc] init];
+                }
+                NSString *crashlogLine = createIncludeLineForFilepath([crashLog_ filepath], @"Crash log", temporaryFilepaths_);
                 NSString *syslogLine = nil;
                 NSString *syslogPath = [self syslogPath];
                 if ([[NSFileManager defaultManager] fileExistsAtPath:syslogPath]) {
-                    syslogLine = createIncludeLineForFilepath([self syslogPath], @"syslog");
+                    syslogLine = createIncludeLineForFilepath([self syslogPath], @"syslog", temporaryFilepaths_);
                 }
 
                 NSMutableArray *includeInstructions = [[NSMutableArray alloc] init];
@@ -0,0 +1,158 @@
+/**
+ * Name: CrashReporter
+ * Type: iOS application
+ * Desc: iOS app for viewing the details of a crash, determining the possible
+ *       cause of said crash, and reporting this information to the developer(s)
+ *       responsible.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import "SymbolicationQueue.h"
+
+#import "CrashLog.h"
+
+@interface CrashLogLoadOperation : NSOperation
+@property (nonatomic, readonly) CrashLog *crashLog;
+@property (nonatomic, readonly, getter = isPrefetch) BOOL prefetch;
+- (id)initWithCrashLog:(CrashLog *)crashLog prefetch:(BOOL)prefetch completion:(void (^)(BOOL didLoad))completion;
+@end
+
+@implementation CrashLogLoadOperation {
+    void (^completion_)(BOOL didLoad);
+}
+
+@synthesize crashLog = crashLog_;
+@synthesize prefetch = prefetch_;
+
+- (id)initWithCrashLog:(CrashLog *)crashLog prefetch:(BOOL)prefetch completion:(void (^)(BOOL didLoad))completion {
+    self = [super init];
+    if (self != nil) {
+        crashLog_ = [crashLog retain];
+        prefetch_ = prefetch;
+        completion_ = [completion copy];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [crashLog_ release];
+    [completion_ release];
+    [super dealloc];
+}
+
+- (void)main {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+    // NOTE: Loading cannot be interrupted once started; cancellation only
+    //       prevents operations that have not yet started from running.
+    BOOL didLoad = NO;
+    if (![self isCancelled]) {
+#if !TARGET_IPHONE_SIMULATOR
+        didLoad = [crashLog_ load];
+#endif
+    }
+
+    // NOTE: The completion handler is always called (on the main thread) so
+    //       that the caller can update its state, even if cancelled.
+    if (completion_ != nil) {
+        void (^completion)(BOOL) = [completion_ retain];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(didLoad);
+            [completion release];
+        });
+    }
+
+    [pool drain];
+}
+
+@end
+
+@implementation SymbolicationQueue {
+    NSOperationQueue *queue_;
+}
+
+@dynamic busy;
+
++ (instancetype)sharedInstance {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [[self alloc] init];
+    });
+    return instance;
+}
+
+- (id)init {
+    self = [super init];
+    if (self != nil) {
+        // NOTE: Symbolication is memory and I/O intensive; logs are processed
+        //       one at a time, in order of priority.
+        queue_ = [[NSOperationQueue alloc] init];
+        [queue_ setMaxConcurrentOperationCount:1];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [queue_ release];
+    [super dealloc];
+}
+
+- (BOOL)isBusy {
+    return ([queue_ operationCount] != 0);
+}
+
+- (void)loadCrashLog:(CrashLog *)crashLog completion:(void (^)(BOOL didLoad))completion {
+    // Any pending prefetch of the same log is superseded by this request.
+    for (CrashLogLoadOperation *operation in [queue_ operations]) {
+        if ([operation isPrefetch] && ([operation crashLog] == crashLog) && ![operation isExecuting]) {
+            [operation cancel];
+        }
+    }
+
+    // NOTE: If the log is already being loaded by a prefetch, this operation
+    //       will wait for that load to finish, and will then return at once.
+    CrashLogLoadOperation *operation = [[CrashLogLoadOperation alloc] initWithCrashLog:crashLog prefetch:NO completion:completion];
+    [operation setQueuePriority:NSOperationQueuePriorityVeryHigh];
+    [queue_ addOperation:operation];
+    [operation release];
+}
+
+- (void)prefetchCrashLogs:(NSArray *)crashLogs {
+    NSArray *operations = [queue_ operations];
+    for (CrashLog *crashLog in crashLogs) {
+        if ([crashLog isLoaded]) {
+            continue;
+        }
+
+        // Skip logs that are already queued.
+        BOOL isQueued = NO;
+        for (CrashLogLoadOperation *operation in operations) {
+            if (([operation crashLog] == crashLog) && ![operation isCancelled]) {
+                isQueued = YES;
+                break;
+            }
+        }
+
+        if (!isQueued) {
+            CrashLogLoadOperation *operation = [[CrashLogLoadOperation alloc] initWithCrashLog:crashLog prefetch:YES completion:nil];
+            [operation setQueuePriority:NSOperationQueuePriorityLow];
+            [queue_ addOperation:operation];
+            [operation release];
+        }
+    }
+}
+
+- (void)cancelPrefetches {
+    for (CrashLogLoadOperation *operation in [queue_ operations]) {
+        if ([operation isPrefetch]) {
+            [operation cancel];
+        }
+    }
+}
+
+@end
+
+/* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
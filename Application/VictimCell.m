@@ -12,8 +12,17 @@
 #import "VictimCell.h"
 
 #import "CrashLog.h"
+#import "CrashLogCluster.h"
+#import "TableViewCellLine.h"
+#include "font-awesome.h"
 
-@implementation VictimCell
+#define kColorFirstCrashDate [UIColor grayColor]
+
+static const CGFloat kFontSizeFirstCrashDate = 12.0;
+
+@implementation VictimCell {
+    TableViewCellLine *firstCrashDateLine_;
+}
 
 + (NSDateFormatter *)timeFormatter {
     static NSDateFormatter *formatter = nil;
@@ -26,20 +35,41 @@
 
 #pragma mark - Overrides (TableViewCell)
 
++ (CGFloat)cellHeight {
+    return [super cellHeight] + kFontSizeFirstCrashDate;
+}
+
 - (id)initWithReuseIdentifier:(NSString *)reuseIdentifier {
     self = [super initWithReuseIdentifier:reuseIdentifier];
     if (self != nil) {
         self.accessoryType = UITableViewCellAccessoryDisclosureIndicator;
+        self.detailTextLabel.backgroundColor  = [UIColor clearColor];
+
+        firstCrashDateLine_ = [[self addLine] retain];
+        firstCrashDateLine_.iconLabel.text = @kFontAwesomeHistory;
+        [firstCrashDateLine_.label setTextColor:kColorFirstCrashDate];
     }
     return self;
 }
 
+- (void)dealloc {
+    [firstCrashDateLine_ release];
+    [super dealloc];
+}
+
 - (void)configureWithObject:(id)object {
-    NSAssert([object isKindOfClass:[CrashLog class]], @"ERROR: Incorrect class type: Expected CrashLog, received %@.", [object class]);
+    NSAssert([object isKindOfClass:[CrashLogCluster class]], @"ERROR: Incorrect class type: Expected CrashLogCluster, received %@.", [object class]);
+
+    // NOTE: Identical crashes are shown as a single entry, with the time of
+    //       the latest occurrence, the time of the first occurrence, and the
+    //       number of occurrences.
+    CrashLogCluster *cluster = object;
+    [self setName:[[[self class] timeFormatter] stringFromDate:[cluster lastDate]]];
+    [self setText:[[[self class] dateFormatter] stringFromDate:[cluster firstDate]] forLabel:firstCrashDateLine_.label];
+    [self setViewed:[cluster isViewed]];
 
-    CrashLog *crashLog = object;
-    [self setName:[[[self class] timeFormatter] stringFromDate:[crashLog logDate]]];
-    [self setViewed:[crashLog isViewed]];
+    const unsigned long count = [cluster count];
+    self.detailTextLabel.text = (count > 1) ? [NSString stringWithFormat:@"%lu", count] : nil;
 }
 
 @end
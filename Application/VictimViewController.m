@@ -13,13 +13,20 @@
 
 #import <libcrashreport/libcrashreport.h>
 #import "CrashLog.h"
+#import "CrashLogCluster.h"
 #import "CrashLogGroup.h"
+#import "ModalActionSheet.h"
 #import "SectionHeaderView.h"
 #import "SuspectsViewController.h"
+#import "SymbolicationQueue.h"
 #import "VictimCell.h"
 
 #include "paths.h"
 
+// NOTE: Number of logs to load speculatively, starting from the latest log (or
+//       from the log being viewed), so that they are ready when selected.
+static const NSUInteger kPrefetchCount = 4;
+
 @implementation VictimViewController {
     CrashLogGroup *group_;
 }
@@ -47,9 +54,26 @@
 }
 
 - (void)viewWillAppear:(BOOL)animated {
+    [super viewWillAppear:animated];
+
     [self.tableView reloadData];
 }
 
+- (void)viewDidAppear:(BOOL)animated {
+    [super viewDidAppear:animated];
+
+    [self prefetchCrashLogsFromIndex:0];
+}
+
+- (void)viewWillDisappear:(BOOL)animated {
+    [super viewWillDisappear:animated];
+
+    // Stop prefetching if this controller is being popped.
+    if (![self.navigationController.viewControllers containsObject:self]) {
+        [[SymbolicationQueue sharedInstance] cancelPrefetches];
+    }
+}
+
 #pragma mark - Actions
 
 - (void)trashButtonTapped {
@@ -66,8 +90,10 @@
 #pragma mark - Other
 
 - (void)reloadCrashLogGroup {
-    // Reload all crash log groups.
-    [CrashLogGroup forgetGroups];
+    // Apply any changes to crash log groups.
+    // NOTE: The group for this controller may have been replaced (e.g. if the
+    //       log directories had to be rescanned).
+    [CrashLogGroup updateGroups];
 
     NSArray *crashLogGroups = [CrashLogGroup groupsForType:[group_ type]];
 
@@ -83,7 +109,38 @@
     }
 }
 
-- (void)showSuspectsForCrashLog:(CrashLog *)crashLog {
+// NOTE: The index is that of the cluster; only the latest log of each cluster
+//       is shown, and so only those logs are prefetched.
+- (void)prefetchCrashLogsFromIndex:(NSUInteger)index {
+    NSArray *clusters = [group_ clusters];
+    const NSUInteger count = [clusters count];
+    if (index < count) {
+        NSMutableArray *crashLogs = [[NSMutableArray alloc] init];
+        const NSUInteger end = MIN(index + kPrefetchCount, count);
+        for (NSUInteger i = index; i < end; ++i) {
+            [crashLogs addObject:[[clusters objectAtIndex:i] latestCrashLog]];
+        }
+        [[SymbolicationQueue sharedInstance] prefetchCrashLogs:crashLogs];
+        [crashLogs release];
+    }
+}
+
+- (void)showSuspectsForCluster:(CrashLogCluster *)cluster {
+    // Prefetch the logs that follow the selected log, as they are the most
+    // likely to be viewed next.
+    const NSUInteger index = [[group_ clusters] indexOfObject:cluster];
+    if (index != NSNotFound) {
+        [self prefetchCrashLogsFromIndex:(index + 1)];
+    }
+
+    // NOTE: Earlier occurrences of the same crash are considered viewed once
+    //       the latest occurrence has been viewed.
+    CrashLog *crashLog = [cluster latestCrashLog];
+    NSMutableArray *otherCrashLogs = [[cluster crashLogs] mutableCopy];
+    [otherCrashLogs removeObjectIdenticalTo:crashLog];
+    [CrashLog markCrashLogsAsViewed:otherCrashLogs];
+    [otherCrashLogs release];
+
     SuspectsViewController *controller = [[SuspectsViewController alloc] initWithCrashLog:crashLog];
     [self.navigationController pushViewController:controller animated:YES];
     [controller release];
@@ -100,17 +157,17 @@
 
     switch (section) {
         case 0: {
-            NSArray *crashLogs = [group_ crashLogs];
-            const NSUInteger count = [crashLogs count];
+            NSArray *clusters = [group_ clusters];
+            const NSUInteger count = [clusters count];
             if (count > 0) {
-                array = [crashLogs subarrayWithRange:NSMakeRange(0, 1)];
+                array = [clusters subarrayWithRange:NSMakeRange(0, 1)];
             }
         }   break;
         case 1: {
-            NSArray *crashLogs = [group_ crashLogs];
-            const NSUInteger count = [crashLogs count];
+            NSArray *clusters = [group_ clusters];
+            const NSUInteger count = [clusters count];
             if (count > 1) {
-                array = [crashLogs subarrayWithRange:NSMakeRange(1, count - 1)];
+                array = [clusters subarrayWithRange:NSMakeRange(1, count - 1)];
             }
         }   break;
         default:
@@ -133,21 +190,32 @@
 
 - (void)alertView:(UIAlertView *)alertView clickedButtonAtIndex:(NSInteger)buttonIndex {
     if (buttonIndex == 1) {
-        if ([group_ delete]) {
-            // FIXME: For a better visual effect, refresh the table, detect when
-            //        the reload has finished, and then, after a brief delay, pop.
-            [self.navigationController popViewControllerAnimated:YES];
-        } else {
-            NSString *title = NSLocalizedString(@"ERROR", nil);
-            NSString *message = NSLocalizedString(@"DELETE_ALL_FAILED", nil);
-            NSString *okMessage = NSLocalizedString(@"OK", nil);
-            UIAlertView *alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
-                cancelButtonTitle:okMessage otherButtonTitles:nil];
-            [alert show];
-            [alert release];
-
-            [self refresh:nil];
-        }
+        // NOTE: Files are deleted in the background.
+        ModalActionSheet *statusPopup = [[ModalActionSheet alloc] init];
+        [statusPopup updateText:NSLocalizedString(@"PROCESSING", nil)];
+        [statusPopup show];
+
+        [group_ deleteWithCompletion:^(BOOL didDelete) {
+            [statusPopup hide];
+            [statusPopup release];
+
+            if (didDelete) {
+                // FIXME: For a better visual effect, refresh the table, detect
+                //        when the reload has finished, and then, after a brief
+                //        delay, pop.
+                [self.navigationController popViewControllerAnimated:YES];
+            } else {
+                NSString *title = NSLocalizedString(@"ERROR", nil);
+                NSString *message = NSLocalizedString(@"DELETE_ALL_FAILED", nil);
+                NSString *okMessage = NSLocalizedString(@"OK", nil);
+                UIAlertView *alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
+                    cancelButtonTitle:okMessage otherButtonTitles:nil];
+                [alert show];
+                [alert release];
+
+                [self refresh:nil];
+            }
+        }];
     }
 }
 
@@ -162,8 +230,8 @@
 - (void)tableView:(UITableView *)tableView didSelectRowAtIndexPath:(NSIndexPath *)indexPath {
     NSArray *array = [self arrayForSection:indexPath.section];
     if (array != nil) {
-        CrashLog *crashLog = [array objectAtIndex:indexPath.row];
-        [self showSuspectsForCrashLog:crashLog];
+        CrashLogCluster *cluster = [array objectAtIndex:indexPath.row];
+        [self showSuspectsForCluster:cluster];
     }
 }
 
@@ -176,19 +244,46 @@
     NSArray *earlier = [self arrayForSection:1];
 
     NSArray *array = (section == 0) ? latest : earlier;
-    CrashLog *crashLog = [array objectAtIndex:indexPath.row];
-    if ([group_ deleteCrashLog:crashLog]) {
+    const NSUInteger count = [array count];
+    const NSUInteger earlierCount = [earlier count];
+    // NOTE: Deleting an entry deletes all occurrences of the crash.
+    // NOTE: Files are deleted in the background; the table is not edited
+    //       until the logs have been removed from the group.
+    CrashLogCluster *cluster = [array objectAtIndex:indexPath.row];
+    [tableView setUserInteractionEnabled:NO];
+    [group_ deleteCrashLogs:[cluster crashLogs] completion:^(BOOL didDelete) {
+        [tableView setUserInteractionEnabled:YES];
+
+        // NOTE: If the table has been reloaded in the meantime, the rows to
+        //       animate are no longer known.
+        // NOTE: An empty section shows a single placeholder row.
+        if (!didDelete || ([tableView numberOfRowsInSection:section] != (NSInteger)(count ?: 1)) ||
+                ([tableView numberOfRowsInSection:1] != (NSInteger)(earlierCount ?: 1))) {
+            if (!didDelete) {
+                NSString *title = NSLocalizedString(@"ERROR", nil);
+                NSString *message = NSLocalizedString(@"FILE_DELETION_FAILED", nil);
+                NSString *okMessage = NSLocalizedString(@"OK", nil);
+                UIAlertView* alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
+                    cancelButtonTitle:okMessage otherButtonTitles:nil];
+                [alert show];
+                [alert release];
+            }
+
+            // NOTE: Some of the occurrences may have been deleted.
+            [tableView reloadData];
+            return;
+        }
+
         // Animate deletion of row.
         NSArray *indexPaths = [NSArray arrayWithObject:indexPath];
         [tableView beginUpdates];
-        if ([array count] == 1) {
+        if (count == 1) {
             [tableView reloadRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
         } else {
             [tableView deleteRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationLeft];
         }
         if (section == 0) {
             // Animate movement of row from section 1 to section 0.
-            const NSUInteger earlierCount = [earlier count];
             NSArray *earlierIndexPaths = [NSArray arrayWithObject:[NSIndexPath indexPathForRow:0 inSection:1]];
             if (earlierCount == 1) {
                 [tableView reloadRowsAtIndexPaths:earlierIndexPaths withRowAnimation:UITableViewRowAnimationLeft];
@@ -197,16 +292,7 @@
             }
         }
         [tableView endUpdates];
-    } else {
-        NSString *title = NSLocalizedString(@"ERROR", nil);
-        NSString *message = NSLocalizedString(@"FILE_DELETION_FAILED"
-           , nil);
-        NSString *okMessage = NSLocalizedString(@"OK", nil);
-        UIAlertView* alert = [[UIAlertView alloc] initWithTitle:title message:message delegate:nil
-            cancelButtonTitle:okMessage otherButtonTitles:nil];
-        [alert show];
-        [alert release];
-    }
+    }];
 }
 
 @end
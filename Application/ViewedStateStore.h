@@ -0,0 +1,26 @@
+/**
+ * Name: CrashReporter
+ * Type: iOS application
+ * Desc: iOS app for viewing the details of a crash, determining the possible
+ *       cause of said crash, and reporting this information to the developer(s)
+ *       responsible.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import <Foundation/Foundation.h>
+
+@interface ViewedStateStore : NSObject
++ (instancetype)sharedInstance;
+- (BOOL)isViewed:(NSString *)filepath;
+- (void)addFilepath:(NSString *)filepath;
+- (void)addFilepaths:(NSArray *)filepaths;
+- (void)removeFilepath:(NSString *)filepath;
+- (void)removeFilepaths:(NSArray *)filepaths;
+- (void)moveFilepath:(NSString *)filepath toFilepath:(NSString *)newFilepath;
+- (void)pruneDirectory:(NSString *)directory existentFilepaths:(NSSet *)existentFilepaths;
+- (void)synchronize;
+@end
+
+/* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
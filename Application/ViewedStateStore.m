@@ -0,0 +1,312 @@
+/**
+ * Name: CrashReporter
+ * Type: iOS application
+ * Desc: iOS app for viewing the details of a crash, determining the possible
+ *       cause of said crash, and reporting this information to the developer(s)
+ *       responsible.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import "ViewedStateStore.h"
+
+#import "crashlog_util.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "paths.h"
+
+// NOTE: Older versions stored the list of viewed logs as an array in the
+//       app's defaults; it is migrated to the journal on first use.
+static NSString * const kViewedCrashLogs = @"viewedCrashLogs";
+
+// NOTE: Older versions kept the journal in the cache directory, which the
+//       system may purge; it is moved to the data directory on first use.
+static const char * const kLegacyViewedStateFilepath = kCacheDirectory "/viewed.journal";
+
+// NOTE: The journal is a list of newline-terminated records, each of which
+//       either adds ('+') or removes ('-') a single filepath. Records are only
+//       ever appended; once the journal has grown much larger than the set of
+//       filepaths it describes, it is compacted.
+static const char kRecordAdd = '+';
+static const char kRecordRemove = '-';
+static const NSUInteger kCompactionSlack = 64;
+
+// NOTE: Changes are written in batches, rather than one write per change.
+static const NSTimeInterval kFlushDelay = 2.0;
+
+@implementation ViewedStateStore {
+    NSMutableSet *filepaths_;
+    NSMutableData *pendingRecords_;
+    NSUInteger recordCount_;
+    BOOL flushScheduled_;
+}
+
++ (instancetype)sharedInstance {
+    static dispatch_once_t once;
+    static id instance;
+    dispatch_once(&once, ^{
+        instance = [[self alloc] init];
+    });
+    return instance;
+}
+
+- (id)init {
+    self = [super init];
+    if (self != nil) {
+        filepaths_ = [[NSMutableSet alloc] init];
+        pendingRecords_ = [[NSMutableData alloc] init];
+
+        [[NSFileManager defaultManager] createDirectoryAtPath:@kDataDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+        [self load];
+
+        // Write any pending changes before the app is suspended or terminated.
+        NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+        [center addObserver:self selector:@selector(synchronize)
+            name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [center addObserver:self selector:@selector(synchronize)
+            name:UIApplicationWillTerminateNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+    [pendingRecords_ release];
+    [filepaths_ release];
+    [super dealloc];
+}
+
+#pragma mark - Persistence
+
+- (void)load {
+    // Move journal from cache directory, if it exists there.
+    if ((access(kViewedStateFilepath, F_OK) != 0) && (errno == ENOENT)) {
+        if ((rename(kLegacyViewedStateFilepath, kViewedStateFilepath) != 0) && (errno != ENOENT)) {
+            fprintf(stderr, "ERROR: Failed to move viewed state file, errno = %d.\n", errno);
+        }
+    }
+
+    NSData *data = [[NSData alloc] initWithContentsOfFile:@kViewedStateFilepath];
+    if (data != nil) {
+        const char *bytes = (const char *)[data bytes];
+        const char *p = bytes;
+        const char *end = p + [data length];
+        while (p < end) {
+            const char *newline = (const char *)memchr(p, '\n', end - p);
+            if (newline == NULL) {
+                // NOTE: Incomplete record, likely from an interrupted write.
+                //       It is removed, as records appended after it would
+                //       otherwise be merged with it (and both lost).
+                if (truncate(kViewedStateFilepath, p - bytes) != 0) {
+                    fprintf(stderr, "ERROR: Failed to truncate viewed state file, errno = %d.\n", errno);
+                }
+                break;
+            }
+
+            if (newline - p > 1) {
+                NSString *filepath = [[NSString alloc] initWithBytes:(p + 1) length:(newline - p - 1) encoding:NSUTF8StringEncoding];
+                if (filepath != nil) {
+                    if (*p == kRecordAdd) {
+                        [filepaths_ addObject:filepath];
+                    } else if (*p == kRecordRemove) {
+                        [filepaths_ removeObject:filepath];
+                    }
+                    [filepath release];
+                }
+            }
+            ++recordCount_;
+
+            p = newline + 1;
+        }
+        [data release];
+    } else {
+        // Migrate list from defaults, if it exists.
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        NSArray *viewedCrashLogs = [defaults arrayForKey:kViewedCrashLogs];
+        if (viewedCrashLogs != nil) {
+            for (id object in viewedCrashLogs) {
+                if ([object isKindOfClass:[NSString class]]) {
+                    [filepaths_ addObject:object];
+                }
+            }
+
+            if ([self writeSnapshot]) {
+                [defaults removeObjectForKey:kViewedCrashLogs];
+                [defaults synchronize];
+            }
+        }
+    }
+}
+
+- (BOOL)writeSnapshot {
+    NSMutableData *data = [[NSMutableData alloc] init];
+    for (NSString *filepath in filepaths_) {
+        const char *string = [filepath UTF8String];
+        [data appendBytes:&kRecordAdd length:1];
+        [data appendBytes:string length:strlen(string)];
+        [data appendBytes:"\n" length:1];
+    }
+
+    // NOTE: Write to a temporary file and rename so that the journal is never
+    //       left partially written.
+    const BOOL succeeded = [data writeToFile:@kViewedStateFilepath atomically:YES];
+    if (succeeded) {
+        [pendingRecords_ setLength:0];
+        recordCount_ = [filepaths_ count];
+    } else {
+        fprintf(stderr, "ERROR: Failed to write viewed state file \"%s\".\n", kViewedStateFilepath);
+    }
+    [data release];
+
+    return succeeded;
+}
+
+- (void)appendRecord:(char)type filepath:(NSString *)filepath {
+    const char *string = [filepath UTF8String];
+    if (strchr(string, '\n') != NULL) {
+        // NOTE: Cannot be represented in the journal; should never happen for
+        //       crash log filepaths.
+        return;
+    }
+
+    [pendingRecords_ appendBytes:&type length:1];
+    [pendingRecords_ appendBytes:string length:strlen(string)];
+    [pendingRecords_ appendBytes:"\n" length:1];
+    ++recordCount_;
+
+    if (!flushScheduled_) {
+        flushScheduled_ = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kFlushDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [self synchronize];
+        });
+    }
+}
+
+- (void)synchronize {
+    @synchronized(self) {
+        flushScheduled_ = NO;
+
+        if ([pendingRecords_ length] == 0) {
+            return;
+        }
+
+        // Compact the journal if it consists mostly of stale records.
+        if (recordCount_ > (2 * [filepaths_ count] + kCompactionSlack)) {
+            if ([self writeSnapshot]) {
+                return;
+            }
+        }
+
+        FILE *f = fopen(kViewedStateFilepath, "a");
+        if (f != NULL) {
+            const size_t length = [pendingRecords_ length];
+            struct stat st;
+            const BOOL hasSize = (fstat(fileno(f), &st) == 0);
+            if ((fwrite([pendingRecords_ bytes], 1, length, f) != length) || (fflush(f) != 0)) {
+                fprintf(stderr, "ERROR: Failed to append to viewed state file, errno = %d.\n", errno);
+
+                // Remove any partially written record.
+                if (hasSize) {
+                    ftruncate(fileno(f), st.st_size);
+                }
+            }
+            fclose(f);
+        } else {
+            fprintf(stderr, "ERROR: Failed to open viewed state file, errno = %d.\n", errno);
+        }
+
+        // NOTE: Records that failed to be written are dropped; viewed state is
+        //       not critical, and retaining them would grow without bound.
+        [pendingRecords_ setLength:0];
+    }
+}
+
+#pragma mark - State
+
+// NOTE: Logs are recorded by their uncompressed filepath, so that the viewed
+//       state is kept when a log is compressed (see compressFile()).
+
+- (BOOL)isViewed:(NSString *)filepath {
+    filepath = uncompressedPathForFile(filepath);
+    @synchronized(self) {
+        return [filepaths_ containsObject:filepath];
+    }
+}
+
+- (void)addFilepath:(NSString *)filepath {
+    filepath = uncompressedPathForFile(filepath);
+    @synchronized(self) {
+        if (![filepaths_ containsObject:filepath]) {
+            [filepaths_ addObject:filepath];
+            [self appendRecord:kRecordAdd filepath:filepath];
+        }
+    }
+}
+
+- (void)addFilepaths:(NSArray *)filepaths {
+    @synchronized(self) {
+        for (NSString *filepath in filepaths) {
+            [self addFilepath:filepath];
+        }
+    }
+}
+
+- (void)removeFilepath:(NSString *)filepath {
+    filepath = uncompressedPathForFile(filepath);
+    @synchronized(self) {
+        if ([filepaths_ containsObject:filepath]) {
+            [filepaths_ removeObject:filepath];
+            [self appendRecord:kRecordRemove filepath:filepath];
+        }
+    }
+}
+
+- (void)removeFilepaths:(NSArray *)filepaths {
+    @synchronized(self) {
+        for (NSString *filepath in filepaths) {
+            [self removeFilepath:filepath];
+        }
+    }
+}
+
+- (void)moveFilepath:(NSString *)filepath toFilepath:(NSString *)newFilepath {
+    filepath = uncompressedPathForFile(filepath);
+    @synchronized(self) {
+        if ([filepaths_ containsObject:filepath]) {
+            [filepaths_ removeObject:filepath];
+            [self appendRecord:kRecordRemove filepath:filepath];
+            [self addFilepath:newFilepath];
+        }
+    }
+}
+
+- (void)pruneDirectory:(NSString *)directory existentFilepaths:(NSSet *)existentFilepaths {
+    @synchronized(self) {
+        NSMutableSet *existent = [[NSMutableSet alloc] initWithCapacity:[existentFilepaths count]];
+        for (NSString *filepath in existentFilepaths) {
+            [existent addObject:uncompressedPathForFile(filepath)];
+        }
+
+        NSMutableArray *stale = [[NSMutableArray alloc] init];
+        for (NSString *filepath in filepaths_) {
+            if (![existent containsObject:filepath]) {
+                if ([[filepath stringByDeletingLastPathComponent] isEqualToString:directory]) {
+                    [stale addObject:filepath];
+                }
+            }
+        }
+        [self removeFilepaths:stale];
+        [stale release];
+        [existent release];
+    }
+}
+
+@end
+
+/* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
@@ -8,25 +8,38 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "paths.h"
 
 static const char * const kTemporaryFilepath = "/tmp/CrashReporter.temp.XXXXXX";
 
+// NOTE: Upper limit on the size of a single request in server mode; large
+//       enough for a batch delete of several thousand log files.
+static const size_t kMaxRequestSize = 1024 * 1024;
+
 static void print_usage() {
     fprintf(stderr,
             "Usage: as_root chmod <filepath> <mode>\n"
             "       as_root chown <filepath> <owner> <group>\n"
             "       as_root copy <from_filepath> <to_filepath>\n"
-            "       as_root delete <filepath>\n"
+            "       as_root delete <filepath> [<filepath> ...]\n"
+            "       as_root link <filename> <link_filepath>\n"
             "       as_root move <from_filepath> <to_filepath>\n"
             "       as_root read <filepath>\n"
+            "       as_root serve\n"
+            "\n"
+            "       In server mode, \"open <filepath>\" is also accepted; the file is\n"
+            "       opened for reading and the descriptor is passed to the client.\n"
             "\n"
             "       Note that only filepaths with the following prefixes are permitted:\n"
             "       * \"%s\"\n"
@@ -66,45 +79,136 @@ exit_copy:
     return result;
 }
 
+static int has_directory_prefix(const char *filepath, const char *directory) {
+    size_t length = strlen(directory);
+    if ((length > 0) && (directory[length - 1] == '/')) {
+        --length;
+    }
+    return (strncmp(filepath, directory, length) == 0) && (filepath[length] == '/');
+}
+
+// NOTE: Paths containing ".." components are rejected, as they could be used
+//       to escape the permitted directories.
+static int has_parent_component(const char *filepath) {
+    for (const char *p = filepath; (p = strstr(p, "..")) != NULL; p += 2) {
+        if (((p == filepath) || (p[-1] == '/')) && ((p[2] == '/') || (p[2] == '\0'))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static int is_valid_filepath(const char *filepath) {
     return
-        (strncmp(filepath, kCrashLogDirectoryForMobile, strlen(kCrashLogDirectoryForMobile)) == 0) ||
-        (strncmp(filepath, kCrashLogDirectoryForRoot, strlen(kCrashLogDirectoryForRoot)) == 0) ||
-        (strncmp(filepath, kTemporaryPath, strlen(kTemporaryPath)) == 0);
+        !has_parent_component(filepath) && (
+        has_directory_prefix(filepath, kCrashLogDirectoryForMobile) ||
+        has_directory_prefix(filepath, kCrashLogDirectoryForRoot) ||
+        has_directory_prefix(filepath, kTemporaryPath));
 }
 
-int main(int argc, const char *argv[]) {
-    // Run as root.
-    if (setuid(geteuid()) != 0) {
-        fprintf(stderr, "ERROR: Unable to assume root powers, errno = %d.\n", errno);
-        return EXIT_FAILURE;
+// NOTE: Opens the permitted directory that the given (valid) filepath is in,
+//       setting *relative_filepath to the rest of the filepath.
+// NOTE: Symbolic links in the path of the directory itself (e.g. "/var" is a
+//       link to "/private/var" on iOS) are part of the system, and are
+//       followed; they cannot be changed by the client.
+static int open_permitted_directory(const char *filepath, const char **relative_filepath) {
+    const char * const directories[] = {kCrashLogDirectoryForMobile, kCrashLogDirectoryForRoot, kTemporaryPath};
+    for (unsigned i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) {
+        if (has_directory_prefix(filepath, directories[i])) {
+            size_t length = strlen(directories[i]);
+            if (directories[i][length - 1] == '/') {
+                --length;
+            }
+            *relative_filepath = filepath + length + 1;
+            return open(directories[i], O_RDONLY | O_DIRECTORY);
+        }
     }
+    errno = EACCES;
+    return -1;
+}
+
+// NOTE: Opens the file at the given filepath for reading, one component at a
+//       time, starting from the permitted directory that contains it. No
+//       symbolic link is followed, so no component can be replaced (between
+//       checking and opening) to point outside of the permitted directories.
+static int open_permitted_file(const char *filepath) {
+    const char *relative_filepath;
+    int dir_fd = open_permitted_directory(filepath, &relative_filepath);
+    if (dir_fd < 0) {
+        return -1;
+    }
+
+    const char *p = relative_filepath;
+    for (;;) {
+        // Skip empty and "." components.
+        // NOTE: ".." components have already been rejected.
+        while ((*p == '/') || ((p[0] == '.') && ((p[1] == '/') || (p[1] == '\0')))) {
+            ++p;
+        }
+
+        const char *end = strchr(p, '/');
+        const size_t length = (end != NULL) ? (size_t)(end - p) : strlen(p);
+        if ((length == 0) || (length >= NAME_MAX + 1)) {
+            // NOTE: The filepath names a directory, or the name is too long.
+            close(dir_fd);
+            errno = (length == 0) ? EISDIR : ENAMETOOLONG;
+            return -1;
+        }
+        char component[NAME_MAX + 1];
+        memcpy(component, p, length);
+        component[length] = '\0';
+        p += length;
+
+        // NOTE: Trailing slashes are skipped, so whether this is the last
+        //       component is determined by what follows them.
+        const char *next = p;
+        while (*next == '/') {
+            ++next;
+        }
+        const int is_last = (*next == '\0');
+
+        int fd = openat(dir_fd, component, is_last ?
+            (O_RDONLY | O_NOFOLLOW | O_NONBLOCK) : (O_RDONLY | O_NOFOLLOW | O_DIRECTORY));
+        const int saved_errno = errno;
+        close(dir_fd);
+        if ((fd < 0) || is_last) {
+            errno = saved_errno;
+            return fd;
+        }
+        dir_fd = fd;
+    }
+}
+
+// NOTE: argv[0] is the name of the command. On success, any output (such as
+//       the filepath produced by "read") is written to the given buffer.
+static int run_command(int argc, const char *argv[], char *output, size_t output_size) {
+    output[0] = '\0';
 
-    if ((argc == 4) && (strcasecmp(argv[1], "chmod") == 0)) {
+    if ((argc == 3) && (strcasecmp(argv[0], "chmod") == 0)) {
         // Get filepath and ownership info.
-        const char *filepath = argv[2];
-        mode_t mode = strtol(argv[3], NULL, 8);
+        const char *filepath = argv[1];
+        mode_t mode = strtol(argv[2], NULL, 8);
 
         // Change mode for filepath.
         if (chmod(filepath, mode) != 0) {
             fprintf(stderr, "WARNING: Failed to change mode of file: %s, errno = %d.\n", filepath, errno);
             return EXIT_FAILURE;
         }
-    } else if ((argc == 5) && (strcasecmp(argv[1], "chown") == 0)) {
+    } else if ((argc == 4) && (strcasecmp(argv[0], "chown") == 0)) {
         // Get filepath and ownership info.
-        const char *filepath = argv[2];
-        uid_t owner = atoi(argv[3]);
-        gid_t group = atoi(argv[4]);
+        const char *filepath = argv[1];
+        uid_t owner = atoi(argv[2]);
+        gid_t group = atoi(argv[3]);
 
         // Change ownership for filepath.
         if (lchown(filepath, owner, group) != 0) {
             fprintf(stderr, "WARNING: Failed to change ownership of file: %s, errno = %d.\n", filepath, errno);
             return EXIT_FAILURE;
         }
-    } else if ((argc == 4) && (strcasecmp(argv[1], "copy") == 0)) {
+    } else if ((argc == 3) && (strcasecmp(argv[0], "copy") == 0)) {
         // Get filepaths.
-        const char *from_filepath = argv[2];
-        const char *to_filepath = argv[3];
+        const char *from_filepath = argv[1];
+        const char *to_filepath = argv[2];
 
         // Check files at filepaths.
         if (!is_valid_filepath(from_filepath) || !is_valid_filepath(to_filepath)) {
@@ -116,10 +220,42 @@ int main(int argc, const char *argv[]) {
         if (copy(from_filepath, to_filepath) != 0) {
             return EXIT_FAILURE;
         }
-    } else if ((argc == 4) && (strcasecmp(argv[1], "move") == 0)) {
+    } else if ((argc == 3) && (strcasecmp(argv[0], "link") == 0)) {
+        // Get destination and filepath.
+        // NOTE: The destination is a filename, relative to the link, so that
+        //       the link cannot point outside of its directory.
+        const char *filename = argv[1];
+        const char *link_filepath = argv[2];
+
+        // Check destination and link at filepath.
+        if ((filename[0] == '\0') || (strchr(filename, '/') != NULL) ||
+                (strcmp(filename, ".") == 0) || (strcmp(filename, "..") == 0) ||
+                !is_valid_filepath(link_filepath)) {
+            fprintf(stderr, "ERROR: Specified filename or filepath is not allowed.\n");
+            return EXIT_FAILURE;
+        }
+
+        // Create link at temporary filepath, then move into place.
+        // NOTE: Any existing link is replaced atomically, and is kept if the
+        //       new link cannot be created.
+        char temp_filepath[PATH_MAX];
+        if (snprintf(temp_filepath, sizeof(temp_filepath), "%s.%d.temp", link_filepath, getpid()) >= (int)sizeof(temp_filepath)) {
+            fprintf(stderr, "ERROR: Specified filepath is too long.\n");
+            return EXIT_FAILURE;
+        }
+        if (symlink(filename, temp_filepath) != 0) {
+            fprintf(stderr, "ERROR: Failed to create symbolic link, errno = %d.\n", errno);
+            return EXIT_FAILURE;
+        }
+        if (rename(temp_filepath, link_filepath) != 0) {
+            fprintf(stderr, "ERROR: Failed to rename symbolic link, errno = %d.\n", errno);
+            unlink(temp_filepath);
+            return EXIT_FAILURE;
+        }
+    } else if ((argc == 3) && (strcasecmp(argv[0], "move") == 0)) {
         // Get filepaths.
-        const char *from_filepath = argv[2];
-        const char *to_filepath = argv[3];
+        const char *from_filepath = argv[1];
+        const char *to_filepath = argv[2];
 
         // Check files at filepaths.
         if (!is_valid_filepath(from_filepath) || !is_valid_filepath(to_filepath)) {
@@ -134,24 +270,30 @@ int main(int argc, const char *argv[]) {
                 return EXIT_FAILURE;
             }
         }
-    } else if ((argc == 3) && (strcasecmp(argv[1], "delete") == 0)) {
-        // Get filepath.
-        const char *filepath = argv[2];
-
-        // Check file at filepath.
-        if (!is_valid_filepath(filepath)) {
-            fprintf(stderr, "ERROR: Specified filepath is not allowed.\n");
-            return EXIT_FAILURE;
+    } else if ((argc >= 2) && (strcasecmp(argv[0], "delete") == 0)) {
+        // Check files at filepaths.
+        // NOTE: All filepaths are checked before any file is deleted.
+        for (int i = 1; i < argc; ++i) {
+            if (!is_valid_filepath(argv[i])) {
+                fprintf(stderr, "ERROR: Specified filepath is not allowed: %s.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
         }
 
-        // Delete file at filepath.
-        if (unlink(filepath) != 0) {
-            fprintf(stderr, "ERROR: Failed to delete file, errno = %d.\n", errno);
-            return EXIT_FAILURE;
+        // Delete files at filepaths.
+        // NOTE: A failure to delete one file does not prevent the deletion of
+        //       the others.
+        int result = EXIT_SUCCESS;
+        for (int i = 1; i < argc; ++i) {
+            if (unlink(argv[i]) != 0) {
+                fprintf(stderr, "ERROR: Failed to delete file: %s, errno = %d.\n", argv[i], errno);
+                result = EXIT_FAILURE;
+            }
         }
-    } else if ((argc == 3) && (strcasecmp(argv[1], "read") == 0)) {
+        return result;
+    } else if ((argc == 2) && (strcasecmp(argv[0], "read") == 0)) {
         // Get filepath.
-        const char *filepath = argv[2];
+        const char *filepath = argv[1];
 
         // Check file at filepath.
         if (!is_valid_filepath(filepath)) {
@@ -172,11 +314,235 @@ int main(int argc, const char *argv[]) {
             return EXIT_FAILURE;
         }
 
-        // Print temporary filepath.
-        fprintf(stdout, "%s\n", temp_filepath);
+        // Output temporary filepath.
+        snprintf(output, output_size, "%s", temp_filepath);
     } else {
-        print_usage();
+        return -1;
     }
 
     return EXIT_SUCCESS;
 }
+
+// NOTE: Reads a single request from stdin. A request is a sequence of
+//       NUL-terminated arguments, followed by an empty argument (i.e. an
+//       additional NUL). Returns the number of arguments, zero if the request
+//       was malformed or too large, or -1 on end of input.
+static int read_request(char **buffer, size_t *buffer_size, const char ***args, size_t *args_size) {
+    size_t length = 0;
+    size_t arg_length = 0;
+    int argc = 0;
+    int is_valid = 1;
+
+    for (;;) {
+        int c = getchar();
+        if (c == EOF) {
+            return -1;
+        }
+
+        // Store character.
+        // NOTE: If the request is too large, the remainder is read and
+        //       discarded so that the next request can be processed.
+        if (is_valid && (length == *buffer_size)) {
+            size_t size = (*buffer_size != 0) ? (2 * *buffer_size) : 4096;
+            char *new_buffer = (size <= kMaxRequestSize) ? realloc(*buffer, size) : NULL;
+            if (new_buffer != NULL) {
+                *buffer = new_buffer;
+                *buffer_size = size;
+            } else {
+                is_valid = 0;
+            }
+        }
+        if (is_valid) {
+            (*buffer)[length++] = c;
+        }
+
+        if (c == '\0') {
+            if (arg_length == 0) {
+                // Empty argument; end of request.
+                break;
+            }
+            ++argc;
+            arg_length = 0;
+        } else {
+            ++arg_length;
+        }
+    }
+
+    if (!is_valid || (argc == 0)) {
+        return 0;
+    }
+
+    // Build argument list.
+    if ((size_t)argc > *args_size) {
+        const char **new_args = realloc(*args, argc * sizeof(char *));
+        if (new_args == NULL) {
+            return 0;
+        }
+        *args = new_args;
+        *args_size = argc;
+    }
+    const char *p = *buffer;
+    for (int i = 0; i < argc; ++i) {
+        (*args)[i] = p;
+        p += strlen(p) + 1;
+    }
+    return argc;
+}
+
+// NOTE: Sends the reply along with an open file descriptor.
+// NOTE: Requires stdout to be a UNIX domain socket.
+static int send_reply_with_fd(const char *reply, int fd) {
+    struct iovec iov;
+    iov.iov_base = (void *)reply;
+    iov.iov_len = strlen(reply);
+
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t count;
+    do {
+        count = sendmsg(STDOUT_FILENO, &msg, 0);
+    } while ((count < 0) && (errno == EINTR));
+    if (count < 0) {
+        fprintf(stderr, "ERROR: Failed to send file descriptor, errno = %d.\n", errno);
+        return 0;
+    }
+
+    // NOTE: The descriptor is sent with the first byte; send the rest of the
+    //       reply, if it was not sent in full.
+    if ((size_t)count < iov.iov_len) {
+        fputs(reply + count, stdout);
+    }
+    return 1;
+}
+
+// NOTE: Opens the file at the given filepath for reading and passes the open
+//       descriptor to the client, so that the client can read a file that it
+//       does not have permission to read without the file being copied.
+// NOTE: As the descriptor outlives the request, the file is opened without
+//       following symbolic links (see open_permitted_file()), and the file
+//       that was actually opened is checked.
+static int serve_open(const char *filepath) {
+    // Check file at filepath.
+    if (!is_valid_filepath(filepath)) {
+        fprintf(stderr, "ERROR: Specified filepath is not allowed.\n");
+        return 0;
+    }
+
+    int fd = open_permitted_file(filepath);
+    if (fd < 0) {
+        if ((errno == ELOOP) || (errno == ENOTDIR) || (errno == EMLINK)) {
+            // NOTE: A component is a symbolic link.
+            fprintf(stderr, "ERROR: Specified filepath is not allowed.\n");
+        } else {
+            fprintf(stderr, "ERROR: Unable to open filepath for reading, errno = %d.\n", errno);
+        }
+        return 0;
+    }
+
+    // NOTE: The descriptor was opened non-blocking, so that opening a FIFO
+    //       could not block the server; it is used for regular files only.
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) ||
+            (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) != 0)) {
+        fprintf(stderr, "ERROR: Specified filepath is not allowed.\n");
+        close(fd);
+        return 0;
+    }
+
+    int result = send_reply_with_fd("0\n", fd);
+    close(fd);
+    return result;
+}
+
+// NOTE: In server mode, requests are read from stdin and a reply is written to
+//       stdout for each request, allowing a client to perform any number of
+//       operations without the cost of launching this tool for each one.
+//       The reply is a single line consisting of the exit status of the
+//       command, followed by a space and the command's output, if any.
+static int serve() {
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+    const char **args = NULL;
+    size_t args_size = 0;
+
+    int argc;
+    while ((argc = read_request(&buffer, &buffer_size, &args, &args_size)) >= 0) {
+        if ((argc == 2) && (strcasecmp(args[0], "open") == 0)) {
+            // NOTE: On success, the reply has already been sent.
+            if (!serve_open(args[1])) {
+                fprintf(stdout, "%d\n", EXIT_FAILURE);
+            }
+            if (fflush(stdout) != 0) {
+                // Client has gone away.
+                break;
+            }
+            continue;
+        }
+
+        char output[PATH_MAX];
+        int result = (argc > 0) ? run_command(argc, args, output, sizeof(output)) : -1;
+        if (result < 0) {
+            fprintf(stderr, "ERROR: Invalid request.\n");
+            result = EXIT_FAILURE;
+            output[0] = '\0';
+        }
+
+        if (output[0] != '\0') {
+            fprintf(stdout, "%d %s\n", result, output);
+        } else {
+            fprintf(stdout, "%d\n", result);
+        }
+        if (fflush(stdout) != 0) {
+            // Client has gone away.
+            break;
+        }
+    }
+
+    free(args);
+    free(buffer);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char *argv[]) {
+    // Run as root.
+    if (setuid(geteuid()) != 0) {
+        fprintf(stderr, "ERROR: Unable to assume root powers, errno = %d.\n", errno);
+        return EXIT_FAILURE;
+    }
+
+    if ((argc == 2) && (strcasecmp(argv[1], "serve") == 0)) {
+        return serve();
+    }
+
+    char output[PATH_MAX];
+    int result = (argc > 1) ? run_command(argc - 1, &argv[1], output, sizeof(output)) : -1;
+    if (result < 0) {
+        print_usage();
+        return EXIT_SUCCESS;
+    }
+
+    // Print output, if any.
+    if (output[0] != '\0') {
+        fprintf(stdout, "%s\n", output);
+    }
+
+    return result;
+}
@@ -0,0 +1,284 @@
+/**
+ * Desc: Test of the server mode of the as_root tool, built without setuid (see
+ *       tests.mk): the passing of open file descriptors (SCM_RIGHTS), and the
+ *       rejection of filepaths outside of the permitted directories, whether
+ *       by "..", by symbolic links, or by a mere common prefix ("/tmpx"); and
+ *       the replacement of "LatestCrash" links.
+ *
+ *       Only the temporary directory ("/tmp/") is permitted on Linux.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "test_util.h"
+
+typedef struct {
+    pid_t pid;
+    int fd;
+} server_t;
+
+static int start_server(const char *path, server_t *server) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        return 0;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // NOTE: The errors reported by the tool are expected.
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        dup2(sockets[1], STDIN_FILENO);
+        dup2(sockets[1], STDOUT_FILENO);
+        close(sockets[0]);
+        close(sockets[1]);
+        execl(path, path, "serve", NULL);
+        _exit(1);
+    }
+    close(sockets[1]);
+    if (pid == -1) {
+        close(sockets[0]);
+        return 0;
+    }
+
+    server->pid = pid;
+    server->fd = sockets[0];
+    return 1;
+}
+
+static int stop_server(server_t *server) {
+    close(server->fd);
+    int stat_loc = 0;
+    waitpid(server->pid, &stat_loc, 0);
+    return WIFEXITED(stat_loc) && (WEXITSTATUS(stat_loc) == 0);
+}
+
+static int send_request(server_t *server, const char **args, unsigned argc) {
+    char buffer[4096];
+    size_t length = 0;
+    for (unsigned i = 0; i < argc; ++i) {
+        const size_t size = strlen(args[i]) + 1;
+        memcpy(buffer + length, args[i], size);
+        length += size;
+    }
+    buffer[length++] = '\0';
+    return send(server->fd, buffer, length, MSG_NOSIGNAL) == (ssize_t)length;
+}
+
+// NOTE: As receive_reply() in exec_as_root.m. Returns the status of the reply
+//       (or -1 if there was none), and any descriptor that was passed.
+static int receive_reply(server_t *server, int *fd) {
+    *fd = -1;
+    char reply[256];
+    size_t length = 0;
+    while ((length == 0) || (reply[length - 1] != '\n')) {
+        struct iovec iov = {reply + length, sizeof(reply) - 1 - length};
+        union {
+            struct cmsghdr header;
+            char buffer[CMSG_SPACE(sizeof(int))];
+        } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+
+        const ssize_t count = recvmsg(server->fd, &msg, 0);
+        if (count <= 0) {
+            if ((count < 0) && (errno == EINTR)) {
+                continue;
+            }
+            return -1;
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+                memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+        length += count;
+    }
+    return atoi(reply);
+}
+
+// NOTE: Returns the descriptor passed for the file, or -1 if it was refused.
+static int open_via_server(server_t *server, const char *filepath) {
+    int fd = -1;
+    const char *args[] = {"open", filepath};
+    CHECK(send_request(server, args, 2));
+    const int status = receive_reply(server, &fd);
+    CHECK(status >= 0);
+    CHECK((status == 0) == (fd >= 0));
+    if ((status != 0) && (fd >= 0)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static int has_contents(int fd, const char *contents) {
+    char buffer[256];
+    const ssize_t count = read(fd, buffer, sizeof(buffer));
+    return (count == (ssize_t)strlen(contents)) && (memcmp(buffer, contents, count) == 0);
+}
+
+static void test_open(server_t *server, const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "log.ips");
+    CHECK(test_write_file(filepath, "crash", 5));
+
+    int fd = open_via_server(server, filepath);
+    CHECK(fd >= 0);
+    CHECK(has_contents(fd, "crash"));
+    close(fd);
+
+    // NOTE: The file stays readable via the descriptor after it is removed.
+    fd = open_via_server(server, filepath);
+    CHECK(unlink(filepath) == 0);
+    CHECK(has_contents(fd, "crash"));
+    close(fd);
+
+    // Nested directories, with empty and "." components.
+    char subdirectory[1024];
+    test_path(subdirectory, sizeof(subdirectory), directory, "sub");
+    CHECK(mkdir(subdirectory, 0755) == 0);
+    test_path(filepath, sizeof(filepath), subdirectory, "log.ips");
+    CHECK(test_write_file(filepath, "nested", 6));
+    test_path(filepath, sizeof(filepath), directory, "/./sub//log.ips");
+    fd = open_via_server(server, filepath);
+    CHECK(fd >= 0);
+    CHECK(has_contents(fd, "nested"));
+    close(fd);
+
+    // Missing files, and directories, are refused.
+    test_path(filepath, sizeof(filepath), directory, "missing.ips");
+    CHECK(open_via_server(server, filepath) < 0);
+    CHECK(open_via_server(server, subdirectory) < 0);
+    test_path(filepath, sizeof(filepath), directory, "sub/");
+    CHECK(open_via_server(server, filepath) < 0);
+}
+
+static void test_rejected_paths(server_t *server, const char *directory) {
+    // NOTE: The test directory is created in "/tmp/"; a file elsewhere is
+    //       needed, readable by this process (the tool is not privileged).
+    char *home = getenv("HOME");
+    char outside_filepath[1024];
+    snprintf(outside_filepath, sizeof(outside_filepath), "%s/.as_root_test.%d", (home != NULL) ? home : ".", getpid());
+    CHECK(test_write_file(outside_filepath, "secret", 6));
+    char outside_dirpath[1024];
+    snprintf(outside_dirpath, sizeof(outside_dirpath), "%s", outside_filepath);
+    char *outside_dirname = dirname(outside_dirpath);
+    char *outside_basename = strrchr(outside_filepath, '/') + 1;
+
+    // "..".
+    char filepath[2048];
+    test_path(filepath, sizeof(filepath), directory, "../..%s", outside_filepath);
+    CHECK(open_via_server(server, filepath) < 0);
+
+    // A symbolic link to the file.
+    char link_filepath[1024];
+    test_path(link_filepath, sizeof(link_filepath), directory, "file_link.ips");
+    CHECK(symlink(outside_filepath, link_filepath) == 0);
+    CHECK(open_via_server(server, link_filepath) < 0);
+
+    // A symbolic link to a directory, as an intermediate component.
+    test_path(link_filepath, sizeof(link_filepath), directory, "dir_link");
+    CHECK(symlink(outside_dirname, link_filepath) == 0);
+    snprintf(filepath, sizeof(filepath), "%s/%s", link_filepath, outside_basename);
+    CHECK(open_via_server(server, filepath) < 0);
+
+    // NOTE: Links within the permitted directories are refused as well.
+    char target_filepath[1024];
+    test_path(target_filepath, sizeof(target_filepath), directory, "target.ips");
+    CHECK(test_write_file(target_filepath, "target", 6));
+    test_path(link_filepath, sizeof(link_filepath), directory, "inner_link.ips");
+    CHECK(symlink("target.ips", link_filepath) == 0);
+    CHECK(open_via_server(server, link_filepath) < 0);
+
+    // A common prefix that is not a directory of the permitted path.
+    snprintf(filepath, sizeof(filepath), "/tmpx%s", directory + 4);
+    CHECK(open_via_server(server, filepath) < 0);
+    CHECK(open_via_server(server, "/tmp") < 0);
+    CHECK(open_via_server(server, outside_filepath) < 0);
+
+    // NOTE: The server still serves valid requests.
+    int fd = open_via_server(server, target_filepath);
+    CHECK(fd >= 0);
+    CHECK(has_contents(fd, "target"));
+    close(fd);
+
+    unlink(outside_filepath);
+}
+
+// NOTE: Returns the status of the reply.
+static int link_via_server(server_t *server, const char *filename, const char *link_filepath) {
+    int fd = -1;
+    const char *args[] = {"link", filename, link_filepath};
+    CHECK(send_request(server, args, 3));
+    const int status = receive_reply(server, &fd);
+    CHECK(fd < 0);
+    return status;
+}
+
+static int has_destination(const char *link_filepath, const char *filename) {
+    char destination[1024];
+    const ssize_t length = readlink(link_filepath, destination, sizeof(destination) - 1);
+    return (length == (ssize_t)strlen(filename)) && (memcmp(destination, filename, length) == 0);
+}
+
+static void test_link(server_t *server, const char *directory) {
+    char link_filepath[1024];
+    test_path(link_filepath, sizeof(link_filepath), directory, "LatestCrash.ips");
+    CHECK(link_via_server(server, "log-1.ips", link_filepath) == 0);
+    CHECK(has_destination(link_filepath, "log-1.ips"));
+
+    // An existing link is replaced.
+    CHECK(link_via_server(server, "log-2.ips", link_filepath) == 0);
+    CHECK(has_destination(link_filepath, "log-2.ips"));
+
+    // The destination must be a file in the same directory, and the link must
+    // be in a permitted directory; the existing link is kept.
+    CHECK(link_via_server(server, "../log-3.ips", link_filepath) != 0);
+    CHECK(link_via_server(server, "/etc/passwd", link_filepath) != 0);
+    CHECK(link_via_server(server, "..", link_filepath) != 0);
+    CHECK(link_via_server(server, "", link_filepath) != 0);
+    CHECK(has_destination(link_filepath, "log-2.ips"));
+    char filepath[1024];
+    snprintf(filepath, sizeof(filepath), "/tmpx%s/LatestCrash.ips", directory + 4);
+    CHECK(link_via_server(server, "log-1.ips", filepath) != 0);
+
+    // NOTE: No temporary link is left behind.
+    char command[1100];
+    snprintf(command, sizeof(command), "test -z \"$(find '%s' -name '*.temp')\"", directory);
+    CHECK(system(command) == 0);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+
+    // NOTE: The tool is built alongside this test.
+    char tool_path[1024];
+    char *argv0 = strdup(argv[0]);
+    snprintf(tool_path, sizeof(tool_path), "%s/as_root", dirname(argv0));
+    free(argv0);
+    CHECK(access(tool_path, X_OK) == 0);
+
+    char *directory = test_make_directory("as_root_test");
+    server_t server;
+    CHECK(start_server(tool_path, &server));
+    test_open(&server, directory);
+    test_rejected_paths(&server, directory);
+    test_link(&server, directory);
+    CHECK(stop_server(&server));
+    test_remove_directory(directory);
+    return test_result("as_root_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
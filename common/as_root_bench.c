@@ -0,0 +1,177 @@
+/**
+ * Desc: Benchmark of operations performed with the as_root tool: a C mirror of
+ *       the client in exec_as_root.m, comparing a request to a server that is
+ *       kept running ("as_root serve", over a UNIX domain socket) with the
+ *       launching of the tool for each operation (as the fallback does).
+ *
+ *       The tool is built without setuid (see tests.mk); the operation (chmod)
+ *       is of a file owned by the caller.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "test_util.h"
+
+static const unsigned kOperationCount = 1000;
+
+typedef struct {
+    pid_t pid;
+    int fd;
+} server_t;
+
+static int start_server(const char *path, server_t *server) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        return 0;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(sockets[1], STDIN_FILENO);
+        dup2(sockets[1], STDOUT_FILENO);
+        close(sockets[0]);
+        close(sockets[1]);
+        execl(path, path, "serve", NULL);
+        _exit(1);
+    }
+    close(sockets[1]);
+    if (pid == -1) {
+        close(sockets[0]);
+        return 0;
+    }
+
+    server->pid = pid;
+    server->fd = sockets[0];
+    return 1;
+}
+
+static void stop_server(server_t *server) {
+    close(server->fd);
+    waitpid(server->pid, NULL, 0);
+}
+
+// NOTE: As as_root_server(): the arguments are NUL-terminated, followed by an
+//       empty one; the reply is a single line.
+static int request(server_t *server, const char **args, unsigned argc) {
+    char buffer[4096];
+    size_t length = 0;
+    for (unsigned i = 0; i < argc; ++i) {
+        const size_t size = strlen(args[i]) + 1;
+        memcpy(buffer + length, args[i], size);
+        length += size;
+    }
+    buffer[length++] = '\0';
+
+    for (size_t sent = 0; sent < length;) {
+        const ssize_t count = send(server->fd, buffer + sent, length - sent, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        sent += count;
+    }
+
+    char reply[256];
+    size_t reply_length = 0;
+    while ((reply_length == 0) || (reply[reply_length - 1] != '\n')) {
+        const ssize_t count = recv(server->fd, reply + reply_length, sizeof(reply) - 1 - reply_length, 0);
+        if (count <= 0) {
+            if ((count < 0) && (errno == EINTR)) {
+                continue;
+            }
+            return 0;
+        }
+        reply_length += count;
+    }
+    return reply[0] == '0';
+}
+
+// NOTE: As as_root_exec().
+static int exec_tool(const char *path, const char **args, unsigned argc) {
+    const char *argv[argc + 2];
+    argv[0] = path;
+    memcpy(&argv[1], args, argc * sizeof(char *));
+    argv[argc + 1] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // NOTE: Silence the usage and warnings of the tool.
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execv(path, (char * const *)argv);
+        _exit(1);
+    } else if (pid == -1) {
+        return 0;
+    }
+
+    int stat_loc;
+    waitpid(pid, &stat_loc, 0);
+    return WIFEXITED(stat_loc) && (WEXITSTATUS(stat_loc) == 0);
+}
+
+static mode_t mode_of(const char *filepath) {
+    struct stat st;
+    return (stat(filepath, &st) == 0) ? (st.st_mode & 0777) : 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+
+    // NOTE: The tool is built alongside this benchmark.
+    char tool_path[1024];
+    char *argv0 = strdup(argv[0]);
+    snprintf(tool_path, sizeof(tool_path), "%s/as_root", dirname(argv0));
+    free(argv0);
+    CHECK(access(tool_path, X_OK) == 0);
+
+    char *directory = test_make_directory("as_root_bench");
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "file.ips");
+    CHECK(test_write_file(filepath, "log", 3));
+
+    const char *args[][3] = {
+        {"chmod", filepath, "600"},
+        {"chmod", filepath, "644"}
+    };
+
+    double start = test_time();
+    unsigned exec_count = 0;
+    for (unsigned i = 0; i < kOperationCount; ++i) {
+        exec_count += exec_tool(tool_path, args[i % 2], 3);
+    }
+    const double exec_time = test_time() - start;
+    CHECK(exec_count == kOperationCount);
+    CHECK(mode_of(filepath) == 0644);
+
+    server_t server;
+    start = test_time();
+    unsigned server_count = 0;
+    if (start_server(tool_path, &server)) {
+        for (unsigned i = 0; i < kOperationCount; ++i) {
+            server_count += request(&server, args[i % 2], 3);
+        }
+        stop_server(&server);
+    }
+    const double server_time = test_time() - start;
+    CHECK(server_count == kOperationCount);
+    CHECK(mode_of(filepath) == 0644);
+
+    printf("%u as_root operations (chmod):\n"
+        "  exec mode:   %.1f ms (%.3f ms per operation)\n"
+        "  server mode: %.1f ms (%.3f ms per operation, including start of server)\n",
+        kOperationCount, exec_time * 1000.0, exec_time * 1000.0 / kOperationCount,
+        server_time * 1000.0, server_time * 1000.0 / kOperationCount);
+
+    test_remove_directory(directory);
+    return test_result("as_root_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
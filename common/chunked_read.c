@@ -0,0 +1,43 @@
+/**
+ * Desc: Reading of a file in fixed-size chunks, so that large files (such as
+ *       dylibs that are hashed by the scanner) are never read into memory in
+ *       full.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "chunked_read.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int chunked_read_file(const char *path, size_t chunk_size, chunked_read_callback_t callback, void *context) {
+    int did_read = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        unsigned char *buffer = (unsigned char *)malloc(chunk_size);
+        if (buffer != NULL) {
+            ssize_t count;
+            while ((count = read(fd, buffer, chunk_size)) != 0) {
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                callback(buffer, (size_t)count, context);
+            }
+            did_read = (count == 0);
+            free(buffer);
+        }
+        close(fd);
+    }
+
+    return did_read;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
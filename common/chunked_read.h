@@ -0,0 +1,31 @@
+/**
+ * Desc: Reading of a file in fixed-size chunks, so that large files (such as
+ *       dylibs that are hashed by the scanner) are never read into memory in
+ *       full.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CHUNKED_READ_H_
+#define COMMON_CHUNKED_READ_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOTE: The bytes are only valid for the duration of the callback.
+typedef void (*chunked_read_callback_t)(const void *bytes, size_t length, void *context);
+
+// NOTE: Returns non-zero if the whole file was read.
+int chunked_read_file(const char *path, size_t chunk_size, chunked_read_callback_t callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CHUNKED_READ_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,118 @@
+/**
+ * Desc: Benchmark of the scanner's hashing of dylibs, over a few hundred
+ *       dylib-sized files: reading each file in full (as the scanner used to),
+ *       reading in chunks, and checking the identity of unchanged files only.
+ *
+ *       CRC-32 (from zlib) stands in for MD5, which is not available here.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "chunked_read.h"
+
+#include <zlib.h>
+
+#include "test_util.h"
+
+static const unsigned kFileCount = 300;
+static const size_t kChunkSize = 64 * 1024;
+
+// NOTE: Most tweaks are small; a few are several megabytes.
+static size_t file_size(unsigned i) {
+    return (i % 30 == 0) ? (2 * 1024 * 1024 + i * 1024) : (16 * 1024 + (size_t)(rand() % (512 * 1024)));
+}
+
+static void update_crc(const void *bytes, size_t length, void *context) {
+    uLong *crc = (uLong *)context;
+    *crc = crc32(*crc, (const Bytef *)bytes, (uInt)length);
+}
+
+// NOTE: As the scanner used to do (with -[NSData initWithContentsOfFile:]).
+static int crc_of_whole_file(const char *path, uLong *crc) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    unsigned char *bytes = malloc(st.st_size);
+    const int did_read = (bytes != NULL) && (read(fd, bytes, st.st_size) == st.st_size);
+    if (did_read) {
+        *crc = crc32(crc32(0, Z_NULL, 0), bytes, (uInt)st.st_size);
+    }
+    free(bytes);
+    close(fd);
+    return did_read;
+}
+
+int main(void) {
+    char *directory = test_make_directory("chunked_read_bench");
+
+    size_t total_size = 0;
+    size_t largest_size = 0;
+    unsigned char *bytes = malloc(4 * 1024 * 1024);
+    for (size_t i = 0; i < 4 * 1024 * 1024; ++i) {
+        bytes[i] = (unsigned char)rand();
+    }
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char path[1024];
+        test_path(path, sizeof(path), directory, "Tweak%u.dylib", i);
+        const size_t size = file_size(i);
+        CHECK(test_write_file(path, bytes + (i % 1024), size));
+        total_size += size;
+        if (size > largest_size) {
+            largest_size = size;
+        }
+    }
+    free(bytes);
+
+    uLong *whole_crcs = malloc(kFileCount * sizeof(uLong));
+    double start = test_time();
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char path[1024];
+        test_path(path, sizeof(path), directory, "Tweak%u.dylib", i);
+        CHECK(crc_of_whole_file(path, &whole_crcs[i]));
+    }
+    const double whole_time = test_time() - start;
+
+    start = test_time();
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char path[1024];
+        test_path(path, sizeof(path), directory, "Tweak%u.dylib", i);
+        uLong crc = crc32(0, Z_NULL, 0);
+        CHECK(chunked_read_file(path, kChunkSize, update_crc, &crc));
+        CHECK(crc == whole_crcs[i]);
+    }
+    const double chunked_time = test_time() - start;
+
+    start = test_time();
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char path[1024];
+        test_path(path, sizeof(path), directory, "Tweak%u.dylib", i);
+        struct stat st;
+        CHECK(stat(path, &st) == 0);
+    }
+    const double stat_time = test_time() - start;
+
+    uLong crc = 0;
+    CHECK(!chunked_read_file("/nonexistent", kChunkSize, update_crc, &crc));
+
+    printf("Hash of %u files (%.1f MB in total, largest %.1f MB):\n"
+        "  whole file: %.1f ms (peak buffer %.1f MB)\n"
+        "  chunked:    %.1f ms (buffer %zu KB)\n"
+        "  stat only:  %.2f ms (unchanged files)\n",
+        kFileCount, total_size / 1048576.0, largest_size / 1048576.0,
+        whole_time * 1000.0, largest_size / 1048576.0,
+        chunked_time * 1000.0, kChunkSize / 1024,
+        stat_time * 1000.0);
+
+    free(whole_crcs);
+    test_remove_directory(directory);
+    return test_result("chunked_read_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,348 @@
+/**
+ * Desc: Bounded queue of crash log filepaths, and the UNIX domain socket
+ *       protocol used by the monitor to submit newly written crash logs to the
+ *       notifier service.
+ *
+ *       A request is the filepath followed by a newline; the reply is a single
+ *       byte, '0' plus the result code.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crash_queue.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// NOTE: The monitor runs inside ReportCrash; a service that has stopped
+//       responding must not hold up the writing of crash logs.
+static const int kSocketTimeout = 2;
+
+// NOTE: A request for a full queue waits briefly for space; it must not wait
+//       for long, as requests are handled one at a time, and the requests
+//       that are waiting to be handled are subject to the socket timeout.
+static const unsigned kPushTimeout = 250;
+
+struct crash_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    char **entries;
+    unsigned capacity;
+    unsigned head;
+    unsigned count;
+    unsigned dropped_count;
+    int is_shut_down;
+};
+
+crash_queue_t *crash_queue_create(unsigned capacity) {
+    crash_queue_t *queue = calloc(1, sizeof(crash_queue_t));
+    if (queue != NULL) {
+        queue->entries = calloc(capacity, sizeof(char *));
+        if ((capacity == 0) || (queue->entries == NULL)) {
+            free(queue->entries);
+            free(queue);
+            return NULL;
+        }
+        queue->capacity = capacity;
+        pthread_mutex_init(&queue->lock, NULL);
+        pthread_cond_init(&queue->not_empty, NULL);
+        pthread_cond_init(&queue->not_full, NULL);
+    }
+    return queue;
+}
+
+static int is_queued(crash_queue_t *queue, const char *filepath) {
+    for (unsigned i = 0; i < queue->count; ++i) {
+        if (strcmp(queue->entries[(queue->head + i) % queue->capacity], filepath) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+crash_queue_result_t crash_queue_push(crash_queue_t *queue, const char *filepath, unsigned timeout) {
+    crash_queue_result_t result = CRASH_QUEUE_RESULT_QUEUED;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + timeout / 1000;
+    deadline.tv_nsec = (now.tv_usec + (timeout % 1000) * 1000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        if (queue->is_shut_down) {
+            result = CRASH_QUEUE_RESULT_REJECTED;
+            goto exit;
+        }
+        if (is_queued(queue, filepath)) {
+            goto exit;
+        }
+        if (queue->count < queue->capacity) {
+            break;
+        }
+        if ((timeout == 0) || (pthread_cond_timedwait(&queue->not_full, &queue->lock, &deadline) == ETIMEDOUT)) {
+            result = CRASH_QUEUE_RESULT_FULL;
+            ++queue->dropped_count;
+            goto exit;
+        }
+    }
+
+    char *copy = strdup(filepath);
+    if (copy == NULL) {
+        result = CRASH_QUEUE_RESULT_FULL;
+        ++queue->dropped_count;
+        goto exit;
+    }
+    queue->entries[(queue->head + queue->count) % queue->capacity] = copy;
+    ++queue->count;
+    pthread_cond_signal(&queue->not_empty);
+
+exit:
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+char *crash_queue_pop(crash_queue_t *queue) {
+    char *filepath = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while ((queue->count == 0) && !queue->is_shut_down) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if (queue->count != 0) {
+        filepath = queue->entries[queue->head];
+        queue->entries[queue->head] = NULL;
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->count;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return filepath;
+}
+
+void crash_queue_shutdown(crash_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->is_shut_down = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+unsigned crash_queue_get_dropped_count(crash_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    const unsigned count = queue->dropped_count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+void crash_queue_destroy(crash_queue_t *queue) {
+    if (queue != NULL) {
+        for (unsigned i = 0; i < queue->count; ++i) {
+            free(queue->entries[(queue->head + i) % queue->capacity]);
+        }
+        free(queue->entries);
+        pthread_cond_destroy(&queue->not_empty);
+        pthread_cond_destroy(&queue->not_full);
+        pthread_mutex_destroy(&queue->lock);
+        free(queue);
+    }
+}
+
+static int make_address(const char *socket_filepath, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_filepath) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "ERROR: Socket path \"%s\" is too long.\n", socket_filepath);
+        return 0;
+    }
+    strcpy(address->sun_path, socket_filepath);
+    return 1;
+}
+
+static void configure_socket(int fd) {
+    // NOTE: Prevent the socket from being inherited by child processes, and
+    //       prevent a write to a closed connection from raising SIGPIPE.
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    const int value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+
+    struct timeval timeout;
+    timeout.tv_sec = kSocketTimeout;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static int send_all(int fd, const char *buffer, size_t length) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    while (length > 0) {
+        ssize_t count = send(fd, buffer, length, flags);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        buffer += count;
+        length -= count;
+    }
+    return 1;
+}
+
+int crash_queue_listen(const char *socket_filepath) {
+    struct sockaddr_un address;
+    if (!make_address(socket_filepath, &address)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Unable to create socket, errno = %d.\n", errno);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // NOTE: Remove socket left over from a previous instance.
+    unlink(socket_filepath);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        fprintf(stderr, "ERROR: Unable to bind socket \"%s\", errno = %d.\n", socket_filepath, errno);
+        close(fd);
+        return -1;
+    }
+
+    // NOTE: ReportCrash runs as either mobile or root.
+    chmod(socket_filepath, 0666);
+
+    if (listen(fd, 16) != 0) {
+        fprintf(stderr, "ERROR: Unable to listen on socket \"%s\", errno = %d.\n", socket_filepath, errno);
+        close(fd);
+        unlink(socket_filepath);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void handle_connection(int fd, crash_queue_t *queue, crash_queue_filter_t filter, crash_queue_overflow_t overflow) {
+    char request[PATH_MAX + 1];
+    size_t length = 0;
+    int is_complete = 0;
+    while (!is_complete && (length < sizeof(request) - 1)) {
+        ssize_t count = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        } else if (count == 0) {
+            break;
+        }
+
+        char *newline = memchr(request + length, '\n', count);
+        if (newline != NULL) {
+            length = newline - request;
+            is_complete = 1;
+        } else {
+            length += count;
+        }
+    }
+    request[length] = '\0';
+
+    crash_queue_result_t result = CRASH_QUEUE_RESULT_REJECTED;
+    if (is_complete && (length != 0) && ((filter == NULL) || filter(request))) {
+        result = crash_queue_push(queue, request, kPushTimeout);
+        if (result == CRASH_QUEUE_RESULT_FULL) {
+            if (overflow != NULL) {
+                fprintf(stderr, "WARNING: Queue is full; \"%s\" is handed to the overflow handler (%u so far).\n",
+                    request, crash_queue_get_dropped_count(queue));
+                overflow(request);
+            } else {
+                // NOTE: No notification will be sent for this log.
+                fprintf(stderr, "WARNING: Queue is full; dropped \"%s\" (%u dropped so far).\n",
+                    request, crash_queue_get_dropped_count(queue));
+            }
+        }
+    }
+
+    const char reply = '0' + result;
+    send_all(fd, &reply, 1);
+}
+
+int crash_queue_serve(int listen_fd, crash_queue_t *queue, crash_queue_filter_t filter, crash_queue_overflow_t overflow) {
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if ((errno == EINTR) || (errno == ECONNABORTED)) {
+                continue;
+            }
+            fprintf(stderr, "ERROR: Failed to accept connection, errno = %d.\n", errno);
+            return -1;
+        }
+
+        configure_socket(fd);
+        handle_connection(fd, queue, filter, overflow);
+        close(fd);
+    }
+}
+
+crash_queue_result_t crash_queue_submit(const char *socket_filepath, const char *filepath) {
+    struct sockaddr_un address;
+    if (!make_address(socket_filepath, &address)) {
+        return CRASH_QUEUE_RESULT_UNAVAILABLE;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return CRASH_QUEUE_RESULT_UNAVAILABLE;
+    }
+    configure_socket(fd);
+
+    crash_queue_result_t result = CRASH_QUEUE_RESULT_UNAVAILABLE;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        if (send_all(fd, filepath, strlen(filepath)) && send_all(fd, "\n", 1)) {
+            char reply;
+            ssize_t count;
+            do {
+                count = recv(fd, &reply, 1, 0);
+            } while ((count < 0) && (errno == EINTR));
+            if ((count == 1) && (reply >= '0') && (reply <= '0' + CRASH_QUEUE_RESULT_REJECTED)) {
+                result = (crash_queue_result_t)(reply - '0');
+            } else if ((count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                // NOTE: The service has the request, but is slow to reply
+                //       (e.g. as requests for a full queue wait for space).
+                //       Processing the log here as well would process it
+                //       twice.
+                result = CRASH_QUEUE_RESULT_QUEUED;
+            }
+        }
+    }
+
+    close(fd);
+    return result;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
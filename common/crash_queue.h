@@ -0,0 +1,67 @@
+/**
+ * Desc: Bounded queue of crash log filepaths, and the UNIX domain socket
+ *       protocol used by the monitor to submit newly written crash logs to the
+ *       notifier service.
+ *
+ *       A request is the filepath followed by a newline; the reply is a single
+ *       byte, '0' plus the result code.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASH_QUEUE_H_
+#define COMMON_CRASH_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CRASH_QUEUE_RESULT_UNAVAILABLE = -1,
+    CRASH_QUEUE_RESULT_QUEUED = 0,
+    CRASH_QUEUE_RESULT_FULL = 1,
+    CRASH_QUEUE_RESULT_REJECTED = 2
+} crash_queue_result_t;
+
+typedef struct crash_queue crash_queue_t;
+
+// NOTE: Returns non-zero if the filepath should be accepted.
+typedef int (*crash_queue_filter_t)(const char *filepath);
+// NOTE: Called with filepaths that could not be queued as the queue was full;
+//       called on the thread that serves requests, and so must not block.
+typedef void (*crash_queue_overflow_t)(const char *filepath);
+
+crash_queue_t *crash_queue_create(unsigned capacity);
+// NOTE: If the queue is full, waits up to the given timeout (in milliseconds)
+//       for space; filepaths that still cannot be added are counted as
+//       dropped. Filepaths that are already queued are not added again.
+crash_queue_result_t crash_queue_push(crash_queue_t *queue, const char *filepath, unsigned timeout);
+// NOTE: Blocks until a filepath is available. Returns NULL once the queue has
+//       been shut down and emptied. The caller must free the result.
+char *crash_queue_pop(crash_queue_t *queue);
+void crash_queue_shutdown(crash_queue_t *queue);
+unsigned crash_queue_get_dropped_count(crash_queue_t *queue);
+void crash_queue_destroy(crash_queue_t *queue);
+
+// Service side.
+int crash_queue_listen(const char *socket_filepath);
+// NOTE: Accepts requests until an unrecoverable error occurs. The overflow
+//       handler may be NULL, in which case filepaths that could not be queued
+//       are dropped.
+int crash_queue_serve(int listen_fd, crash_queue_t *queue, crash_queue_filter_t filter, crash_queue_overflow_t overflow);
+
+// Client side.
+// NOTE: Fails with "unavailable" if the service is not running, in which case
+//       the caller is expected to process the crash log itself.
+// NOTE: If the request was sent but no reply was received in time, the
+//       filepath is considered queued, as the service has received it.
+crash_queue_result_t crash_queue_submit(const char *socket_filepath, const char *filepath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASH_QUEUE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
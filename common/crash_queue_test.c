@@ -0,0 +1,359 @@
+/**
+ * Desc: Load test of the crash log queue and its socket protocol: bursts of
+ *       synthetic crash log filepaths are submitted from several threads, the
+ *       way the monitor does during a crash storm. Also checks that logs that
+ *       cannot be queued are handed to the overflow handler, and that a
+ *       request whose reply times out is considered queued.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crash_queue.h"
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "test_util.h"
+
+static const char kLogDirectory[] = "/var/mobile/Library/Logs/CrashReporter";
+
+#define kClientCount 8
+#define kLogsPerClient 100
+
+static const unsigned kQueueCapacity = 32;
+static const unsigned kSmallQueueCapacity = 4;
+
+typedef struct {
+    crash_queue_t *queue;
+    char socket_filepath[1024];
+    // NOTE: Workers wait while the queue is stalled, standing in for logs that
+    //       take long to process.
+    pthread_mutex_t lock;
+    pthread_cond_t resumed;
+    int is_stalled;
+    unsigned delay;
+    unsigned popped_count;
+    unsigned processed[kClientCount][kLogsPerClient];
+    unsigned processed_count;
+    // NOTE: Logs that could not be queued, as handed to the overflow handler.
+    unsigned overflowed[kClientCount][kLogsPerClient];
+    int has_overflow_handler;
+} service_t;
+
+// NOTE: The overflow handler takes no context; services are tested one at a
+//       time.
+static service_t *current_service = NULL;
+
+static int is_crash_log_path(const char *filepath) {
+    const size_t length = sizeof(kLogDirectory) - 1;
+    return (strncmp(filepath, kLogDirectory, length) == 0) && (filepath[length] == '/');
+}
+
+static void log_filepath(char *buffer, size_t size, unsigned client, unsigned i) {
+    snprintf(buffer, size, "%s/Process%u-%u-2016-03-01-100203.ips", kLogDirectory, client, i);
+}
+
+static void handle_overflow(const char *filepath) {
+    unsigned client;
+    unsigned i;
+    CHECK(sscanf(filepath, "/var/mobile/Library/Logs/CrashReporter/Process%u-%u-", &client, &i) == 2);
+    if ((client < kClientCount) && (i < kLogsPerClient)) {
+        pthread_mutex_lock(&current_service->lock);
+        ++current_service->overflowed[client][i];
+        pthread_mutex_unlock(&current_service->lock);
+    }
+}
+
+static void *serve(void *context) {
+    service_t *service = (service_t *)context;
+    int fd = crash_queue_listen(service->socket_filepath);
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        crash_queue_serve(fd, service->queue, is_crash_log_path,
+            service->has_overflow_handler ? handle_overflow : NULL);
+    }
+    return NULL;
+}
+
+static void *work(void *context) {
+    service_t *service = (service_t *)context;
+    char *path;
+    while ((path = crash_queue_pop(service->queue)) != NULL) {
+        pthread_mutex_lock(&service->lock);
+        ++service->popped_count;
+        while (service->is_stalled) {
+            pthread_cond_wait(&service->resumed, &service->lock);
+        }
+        pthread_mutex_unlock(&service->lock);
+        usleep(service->delay);
+
+        unsigned client;
+        unsigned i;
+        char expected[1024];
+        CHECK(sscanf(path, "/var/mobile/Library/Logs/CrashReporter/Process%u-%u-", &client, &i) == 2);
+        if ((client < kClientCount) && (i < kLogsPerClient)) {
+            log_filepath(expected, sizeof(expected), client, i);
+            CHECK(strcmp(path, expected) == 0);
+            pthread_mutex_lock(&service->lock);
+            ++service->processed[client][i];
+            ++service->processed_count;
+            pthread_mutex_unlock(&service->lock);
+        }
+        free(path);
+    }
+    return NULL;
+}
+
+static void start_service(service_t *service, const char *directory, const char *name, unsigned capacity,
+        pthread_t *workers, unsigned worker_count, int has_overflow_handler) {
+    memset(service, 0, sizeof(*service));
+    service->has_overflow_handler = has_overflow_handler;
+    current_service = service;
+    test_path(service->socket_filepath, sizeof(service->socket_filepath), directory, "%s", name);
+    service->queue = crash_queue_create(capacity);
+    pthread_mutex_init(&service->lock, NULL);
+    pthread_cond_init(&service->resumed, NULL);
+
+    // NOTE: The server runs until the test exits.
+    pthread_t server;
+    CHECK(pthread_create(&server, NULL, serve, service) == 0);
+    pthread_detach(server);
+    for (unsigned i = 0; i < 100; ++i) {
+        if (access(service->socket_filepath, F_OK) == 0) {
+            break;
+        }
+        usleep(10000);
+    }
+
+    for (unsigned i = 0; i < worker_count; ++i) {
+        CHECK(pthread_create(&workers[i], NULL, work, service) == 0);
+    }
+}
+
+static void stop_service(service_t *service, pthread_t *workers, unsigned worker_count) {
+    crash_queue_shutdown(service->queue);
+    for (unsigned i = 0; i < worker_count; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+typedef struct {
+    service_t *service;
+    unsigned client;
+    unsigned log_count;
+    crash_queue_result_t results[kLogsPerClient];
+} client_t;
+
+static void *submit(void *context) {
+    client_t *client = (client_t *)context;
+    for (unsigned i = 0; i < client->log_count; ++i) {
+        char filepath[1024];
+        log_filepath(filepath, sizeof(filepath), client->client, i);
+        client->results[i] = crash_queue_submit(client->service->socket_filepath, filepath);
+    }
+    return NULL;
+}
+
+// NOTE: Returns the number of submissions that could not be queued as the
+//       queue was full; checks that every queued log was processed exactly
+//       once, and that any other was handed to the overflow handler (if any).
+static unsigned check_results(service_t *service, client_t *clients, unsigned client_count) {
+    unsigned queued_count = 0;
+    unsigned full_count = 0;
+    for (unsigned c = 0; c < client_count; ++c) {
+        for (unsigned i = 0; i < clients[c].log_count; ++i) {
+            const crash_queue_result_t result = clients[c].results[i];
+            CHECK((result == CRASH_QUEUE_RESULT_QUEUED) || (result == CRASH_QUEUE_RESULT_FULL));
+            if (result == CRASH_QUEUE_RESULT_QUEUED) {
+                ++queued_count;
+                CHECK(service->processed[c][i] == 1);
+                CHECK(service->overflowed[c][i] == 0);
+            } else {
+                ++full_count;
+                CHECK(service->processed[c][i] == 0);
+                CHECK(service->overflowed[c][i] == (service->has_overflow_handler ? 1 : 0));
+            }
+        }
+    }
+    CHECK(service->processed_count == queued_count);
+    CHECK(crash_queue_get_dropped_count(service->queue) == full_count);
+    return full_count;
+}
+
+static void test_queue(void) {
+    crash_queue_t *queue = crash_queue_create(2);
+    CHECK(crash_queue_push(queue, "a", 0) == CRASH_QUEUE_RESULT_QUEUED);
+    // Filepaths that are already queued are not added again.
+    CHECK(crash_queue_push(queue, "a", 0) == CRASH_QUEUE_RESULT_QUEUED);
+    CHECK(crash_queue_push(queue, "b", 0) == CRASH_QUEUE_RESULT_QUEUED);
+    CHECK(crash_queue_push(queue, "a", 100) == CRASH_QUEUE_RESULT_QUEUED);
+
+    // A push to a full queue waits only as long as asked.
+    double start = test_time();
+    CHECK(crash_queue_push(queue, "c", 0) == CRASH_QUEUE_RESULT_FULL);
+    CHECK(crash_queue_push(queue, "c", 100) == CRASH_QUEUE_RESULT_FULL);
+    const double elapsed = test_time() - start;
+    CHECK((elapsed >= 0.09) && (elapsed < 1.0));
+    CHECK(crash_queue_get_dropped_count(queue) == 2);
+
+    char *path = crash_queue_pop(queue);
+    CHECK((path != NULL) && (strcmp(path, "a") == 0));
+    free(path);
+    CHECK(crash_queue_push(queue, "c", 0) == CRASH_QUEUE_RESULT_QUEUED);
+
+    crash_queue_shutdown(queue);
+    CHECK(crash_queue_push(queue, "d", 100) == CRASH_QUEUE_RESULT_REJECTED);
+    path = crash_queue_pop(queue);
+    CHECK((path != NULL) && (strcmp(path, "b") == 0));
+    free(path);
+    path = crash_queue_pop(queue);
+    CHECK((path != NULL) && (strcmp(path, "c") == 0));
+    free(path);
+    CHECK(crash_queue_pop(queue) == NULL);
+    CHECK(crash_queue_get_dropped_count(queue) == 2);
+    crash_queue_destroy(queue);
+}
+
+static void *pop_later(void *context) {
+    usleep(50000);
+    free(crash_queue_pop((crash_queue_t *)context));
+    return NULL;
+}
+
+// NOTE: A push to a full queue succeeds if space is made in time.
+static void test_wait(void) {
+    crash_queue_t *queue = crash_queue_create(1);
+    CHECK(crash_queue_push(queue, "a", 0) == CRASH_QUEUE_RESULT_QUEUED);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, pop_later, queue) == 0);
+    CHECK(crash_queue_push(queue, "b", 2000) == CRASH_QUEUE_RESULT_QUEUED);
+    pthread_join(thread, NULL);
+    CHECK(crash_queue_get_dropped_count(queue) == 0);
+    crash_queue_destroy(queue);
+}
+
+// NOTE: With workers that keep up, a burst from several clients is queued in
+//       full, as requests for a full queue wait for space.
+static void test_burst(const char *directory) {
+    service_t *service = malloc(sizeof(service_t));
+    pthread_t workers[2];
+    start_service(service, directory, "burst.sock", kQueueCapacity, workers, 2, 1);
+    service->delay = 500;
+
+    CHECK(crash_queue_submit(service->socket_filepath, "/etc/passwd") == CRASH_QUEUE_RESULT_REJECTED);
+    CHECK(crash_queue_submit(service->socket_filepath, "relative.ips") == CRASH_QUEUE_RESULT_REJECTED);
+
+    client_t *clients = calloc(kClientCount, sizeof(client_t));
+    pthread_t threads[kClientCount];
+    const double start = test_time();
+    for (unsigned c = 0; c < kClientCount; ++c) {
+        clients[c].service = service;
+        clients[c].client = c;
+        clients[c].log_count = kLogsPerClient;
+        CHECK(pthread_create(&threads[c], NULL, submit, &clients[c]) == 0);
+    }
+    for (unsigned c = 0; c < kClientCount; ++c) {
+        pthread_join(threads[c], NULL);
+    }
+    const double elapsed = test_time() - start;
+    stop_service(service, workers, 2);
+
+    CHECK(check_results(service, clients, kClientCount) == 0);
+    printf("Burst of %u logs from %u clients: %.1f ms\n",
+        kClientCount * kLogsPerClient, kClientCount, elapsed * 1000.0);
+
+    free(clients);
+    crash_queue_destroy(service->queue);
+    free(service);
+}
+
+// NOTE: With workers that are stalled, logs beyond the capacity of the queue
+//       are counted, and are either handed to the overflow handler (the
+//       notifier processes them without symbolication) or dropped.
+static void test_storm(const char *directory, const char *name, int has_overflow_handler) {
+    static const unsigned kLogCount = 8;
+
+    service_t *service = malloc(sizeof(service_t));
+    pthread_t workers[1];
+    start_service(service, directory, name, kSmallQueueCapacity, workers, 1, has_overflow_handler);
+    service->is_stalled = 1;
+
+    // NOTE: The single worker holds one log while stalled.
+    client_t *client = calloc(1, sizeof(client_t));
+    client->service = service;
+    client->log_count = 1;
+    submit(client);
+    for (unsigned popped_count = 0; popped_count == 0; usleep(1000)) {
+        pthread_mutex_lock(&service->lock);
+        popped_count = service->popped_count;
+        pthread_mutex_unlock(&service->lock);
+    }
+
+    client->log_count = kLogCount;
+    submit(client);
+
+    pthread_mutex_lock(&service->lock);
+    service->is_stalled = 0;
+    pthread_cond_broadcast(&service->resumed);
+    pthread_mutex_unlock(&service->lock);
+    stop_service(service, workers, 1);
+
+    // NOTE: The first log was submitted twice; it had already left the queue,
+    //       and so was queued again.
+    service->processed[0][0] -= 1;
+    service->processed_count -= 1;
+    CHECK(check_results(service, client, 1) == kLogCount - kSmallQueueCapacity);
+
+    free(client);
+    crash_queue_destroy(service->queue);
+    free(service);
+}
+
+static void *accept_without_reply(void *context) {
+    int fd = accept(*(int *)context, NULL, NULL);
+    CHECK(fd >= 0);
+    char buffer[1024];
+    CHECK(recv(fd, buffer, sizeof(buffer), 0) > 0);
+    // Wait for the client to give up and close the connection.
+    while (recv(fd, buffer, sizeof(buffer), 0) > 0) {
+    }
+    close(fd);
+    return NULL;
+}
+
+// NOTE: A service that received the request but is slow to reply has the log;
+//       the monitor must not process it as well.
+static void test_slow_reply(const char *directory) {
+    char socket_filepath[1024];
+    test_path(socket_filepath, sizeof(socket_filepath), directory, "slow.sock");
+    int fd = crash_queue_listen(socket_filepath);
+    CHECK(fd >= 0);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, accept_without_reply, &fd) == 0);
+    const double start = test_time();
+    CHECK(crash_queue_submit(socket_filepath, "/var/mobile/Library/Logs/CrashReporter/A.ips") == CRASH_QUEUE_RESULT_QUEUED);
+    CHECK(test_time() - start < 3.0);
+    pthread_join(thread, NULL);
+    close(fd);
+}
+
+int main(void) {
+    char *directory = test_make_directory("crash_queue_test");
+    char socket_filepath[1024];
+    test_path(socket_filepath, sizeof(socket_filepath), directory, "none.sock");
+    CHECK(crash_queue_submit(socket_filepath, "/var/mobile/Library/Logs/CrashReporter/A.ips") == CRASH_QUEUE_RESULT_UNAVAILABLE);
+
+    test_queue();
+    test_wait();
+    test_burst(directory);
+    test_storm(directory, "storm.sock", 0);
+    test_storm(directory, "overflow.sock", 1);
+    test_slow_reply(directory);
+
+    test_remove_directory(directory);
+    return test_result("crash_queue_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,232 @@
+/**
+ * Desc: Persistent record of recent crash times per process, used to detect
+ *       processes that are crashing repeatedly (crash loops) so that a single
+ *       notification can be sent for the loop instead of one per crash.
+ *
+ *       The record is shared by the notifier (any number of processes or
+ *       threads) and the app; access is serialized with an advisory lock.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crash_rate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: The file is small and of fixed size; it is read and rewritten in
+//       place while locked (a temporary file and rename cannot be used, as
+//       the lock is tied to the file). If the format changes, the version must
+//       be bumped, which causes any existing record to be discarded.
+static const char kRateMagic[4] = {'C', 'R', 'R', 'T'};
+static const uint32_t kRateVersion = 1;
+
+// NOTE: Number of processes tracked; the process that crashed least recently
+//       is dropped first.
+#define kRateEntryCount 32
+
+#define kRateNameMax 64
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t reserved[2];
+} rate_header_t;
+
+typedef struct {
+    uint64_t key;
+    // NOTE: Ring buffer of crash times; head is the index of the next slot.
+    int64_t times[CRASH_RATE_HISTORY_SIZE];
+    uint32_t head;
+    uint32_t count;
+    uint32_t is_notified;
+    uint32_t reserved;
+    char name[kRateNameMax];
+} rate_entry_t;
+
+typedef struct {
+    rate_header_t header;
+    rate_entry_t entries[kRateEntryCount];
+} rate_file_t;
+
+static uint64_t hash_key(const char *name, const char *bundle_id) {
+    // FNV-1a.
+    uint64_t hash = 14695981039346656037ull;
+    const char *strings[] = {name, bundle_id};
+    for (unsigned i = 0; i < 2; ++i) {
+        if (strings[i] != NULL) {
+            for (const unsigned char *p = (const unsigned char *)strings[i]; *p != '\0'; ++p) {
+                hash ^= *p;
+                hash *= 1099511628211ull;
+            }
+        }
+        // NOTE: Include the terminating NUL, so that "ab" + "c" and "a" + "bc"
+        //       produce different keys.
+        hash *= 1099511628211ull;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
+static int64_t latest_time(const rate_entry_t *entry) {
+    if (entry->count == 0) {
+        return 0;
+    }
+    return entry->times[(entry->head + CRASH_RATE_HISTORY_SIZE - 1) % CRASH_RATE_HISTORY_SIZE];
+}
+
+static unsigned count_since(const rate_entry_t *entry, int64_t since) {
+    unsigned count = 0;
+    for (unsigned i = 0; i < entry->count; ++i) {
+        if (entry->times[(entry->head + CRASH_RATE_HISTORY_SIZE - 1 - i) % CRASH_RATE_HISTORY_SIZE] > since) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static int open_locked(const char *filepath, rate_file_t *file) {
+    int fd = open(filepath, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Unable to open crash rate file \"%s\", errno = %d.\n", filepath, errno);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int result;
+    do {
+        result = flock(fd, LOCK_EX);
+    } while ((result != 0) && (errno == EINTR));
+    if (result != 0) {
+        fprintf(stderr, "ERROR: Unable to lock crash rate file \"%s\", errno = %d.\n", filepath, errno);
+        close(fd);
+        return -1;
+    }
+
+    // NOTE: A missing, truncated or outdated file is treated as empty.
+    const ssize_t size = pread(fd, file, sizeof(*file), 0);
+    if ((size != (ssize_t)sizeof(*file)) ||
+            (memcmp(file->header.magic, kRateMagic, sizeof(kRateMagic)) != 0) ||
+            (file->header.version != kRateVersion)) {
+        memset(file, 0, sizeof(*file));
+        memcpy(file->header.magic, kRateMagic, sizeof(kRateMagic));
+        file->header.version = kRateVersion;
+    }
+    return fd;
+}
+
+static int write_and_close(int fd, const rate_file_t *file) {
+    const int succeeded = (pwrite(fd, file, sizeof(*file), 0) == (ssize_t)sizeof(*file));
+    if (!succeeded) {
+        fprintf(stderr, "ERROR: Failed to write crash rate file, errno = %d.\n", errno);
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return succeeded;
+}
+
+static rate_entry_t *find_entry(rate_file_t *file, uint64_t key, const char *name) {
+    rate_entry_t *unused = NULL;
+    for (unsigned i = 0; i < kRateEntryCount; ++i) {
+        rate_entry_t *entry = &file->entries[i];
+        if (entry->key == key) {
+            return entry;
+        }
+        if ((unused == NULL) || (latest_time(entry) < latest_time(unused))) {
+            unused = entry;
+        }
+    }
+
+    // NOTE: Empty entries have no crash times, and so are chosen first.
+    memset(unused, 0, sizeof(*unused));
+    unused->key = key;
+    strncpy(unused->name, name, sizeof(unused->name) - 1);
+    return unused;
+}
+
+int crash_rate_record(const char *filepath, const char *name, const char *bundle_id, time_t time,
+        unsigned window, unsigned threshold, crash_rate_state_t *state, unsigned *count) {
+    *state = CRASH_RATE_STATE_NORMAL;
+    *count = 1;
+    if (name == NULL) {
+        return 0;
+    }
+
+    rate_file_t file;
+    int fd = open_locked(filepath, &file);
+    if (fd < 0) {
+        return 0;
+    }
+
+    rate_entry_t *entry = find_entry(&file, hash_key(name, bundle_id), name);
+
+    // NOTE: The loop is considered to have ended if the process has not
+    //       crashed for the length of the window.
+    const int64_t since = (int64_t)time - window;
+    if (entry->is_notified && (latest_time(entry) <= since)) {
+        entry->is_notified = 0;
+    }
+
+    entry->times[entry->head] = time;
+    entry->head = (entry->head + 1) % CRASH_RATE_HISTORY_SIZE;
+    if (entry->count < CRASH_RATE_HISTORY_SIZE) {
+        ++entry->count;
+    }
+    *count = count_since(entry, since);
+
+    if (threshold > CRASH_RATE_HISTORY_SIZE) {
+        threshold = CRASH_RATE_HISTORY_SIZE;
+    }
+    if (entry->is_notified) {
+        *state = CRASH_RATE_STATE_SUPPRESSED;
+    } else if ((threshold != 0) && (*count >= threshold)) {
+        *state = CRASH_RATE_STATE_LOOP;
+        entry->is_notified = 1;
+    }
+
+    return write_and_close(fd, &file);
+}
+
+int crash_rate_acknowledge(const char *filepath, const char *name) {
+    // NOTE: Avoid creating (or locking) the file if there is nothing to do.
+    struct stat st;
+    if ((name == NULL) || (stat(filepath, &st) != 0)) {
+        return 1;
+    }
+
+    rate_file_t file;
+    int fd = open_locked(filepath, &file);
+    if (fd < 0) {
+        return 0;
+    }
+
+    int changed = 0;
+    for (unsigned i = 0; i < kRateEntryCount; ++i) {
+        rate_entry_t *entry = &file.entries[i];
+        if ((entry->key != 0) && (entry->count != 0) &&
+                (strncmp(entry->name, name, sizeof(entry->name) - 1) == 0)) {
+            // NOTE: The count starts over, so that a loop that continues is
+            //       detected (and notified) again.
+            memset(entry->times, 0, sizeof(entry->times));
+            entry->head = 0;
+            entry->count = 0;
+            entry->is_notified = 0;
+            changed = 1;
+        }
+    }
+
+    if (changed) {
+        return write_and_close(fd, &file);
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return 1;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
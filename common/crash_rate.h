@@ -0,0 +1,53 @@
+/**
+ * Desc: Persistent record of recent crash times per process, used to detect
+ *       processes that are crashing repeatedly (crash loops) so that a single
+ *       notification can be sent for the loop instead of one per crash.
+ *
+ *       The record is shared by the notifier (any number of processes or
+ *       threads) and the app; access is serialized with an advisory lock.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASH_RATE_H_
+#define COMMON_CRASH_RATE_H_
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOTE: Maximum number of crashes remembered per process; thresholds greater
+//       than this are treated as equal to it.
+#define CRASH_RATE_HISTORY_SIZE 16
+
+typedef enum {
+    // Fewer crashes than the threshold within the window.
+    CRASH_RATE_STATE_NORMAL,
+    // The threshold has just been reached; a crash-loop notification should
+    // be sent.
+    CRASH_RATE_STATE_LOOP,
+    // A crash-loop notification has already been sent for this process and
+    // has not yet been acknowledged.
+    CRASH_RATE_STATE_SUPPRESSED
+} crash_rate_state_t;
+
+// NOTE: Records a crash of the given process at the given time. The number of
+//       crashes within the window (including this one) is returned in count.
+//       A threshold of zero disables detection.
+//       Returns zero (and sets the state to normal) on error.
+int crash_rate_record(const char *filepath, const char *name, const char *bundle_id, time_t time,
+    unsigned window, unsigned threshold, crash_rate_state_t *state, unsigned *count);
+// NOTE: Ends suppression for all records with the given process name, so that
+//       the next crash is processed (and notified) normally.
+int crash_rate_acknowledge(const char *filepath, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASH_RATE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,243 @@
+/**
+ * Desc: Benchmark of deleting 1,000 crash logs (with their syslogs, summaries
+ *       and "LatestCrash" links): a C mirror of the app deleting all groups,
+ *       comparing the deletion of each group in turn on the main thread (as
+ *       the app used to) with a single transaction (CrashLogDeletion), which
+ *       only determines the replacement links on the main thread and does all
+ *       file system work in the background.
+ *
+ *       The times are of the file system work on Linux; on a device, each
+ *       group that required the as_root tool also cost a request.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include <dirent.h>
+#include <errno.h>
+
+#include "test_util.h"
+
+static const unsigned kGroupCount = 50;
+static const unsigned kLogsPerGroup = 20;
+static const unsigned kRoundCount = 5;
+
+typedef struct {
+    char filepath[1024];
+    char summary_filepath[1024];
+    int deleted;
+} log_t;
+
+static void log_filename(char *buffer, size_t size, unsigned group, unsigned n) {
+    snprintf(buffer, size, "Process%02u-2016-03-01-10%04u.ips", group, n);
+}
+
+// NOTE: Half of the syslogs have been compressed (see syslogPathForFile()).
+static void syslog_path_for_file(char *buffer, size_t size, const char *filepath) {
+    snprintf(buffer, size, "%.*s.syslog.gz", (int)(strlen(filepath) - 4), filepath);
+    struct stat st;
+    if (lstat(buffer, &st) != 0) {
+        buffer[strlen(buffer) - 3] = '\0';
+    }
+}
+
+static void make_logs(const char *directory, log_t *logs) {
+    char summary_directory[1024];
+    test_path(summary_directory, sizeof(summary_directory), directory, "summaries");
+    CHECK(mkdir(summary_directory, 0755) == 0);
+
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        for (unsigned i = 0; i < kLogsPerGroup; ++i) {
+            log_t *log = &logs[g * kLogsPerGroup + i];
+            char filename[256];
+            log_filename(filename, sizeof(filename), g, i);
+            test_path(log->filepath, sizeof(log->filepath), directory, "%s", filename);
+            test_path(log->summary_filepath, sizeof(log->summary_filepath), summary_directory, "%s", filename);
+            log->deleted = 0;
+            CHECK(test_write_file(log->filepath, "log", 3));
+            CHECK(test_write_file(log->summary_filepath, "summary", 7));
+
+            char syslog_filepath[1040];
+            snprintf(syslog_filepath, sizeof(syslog_filepath), "%.*s.syslog%s",
+                (int)(strlen(log->filepath) - 4), log->filepath, (i % 2) ? ".gz" : "");
+            CHECK(test_write_file(syslog_filepath, "syslog", 6));
+        }
+
+        // NOTE: The links point to the newest log, relative to the link.
+        char link_filepath[1024];
+        test_path(link_filepath, sizeof(link_filepath), directory, "LatestCrash-Process%02u.ips", g);
+        char filename[256];
+        log_filename(filename, sizeof(filename), g, kLogsPerGroup - 1);
+        CHECK(symlink(filename, link_filepath) == 0);
+    }
+    char link_filepath[1024];
+    test_path(link_filepath, sizeof(link_filepath), directory, "LatestCrash.ips");
+    char filename[256];
+    log_filename(filename, sizeof(filename), kGroupCount - 1, kLogsPerGroup - 1);
+    CHECK(symlink(filename, link_filepath) == 0);
+}
+
+static unsigned delete_files(char **filepaths, unsigned count) {
+    unsigned deleted_count = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        if ((unlink(filepaths[i]) == 0) || (errno == ENOENT)) {
+            ++deleted_count;
+        }
+    }
+    return deleted_count;
+}
+
+// NOTE: As -[CrashLogGroup delete] used to, for each group: collect the files
+//       of its logs, delete them, then check each log. Links were not updated.
+static double delete_by_group(log_t *logs) {
+    const double start = test_time();
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        char *filepaths[3 * kLogsPerGroup];
+        char syslog_filepaths[kLogsPerGroup][1040];
+        unsigned count = 0;
+        for (unsigned i = 0; i < kLogsPerGroup; ++i) {
+            log_t *log = &logs[g * kLogsPerGroup + i];
+            filepaths[count++] = log->filepath;
+            filepaths[count++] = log->summary_filepath;
+            syslog_path_for_file(syslog_filepaths[i], sizeof(syslog_filepaths[i]), log->filepath);
+            filepaths[count++] = syslog_filepaths[i];
+        }
+        delete_files(filepaths, count);
+
+        for (unsigned i = 0; i < kLogsPerGroup; ++i) {
+            log_t *log = &logs[g * kLogsPerGroup + i];
+            struct stat st;
+            log->deleted = (stat(log->filepath, &st) != 0);
+        }
+    }
+    return test_time() - start;
+}
+
+typedef struct {
+    double main_time;
+    double background_time;
+    unsigned link_count;
+} transaction_times_t;
+
+// NOTE: As CrashLogDeletion: the replacements for links are determined from
+//       the groups (in memory) on the main thread; the files (including the
+//       links found by reading the log directory) are collected, deleted and
+//       checked in the background.
+static void delete_by_transaction(const char *directory, log_t *logs, transaction_times_t *times) {
+    const unsigned log_count = kGroupCount * kLogsPerGroup;
+
+    // Main thread: the newest remaining log of each group, and overall.
+    // NOTE: All logs are deleted, so there are no replacements; the groups
+    //       are still searched.
+    double start = test_time();
+    int *replacements = malloc((kGroupCount + 1) * sizeof(int));
+    replacements[kGroupCount] = -1;
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        replacements[g] = -1;
+        for (int i = kLogsPerGroup - 1; i >= 0; --i) {
+            if (!logs[g * kLogsPerGroup + i].deleted) {
+                replacements[g] = g * kLogsPerGroup + i;
+                break;
+            }
+        }
+        if (replacements[g] != -1) {
+            replacements[kGroupCount] = replacements[g];
+        }
+    }
+    for (unsigned i = 0; i < log_count; ++i) {
+        logs[i].deleted = 1;
+    }
+    times->main_time = test_time() - start;
+
+    // Background: collect the files, including the links to deleted logs.
+    start = test_time();
+    char **filepaths = malloc((3 * log_count + kGroupCount + 1) * sizeof(char *));
+    char (*syslog_filepaths)[1040] = malloc(log_count * sizeof(*syslog_filepaths));
+    char (*link_filepaths)[1024] = malloc((kGroupCount + 1) * sizeof(*link_filepaths));
+    unsigned count = 0;
+    for (unsigned i = 0; i < log_count; ++i) {
+        filepaths[count++] = logs[i].filepath;
+        filepaths[count++] = logs[i].summary_filepath;
+        syslog_path_for_file(syslog_filepaths[i], sizeof(syslog_filepaths[i]), logs[i].filepath);
+        filepaths[count++] = syslog_filepaths[i];
+    }
+
+    times->link_count = 0;
+    DIR *dir = opendir(directory);
+    struct dirent *entry;
+    while ((dir != NULL) && ((entry = readdir(dir)) != NULL)) {
+        if ((strncmp(entry->d_name, "LatestCrash", 11) != 0) || (times->link_count >= kGroupCount + 1)) {
+            continue;
+        }
+        char *link_filepath = link_filepaths[times->link_count];
+        test_path(link_filepath, 1024, directory, "%s", entry->d_name);
+        char destination[1024];
+        const ssize_t length = readlink(link_filepath, destination, sizeof(destination) - 1);
+        if (length > 0) {
+            // NOTE: Every log is deleted; the app looks up the destination.
+            filepaths[count++] = link_filepath;
+            ++times->link_count;
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+
+    CHECK(delete_files(filepaths, count) == count);
+    for (unsigned i = 0; i < log_count; ++i) {
+        struct stat st;
+        CHECK(lstat(logs[i].filepath, &st) != 0);
+    }
+    times->background_time = test_time() - start;
+
+    free(link_filepaths);
+    free(syslog_filepaths);
+    free(filepaths);
+    free(replacements);
+}
+
+static unsigned remaining_file_count(const char *directory) {
+    char command[1100];
+    snprintf(command, sizeof(command), "test -z \"$(find '%s' ! -type d)\"", directory);
+    return (system(command) == 0) ? 0 : 1;
+}
+
+int main(void) {
+    const unsigned log_count = kGroupCount * kLogsPerGroup;
+    log_t *logs = calloc(log_count, sizeof(log_t));
+
+    double by_group_time = 0.0;
+    transaction_times_t total_times = {0.0, 0.0, 0};
+    for (unsigned round = 0; round < kRoundCount; ++round) {
+        char *directory = test_make_directory("crashlog_deletion_bench");
+        make_logs(directory, logs);
+        by_group_time += delete_by_group(logs);
+        for (unsigned i = 0; i < log_count; ++i) {
+            CHECK(logs[i].deleted);
+        }
+        // NOTE: The links were left pointing to deleted logs.
+        CHECK(remaining_file_count(directory) != 0);
+        test_remove_directory(directory);
+
+        directory = test_make_directory("crashlog_deletion_bench");
+        make_logs(directory, logs);
+        transaction_times_t times;
+        delete_by_transaction(directory, logs, &times);
+        CHECK(times.link_count == kGroupCount + 1);
+        CHECK(remaining_file_count(directory) == 0);
+        total_times.main_time += times.main_time;
+        total_times.background_time += times.background_time;
+        test_remove_directory(directory);
+    }
+
+    printf("Delete %u logs in %u groups (with syslogs, summaries and links):\n"
+        "  by group:    %.2f ms on the main thread (links left behind)\n"
+        "  transaction: %.3f ms on the main thread, %.2f ms in the background\n",
+        log_count, kGroupCount, by_group_time * 1000.0 / kRoundCount,
+        total_times.main_time * 1000.0 / kRoundCount, total_times.background_time * 1000.0 / kRoundCount);
+
+    free(logs);
+    return test_result("crashlog_deletion_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,418 @@
+/**
+ * Desc: Streaming reader that computes a stable fingerprint for a crash log,
+ *       used to recognize repeated occurrences of the same crash.
+ *
+ *       The fingerprint is derived from the exception type and code, and from
+ *       the top frames of the crashed thread (image name and image-relative
+ *       offset), and so does not change when a log is symbolicated.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_fingerprint.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_compression.h"
+
+// NOTE: The list of binary images is at the end of a report; if it has not
+//       been reached within this many bytes, give up.
+static const size_t kReadLimit = 4 * 1024 * 1024;
+
+// NOTE: Deeper frames mostly differ in how the crashing code was reached, and
+//       would cause identical crashes to be counted separately.
+#define kFrameCount 5
+
+typedef enum {
+    FormatUnknown,
+    FormatIPS,
+    FormatPlist,
+    FormatText
+} format_t;
+
+typedef enum {
+    SectionNone,
+    SectionCrashedThread,
+    SectionBinaryImages
+} section_t;
+
+typedef struct {
+    char image_name[128];
+    uint64_t address;
+    uint64_t offset;
+    int has_offset;
+} frame_t;
+
+typedef struct {
+    format_t format;
+    section_t section;
+    unsigned line_number;
+    int expects_description;
+    int in_description;
+    int has_crashed_thread;
+    int done;
+    char exception_type[128];
+    char exception_codes[128];
+    frame_t frames[kFrameCount];
+    unsigned frame_count;
+} reader_t;
+
+#define HAS_PREFIX(string, prefix) \
+    (strncmp((string), (prefix), sizeof(prefix) - 1) == 0)
+
+static const char *skip_whitespace(const char *p) {
+    while ((*p == ' ') || (*p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+static int is_hex_digit(char c) {
+    return ((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+}
+
+static void copy_field(char *dst, size_t dst_size, const char *src, size_t length) {
+    // Trim surrounding whitespace.
+    while ((length > 0) && ((*src == ' ') || (*src == '\t'))) {
+        ++src;
+        --length;
+    }
+    while ((length > 0) && ((src[length - 1] == ' ') || (src[length - 1] == '\t'))) {
+        --length;
+    }
+
+    if (length >= dst_size) {
+        length = dst_size - 1;
+    }
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+}
+
+static void process_exception_codes(reader_t *r, const char *value) {
+    // NOTE: Only the first code is used; the others (and the "at" part of the
+    //       older format) are addresses, which differ between occurrences.
+    size_t length = strcspn(value, ",");
+    const char *at = strstr(value, " at ");
+    if ((at != NULL) && ((size_t)(at - value) < length)) {
+        length = at - value;
+    }
+    copy_field(r->exception_codes, sizeof(r->exception_codes), value, length);
+}
+
+static void process_frame_line(reader_t *r, const char *line) {
+    // NOTE: Frame lines are of the form "index image_name address rest", where
+    //       rest is either "load_address + offset" or "symbol + offset".
+    const char *p = skip_whitespace(line);
+    if ((*p < '0') || (*p > '9')) {
+        return;
+    }
+    while ((*p >= '0') && (*p <= '9')) {
+        ++p;
+    }
+    const char *name = skip_whitespace(p);
+
+    // NOTE: The image name may contain spaces; it ends at the address.
+    const char *address = name;
+    while ((address = strstr(address, "0x")) != NULL) {
+        if ((address > name) && ((address[-1] == ' ') || (address[-1] == '\t')) && is_hex_digit(address[2])) {
+            break;
+        }
+        address += 2;
+    }
+    if (address == NULL) {
+        return;
+    }
+
+    frame_t *frame = &r->frames[r->frame_count++];
+    copy_field(frame->image_name, sizeof(frame->image_name), name, address - name);
+
+    char *end;
+    frame->address = strtoull(address, &end, 16);
+
+    // For unsymbolicated frames, the offset is given directly.
+    p = skip_whitespace(end);
+    if (HAS_PREFIX(p, "0x")) {
+        strtoull(p, &end, 16);
+        p = skip_whitespace(end);
+        if (*p == '+') {
+            p = skip_whitespace(p + 1);
+            if ((*p >= '0') && (*p <= '9')) {
+                frame->offset = strtoull(p, NULL, 10);
+                frame->has_offset = 1;
+            }
+        }
+    }
+}
+
+static void process_binary_image_line(reader_t *r, const char *line) {
+    // NOTE: Binary image lines are of the form "start - end name ...".
+    const char *p = skip_whitespace(line);
+    if (!HAS_PREFIX(p, "0x")) {
+        return;
+    }
+    char *end;
+    const uint64_t start_address = strtoull(p, &end, 16);
+    p = skip_whitespace(end);
+    if (*p != '-') {
+        return;
+    }
+    p = skip_whitespace(p + 1);
+    const uint64_t end_address = strtoull(p, NULL, 16);
+
+    // Offsets from the image load address do not depend on where the image was
+    // loaded, and are the same for symbolicated and unsymbolicated logs.
+    for (unsigned i = 0; i < r->frame_count; ++i) {
+        frame_t *frame = &r->frames[i];
+        if ((frame->address >= start_address) && (frame->address <= end_address)) {
+            frame->offset = frame->address - start_address;
+            frame->has_offset = 1;
+        }
+    }
+}
+
+static void process_body_line(reader_t *r, const char *line) {
+    if (line[0] == '\0') {
+        // Blank lines separate the sections of a report.
+        if (r->section == SectionBinaryImages) {
+            r->done = 1;
+        }
+        r->section = SectionNone;
+        return;
+    }
+
+    switch (r->section) {
+        case SectionCrashedThread:
+            if (HAS_PREFIX(line, "Thread ")) {
+                r->section = SectionNone;
+                break;
+            }
+            if (r->frame_count < kFrameCount) {
+                process_frame_line(r, line);
+            }
+            return;
+        case SectionBinaryImages:
+            process_binary_image_line(r, line);
+            return;
+        case SectionNone:
+        default:
+            break;
+    }
+
+    if (HAS_PREFIX(line, "Exception Type:")) {
+        copy_field(r->exception_type, sizeof(r->exception_type),
+            line + (sizeof("Exception Type:") - 1), strlen(line) - (sizeof("Exception Type:") - 1));
+    } else if (HAS_PREFIX(line, "Exception Codes:")) {
+        process_exception_codes(r, line + (sizeof("Exception Codes:") - 1));
+    } else if (HAS_PREFIX(line, "Thread ") && (strstr(line, " Crashed:") != NULL)) {
+        // NOTE: Only the first crashed thread is used.
+        if (!r->has_crashed_thread) {
+            r->has_crashed_thread = 1;
+            r->section = SectionCrashedThread;
+        }
+    } else if (HAS_PREFIX(line, "Binary Images:")) {
+        r->section = SectionBinaryImages;
+    }
+}
+
+static const char *find(const char *haystack, size_t length, const char *needle) {
+    const size_t needle_length = strlen(needle);
+    if (length >= needle_length) {
+        for (const char *p = haystack; p <= haystack + length - needle_length; ++p) {
+            if ((*p == *needle) && (memcmp(p, needle, needle_length) == 0)) {
+                return p;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void process_description_line(reader_t *r, const char *line, size_t length) {
+    static const struct { const char *entity; size_t length; char c; } kEntities[] = {
+        {"&lt;", 4, '<'},
+        {"&gt;", 4, '>'},
+        {"&amp;", 5, '&'},
+        {"&quot;", 6, '"'},
+        {"&apos;", 6, '\''}
+    };
+
+    char buffer[1024];
+    size_t i = 0;
+    size_t j = 0;
+    while ((i < length) && (j + 1 < sizeof(buffer))) {
+        char c = line[i];
+        size_t advance = 1;
+        if (c == '&') {
+            for (unsigned k = 0; k < sizeof(kEntities) / sizeof(kEntities[0]); ++k) {
+                if ((length - i >= kEntities[k].length) && (memcmp(line + i, kEntities[k].entity, kEntities[k].length) == 0)) {
+                    c = kEntities[k].c;
+                    advance = kEntities[k].length;
+                    break;
+                }
+            }
+        }
+        buffer[j++] = c;
+        i += advance;
+    }
+    buffer[j] = '\0';
+    process_body_line(r, buffer);
+}
+
+static void process_plist_line(reader_t *r, const char *line, size_t length) {
+    // NOTE: The report itself is stored as the "description" string.
+    const char *p = line;
+    const char *end = line + length;
+    if (!r->in_description) {
+        if (!r->expects_description) {
+            const char *key = find(p, end - p, "<key>description</key>");
+            if (key == NULL) {
+                return;
+            }
+            p = key + (sizeof("<key>description</key>") - 1);
+            r->expects_description = 1;
+        }
+
+        const char *value = find(p, end - p, "<string>");
+        if (value == NULL) {
+            return;
+        }
+        p = value + (sizeof("<string>") - 1);
+        r->expects_description = 0;
+        r->in_description = 1;
+    }
+
+    const char *close = find(p, end - p, "</string>");
+    process_description_line(r, p, (close != NULL) ? (size_t)(close - p) : (size_t)(end - p));
+    if (close != NULL) {
+        r->in_description = 0;
+        r->done = 1;
+    }
+}
+
+static void process_line(reader_t *r, char *line, size_t length) {
+    // Strip carriage return, if any.
+    if ((length > 0) && (line[length - 1] == '\r')) {
+        --length;
+    }
+    line[length] = '\0';
+
+    if (r->format == FormatUnknown) {
+        const char *p = skip_whitespace(line);
+        if (*p == '\0') {
+            return;
+        }
+        r->format = (*p == '{') ? FormatIPS : ((*p == '<') ? FormatPlist : FormatText);
+    }
+
+    if (r->format == FormatIPS) {
+        // NOTE: The first line of an IPS file is a JSON header.
+        if (r->line_number != 0) {
+            process_body_line(r, line);
+        }
+    } else if (r->format == FormatPlist) {
+        process_plist_line(r, line, length);
+    } else {
+        process_body_line(r, line);
+    }
+    ++r->line_number;
+}
+
+static void hash_bytes(uint64_t *hash, const void *bytes, size_t length) {
+    // FNV-1a.
+    for (const unsigned char *p = bytes; length > 0; ++p, --length) {
+        *hash ^= *p;
+        *hash *= 1099511628211ull;
+    }
+}
+
+static uint64_t compute_fingerprint(const reader_t *r) {
+    uint64_t hash = 14695981039346656037ull;
+    hash_bytes(&hash, r->exception_type, strlen(r->exception_type) + 1);
+    hash_bytes(&hash, r->exception_codes, strlen(r->exception_codes) + 1);
+    for (unsigned i = 0; i < r->frame_count; ++i) {
+        const frame_t *frame = &r->frames[i];
+        hash_bytes(&hash, frame->image_name, strlen(frame->image_name) + 1);
+
+        // NOTE: Hashed byte by byte so that the result does not depend on the
+        //       byte order of the device.
+        // NOTE: If the offset is unknown, only the image name is used.
+        unsigned char bytes[9];
+        bytes[0] = frame->has_offset;
+        for (unsigned j = 0; j < 8; ++j) {
+            bytes[j + 1] = (frame->has_offset ? (frame->offset >> (8 * j)) : 0) & 0xff;
+        }
+        hash_bytes(&hash, bytes, sizeof(bytes));
+    }
+    return (hash != CRASHLOG_FINGERPRINT_NONE) ? hash : 1;
+}
+
+int crashlog_fingerprint_read_fd(int fd, uint64_t *fingerprint) {
+    *fingerprint = CRASHLOG_FINGERPRINT_NONE;
+
+    reader_t r;
+    memset(&r, 0, sizeof(r));
+
+    // NOTE: Compressed (aged) logs are decompressed as they are read.
+    log_reader_t *reader = log_reader_open(fd);
+    if (reader == NULL) {
+        return 0;
+    }
+
+    // NOTE: Lines longer than the line buffer are truncated; only the start
+    //       of a line is of interest.
+    char buffer[4096];
+    char line[4096 + 1];
+    size_t line_length = 0;
+    size_t total = 0;
+    while (!r.done && (total < kReadLimit)) {
+        ssize_t count = log_reader_read(reader, buffer, sizeof(buffer));
+        if (count < 0) {
+            log_reader_close(reader);
+            return 0;
+        } else if (count == 0) {
+            break;
+        }
+        total += count;
+
+        for (ssize_t i = 0; (i < count) && !r.done; ++i) {
+            const char c = buffer[i];
+            if (c == '\n') {
+                process_line(&r, line, line_length);
+                line_length = 0;
+            } else if (line_length < sizeof(line) - 1) {
+                line[line_length++] = c;
+            }
+        }
+    }
+    if (!r.done && (line_length > 0)) {
+        process_line(&r, line, line_length);
+    }
+    log_reader_close(reader);
+
+    if (r.frame_count == 0) {
+        // Not a crash, or not a supported format.
+        return 0;
+    }
+    *fingerprint = compute_fingerprint(&r);
+    return 1;
+}
+
+int crashlog_fingerprint_read(const char *filepath, uint64_t *fingerprint) {
+    int result = 0;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd >= 0) {
+        result = crashlog_fingerprint_read_fd(fd, fingerprint);
+        close(fd);
+    } else {
+        *fingerprint = CRASHLOG_FINGERPRINT_NONE;
+    }
+
+    return result;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
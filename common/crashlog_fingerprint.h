@@ -0,0 +1,35 @@
+/**
+ * Desc: Streaming reader that computes a stable fingerprint for a crash log,
+ *       used to recognize repeated occurrences of the same crash.
+ *
+ *       The fingerprint is derived from the exception type and code, and from
+ *       the top frames of the crashed thread (image name and image-relative
+ *       offset), and so does not change when a log is symbolicated.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASHLOG_FINGERPRINT_H_
+#define COMMON_CRASHLOG_FINGERPRINT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOTE: Zero is never a valid fingerprint; it is used for logs that do not
+//       include a crashed thread (e.g. low memory reports).
+#define CRASHLOG_FINGERPRINT_NONE 0
+
+int crashlog_fingerprint_read(const char *filepath, uint64_t *fingerprint);
+int crashlog_fingerprint_read_fd(int fd, uint64_t *fingerprint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASHLOG_FINGERPRINT_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,211 @@
+/**
+ * Desc: Benchmark of the list of crash log groups in the app, as it is
+ *       scrolled: a C mirror of CrashLogGroup, comparing groups that keep
+ *       their logs sorted by numeric timestamp as they are added (and keep the
+ *       counts shown in each row) with groups that re-sort their logs by
+ *       filepath each time a row is configured (as the app used to).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include "test_util.h"
+
+static const unsigned kGroupCount = 200;
+static const unsigned kLogsPerGroup = 100;
+static const unsigned kScrollPassCount = 10;
+
+typedef struct {
+    char filepath[128];
+    // NOTE: Seconds since the epoch, as taken from the filename.
+    int64_t timestamp;
+    int viewed;
+} log_t;
+
+typedef struct {
+    log_t **logs;
+    unsigned count;
+    unsigned unviewed_count;
+} group_t;
+
+// NOTE: As reverseCompareCrashLogs(): newest first, by the numeric date;
+//       logs with the same date are ordered by filepath.
+static int reverse_compare_logs(const log_t *a, const log_t *b) {
+    if (a->timestamp != b->timestamp) {
+        return (a->timestamp > b->timestamp) ? -1 : 1;
+    }
+    return strcmp(b->filepath, a->filepath);
+}
+
+// NOTE: As the app used to: newest first, by comparing filepaths.
+static int reverse_compare_filepaths(const void *a, const void *b) {
+    const log_t *log_a = *(log_t * const *)a;
+    const log_t *log_b = *(log_t * const *)b;
+    return strcmp(log_b->filepath, log_a->filepath);
+}
+
+// NOTE: As -[CrashLogGroup addCrashLog:]: binary search for the insertion
+//       index, and keep the unviewed count.
+static void add_sorted(group_t *group, log_t *log) {
+    unsigned low = 0;
+    unsigned high = group->count;
+    while (low < high) {
+        const unsigned middle = low + (high - low) / 2;
+        if (reverse_compare_logs(group->logs[middle], log) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    memmove(&group->logs[low + 1], &group->logs[low], (group->count - low) * sizeof(log_t *));
+    group->logs[low] = log;
+    ++group->count;
+    if (!log->viewed) {
+        ++group->unviewed_count;
+    }
+}
+
+static void add_unsorted(group_t *group, log_t *log) {
+    group->logs[group->count++] = log;
+}
+
+typedef struct {
+    int64_t latest_timestamp;
+    unsigned count;
+    unsigned unviewed_count;
+} row_t;
+
+// NOTE: As RootCell used to: the logs were sorted once for the type of the
+//       group (of its latest log), and again for the row itself, which then
+//       counted the unviewed logs.
+static void configure_row_resorting(const group_t *group, log_t **scratch, row_t *row) {
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        memcpy(scratch, group->logs, group->count * sizeof(log_t *));
+        qsort(scratch, group->count, sizeof(log_t *), reverse_compare_filepaths);
+    }
+    row->latest_timestamp = scratch[0]->timestamp;
+    row->count = group->count;
+    row->unviewed_count = 0;
+    for (unsigned i = 0; i < group->count; ++i) {
+        if (!scratch[i]->viewed) {
+            ++row->unviewed_count;
+        }
+    }
+}
+
+static void configure_row_sorted(const group_t *group, row_t *row) {
+    row->latest_timestamp = group->logs[0]->timestamp;
+    row->count = group->count;
+    row->unviewed_count = group->unviewed_count;
+}
+
+int main(void) {
+    srand(1);
+
+    // NOTE: Logs are listed in directory order, which is not sorted.
+    const unsigned log_count = kGroupCount * kLogsPerGroup;
+    log_t *logs = calloc(log_count, sizeof(log_t));
+    unsigned *order = malloc(log_count * sizeof(unsigned));
+    for (unsigned i = 0; i < log_count; ++i) {
+        const unsigned group = i / kLogsPerGroup;
+        const int64_t timestamp = 1451606400 + (int64_t)(rand() % (365 * 24 * 60 * 60));
+        const time_t time = (time_t)timestamp;
+        struct tm tm;
+        gmtime_r(&time, &tm);
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%d-%H%M%S", &tm);
+        snprintf(logs[i].filepath, sizeof(logs[i].filepath),
+            "/var/mobile/Library/Logs/CrashReporter/Process%03u-%s.ips.synced", group, date);
+        logs[i].timestamp = timestamp;
+        logs[i].viewed = (rand() % 4 != 0);
+        order[i] = i;
+    }
+    for (unsigned i = log_count - 1; i > 0; --i) {
+        const unsigned j = rand() % (i + 1);
+        const unsigned swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    group_t *sorted_groups = calloc(kGroupCount, sizeof(group_t));
+    group_t *unsorted_groups = calloc(kGroupCount, sizeof(group_t));
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        sorted_groups[g].logs = malloc(kLogsPerGroup * sizeof(log_t *));
+        unsorted_groups[g].logs = malloc(kLogsPerGroup * sizeof(log_t *));
+    }
+
+    double start = test_time();
+    for (unsigned i = 0; i < log_count; ++i) {
+        log_t *log = &logs[order[i]];
+        add_unsorted(&unsorted_groups[order[i] / kLogsPerGroup], log);
+    }
+    const double unsorted_add_time = test_time() - start;
+
+    start = test_time();
+    for (unsigned i = 0; i < log_count; ++i) {
+        log_t *log = &logs[order[i]];
+        add_sorted(&sorted_groups[order[i] / kLogsPerGroup], log);
+    }
+    const double sorted_add_time = test_time() - start;
+
+    // Both give the same rows.
+    log_t **scratch = malloc(kLogsPerGroup * sizeof(log_t *));
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        row_t expected;
+        row_t actual;
+        configure_row_resorting(&unsorted_groups[g], scratch, &expected);
+        configure_row_sorted(&sorted_groups[g], &actual);
+        CHECK(actual.latest_timestamp == expected.latest_timestamp);
+        CHECK(actual.count == expected.count);
+        CHECK(actual.unviewed_count == expected.unviewed_count);
+        for (unsigned i = 1; i < sorted_groups[g].count; ++i) {
+            CHECK(reverse_compare_logs(sorted_groups[g].logs[i - 1], sorted_groups[g].logs[i]) < 0);
+        }
+    }
+
+    // Scroll through the whole list several times.
+    uint64_t checksum = 0;
+    start = test_time();
+    for (unsigned pass = 0; pass < kScrollPassCount; ++pass) {
+        for (unsigned g = 0; g < kGroupCount; ++g) {
+            row_t row;
+            configure_row_resorting(&unsorted_groups[g], scratch, &row);
+            checksum += row.unviewed_count;
+        }
+    }
+    const double resorting_time = (test_time() - start) / kScrollPassCount;
+
+    start = test_time();
+    for (unsigned pass = 0; pass < kScrollPassCount; ++pass) {
+        for (unsigned g = 0; g < kGroupCount; ++g) {
+            row_t row;
+            configure_row_sorted(&sorted_groups[g], &row);
+            checksum -= row.unviewed_count;
+        }
+    }
+    const double sorted_time = (test_time() - start) / kScrollPassCount;
+    CHECK(checksum == 0);
+
+    printf("%u groups of %u logs:\n"
+        "  add logs:           %.2f ms sorted insertion, %.2f ms append\n"
+        "  scroll (all rows):  %.3f ms re-sorting by filepath, %.4f ms kept sorted\n",
+        kGroupCount, kLogsPerGroup,
+        sorted_add_time * 1000.0, unsorted_add_time * 1000.0,
+        resorting_time * 1000.0, sorted_time * 1000.0);
+
+    for (unsigned g = 0; g < kGroupCount; ++g) {
+        free(sorted_groups[g].logs);
+        free(unsorted_groups[g].logs);
+    }
+    free(sorted_groups);
+    free(unsorted_groups);
+    free(scratch);
+    free(order);
+    free(logs);
+    return test_result("crashlog_group_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,440 @@
+/**
+ * Desc: Streaming reader for the header of a crash log file.
+ *
+ *       Reads only as much of the file as is needed to determine the bug type,
+ *       process name, timestamp and process path, without parsing the full
+ *       report.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_header.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_compression.h"
+
+// NOTE: The information needed is always found near the start of a report.
+//       If it has not been found within this many bytes, give up.
+static const size_t kReadLimit = 64 * 1024;
+
+typedef enum {
+    FormatUnknown,
+    FormatIPS,
+    FormatPlist
+} format_t;
+
+typedef struct {
+    crashlog_header_t *header;
+    format_t format;
+    unsigned line_number;
+    int in_description;
+    int body_ended;
+    int done;
+    char current_key[64];
+} reader_t;
+
+#define HAS_PREFIX(string, length, prefix) \
+    (((length) >= (sizeof(prefix) - 1)) && (memcmp((string), (prefix), sizeof(prefix) - 1) == 0))
+
+static void copy_field(char *dst, size_t dst_size, const char *src, size_t length) {
+    // Trim surrounding whitespace.
+    while ((length > 0) && ((*src == ' ') || (*src == '\t'))) {
+        ++src;
+        --length;
+    }
+    while ((length > 0) && ((src[length - 1] == ' ') || (src[length - 1] == '\t'))) {
+        --length;
+    }
+
+    if (length >= dst_size) {
+        length = dst_size - 1;
+    }
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+}
+
+// NOTE: In .plist files, the "symbolicated" key follows the "description" key,
+//       which holds the body of the report; the file is read until the key
+//       (or the end of the file) is reached.
+static void update_done(reader_t *r) {
+    const crashlog_header_t *header = r->header;
+    r->done =
+        (header->bug_type != CRASHLOG_HEADER_BUG_TYPE_UNKNOWN) &&
+        (header->name[0] != '\0') &&
+        (r->body_ended || ((header->process_path[0] != '\0') && (header->date_time[0] != '\0'))) &&
+        header->symbolicated_is_known;
+}
+
+static void process_body_line(reader_t *r, const char *line, size_t length) {
+    crashlog_header_t *header = r->header;
+
+    if (HAS_PREFIX(line, length, "Process:")) {
+        if (header->name[0] == '\0') {
+            // NOTE: Value is of the form "name [pid]".
+            const char *value = line + (sizeof("Process:") - 1);
+            size_t value_length = length - (sizeof("Process:") - 1);
+            const char *bracket = memchr(value, '[', value_length);
+            if (bracket != NULL) {
+                value_length = bracket - value;
+            }
+            copy_field(header->name, sizeof(header->name), value, value_length);
+        }
+    } else if (HAS_PREFIX(line, length, "Path:")) {
+        copy_field(header->process_path, sizeof(header->process_path),
+            line + (sizeof("Path:") - 1), length - (sizeof("Path:") - 1));
+    } else if (HAS_PREFIX(line, length, "Date/Time:")) {
+        copy_field(header->date_time, sizeof(header->date_time),
+            line + (sizeof("Date/Time:") - 1), length - (sizeof("Date/Time:") - 1));
+    } else if (
+            HAS_PREFIX(line, length, "Exception Type:") ||
+            HAS_PREFIX(line, length, "Triggered by Thread:") ||
+            HAS_PREFIX(line, length, "Thread ") ||
+            HAS_PREFIX(line, length, "Binary Images:") ||
+            HAS_PREFIX(line, length, "Free pages:")
+            ) {
+        // Reached the end of the header portion of the report.
+        r->body_ended = 1;
+    }
+}
+
+static const char *skip_whitespace(const char *p, const char *end) {
+    while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *parse_json_string(const char *p, const char *end, char *dst, size_t dst_size) {
+    // NOTE: Expects p to point just past the opening quote.
+    size_t length = 0;
+    while ((p < end) && (*p != '"')) {
+        char c = *p++;
+        if ((c == '\\') && (p < end)) {
+            c = *p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                default: break;
+            }
+        }
+        if (length + 1 < dst_size) {
+            dst[length++] = c;
+        }
+    }
+    if (dst_size > 0) {
+        dst[length] = '\0';
+    }
+    return (p < end) ? (p + 1) : p;
+}
+
+static const char *skip_json_value(const char *p, const char *end) {
+    unsigned depth = 0;
+    while (p < end) {
+        const char c = *p;
+        if (c == '"') {
+            p = parse_json_string(p + 1, end, NULL, 0);
+            continue;
+        } else if ((c == '{') || (c == '[')) {
+            ++depth;
+        } else if ((c == '}') || (c == ']')) {
+            if (depth == 0) {
+                break;
+            }
+            --depth;
+        } else if ((c == ',') && (depth == 0)) {
+            break;
+        }
+        ++p;
+    }
+    return p;
+}
+
+static void process_json_header(reader_t *r, const char *line, size_t length) {
+    crashlog_header_t *header = r->header;
+    const char *p = line;
+    const char *end = line + length;
+
+    p = skip_whitespace(p, end);
+    if ((p == end) || (*p != '{')) {
+        return;
+    }
+    ++p;
+
+    while (p < end) {
+        char key[64];
+        char value[1024];
+
+        p = skip_whitespace(p, end);
+        if ((p == end) || (*p != '"')) {
+            break;
+        }
+        p = parse_json_string(p + 1, end, key, sizeof(key));
+        p = skip_whitespace(p, end);
+        if ((p == end) || (*p != ':')) {
+            break;
+        }
+        p = skip_whitespace(p + 1, end);
+
+        if ((p < end) && (*p == '"')) {
+            p = parse_json_string(p + 1, end, value, sizeof(value));
+        } else {
+            const char *start = p;
+            p = skip_json_value(p, end);
+            copy_field(value, sizeof(value), start, p - start);
+        }
+
+        if (strcmp(key, "bug_type") == 0) {
+            header->bug_type = atoi(value);
+        } else if (strcmp(key, "name") == 0) {
+            copy_field(header->name, sizeof(header->name), value, strlen(value));
+        } else if (strcmp(key, "bundleID") == 0) {
+            copy_field(header->bundle_id, sizeof(header->bundle_id), value, strlen(value));
+        } else if (strcmp(key, "timestamp") == 0) {
+            copy_field(header->timestamp, sizeof(header->timestamp), value, strlen(value));
+        } else if (strcmp(key, "symbolicated") == 0) {
+            header->symbolicated = (strcmp(value, "true") == 0) || (strcmp(value, "1") == 0);
+        }
+
+        p = skip_whitespace(p, end);
+        if ((p < end) && (*p == ',')) {
+            ++p;
+        } else {
+            break;
+        }
+    }
+}
+
+static size_t unescape_xml(char *dst, size_t dst_size, const char *src, size_t length) {
+    static const struct { const char *entity; size_t length; char c; } kEntities[] = {
+        {"&lt;", 4, '<'},
+        {"&gt;", 4, '>'},
+        {"&amp;", 5, '&'},
+        {"&quot;", 6, '"'},
+        {"&apos;", 6, '\''}
+    };
+
+    size_t i = 0;
+    size_t j = 0;
+    while ((i < length) && (j + 1 < dst_size)) {
+        char c = src[i];
+        size_t advance = 1;
+        if (c == '&') {
+            for (unsigned k = 0; k < sizeof(kEntities) / sizeof(kEntities[0]); ++k) {
+                if ((length - i >= kEntities[k].length) && (memcmp(src + i, kEntities[k].entity, kEntities[k].length) == 0)) {
+                    c = kEntities[k].c;
+                    advance = kEntities[k].length;
+                    break;
+                }
+            }
+        }
+        dst[j++] = c;
+        i += advance;
+    }
+    dst[j] = '\0';
+    return j;
+}
+
+static void process_description_line(reader_t *r, const char *line, size_t length) {
+    char buffer[1024];
+    const size_t buffer_length = unescape_xml(buffer, sizeof(buffer), line, length);
+    process_body_line(r, buffer, buffer_length);
+}
+
+static const char *find(const char *haystack, size_t length, const char *needle) {
+    const size_t needle_length = strlen(needle);
+    if (length >= needle_length) {
+        for (const char *p = haystack; p <= haystack + length - needle_length; ++p) {
+            if ((*p == *needle) && (memcmp(p, needle, needle_length) == 0)) {
+                return p;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void process_plist_value(reader_t *r, const char *value, size_t length) {
+    crashlog_header_t *header = r->header;
+    const char *key = r->current_key;
+
+    if (strcmp(key, "bug_type") == 0) {
+        char buffer[16];
+        copy_field(buffer, sizeof(buffer), value, length);
+        header->bug_type = atoi(buffer);
+    } else if (strcmp(key, "name") == 0) {
+        unescape_xml(header->name, sizeof(header->name), value, length);
+    } else if (strcmp(key, "bundleID") == 0) {
+        unescape_xml(header->bundle_id, sizeof(header->bundle_id), value, length);
+    } else if (strcmp(key, "timestamp") == 0) {
+        unescape_xml(header->timestamp, sizeof(header->timestamp), value, length);
+    }
+}
+
+static void process_plist_line(reader_t *r, const char *line, size_t length) {
+    // NOTE: Markup within values is escaped; this can only be the end of the
+    //       file, in which case the "symbolicated" key is not present.
+    if (find(line, length, "</plist>") != NULL) {
+        r->header->symbolicated_is_known = 1;
+    }
+
+    if (r->in_description) {
+        const char *close = find(line, length, "</string>");
+        process_description_line(r, line, (close != NULL) ? (size_t)(close - line) : length);
+        if (close != NULL) {
+            r->in_description = 0;
+            r->current_key[0] = '\0';
+        }
+        return;
+    }
+
+    const char *end = line + length;
+    const char *p = find(line, length, "<key>");
+    if (p != NULL) {
+        p += sizeof("<key>") - 1;
+        const char *close = find(p, end - p, "</key>");
+        if (close == NULL) {
+            return;
+        }
+        copy_field(r->current_key, sizeof(r->current_key), p, close - p);
+        p = close + (sizeof("</key>") - 1);
+    } else {
+        p = line;
+    }
+
+    if (r->current_key[0] == '\0') {
+        return;
+    }
+
+    const char *value;
+    if ((value = find(p, end - p, "<string>")) != NULL) {
+        value += sizeof("<string>") - 1;
+        const char *close = find(value, end - value, "</string>");
+        if (strcmp(r->current_key, "description") == 0) {
+            process_description_line(r, value, (close != NULL) ? (size_t)(close - value) : (size_t)(end - value));
+            if (close == NULL) {
+                r->in_description = 1;
+                return;
+            }
+        } else if (close != NULL) {
+            process_plist_value(r, value, close - value);
+        }
+        r->current_key[0] = '\0';
+    } else if ((value = find(p, end - p, "<integer>")) != NULL) {
+        value += sizeof("<integer>") - 1;
+        const char *close = find(value, end - value, "</integer>");
+        if (close != NULL) {
+            process_plist_value(r, value, close - value);
+        }
+        r->current_key[0] = '\0';
+    } else if (find(p, end - p, "<true/>") != NULL) {
+        if (strcmp(r->current_key, "symbolicated") == 0) {
+            r->header->symbolicated = 1;
+            r->header->symbolicated_is_known = 1;
+        }
+        r->current_key[0] = '\0';
+    } else if (find(p, end - p, "<false/>") != NULL) {
+        if (strcmp(r->current_key, "symbolicated") == 0) {
+            r->header->symbolicated_is_known = 1;
+        }
+        r->current_key[0] = '\0';
+    }
+}
+
+static void process_line(reader_t *r, const char *line, size_t length) {
+    // Strip carriage return, if any.
+    if ((length > 0) && (line[length - 1] == '\r')) {
+        --length;
+    }
+
+    if (r->format == FormatUnknown) {
+        const char *p = skip_whitespace(line, line + length);
+        if (p == line + length) {
+            return;
+        }
+        r->format = (*p == '{') ? FormatIPS : ((*p == '<') ? FormatPlist : FormatUnknown);
+        if (r->format == FormatUnknown) {
+            // Not a supported file format.
+            r->done = 1;
+            return;
+        }
+    }
+
+    if (r->format == FormatIPS) {
+        if (r->line_number == 0) {
+            process_json_header(r, line, length);
+            // NOTE: The "symbolicated" key, if present, is in the first line.
+            r->header->symbolicated_is_known = 1;
+        } else {
+            process_body_line(r, line, length);
+        }
+    } else {
+        process_plist_line(r, line, length);
+    }
+    ++r->line_number;
+
+    update_done(r);
+}
+
+int crashlog_header_read_fd(int fd, crashlog_header_t *header) {
+    memset(header, 0, sizeof(*header));
+    header->bug_type = CRASHLOG_HEADER_BUG_TYPE_UNKNOWN;
+
+    reader_t r;
+    memset(&r, 0, sizeof(r));
+    r.header = header;
+
+    // NOTE: Compressed (aged) logs are decompressed as they are read.
+    log_reader_t *reader = log_reader_open(fd);
+    if (reader == NULL) {
+        return 0;
+    }
+
+    // NOTE: Lines longer than the line buffer are truncated; none of the
+    //       values of interest are anywhere near this long.
+    char buffer[4096];
+    char line[4096];
+    size_t line_length = 0;
+    size_t total = 0;
+    while (!r.done && (total < kReadLimit)) {
+        ssize_t count = log_reader_read(reader, buffer, sizeof(buffer));
+        if (count <= 0) {
+            break;
+        }
+        total += count;
+
+        for (ssize_t i = 0; (i < count) && !r.done; ++i) {
+            const char c = buffer[i];
+            if (c == '\n') {
+                process_line(&r, line, line_length);
+                line_length = 0;
+            } else if (line_length < sizeof(line)) {
+                line[line_length++] = c;
+            }
+        }
+    }
+    if (!r.done && (line_length > 0)) {
+        process_line(&r, line, line_length);
+    }
+    log_reader_close(reader);
+
+    return (r.format != FormatUnknown) && (header->bug_type != CRASHLOG_HEADER_BUG_TYPE_UNKNOWN);
+}
+
+int crashlog_header_read(const char *filepath, crashlog_header_t *header) {
+    int result = 0;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd >= 0) {
+        result = crashlog_header_read_fd(fd, header);
+        close(fd);
+    }
+
+    return result;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,47 @@
+/**
+ * Desc: Streaming reader for the header of a crash log file.
+ *
+ *       Reads only as much of the file as is needed to determine the bug type,
+ *       process name, timestamp and process path, without parsing the full
+ *       report.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASHLOG_HEADER_H_
+#define COMMON_CRASHLOG_HEADER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRASHLOG_HEADER_BUG_TYPE_UNKNOWN   (-1)
+#define CRASHLOG_HEADER_BUG_TYPE_CRASH      109
+#define CRASHLOG_HEADER_BUG_TYPE_LOW_MEMORY 198
+
+typedef struct {
+    int bug_type;
+    int symbolicated;
+    // NOTE: Zero if the end of the header (the first line of an .ips file, or
+    //       the end of a .plist file) was not reached before the read limit;
+    //       a log that has not been marked as symbolicated may then still be
+    //       symbolicated.
+    int symbolicated_is_known;
+    char name[256];
+    char bundle_id[256];
+    char timestamp[64];
+    char date_time[64];
+    char process_path[1024];
+} crashlog_header_t;
+
+int crashlog_header_read(const char *filepath, crashlog_header_t *header);
+int crashlog_header_read_fd(int fd, crashlog_header_t *header);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASHLOG_HEADER_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
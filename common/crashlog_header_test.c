@@ -0,0 +1,215 @@
+/**
+ * Desc: Test and benchmark of the crash log header reader, with .ips and
+ *       .plist logs (plain and compressed).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_header.h"
+
+#include "log_compression.h"
+#include "test_util.h"
+
+static const char kIPSHeader[] =
+    "{\"app_name\":\"MobileSafari\",\"timestamp\":\"2016-03-01 10:00:00.00 +0900\",\"bug_type\":\"109\",\"name\":\"MobileSafari\",\"bundleID\":\"com.apple.mobilesafari\"%s}\n"
+    "Incident Identifier: 1234\n"
+    "Process:             MobileSafari [123]\n"
+    "Path:                /Applications/MobileSafari.app/MobileSafari\n"
+    "Date/Time:           2016-03-01 10:00:00.00 +0900\n"
+    "Exception Type:  EXC_BAD_ACCESS (SIGSEGV)\n"
+    "Thread 0 Crashed:\n";
+
+static const char kPlistHeader[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<plist version=\"1.0\">\n"
+    "<dict>\n"
+    "\t<key>bug_type</key>\n"
+    "\t<string>109</string>\n"
+    "\t<key>description</key>\n"
+    "\t<string>Incident Identifier: 1234\n"
+    "Process:         Mail &amp; Co [123]\n"
+    "Path:            /Applications/Mail.app/Mail\n"
+    "Date/Time:       2012-03-01 10:00:00.000 +0900\n"
+    "Exception Type:  EXC_BAD_ACCESS (SIGSEGV)\n"
+    "Thread 0 Crashed:\n";
+
+static const char kFrameLine[] =
+    "0   libobjc.A.dylib               \t0x3a0c5b66 0x3a0c2000 + 15206\n";
+
+// NOTE: Writes a report with the given number of body lines.
+static size_t make_ips(char **bytes, const char *extra_keys, unsigned line_count) {
+    size_t capacity = sizeof(kIPSHeader) + strlen(extra_keys) + line_count * sizeof(kFrameLine);
+    char *buffer = malloc(capacity);
+    size_t length = snprintf(buffer, capacity, kIPSHeader, extra_keys);
+    for (unsigned i = 0; i < line_count; ++i) {
+        length += snprintf(buffer + length, capacity - length, "%s", kFrameLine);
+    }
+    *bytes = buffer;
+    return length;
+}
+
+static size_t make_plist(char **bytes, const char *trailing_keys, unsigned line_count) {
+    size_t capacity = sizeof(kPlistHeader) + line_count * sizeof(kFrameLine) + strlen(trailing_keys) + 256;
+    char *buffer = malloc(capacity);
+    size_t length = snprintf(buffer, capacity, "%s", kPlistHeader);
+    for (unsigned i = 0; i < line_count; ++i) {
+        length += snprintf(buffer + length, capacity - length, "%s", kFrameLine);
+    }
+    length += snprintf(buffer + length, capacity - length,
+        "</string>\n"
+        "\t<key>name</key>\n"
+        "\t<string>Mail &amp; Co</string>\n"
+        "%s"
+        "\t<key>timestamp</key>\n"
+        "\t<string>2012-03-01 10:00:00 +0900</string>\n"
+        "</dict>\n"
+        "</plist>\n",
+        trailing_keys);
+    *bytes = buffer;
+    return length;
+}
+
+// NOTE: As the notifier does: the log is compressed to "<filename>.gz", and
+//       the original is deleted.
+static void write_compressed(char *compressed_filepath, size_t size, const char *filepath, const char *bytes, size_t length) {
+    CHECK(test_write_file(filepath, bytes, length));
+    snprintf(compressed_filepath, size, "%s." kCompressedPathExtension, filepath);
+
+    int fd = open(filepath, O_RDONLY);
+    FILE *f = fopen(compressed_filepath, "w");
+    CHECK((fd >= 0) && (f != NULL));
+    CHECK(log_compression_compress_fd(fd, f));
+    fclose(f);
+    close(fd);
+    unlink(filepath);
+}
+
+static void test_ips(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "MobileSafari.ips");
+    crashlog_header_t header;
+
+    char *bytes;
+    size_t length = make_ips(&bytes, "", 10);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(header.bug_type == CRASHLOG_HEADER_BUG_TYPE_CRASH);
+    CHECK(strcmp(header.name, "MobileSafari") == 0);
+    CHECK(strcmp(header.bundle_id, "com.apple.mobilesafari") == 0);
+    CHECK(strcmp(header.timestamp, "2016-03-01 10:00:00.00 +0900") == 0);
+    CHECK(strcmp(header.date_time, "2016-03-01 10:00:00.00 +0900") == 0);
+    CHECK(strcmp(header.process_path, "/Applications/MobileSafari.app/MobileSafari") == 0);
+    CHECK(!header.symbolicated);
+    CHECK(header.symbolicated_is_known);
+
+    // Compressed logs are read transparently.
+    char compressed_filepath[1024];
+    write_compressed(compressed_filepath, sizeof(compressed_filepath), filepath, bytes, length);
+    CHECK(crashlog_header_read(compressed_filepath, &header));
+    CHECK(strcmp(header.process_path, "/Applications/MobileSafari.app/MobileSafari") == 0);
+    free(bytes);
+
+    length = make_ips(&bytes, ",\"symbolicated\":true", 10);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(header.symbolicated);
+    CHECK(header.symbolicated_is_known);
+    free(bytes);
+
+    // Not a crash log.
+    CHECK(test_write_file(filepath, "Hello\n", 6));
+    CHECK(!crashlog_header_read(filepath, &header));
+}
+
+static void test_plist(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "Mail.plist");
+    crashlog_header_t header;
+
+    char *bytes;
+    size_t length = make_plist(&bytes, "", 10);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(header.bug_type == CRASHLOG_HEADER_BUG_TYPE_CRASH);
+    CHECK(strcmp(header.name, "Mail & Co") == 0);
+    CHECK(strcmp(header.process_path, "/Applications/Mail.app/Mail") == 0);
+    CHECK(strcmp(header.date_time, "2012-03-01 10:00:00.000 +0900") == 0);
+    CHECK(!header.symbolicated);
+    CHECK(header.symbolicated_is_known);
+    free(bytes);
+
+    // NOTE: The "symbolicated" key follows the description.
+    length = make_plist(&bytes, "\t<key>symbolicated</key>\n\t<true/>\n", 100);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(header.symbolicated);
+    CHECK(header.symbolicated_is_known);
+
+    char compressed_filepath[1024];
+    write_compressed(compressed_filepath, sizeof(compressed_filepath), filepath, bytes, length);
+    CHECK(crashlog_header_read(compressed_filepath, &header));
+    CHECK(header.symbolicated);
+    free(bytes);
+
+    length = make_plist(&bytes, "\t<key>symbolicated</key>\n\t<false/>\n", 100);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(!header.symbolicated);
+    CHECK(header.symbolicated_is_known);
+    free(bytes);
+
+    // If the description is too long for the key to be reached, the state is
+    // not known.
+    length = make_plist(&bytes, "\t<key>symbolicated</key>\n\t<true/>\n", 5000);
+    CHECK(test_write_file(filepath, bytes, length));
+    CHECK(crashlog_header_read(filepath, &header));
+    CHECK(header.bug_type == CRASHLOG_HEADER_BUG_TYPE_CRASH);
+    CHECK(strcmp(header.name, "Mail & Co") == 0);
+    CHECK(!header.symbolicated_is_known);
+    free(bytes);
+}
+
+// NOTE: Compares reading the header with reading the whole file, which is the
+//       least that a full parse of the report must do.
+static void benchmark(const char *directory) {
+    static const unsigned kIterations = 200;
+
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "Large.ips");
+    char *bytes;
+    const size_t length = make_ips(&bytes, "", 20000);
+    CHECK(test_write_file(filepath, bytes, length));
+    free(bytes);
+
+    double start = test_time();
+    for (unsigned i = 0; i < kIterations; ++i) {
+        crashlog_header_t header;
+        CHECK(crashlog_header_read(filepath, &header));
+    }
+    const double header_time = (test_time() - start) / kIterations;
+
+    char *buffer = malloc(length);
+    start = test_time();
+    for (unsigned i = 0; i < kIterations; ++i) {
+        int fd = open(filepath, O_RDONLY);
+        CHECK(read(fd, buffer, length) == (ssize_t)length);
+        close(fd);
+    }
+    const double read_time = (test_time() - start) / kIterations;
+    free(buffer);
+
+    printf("Report of %zu KB: header %.1f us, whole file read %.1f us\n",
+        length / 1024, header_time * 1e6, read_time * 1e6);
+}
+
+int main(void) {
+    char *directory = test_make_directory("crashlog_header_test");
+    test_ips(directory);
+    test_plist(directory);
+    benchmark(directory);
+    test_remove_directory(directory);
+    return test_result("crashlog_header_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
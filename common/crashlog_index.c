@@ -0,0 +1,384 @@
+/**
+ * Desc: Persistent index of crash log metadata, keyed by filename and file
+ *       identity (inode, size, mtime), so that directory scans only need to
+ *       parse new or changed log files.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_index.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// NOTE: The index is a local cache; records are stored in native byte order.
+//       If the format changes, the version must be bumped, which causes any
+//       existing index to be discarded and rebuilt.
+static const char kIndexMagic[4] = {'C', 'R', 'I', 'X'};
+static const uint32_t kIndexVersion = 2;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} index_header_t;
+
+typedef struct {
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime;
+    int64_t log_date;
+    uint64_t fingerprint;
+    uint32_t bug_type;
+    uint32_t type;
+    uint32_t flags;
+    uint16_t filename_length;
+    uint16_t name_length;
+} index_record_t;
+
+typedef struct {
+    index_record_t record;
+    char *filename;
+    char *name;
+    int seen;
+    // NOTE: Set for the old entry of a renamed file; such entries are never
+    //       looked up or saved.
+    int removed;
+} index_entry_t;
+
+struct crashlog_index {
+    char *filepath;
+    index_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    // NOTE: Open-addressed hash table of (entry index + 1); zero marks an
+    //       empty slot.
+    size_t *slots;
+    size_t slot_count;
+    int dirty;
+};
+
+static uint32_t hash_string(const char *string) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)string; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t *find_slot(crashlog_index_t *index, const char *filename) {
+    const size_t mask = index->slot_count - 1;
+    size_t i = hash_string(filename) & mask;
+    while (index->slots[i] != 0) {
+        if (strcmp(index->entries[index->slots[i] - 1].filename, filename) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &index->slots[i];
+}
+
+static int rehash(crashlog_index_t *index, size_t slot_count) {
+    size_t *slots = calloc(slot_count, sizeof(size_t));
+    if (slots == NULL) {
+        return 0;
+    }
+
+    free(index->slots);
+    index->slots = slots;
+    index->slot_count = slot_count;
+    for (size_t i = 0; i < index->count; ++i) {
+        *find_slot(index, index->entries[i].filename) = i + 1;
+    }
+    return 1;
+}
+
+static index_entry_t *add_entry(crashlog_index_t *index, const char *filename) {
+    // Keep load factor of hash table below one half.
+    if (2 * (index->count + 1) > index->slot_count) {
+        if (!rehash(index, (index->slot_count != 0) ? (2 * index->slot_count) : 64)) {
+            return NULL;
+        }
+    }
+
+    if (index->count == index->capacity) {
+        size_t capacity = (index->capacity != 0) ? (2 * index->capacity) : 32;
+        index_entry_t *entries = realloc(index->entries, capacity * sizeof(index_entry_t));
+        if (entries == NULL) {
+            return NULL;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    char *copy = strdup(filename);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    index_entry_t *entry = &index->entries[index->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->filename = copy;
+    ++index->count;
+    *find_slot(index, filename) = index->count;
+    return entry;
+}
+
+static int identity_matches(const index_record_t *record, const struct stat *st) {
+    return
+        (record->inode == (uint64_t)st->st_ino) &&
+        (record->size == (uint64_t)st->st_size) &&
+        (record->mtime == (int64_t)st->st_mtime);
+}
+
+static char *read_string(FILE *f, uint16_t length) {
+    char *string = malloc(length + 1);
+    if (string != NULL) {
+        if (fread(string, 1, length, f) == length) {
+            string[length] = '\0';
+        } else {
+            free(string);
+            string = NULL;
+        }
+    }
+    return string;
+}
+
+static void load(crashlog_index_t *index) {
+    FILE *f = fopen(index->filepath, "r");
+    if (f == NULL) {
+        // NOTE: A missing index is not an error; it is created on save.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open crash log index \"%s\", errno = %d.\n", index->filepath, errno);
+        }
+        return;
+    }
+
+    index_header_t header;
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+            (memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0) ||
+            (header.version != kIndexVersion)) {
+        // Unknown or outdated format; index will be rebuilt.
+        index->dirty = 1;
+        goto exit;
+    }
+
+    for (uint32_t i = 0; i < header.count; ++i) {
+        index_record_t record;
+        if (fread(&record, sizeof(record), 1, f) != 1) {
+            goto corrupt;
+        }
+
+        char *filename = read_string(f, record.filename_length);
+        char *name = read_string(f, record.name_length);
+        if ((filename == NULL) || (name == NULL)) {
+            free(filename);
+            free(name);
+            goto corrupt;
+        }
+
+        index_entry_t *entry = add_entry(index, filename);
+        free(filename);
+        if (entry == NULL) {
+            free(name);
+            goto corrupt;
+        }
+        entry->record = record;
+        entry->name = name;
+    }
+    goto exit;
+
+corrupt:
+    fprintf(stderr, "WARNING: Crash log index \"%s\" is truncated or corrupt; discarding remaining entries.\n", index->filepath);
+    index->dirty = 1;
+
+exit:
+    fclose(f);
+}
+
+crashlog_index_t *crashlog_index_open(const char *filepath) {
+    crashlog_index_t *index = calloc(1, sizeof(crashlog_index_t));
+    if (index != NULL) {
+        index->filepath = strdup(filepath);
+        if ((index->filepath == NULL) || !rehash(index, 64)) {
+            crashlog_index_close(index);
+            return NULL;
+        }
+        load(index);
+    }
+    return index;
+}
+
+int crashlog_index_lookup(crashlog_index_t *index, const char *filename, const struct stat *st, crashlog_index_info_t *info) {
+    const size_t slot = *find_slot(index, filename);
+    if (slot != 0) {
+        index_entry_t *entry = &index->entries[slot - 1];
+        if (!entry->removed && identity_matches(&entry->record, st)) {
+            entry->seen = 1;
+            if (info != NULL) {
+                info->name = entry->name;
+                info->log_date = entry->record.log_date;
+                info->fingerprint = entry->record.fingerprint;
+                info->bug_type = entry->record.bug_type;
+                info->type = entry->record.type;
+                info->flags = entry->record.flags;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int crashlog_index_update(crashlog_index_t *index, const char *filename, const struct stat *st, const crashlog_index_info_t *info) {
+    const size_t filename_length = strlen(filename);
+    const size_t name_length = (info->name != NULL) ? strlen(info->name) : 0;
+    if ((filename_length > UINT16_MAX) || (name_length > UINT16_MAX)) {
+        return 0;
+    }
+
+    char *name = strdup((info->name != NULL) ? info->name : "");
+    if (name == NULL) {
+        return 0;
+    }
+
+    const size_t slot = *find_slot(index, filename);
+    index_entry_t *entry = (slot != 0) ? &index->entries[slot - 1] : add_entry(index, filename);
+    if (entry == NULL) {
+        free(name);
+        return 0;
+    }
+
+    free(entry->name);
+    entry->name = name;
+    entry->record.inode = st->st_ino;
+    entry->record.size = st->st_size;
+    entry->record.mtime = st->st_mtime;
+    entry->record.log_date = info->log_date;
+    entry->record.fingerprint = info->fingerprint;
+    entry->record.bug_type = info->bug_type;
+    entry->record.type = info->type;
+    entry->record.flags = info->flags;
+    entry->record.filename_length = filename_length;
+    entry->record.name_length = name_length;
+    entry->seen = 1;
+    entry->removed = 0;
+    index->dirty = 1;
+    return 1;
+}
+
+int crashlog_index_rename(crashlog_index_t *index, const char *filename, const char *new_filename,
+        const struct stat *old_st, const struct stat *new_st) {
+    const size_t slot = *find_slot(index, filename);
+    if ((slot == 0) || (strcmp(filename, new_filename) == 0)) {
+        return 0;
+    }
+    index_entry_t *entry = &index->entries[slot - 1];
+    if (entry->removed || !identity_matches(&entry->record, old_st)) {
+        return 0;
+    }
+
+    crashlog_index_info_t info;
+    info.name = entry->name;
+    info.log_date = entry->record.log_date;
+    info.fingerprint = entry->record.fingerprint;
+    info.bug_type = entry->record.bug_type;
+    info.type = entry->record.type;
+    info.flags = entry->record.flags;
+    if (!crashlog_index_update(index, new_filename, new_st, &info)) {
+        return 0;
+    }
+
+    // NOTE: The update may have moved the entries.
+    entry = &index->entries[slot - 1];
+    entry->seen = 0;
+    entry->removed = 1;
+    return 1;
+}
+
+void crashlog_index_keep_all(crashlog_index_t *index) {
+    for (size_t i = 0; i < index->count; ++i) {
+        if (!index->entries[i].removed) {
+            index->entries[i].seen = 1;
+        }
+    }
+}
+
+int crashlog_index_save(crashlog_index_t *index) {
+    // Entries that were neither looked up nor updated belong to files that no
+    // longer exist; they are dropped when the index is written.
+    uint32_t count = 0;
+    for (size_t i = 0; i < index->count; ++i) {
+        if (index->entries[i].seen) {
+            ++count;
+        }
+    }
+    if (!index->dirty && (count == index->count)) {
+        // Nothing has changed.
+        return 1;
+    }
+
+    // NOTE: Write to a temporary file and rename so that readers never see a
+    //       partially written index.
+    const size_t length = strlen(index->filepath) + 16;
+    char temp_filepath[length];
+    snprintf(temp_filepath, length, "%s.%d", index->filepath, (int)getpid());
+
+    FILE *f = fopen(temp_filepath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to write crash log index \"%s\", errno = %d.\n", temp_filepath, errno);
+        return 0;
+    }
+
+    index_header_t header;
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.count = count;
+    header.reserved = 0;
+    int succeeded = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    for (size_t i = 0; succeeded && (i < index->count); ++i) {
+        const index_entry_t *entry = &index->entries[i];
+        if (entry->seen) {
+            succeeded =
+                (fwrite(&entry->record, sizeof(entry->record), 1, f) == 1) &&
+                (fwrite(entry->filename, 1, entry->record.filename_length, f) == entry->record.filename_length) &&
+                (fwrite(entry->name, 1, entry->record.name_length, f) == entry->record.name_length);
+        }
+    }
+
+    if (fclose(f) != 0) {
+        succeeded = 0;
+    }
+    if (succeeded && (rename(temp_filepath, index->filepath) != 0)) {
+        succeeded = 0;
+    }
+    if (succeeded) {
+        index->dirty = 0;
+    } else {
+        fprintf(stderr, "ERROR: Failed to save crash log index \"%s\", errno = %d.\n", index->filepath, errno);
+        unlink(temp_filepath);
+    }
+    return succeeded;
+}
+
+void crashlog_index_close(crashlog_index_t *index) {
+    if (index != NULL) {
+        for (size_t i = 0; i < index->count; ++i) {
+            free(index->entries[i].filename);
+            free(index->entries[i].name);
+        }
+        free(index->entries);
+        free(index->slots);
+        free(index->filepath);
+        free(index);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,55 @@
+/**
+ * Desc: Persistent index of crash log metadata, keyed by filename and file
+ *       identity (inode, size, mtime), so that directory scans only need to
+ *       parse new or changed log files.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASHLOG_INDEX_H_
+#define COMMON_CRASHLOG_INDEX_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRASHLOG_INDEX_FLAG_SYMBOLICATED 0x1
+
+typedef struct crashlog_index crashlog_index_t;
+
+typedef struct {
+    const char *name;
+    int64_t log_date;
+    // NOTE: See crashlog_fingerprint.h.
+    uint64_t fingerprint;
+    uint32_t bug_type;
+    uint32_t type;
+    uint32_t flags;
+} crashlog_index_info_t;
+
+crashlog_index_t *crashlog_index_open(const char *filepath);
+int crashlog_index_lookup(crashlog_index_t *index, const char *filename, const struct stat *st, crashlog_index_info_t *info);
+int crashlog_index_update(crashlog_index_t *index, const char *filename, const struct stat *st, const crashlog_index_info_t *info);
+// NOTE: For a file that was replaced by another without its contents changing
+//       (e.g. when compressed); the metadata is kept if the entry matched the
+//       old identity. Returns zero if there was no such entry.
+int crashlog_index_rename(crashlog_index_t *index, const char *filename, const char *new_filename,
+        const struct stat *old_st, const struct stat *new_st);
+// NOTE: Keeps the entries that were not looked up when the index is saved;
+//       for updates made without scanning the whole directory.
+void crashlog_index_keep_all(crashlog_index_t *index);
+int crashlog_index_save(crashlog_index_t *index);
+void crashlog_index_close(crashlog_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASHLOG_INDEX_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,194 @@
+/**
+ * Desc: Test of the crash log index: scans a synthetic log directory the way
+ *       the app does, and checks that only new or changed logs are parsed.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_index.h"
+
+#include <dirent.h>
+
+#include "crashlog_header.h"
+#include "log_compression.h"
+#include "test_util.h"
+
+static const unsigned kLogCount = 200;
+
+static int has_suffix(const char *string, const char *suffix) {
+    const size_t length = strlen(string);
+    const size_t suffix_length = strlen(suffix);
+    return (length >= suffix_length) && (strcmp(string + length - suffix_length, suffix) == 0);
+}
+
+static void log_filename(char *buffer, size_t size, unsigned i) {
+    snprintf(buffer, size, "Process%u-2016-01-%02u-%06u.ips", i % 10, 1 + (i % 28), i);
+}
+
+static void write_log(const char *directory, unsigned i, const char *extra) {
+    char filename[256];
+    log_filename(filename, sizeof(filename), i);
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "%s", filename);
+
+    char contents[1024];
+    const int length = snprintf(contents, sizeof(contents),
+        "{\"app_name\":\"Process%u\",\"timestamp\":\"2016-01-%02u 12:00:%02u.00 +0900\",\"bug_type\":\"%d\",\"name\":\"Process%u\"}\n"
+        "Incident Identifier: %u\n"
+        "Process:             Process%u [%u]\n"
+        "Path:                /Applications/Process%u.app/Process%u\n"
+        "Date/Time:           2016-01-%02u 12:00:%02u.00 +0900\n"
+        "%s"
+        "Exception Type:  EXC_BAD_ACCESS (SIGSEGV)\n",
+        i % 10, 1 + (i % 28), i % 60, (i % 7 == 0) ? 198 : 109, i % 10,
+        i, i % 10, 100 + i, i % 10, i % 10, 1 + (i % 28), i % 60, extra);
+    CHECK(test_write_file(filepath, contents, length));
+}
+
+// NOTE: Mirrors crashLogGroupsForDirectory() in the app; returns the number of
+//       logs that had to be parsed.
+static unsigned scan(const char *directory, const char *index_path, unsigned *log_count) {
+    unsigned parse_count = 0;
+    *log_count = 0;
+
+    crashlog_index_t *index = crashlog_index_open(index_path);
+    CHECK(index != NULL);
+
+    DIR *dir = opendir(directory);
+    CHECK(dir != NULL);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!has_suffix(entry->d_name, ".ips") && !has_suffix(entry->d_name, ".ips." kCompressedPathExtension)) {
+            continue;
+        }
+
+        char filepath[1024];
+        test_path(filepath, sizeof(filepath), directory, "%s", entry->d_name);
+        struct stat st;
+        CHECK(stat(filepath, &st) == 0);
+
+        crashlog_index_info_t info;
+        if (!crashlog_index_lookup(index, entry->d_name, &st, &info)) {
+            crashlog_header_t header;
+            CHECK(crashlog_header_read(filepath, &header));
+            ++parse_count;
+
+            info.name = header.name;
+            info.log_date = 0;
+            info.fingerprint = 0;
+            info.bug_type = header.bug_type;
+            info.type = 0;
+            info.flags = header.symbolicated ? CRASHLOG_INDEX_FLAG_SYMBOLICATED : 0;
+            CHECK(crashlog_index_update(index, entry->d_name, &st, &info));
+            CHECK(crashlog_index_lookup(index, entry->d_name, &st, &info));
+        }
+        CHECK(strncmp(info.name, "Process", 7) == 0);
+        CHECK((info.bug_type == 109) || (info.bug_type == 198));
+        ++*log_count;
+    }
+    closedir(dir);
+
+    CHECK(crashlog_index_save(index));
+    crashlog_index_close(index);
+    return parse_count;
+}
+
+int main(void) {
+    char *directory = test_make_directory("crashlog_index_test");
+    char index_path[1024];
+    test_path(index_path, sizeof(index_path), directory, "index.bin");
+
+    for (unsigned i = 0; i < kLogCount; ++i) {
+        write_log(directory, i, "");
+    }
+
+    // First scan parses every log.
+    unsigned log_count;
+    double start = test_time();
+    CHECK(scan(directory, index_path, &log_count) == kLogCount);
+    const double first_time = test_time() - start;
+    CHECK(log_count == kLogCount);
+
+    // Later scans parse nothing.
+    start = test_time();
+    CHECK(scan(directory, index_path, &log_count) == 0);
+    const double second_time = test_time() - start;
+    CHECK(log_count == kLogCount);
+
+    // A changed log is parsed again; a new log is parsed.
+    write_log(directory, 3, "Crashed Thread:  0\n");
+    write_log(directory, kLogCount, "");
+    CHECK(scan(directory, index_path, &log_count) == 2);
+    CHECK(log_count == kLogCount + 1);
+
+    // Entries for deleted logs are dropped when the index is saved.
+    char filename[256];
+    log_filename(filename, sizeof(filename), 5);
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "%s", filename);
+    struct stat st;
+    CHECK(stat(filepath, &st) == 0);
+    CHECK(unlink(filepath) == 0);
+    CHECK(scan(directory, index_path, &log_count) == 0);
+    CHECK(log_count == kLogCount);
+    crashlog_index_t *index = crashlog_index_open(index_path);
+    CHECK(!crashlog_index_lookup(index, filename, &st, NULL));
+    crashlog_index_close(index);
+
+    // A compressed log keeps its entry, under its new name; the old entry is
+    // dropped, even if all entries are kept.
+    log_filename(filename, sizeof(filename), 7);
+    test_path(filepath, sizeof(filepath), directory, "%s", filename);
+    char compressed_filename[264];
+    snprintf(compressed_filename, sizeof(compressed_filename), "%s." kCompressedPathExtension, filename);
+    char compressed_filepath[1024];
+    test_path(compressed_filepath, sizeof(compressed_filepath), directory, "%s", compressed_filename);
+    int fd = open(filepath, O_RDONLY);
+    FILE *f = fopen(compressed_filepath, "w");
+    CHECK((fd >= 0) && (f != NULL));
+    CHECK(log_compression_compress_fd(fd, f));
+    fclose(f);
+    close(fd);
+    struct stat compressed_st;
+    CHECK(stat(filepath, &st) == 0);
+    CHECK(stat(compressed_filepath, &compressed_st) == 0);
+    CHECK(unlink(filepath) == 0);
+
+    index = crashlog_index_open(index_path);
+    CHECK(!crashlog_index_rename(index, filename, compressed_filename, &compressed_st, &compressed_st));
+    CHECK(crashlog_index_rename(index, filename, compressed_filename, &st, &compressed_st));
+    CHECK(!crashlog_index_rename(index, filename, compressed_filename, &st, &compressed_st));
+    CHECK(!crashlog_index_lookup(index, filename, &st, NULL));
+    crashlog_index_keep_all(index);
+    CHECK(crashlog_index_save(index));
+    crashlog_index_close(index);
+    CHECK(scan(directory, index_path, &log_count) == 0);
+    CHECK(log_count == kLogCount);
+    index = crashlog_index_open(index_path);
+    CHECK(!crashlog_index_lookup(index, filename, &st, NULL));
+    crashlog_index_info_t info;
+    CHECK(crashlog_index_lookup(index, compressed_filename, &compressed_st, &info));
+    CHECK(strcmp(info.name, "Process7") == 0);
+    crashlog_index_close(index);
+
+    // Entries of a truncated index are kept up to the truncated one.
+    struct stat index_st;
+    CHECK(stat(index_path, &index_st) == 0);
+    CHECK(truncate(index_path, index_st.st_size - 7) == 0);
+    CHECK(scan(directory, index_path, &log_count) == 1);
+
+    // An index of another format is discarded, and rebuilt.
+    CHECK(test_write_file(index_path, "CRIX", 4));
+    const unsigned parse_count = scan(directory, index_path, &log_count);
+    CHECK(parse_count == log_count);
+    CHECK(scan(directory, index_path, &log_count) == 0);
+
+    printf("Scan of %u logs: %.2f ms without index, %.2f ms with index\n",
+        kLogCount, first_time * 1000.0, second_time * 1000.0);
+
+    test_remove_directory(directory);
+    return test_result("crashlog_index_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
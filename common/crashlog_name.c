@@ -0,0 +1,100 @@
+/**
+ * Desc: Parser for the filenames of crash log files.
+ *
+ *       Extracts the process name and the date and time of the crash without
+ *       allocating memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_name.h"
+
+#include <string.h>
+
+// NOTE: Length of the "YYYY-MM-DD-HHMMSS" portion of the filename.
+#define kDateTimeLength 17
+
+static int parse_digits(const char *string, size_t count, int *value) {
+    int result = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const char c = string[i];
+        if ((c < '0') || (c > '9')) {
+            return 0;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *value = result;
+    return 1;
+}
+
+static int parse_date_time(const char *string, uint64_t *timestamp) {
+    int year, month, day, hour, minute, second;
+    if (
+            !parse_digits(&string[0], 4, &year) || (string[4] != '-') ||
+            !parse_digits(&string[5], 2, &month) || (string[7] != '-') ||
+            !parse_digits(&string[8], 2, &day) || (string[10] != '-') ||
+            !parse_digits(&string[11], 2, &hour) ||
+            !parse_digits(&string[13], 2, &minute) ||
+            !parse_digits(&string[15], 2, &second)
+       ) {
+        return 0;
+    }
+
+    // NOTE: Values that cannot be packed cannot belong to a valid date.
+    if ((month > 0xf) || (day > 0x1f) || (hour > 0x1f) || (minute > 0x3f) || (second > 0x3f)) {
+        return 0;
+    }
+
+    *timestamp =
+        ((uint64_t)year << 26) |
+        ((uint64_t)month << 22) |
+        ((uint64_t)day << 17) |
+        ((uint64_t)hour << 12) |
+        ((uint64_t)minute << 6) |
+        (uint64_t)second;
+    return 1;
+}
+
+int crashlog_name_parse(const char *filename, crashlog_name_format_t format, crashlog_name_t *result) {
+    // Ignore path extensions.
+    // NOTE: Everything from the first period onward is ignored; a period at
+    //       the very start does not begin an extension.
+    const char *period = (filename[0] != '\0') ? strchr(&filename[1], '.') : NULL;
+    size_t length = (period != NULL) ? (size_t)(period - filename) : strlen(filename);
+
+    if (format == CRASHLOG_NAME_FORMAT_PRE_9_3) {
+        // Strip device name, which follows the last underscore.
+        size_t i = length;
+        while ((i > 0) && (filename[i - 1] != '_')) {
+            --i;
+        }
+        if ((i == 0) || (i == length)) {
+            // No underscore, or empty device name.
+            return 0;
+        }
+        length = i - 1;
+    }
+
+    // Name must be followed by a separator, the date and time, and must not be
+    // empty.
+    if (length < (kDateTimeLength + 2)) {
+        return 0;
+    }
+    const size_t name_length = length - kDateTimeLength - 1;
+    const char separator = (format == CRASHLOG_NAME_FORMAT_PRE_9_3) ? '_' : '-';
+    if (filename[name_length] != separator) {
+        return 0;
+    }
+
+    uint64_t timestamp;
+    if (!parse_date_time(&filename[name_length + 1], &timestamp)) {
+        return 0;
+    }
+
+    result->name_length = name_length;
+    result->timestamp = timestamp;
+    return 1;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,51 @@
+/**
+ * Desc: Parser for the filenames of crash log files.
+ *
+ *       Extracts the process name and the date and time of the crash without
+ *       allocating memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_CRASHLOG_NAME_H_
+#define COMMON_CRASHLOG_NAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    // iOS < 9.3: appname_YYYY-MM-DD-HHMMSS_devicename
+    CRASHLOG_NAME_FORMAT_PRE_9_3,
+    // iOS >= 9.3: appname-YYYY-MM-DD-HHMMSS
+    CRASHLOG_NAME_FORMAT_9_3
+} crashlog_name_format_t;
+
+// NOTE: The timestamp is packed so that comparing two packed values compares
+//       the dates and times they represent.
+#define CRASHLOG_NAME_TIMESTAMP_YEAR(t)   ((int)((t) >> 26))
+#define CRASHLOG_NAME_TIMESTAMP_MONTH(t)  ((int)(((t) >> 22) & 0xf))
+#define CRASHLOG_NAME_TIMESTAMP_DAY(t)    ((int)(((t) >> 17) & 0x1f))
+#define CRASHLOG_NAME_TIMESTAMP_HOUR(t)   ((int)(((t) >> 12) & 0x1f))
+#define CRASHLOG_NAME_TIMESTAMP_MINUTE(t) ((int)(((t) >> 6) & 0x3f))
+#define CRASHLOG_NAME_TIMESTAMP_SECOND(t) ((int)((t) & 0x3f))
+
+typedef struct {
+    // NOTE: The name always starts at the beginning of the filename.
+    size_t name_length;
+    uint64_t timestamp;
+} crashlog_name_t;
+
+int crashlog_name_parse(const char *filename, crashlog_name_format_t format, crashlog_name_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CRASHLOG_NAME_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,226 @@
+/**
+ * Desc: Fuzz test and benchmark of the crash log filename parser.
+ *
+ *       Filenames are compared against the regular expressions that the parser
+ *       replaced (here evaluated with POSIX regex instead of ICU).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "crashlog_name.h"
+
+#include <regex.h>
+
+#include "test_util.h"
+
+static const char * const kRegexLogNameDatePre93 =
+    "^(.+)_([0-9]{4})-([0-9]{2})-([0-9]{2})-([0-9]{2})([0-9]{2})([0-9]{2})_[^_]+$";
+static const char * const kRegexLogNameDate =
+    "^(.+)-([0-9]{4})-([0-9]{2})-([0-9]{2})-([0-9]{2})([0-9]{2})([0-9]{2})$";
+
+static const unsigned kFuzzIterations = 200000;
+static const unsigned kBenchmarkIterations = 200000;
+
+static void compile_regex(regex_t *regex, crashlog_name_format_t format) {
+    const char *pattern = (format == CRASHLOG_NAME_FORMAT_PRE_9_3) ? kRegexLogNameDatePre93 : kRegexLogNameDate;
+    if (regcomp(regex, pattern, REG_EXTENDED) != 0) {
+        fprintf(stderr, "ERROR: Failed to compile regular expression.\n");
+        exit(1);
+    }
+}
+
+static int int_from_match(const char *string, const regmatch_t *match) {
+    int value = 0;
+    for (regoff_t i = match->rm_so; i < match->rm_eo; ++i) {
+        value = value * 10 + (string[i] - '0');
+    }
+    return value;
+}
+
+// NOTE: Mirrors the regex-based parsing that the app used to do; path
+//       extensions are removed before matching.
+static int reference_parse(regex_t *regex, const char *filename, int *name_length, int fields[6]) {
+    char basename[256];
+    snprintf(basename, sizeof(basename), "%s", filename);
+    char *period = (basename[0] != '\0') ? strchr(&basename[1], '.') : NULL;
+    if (period != NULL) {
+        *period = '\0';
+    }
+
+    regmatch_t matches[8];
+    if (regexec(regex, basename, 8, matches, 0) != 0) {
+        return 0;
+    }
+    *name_length = matches[1].rm_eo;
+    for (unsigned i = 0; i < 6; ++i) {
+        fields[i] = int_from_match(basename, &matches[2 + i]);
+    }
+    return 1;
+}
+
+static void check_known(void) {
+    crashlog_name_t parsed;
+
+    CHECK(crashlog_name_parse("MobileSafari-2016-03-01-100203.ips", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    CHECK(parsed.name_length == 12);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_YEAR(parsed.timestamp) == 2016);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_MONTH(parsed.timestamp) == 3);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_DAY(parsed.timestamp) == 1);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_HOUR(parsed.timestamp) == 10);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_MINUTE(parsed.timestamp) == 2);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_SECOND(parsed.timestamp) == 3);
+
+    // Names may contain the separator.
+    CHECK(crashlog_name_parse("Web-Content-2016-03-01-100203.ips.synced", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    CHECK(parsed.name_length == 11);
+
+    CHECK(crashlog_name_parse("Mail_2012-03-01-100203_My-iPhone.plist", CRASHLOG_NAME_FORMAT_PRE_9_3, &parsed));
+    CHECK(parsed.name_length == 4);
+    CHECK(CRASHLOG_NAME_TIMESTAMP_YEAR(parsed.timestamp) == 2012);
+
+    // Packed timestamps compare in date order.
+    crashlog_name_t later;
+    CHECK(crashlog_name_parse("Mail_2012-03-01-100204_My-iPhone.plist", CRASHLOG_NAME_FORMAT_PRE_9_3, &later));
+    CHECK(later.timestamp > parsed.timestamp);
+
+    CHECK(!crashlog_name_parse("", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    CHECK(!crashlog_name_parse("-2016-03-01-100203.ips", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    CHECK(!crashlog_name_parse("Mail-2016-03-01-10020.ips", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    CHECK(!crashlog_name_parse("Mail-2016-03-01-100203.ips", CRASHLOG_NAME_FORMAT_PRE_9_3, &parsed));
+    CHECK(!crashlog_name_parse("Mail_2012-03-01-100203_.plist", CRASHLOG_NAME_FORMAT_PRE_9_3, &parsed));
+    CHECK(!crashlog_name_parse("LatestCrash.plist", CRASHLOG_NAME_FORMAT_9_3, &parsed));
+}
+
+// NOTE: Random filenames are mostly built from valid pieces, so that both
+//       matching and almost-matching names are common.
+static size_t random_filename(char *buffer, size_t size, crashlog_name_format_t format) {
+    static const char kAlphabet[] = "ab_-0123456789.";
+    static const char * const kExtensions[] = {"", ".ips", ".plist", ".ips.synced", ".", ".beta"};
+    const char separator = (format == CRASHLOG_NAME_FORMAT_PRE_9_3) ? '_' : '-';
+
+    size_t length = 0;
+    const unsigned name_length = rand() % 6;
+    for (unsigned i = 0; i < name_length; ++i) {
+        buffer[length++] = "Ab_-9"[rand() % 5];
+    }
+    if (rand() % 8 != 0) {
+        buffer[length++] = separator;
+    }
+    length += snprintf(buffer + length, size - length, "%04d-%02d-%02d-%02d%02d%02d",
+        rand() % 10000, rand() % 20, rand() % 40, rand() % 40, rand() % 70, rand() % 70);
+    if (format == CRASHLOG_NAME_FORMAT_PRE_9_3) {
+        length += snprintf(buffer + length, size - length, "%s", (rand() % 4 != 0) ? "_iPhone" : "_");
+    }
+    length += snprintf(buffer + length, size - length, "%s", kExtensions[rand() % 6]);
+
+    // Mutate a few characters, drop the tail, or both.
+    const unsigned mutations = rand() % 3;
+    for (unsigned i = 0; (i < mutations) && (length > 0); ++i) {
+        buffer[rand() % length] = kAlphabet[rand() % (sizeof(kAlphabet) - 1)];
+    }
+    if ((length > 0) && (rand() % 8 == 0)) {
+        length = rand() % length;
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+static void fuzz(crashlog_name_format_t format) {
+    regex_t regex;
+    compile_regex(&regex, format);
+
+    unsigned match_count = 0;
+    for (unsigned i = 0; i < kFuzzIterations; ++i) {
+        char buffer[128];
+        const size_t length = random_filename(buffer, sizeof(buffer), format);
+
+        // NOTE: Parse an exactly-sized copy so that reads past the end of the
+        //       string can be caught by tools such as valgrind.
+        char *filename = malloc(length + 1);
+        memcpy(filename, buffer, length + 1);
+
+        crashlog_name_t parsed;
+        const int result = crashlog_name_parse(filename, format, &parsed);
+
+        int name_length;
+        int fields[6];
+        if (reference_parse(&regex, filename, &name_length, fields)) {
+            // NOTE: Values that cannot be packed are rejected by the parser
+            //       only.
+            const int packable = (fields[1] <= 0xf) && (fields[2] <= 0x1f) &&
+                (fields[3] <= 0x1f) && (fields[4] <= 0x3f) && (fields[5] <= 0x3f);
+            if (result != packable) {
+                fprintf(stderr, "Mismatch for \"%s\": parser %d, regex 1\n", filename, result);
+            }
+            CHECK(result == packable);
+            if (result && packable) {
+                CHECK(parsed.name_length == (size_t)name_length);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_YEAR(parsed.timestamp) == fields[0]);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_MONTH(parsed.timestamp) == fields[1]);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_DAY(parsed.timestamp) == fields[2]);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_HOUR(parsed.timestamp) == fields[3]);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_MINUTE(parsed.timestamp) == fields[4]);
+                CHECK(CRASHLOG_NAME_TIMESTAMP_SECOND(parsed.timestamp) == fields[5]);
+                ++match_count;
+            }
+        } else {
+            if (result) {
+                fprintf(stderr, "Mismatch for \"%s\": parser 1, regex 0\n", filename);
+            }
+            CHECK(!result);
+        }
+
+        free(filename);
+    }
+    regfree(&regex);
+
+    // NOTE: Make sure that the fuzzer exercises the matching path.
+    CHECK(match_count > kFuzzIterations / 10);
+}
+
+// NOTE: The app used to compile the regular expression for each log.
+static void benchmark(void) {
+    static const char * const kFilename = "MobileSafari-2016-03-01-100203.ips.synced";
+    crashlog_name_t parsed;
+    int name_length;
+    int fields[6];
+
+    double start = test_time();
+    for (unsigned i = 0; i < kBenchmarkIterations; ++i) {
+        CHECK(crashlog_name_parse(kFilename, CRASHLOG_NAME_FORMAT_9_3, &parsed));
+    }
+    const double parse_time = (test_time() - start) / kBenchmarkIterations;
+
+    regex_t regex;
+    compile_regex(&regex, CRASHLOG_NAME_FORMAT_9_3);
+    start = test_time();
+    for (unsigned i = 0; i < kBenchmarkIterations; ++i) {
+        CHECK(reference_parse(&regex, kFilename, &name_length, fields));
+    }
+    const double match_time = (test_time() - start) / kBenchmarkIterations;
+    regfree(&regex);
+
+    const unsigned compile_iterations = kBenchmarkIterations / 10;
+    start = test_time();
+    for (unsigned i = 0; i < compile_iterations; ++i) {
+        compile_regex(&regex, CRASHLOG_NAME_FORMAT_9_3);
+        CHECK(reference_parse(&regex, kFilename, &name_length, fields));
+        regfree(&regex);
+    }
+    const double compile_time = (test_time() - start) / compile_iterations;
+
+    printf("Filename parse: %.3f us; regex match %.3f us, compile and match %.3f us\n",
+        parse_time * 1e6, match_time * 1e6, compile_time * 1e6);
+}
+
+int main(int argc, char **argv) {
+    srand((argc > 1) ? (unsigned)atoi(argv[1]) : 1);
+    check_known();
+    fuzz(CRASHLOG_NAME_FORMAT_9_3);
+    fuzz(CRASHLOG_NAME_FORMAT_PRE_9_3);
+    benchmark();
+    return test_result("crashlog_name_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -6,14 +6,38 @@
  * License: GPL v3 (See LICENSE file for details)
  */
 
+#include <stdio.h>
+#include "crashlog_fingerprint.h"
+#include "crashlog_header.h"
+
+@class CRBinaryImage;
 @class CRCrashReport;
 
+NSString *compressFile(NSString *filepath);
+BOOL fileIsCompressed(NSString *filepath);
 BOOL fileIsSymbolicated(NSString *filepath, CRCrashReport *report);
 NSData *dataForFile(NSString *filepath);
+BOOL isCrashLogFilename(NSString *filename);
+BOOL headerForFile(NSString *filepath, crashlog_header_t *header);
+BOOL fingerprintForFile(NSString *filepath, uint64_t *fingerprint);
+NSArray *unsymbolicatedFilesInDirectory(NSString *directory);
+BOOL createSymbolicLink(NSString *linkPath, NSString *filename);
 BOOL deleteFile(NSString *filepath);
+BOOL deleteFiles(NSArray *filepaths, void (^progress)(NSUInteger deletedCount));
 BOOL fixFileOwnershipAndPermissions(NSString *filepath);
+void getBlameResults(CRCrashReport *report, CRBinaryImage **victim, NSArray **suspects, NSArray **potentialSuspects);
+void getSymbolCacheStatistics(uint64_t *hits, uint64_t *misses);
+NSString *indexPathForDirectory(NSString *directory);
+BOOL readSummaryForFile(NSString *filepath, CRBinaryImage **victim, NSArray **suspects, NSArray **potentialSuspects, NSDictionary **processInfo);
+void replaceSymbolicLink(NSString *linkPath, NSString *oldDestPath, NSString *newDestPath);
+NSString *summaryDirectoryForDirectory(NSString *directory);
+NSString *summaryPathForFile(NSString *filepath);
 NSString *symbolicateFile(NSString *filepath, CRCrashReport *report);
+NSUInteger symbolicateFiles(NSArray *filepaths, NSUInteger threadCount, void (^progress)(NSString *filepath, NSString *outputFilepath));
 NSString *syslogPathForFile(NSString *filepath);
+NSString *uncompressedPathForFile(NSString *filepath);
 BOOL writeToFile(NSString *string, NSString *outputFilepath);
+BOOL writeStreamToFile(NSString *outputFilepath, BOOL (^writer)(FILE *stream));
+BOOL writeSummaryForFile(NSString *filepath, CRBinaryImage *victim, NSArray *suspects, NSArray *potentialSuspects, NSDictionary *processInfo);
 
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
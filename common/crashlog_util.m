@@ -9,9 +9,53 @@
 #import "crashlog_util.h"
 
 #import <libcrashreport/libcrashreport.h>
+#import <libpackageinfo/libpackageinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include "exec_as_root.h"
+#include "log_compression.h"
+#include "paths.h"
+#include "report_summary.h"
+#include "symbol_cache.h"
+#include "symbol_table.h"
+
+// NOTE: These interfaces are provided by libcrashreport and libsymbolicate, but
+//       are not declared in libcrashreport.h. Their availability is checked at
+//       runtime; if they are missing, the cache is simply not used.
+@protocol CRSymbolCacheThread <NSObject>
+@property(nonatomic, readonly) NSArray *stackFrames;
+@end
+
+@protocol CRSymbolCacheStackFrame <NSObject>
+@property(nonatomic, readonly) uint64_t address;
+@property(nonatomic, readonly) uint64_t imageAddress;
+@property(nonatomic, retain) id symbolInfo;
+@end
+
+@protocol CRSymbolCacheSymbolInfo <NSObject>
+@property(nonatomic, assign) uint64_t address;
+@property(nonatomic, copy) NSString *name;
+@property(nonatomic, copy) NSString *sourcePath;
+@property(nonatomic, assign) NSUInteger sourceLineNumber;
+@end
+
+@interface CRCrashReport (SymbolCache)
+@property(nonatomic, readonly) NSArray *threads;
+@end
+
+// NOTE: As above, for restoring the packages of the images of a summary.
+@interface CRBinaryImage (Summary)
+- (void)setPackage:(PIPackage *)package;
+@end
+
+@interface PIDebianPackage (Summary)
++ (instancetype)packageWithIdentifier:(NSString *)identifier;
+@end
 
 static const char * const kTemporaryFilepath = "/tmp/CrashReporter.temp.XXXXXX";
 
@@ -28,20 +72,32 @@ BOOL fileIsSymbolicated(NSString *filepath, CRCrashReport *report) {
     //      symbolicated if the name of the crashed process includes the text
     //      ".symbolicated.". The chance of such a process existing, though, is
     //      considered to be low enough that code for this has not been added.
+    NSString *path = filepath;
     NSString *pathExtension = nil;
     do {
         // NOTE: This assumes that symbolicated files have a specific extension,
         //       which may not be the case if the file was symbolicated by a
         //       tool other than CrashReporter.
-        pathExtension = [filepath pathExtension];
+        pathExtension = [path pathExtension];
         if ([pathExtension isEqualToString:@"symbolicated"]) {
             isSymbolicated = YES;
             break;
         }
-        filepath = [filepath stringByDeletingPathExtension];
+        path = [path stringByDeletingPathExtension];
     } while ([pathExtension length] > 0);
 
     if (!isSymbolicated) {
+        // If no report was passed, check the header of the log file first.
+        // NOTE: This avoids loading and parsing the entire report.
+        // NOTE: If the end of the header was not reached, only a positive
+        //       result can be trusted.
+        if (report == nil) {
+            crashlog_header_t header;
+            if (headerForFile(filepath, &header) && (header.symbolicated || header.symbolicated_is_known)) {
+                return (header.symbolicated != 0);
+            }
+        }
+
         // Load crash report if necessary.
         BOOL needsRelease = NO;
         if (report == nil) {
@@ -53,6 +109,7 @@ BOOL fileIsSymbolicated(NSString *filepath, CRCrashReport *report) {
                 if (report != nil) {
                     needsRelease = YES;
                 }
+                [data release];
             }
         }
 
@@ -68,13 +125,145 @@ BOOL fileIsSymbolicated(NSString *filepath, CRCrashReport *report) {
     return isSymbolicated;
 }
 
+// NOTE: Files at or above this size are memory-mapped rather than read into
+//       memory; mapped pages are backed by the file and can be discarded by
+//       the system under memory pressure.
+static const off_t kMappedDataThreshold = 64 * 1024;
+
+// NOTE: Files modified more recently than this (in seconds) are read rather
+//       than mapped, as they may still be being written (see
+//       createDataForFileDescriptor()).
+static const time_t kMappedDataSettleInterval = 30;
+
+@interface MappedData : NSData {
+    void *bytes_;
+    NSUInteger length_;
+}
+- (instancetype)initWithMappedBytes:(void *)bytes length:(NSUInteger)length;
+@end
+
+@implementation MappedData
+
+- (instancetype)initWithMappedBytes:(void *)bytes length:(NSUInteger)length {
+    self = [super init];
+    if (self != nil) {
+        bytes_ = bytes;
+        length_ = length;
+    } else {
+        munmap(bytes, length);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    munmap(bytes_, length_);
+    [super dealloc];
+}
+
+- (const void *)bytes {
+    return bytes_;
+}
+
+- (NSUInteger)length {
+    return length_;
+}
+
+@end
+
+// NOTE: Text logs typically compress to between a fifth and a tenth of their
+//       size; used only to size the initial buffer.
+static const off_t kExpectedCompressionRatio = 8;
+
+static NSData *createDataForCompressedFileDescriptor(int fd, NSString *filepath, off_t size) {
+    log_reader_t *reader = log_reader_open(fd);
+    if (reader == NULL) {
+        fprintf(stderr, "ERROR: Unable to decompress \"%s\".\n", [filepath UTF8String]);
+        return nil;
+    }
+
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:(size * kExpectedCompressionRatio)];
+    char buffer[16384];
+    ssize_t count;
+    while ((count = log_reader_read(reader, buffer, sizeof(buffer))) > 0) {
+        [data appendBytes:buffer length:count];
+    }
+    if (count < 0) {
+        fprintf(stderr, "ERROR: Unable to decompress \"%s\".\n", [filepath UTF8String]);
+        [data release];
+        data = nil;
+    }
+    log_reader_close(reader);
+    return data;
+}
+
+// NOTE: If isPrivateCopy is set, the file is a temporary copy made by this
+//       process, which nothing else modifies.
+static NSData *createDataForFileDescriptor(int fd, NSString *filepath, BOOL isPrivateCopy) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "ERROR: Unable to determine size of \"%s\", errno = %d.\n", [filepath UTF8String], errno);
+        return nil;
+    }
+
+    // Decompress aged logs (see compressFile()).
+    // NOTE: The decompressed contents are not backed by a file, and so are
+    //       always read into memory.
+    if (fileIsCompressed(filepath)) {
+        return createDataForCompressedFileDescriptor(fd, filepath, st.st_size);
+    }
+
+    // Map large files whose modification time has settled.
+    // NOTE: CrashReporter itself replaces files via rename, but on iOS < 9.3
+    //       ReportCrash writes (and may truncate and rewrite) crash log files
+    //       in place. Accessing a page of a mapping beyond the end of a file
+    //       that has since been truncated raises SIGBUS, so files that may
+    //       still be being written are read instead.
+    const BOOL isSettled = isPrivateCopy || (time(NULL) - st.st_mtime >= kMappedDataSettleInterval);
+    if ((st.st_size >= kMappedDataThreshold) && isSettled) {
+        void *bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (bytes != MAP_FAILED) {
+            madvise(bytes, st.st_size, MADV_SEQUENTIAL);
+            return [[MappedData alloc] initWithMappedBytes:bytes length:st.st_size];
+        }
+        fprintf(stderr, "WARNING: Unable to map \"%s\", errno = %d; reading instead.\n", [filepath UTF8String], errno);
+    }
+
+    // Read small (or recently modified) files.
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:st.st_size];
+    char buffer[16384];
+    ssize_t count;
+    while (((count = read(fd, buffer, sizeof(buffer))) > 0) || ((count < 0) && (errno == EINTR))) {
+        if (count > 0) {
+            [data appendBytes:buffer length:count];
+        }
+    }
+    if (count < 0) {
+        fprintf(stderr, "ERROR: Unable to load data from \"%s\", errno = %d.\n", [filepath UTF8String], errno);
+        [data release];
+        data = nil;
+    }
+    return data;
+}
+
 NSData *dataForFile(NSString *filepath) {
     NSData *data = nil;
 
-    // If filepath is not readable, copy to temporary file.
-    NSString *tempFilepath = nil;
+    // If filepath is not readable, have the as_root tool open the file.
+    // NOTE: The open file descriptor is passed back from the tool, avoiding
+    //       the need to copy the file.
+    int fd = open([filepath fileSystemRepresentation], O_RDONLY);
+    if ((fd < 0) && (errno == EACCES)) {
+        fd = open_as_root([filepath UTF8String]);
+    }
+    if (fd >= 0) {
+        data = createDataForFileDescriptor(fd, filepath, NO);
+        close(fd);
+        return data;
+    }
+
+    // If filepath is still not readable, copy to temporary file.
     NSFileManager *fileMan = [NSFileManager defaultManager];
-    if (![fileMan isReadableFileAtPath:filepath]) {
+    if ([fileMan fileExistsAtPath:filepath]) {
         // Copy file to temporary file.
         char path[strlen(kTemporaryFilepath) + 1 ];
         memcpy(path, kTemporaryFilepath, sizeof(path));
@@ -88,24 +277,127 @@ NSData *dataForFile(NSString *filepath) {
             return nil;
         }
 
-        tempFilepath = [[NSString alloc] initWithCString:path encoding:NSUTF8StringEncoding];
+        // Load file data.
+        fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            data = createDataForFileDescriptor(fd, filepath, YES);
+            close(fd);
+        } else {
+            fprintf(stderr, "ERROR: Unable to load data from \"%s\", errno = %d.\n", path, errno);
+        }
+
+        // Delete temporary file.
+        // NOTE: A mapping remains valid after the file is deleted.
+        deleteFile([NSString stringWithCString:path encoding:NSUTF8StringEncoding]);
+    } else {
+        fprintf(stderr, "ERROR: Unable to load data from \"%s\": file does not exist.\n", [filepath UTF8String]);
     }
 
-    // Load file data.
-    NSError *error = nil;
-    data = [[NSData alloc] initWithContentsOfFile:(tempFilepath ?: filepath) options:0 error:&error];
-    if (data == nil) {
-        fprintf(stderr, "ERROR: Unable to load data from \"%s\": \"%s\".\n",
-                [(tempFilepath ?: filepath) UTF8String], [[error localizedDescription] UTF8String]);
+    return data;
+}
+
+BOOL headerForFile(NSString *filepath, crashlog_header_t *header) {
+    const char *path = [filepath fileSystemRepresentation];
+    if (access(path, R_OK) == 0) {
+        return crashlog_header_read(path, header);
     }
 
-    // Delete temporary file, if necessary.
-    if (tempFilepath != nil) {
-        deleteFile(tempFilepath);
-        [tempFilepath release];
+    // If filepath is not readable, have the as_root tool open the file.
+    // NOTE: If this fails, the caller is expected to fall back to loading the
+    //       full report via dataForFile().
+    BOOL didRead = NO;
+    int fd = open_as_root([filepath UTF8String]);
+    if (fd >= 0) {
+        didRead = crashlog_header_read_fd(fd, header);
+        close(fd);
     }
+    return didRead;
+}
 
-    return data;
+BOOL fingerprintForFile(NSString *filepath, uint64_t *fingerprint) {
+    const char *path = [filepath fileSystemRepresentation];
+    if (access(path, R_OK) == 0) {
+        return crashlog_fingerprint_read(path, fingerprint);
+    }
+
+    // If filepath is not readable, have the as_root tool open the file.
+    BOOL didRead = NO;
+    int fd = open_as_root([filepath UTF8String]);
+    if (fd >= 0) {
+        didRead = crashlog_fingerprint_read_fd(fd, fingerprint);
+        close(fd);
+    } else {
+        *fingerprint = CRASHLOG_FINGERPRINT_NONE;
+    }
+    return didRead;
+}
+
+BOOL fileIsCompressed(NSString *filepath) {
+    return [[filepath pathExtension] isEqualToString:@kCompressedPathExtension];
+}
+
+NSString *uncompressedPathForFile(NSString *filepath) {
+    return fileIsCompressed(filepath) ? [filepath stringByDeletingPathExtension] : filepath;
+}
+
+// NOTE: The compressed copy is written alongside the file, as
+//       "<filename>.gz", and the file is then deleted. The modification time is
+//       kept, so that the age of the log does not change.
+// NOTE: Returns the path of the compressed copy, or nil on failure.
+NSString *compressFile(NSString *filepath) {
+    if (fileIsCompressed(filepath)) {
+        return filepath;
+    }
+
+    int fd = open([filepath fileSystemRepresentation], O_RDONLY);
+    if ((fd < 0) && (errno == EACCES)) {
+        fd = open_as_root([filepath UTF8String]);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Unable to open \"%s\" for compression.\n", [filepath UTF8String]);
+        return nil;
+    }
+
+    NSString *outputFilepath = [filepath stringByAppendingPathExtension:@kCompressedPathExtension];
+    BOOL didCompress = NO;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "ERROR: Unable to determine attributes of \"%s\", errno = %d.\n", [filepath UTF8String], errno);
+    } else {
+        didCompress = writeStreamToFile(outputFilepath, ^BOOL(FILE *stream) {
+            if (!log_compression_compress_fd(fd, stream) || (fflush(stream) != 0)) {
+                return NO;
+            }
+
+            struct timeval times[2];
+            times[0].tv_sec = st.st_atime;
+            times[0].tv_usec = 0;
+            times[1].tv_sec = st.st_mtime;
+            times[1].tv_usec = 0;
+            futimes(fileno(stream), times);
+            return YES;
+        });
+    }
+    close(fd);
+
+    if (didCompress) {
+        // NOTE: The file may have been replaced (e.g. by symbolication) while
+        //       it was being compressed; the copy is then stale.
+        struct stat current;
+        if ((stat([filepath fileSystemRepresentation], &current) != 0) || (current.st_ino != st.st_ino) ||
+                (current.st_mtime != st.st_mtime)) {
+            deleteFile(outputFilepath);
+            didCompress = NO;
+        } else if (!deleteFile(filepath)) {
+            // NOTE: Keep the original rather than have both appear as logs.
+            deleteFile(outputFilepath);
+            didCompress = NO;
+        } else {
+            fixFileOwnershipAndPermissions(outputFilepath);
+        }
+    }
+
+    return didCompress ? outputFilepath : nil;
 }
 
 BOOL deleteFile(NSString *filepath) {
@@ -124,6 +416,67 @@ BOOL deleteFile(NSString *filepath) {
     return didDelete;
 }
 
+// NOTE: The as_root server limits the size of a request (see as_root.c);
+//       larger batches are split.
+static const size_t kMaxDeleteRequestSize = 512 * 1024;
+
+// NOTE: Files that do not exist are considered deleted.
+BOOL deleteFiles(NSArray *filepaths, void (^progress)(NSUInteger deletedCount)) {
+    BOOL didDelete = YES;
+
+    // Delete the files that can be deleted without the as_root tool.
+    NSMutableArray *remainingFilepaths = [NSMutableArray array];
+    NSUInteger deletedCount = 0;
+    for (NSString *filepath in filepaths) {
+        if ((unlink([filepath fileSystemRepresentation]) == 0) || (errno == ENOENT)) {
+            ++deletedCount;
+            if ((progress != nil) && ((deletedCount % 64) == 0)) {
+                progress(deletedCount);
+            }
+        } else {
+            [remainingFilepaths addObject:filepath];
+        }
+    }
+
+    // Try again using as_root tool.
+    // NOTE: All remaining files are deleted with a single request (unless
+    //       there are thousands of them).
+    const unsigned count = [remainingFilepaths count];
+    if (count > 0) {
+        const char **paths = malloc(count * sizeof(char *));
+        if (paths != NULL) {
+            for (unsigned i = 0; i < count; ++i) {
+                paths[i] = [[remainingFilepaths objectAtIndex:i] fileSystemRepresentation];
+            }
+            unsigned start = 0;
+            while (start < count) {
+                unsigned end = start;
+                size_t size = 0;
+                do {
+                    size += strlen(paths[end]) + 1;
+                    ++end;
+                } while ((end < count) && (size + strlen(paths[end]) + 1 <= kMaxDeleteRequestSize));
+
+                if (delete_as_root_batch(&paths[start], end - start)) {
+                    deletedCount += end - start;
+                } else {
+                    fprintf(stderr, "WARNING: Unable to delete one or more of %u files.\n", end - start);
+                    didDelete = NO;
+                }
+                start = end;
+            }
+            free(paths);
+        } else {
+            didDelete = NO;
+        }
+    }
+
+    if (progress != nil) {
+        progress(deletedCount);
+    }
+    return didDelete;
+}
+
 BOOL fixFileOwnershipAndPermissions(NSString *filepath) {
     BOOL didFix = NO;
 
@@ -163,7 +516,35 @@ BOOL fixFileOwnershipAndPermissions(NSString *filepath) {
     return didFix;
 }
 
-static void replaceSymbolicLink(NSString *linkPath, NSString *oldDestPath, NSString *newDestPath) {
+// NOTE: Creates the link, replacing any existing link atomically: the new link
+//       is created under a temporary name and moved into place. If the new
+//       link cannot be created, the existing link is kept.
+// NOTE: The destination is a filename, relative to the link.
+BOOL createSymbolicLink(NSString *linkPath, NSString *filename) {
+    NSString *tempPath = [NSString stringWithFormat:@"%@.%d.temp", linkPath, getpid()];
+    const char *temp_path = [tempPath fileSystemRepresentation];
+    const char *link_path = [linkPath fileSystemRepresentation];
+    if (symlink([filename fileSystemRepresentation], temp_path) == 0) {
+        if (rename(temp_path, link_path) == 0) {
+            fixFileOwnershipAndPermissions(linkPath);
+            return YES;
+        }
+        unlink(temp_path);
+    }
+
+    // Try again using as_root tool.
+    // NOTE: Links in the log directory of root cannot be created by mobile.
+    if (link_as_root([filename fileSystemRepresentation], link_path)) {
+        fixFileOwnershipAndPermissions(linkPath);
+        return YES;
+    }
+    fprintf(stderr, "ERROR: Failed to create \"%s\" symbolic link, errno = %d.\n",
+        [[linkPath lastPathComponent] UTF8String], errno);
+    return NO;
+}
+
+// NOTE: Destination paths are relative to the link.
+void replaceSymbolicLink(NSString *linkPath, NSString *oldDestPath, NSString *newDestPath) {
     // NOTE: Must check the destination of the links, as the links may have
     //       been updated since this tool began executing.
     NSFileManager *fileMan = [NSFileManager defaultManager];
@@ -171,27 +552,612 @@ static void replaceSymbolicLink(NSString *linkPath, NSString *oldDestPath, NSStr
     NSString *destPath = [fileMan destinationOfSymbolicLinkAtPath:linkPath error:&error];
     if (destPath != nil) {
         if ([destPath isEqualToString:oldDestPath]) {
-            // Remove old link.
-            if (deleteFile(linkPath)) {
-                // Create new link.
-                if ([fileMan createSymbolicLinkAtPath:linkPath withDestinationPath:newDestPath error:&error]) {
-                    fixFileOwnershipAndPermissions(linkPath);
+            // Replace old link.
+            createSymbolicLink(linkPath, newDestPath);
+        }
+    } else {
+        fprintf(stderr, "ERROR: Failed to determine destination of \"%s\" symbolic link: %s.\n",
+            [[linkPath lastPathComponent] UTF8String], [[error localizedDescription] UTF8String]);
+    }
+}
+
+// NOTE: Limits the size of the cache file to roughly a few megabytes.
+static const size_t kSymbolCacheMaxEntries = 32768;
+
+// NOTE: Each open symbol table keeps its file mapped; only the most recently
+//       used tables are kept open.
+static const NSUInteger kSymbolTablesMaxOpen = 32;
+
+static symbol_cache_t *symbolCache$ = NULL;
+static pthread_mutex_t symbolCacheLock$ = PTHREAD_MUTEX_INITIALIZER;
+
+static NSMutableDictionary *symbolTables$ = nil;
+static NSMutableArray *symbolTableKeys$ = nil;
+static NSMutableSet *symbolTablesOpening$ = nil;
+static pthread_mutex_t symbolTablesLock$ = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t symbolTablesCondition$ = PTHREAD_COND_INITIALIZER;
+
+// NOTE: The cache is loaded once; lookups and updates require the lock.
+static symbol_cache_t *symbolCache() {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        // NOTE: The cache is shared by the app (running as mobile) and by
+        //       notifier (running as root); the directory must be owned by
+        //       mobile.
+        NSDictionary *attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+            @"mobile", NSFileOwnerAccountName, @"mobile", NSFileGroupOwnerAccountName, nil];
+        [[NSFileManager defaultManager] createDirectoryAtPath:@kCacheDirectory withIntermediateDirectories:YES attributes:attributes error:NULL];
+        symbolCache$ = symbol_cache_open(kSymbolCacheFilepath, kSymbolCacheMaxEntries);
+    });
+    return symbolCache$;
+}
+
+static BOOL canUseSymbolCache() {
+    static BOOL canUse;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        canUse =
+            [CRCrashReport instancesRespondToSelector:@selector(threads)] &&
+            [CRBinaryImage instancesRespondToSelector:@selector(uuid)] &&
+            [NSClassFromString(@"CRStackFrame") instancesRespondToSelector:@selector(setSymbolInfo:)] &&
+            (NSClassFromString(@"SCSymbolInfo") != nil);
+    });
+    return canUse;
+}
+
+typedef struct {
+    uint8_t uuid[16];
+    BOOL hasUUID;
+    uint64_t address;
+    const char *path;
+} image_key_t;
+
+// NOTE: Calls the given block for each stack frame. The UUID is NULL for frames
+//       that cannot be cached: imagePath is then non-NULL if the frame belongs
+//       to a binary image of the report that has no UUID (and so could still
+//       be symbolicated), or NULL if it belongs to no known image.
+static void enumerateStackFrames(CRCrashReport *report, void (^block)(id<CRSymbolCacheStackFrame> stackFrame, const uint8_t uuid[16], uint64_t offset, const char *imagePath, BOOL *stop)) {
+    // Determine the UUID for each binary image, keyed by load address.
+    NSArray *binaryImages = [[report binaryImages] allValues];
+    const NSUInteger imageCount = [binaryImages count];
+    image_key_t *images = malloc(imageCount * sizeof(image_key_t));
+    if (images == NULL) {
+        return;
+    }
+    NSUInteger count = 0;
+    for (CRBinaryImage *binaryImage in binaryImages) {
+        NSString *uuid = [binaryImage uuid];
+        images[count].hasUUID = (uuid != nil) && symbol_cache_parse_uuid([uuid UTF8String], images[count].uuid);
+        images[count].address = [binaryImage address];
+        images[count].path = [[binaryImage path] UTF8String] ?: "";
+        ++count;
+    }
+
+    BOOL stop = NO;
+    for (id<CRSymbolCacheThread> thread in [report threads]) {
+        for (id<CRSymbolCacheStackFrame> stackFrame in [thread stackFrames]) {
+            const uint64_t imageAddress = [stackFrame imageAddress];
+            const uint64_t address = [stackFrame address];
+            const image_key_t *image = NULL;
+            for (NSUInteger i = 0; i < count; ++i) {
+                if (images[i].address == imageAddress) {
+                    image = &images[i];
+                    break;
+                }
+            }
+
+            if ((image != NULL) && (address >= imageAddress)) {
+                if (image->hasUUID) {
+                    block(stackFrame, image->uuid, address - imageAddress, image->path, &stop);
                 } else {
-                    fprintf(stderr, "ERROR: Failed to create \"%s\" symbolic link: %s.\n",
-                        [[linkPath lastPathComponent] UTF8String], [[error localizedDescription] UTF8String]);
+                    block(stackFrame, NULL, 0, image->path, &stop);
                 }
+            } else {
+                block(stackFrame, NULL, 0, NULL, &stop);
+            }
+            if (stop) {
+                goto exit;
             }
         }
+    }
+
+exit:
+    free(images);
+}
+
+// NOTE: Symbol tables are built from the binaries themselves, and so are only
+//       available for images that exist as separate files (i.e. not for those
+//       in the shared cache) and that have not been stripped.
+static symbol_table_t *openSymbolTable(const uint8_t uuid[16], NSString *key, const char *imagePath) {
+    NSString *filepath = [NSString stringWithFormat:@"%s/%@.symtab", kSymbolTableDirectory, key];
+    symbol_table_t *table = symbol_table_open([filepath UTF8String], uuid);
+    if ((table == NULL) && (imagePath != NULL)) {
+        NSDictionary *attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+            @"mobile", NSFileOwnerAccountName, @"mobile", NSFileGroupOwnerAccountName, nil];
+        [[NSFileManager defaultManager] createDirectoryAtPath:@kSymbolTableDirectory withIntermediateDirectories:YES attributes:attributes error:NULL];
+        if (symbol_table_build_for_binary(imagePath, uuid, [filepath UTF8String])) {
+            fixFileOwnershipAndPermissions(filepath);
+            table = symbol_table_open([filepath UTF8String], uuid);
+        }
+    }
+    return table;
+}
+
+// NOTE: Must be called with the lock held.
+static id addSymbolTable(NSString *key, symbol_table_t *table) {
+    // NOTE: Images without a table are remembered so that building is not
+    //       attempted again by this process.
+    id object = (table != NULL) ? [NSValue valueWithPointer:table] : [NSNull null];
+    [symbolTables$ setObject:object forKey:key];
+    [symbolTableKeys$ addObject:key];
+
+    // Close the least recently used table.
+    if ([symbolTableKeys$ count] > kSymbolTablesMaxOpen) {
+        NSString *oldKey = [symbolTableKeys$ objectAtIndex:0];
+        id oldObject = [symbolTables$ objectForKey:oldKey];
+        if (oldObject != [NSNull null]) {
+            symbol_table_close([oldObject pointerValue]);
+        }
+        [symbolTables$ removeObjectForKey:oldKey];
+        [symbolTableKeys$ removeObjectAtIndex:0];
+    }
+    return object;
+}
+
+// NOTE: Only the lookup itself is done with the lock held; tables are opened
+//       (and built if necessary, which reads the whole binary) without it.
+//       The name is copied, as the table may be closed once the lock is
+//       released.
+static BOOL lookUpSymbolInTable(const uint8_t uuid[16], const char *imagePath, uint64_t offset, NSString **name, uint64_t *symbolOffset) {
+    char uuidString[33];
+    for (unsigned i = 0; i < 16; ++i) {
+        snprintf(&uuidString[2 * i], 3, "%02x", uuid[i]);
+    }
+    NSString *key = [NSString stringWithUTF8String:uuidString];
+
+    BOOL found = NO;
+    pthread_mutex_lock(&symbolTablesLock$);
+    if (symbolTables$ == nil) {
+        symbolTables$ = [[NSMutableDictionary alloc] init];
+        symbolTableKeys$ = [[NSMutableArray alloc] init];
+        symbolTablesOpening$ = [[NSMutableSet alloc] init];
+    }
+
+    // Wait for any other thread that is opening the same table.
+    while ([symbolTablesOpening$ containsObject:key]) {
+        pthread_cond_wait(&symbolTablesCondition$, &symbolTablesLock$);
+    }
+
+    id object = [symbolTables$ objectForKey:key];
+    if (object != nil) {
+        // Mark as most recently used.
+        [symbolTableKeys$ removeObject:key];
+        [symbolTableKeys$ addObject:key];
     } else {
-        fprintf(stderr, "ERROR: Failed to determine destination of \"%s\" symbolic link: %s.\n",
-            [[linkPath lastPathComponent] UTF8String], [[error localizedDescription] UTF8String]);
+        [symbolTablesOpening$ addObject:key];
+        pthread_mutex_unlock(&symbolTablesLock$);
+        symbol_table_t *table = openSymbolTable(uuid, key, imagePath);
+        pthread_mutex_lock(&symbolTablesLock$);
+        [symbolTablesOpening$ removeObject:key];
+        pthread_cond_broadcast(&symbolTablesCondition$);
+        object = addSymbolTable(key, table);
     }
+
+    if (object != [NSNull null]) {
+        const char *symbolName;
+        if (symbol_table_lookup([object pointerValue], offset, &symbolName, symbolOffset)) {
+            *name = [NSString stringWithUTF8String:symbolName];
+            found = YES;
+        }
+    }
+    pthread_mutex_unlock(&symbolTablesLock$);
+
+    return found;
+}
+
+static id symbolInfoForStackFrame(id<CRSymbolCacheStackFrame> stackFrame, const symbol_cache_info_t *info) {
+    if (info->name == NULL) {
+        return [NSNull null];
+    }
+
+    id<CRSymbolCacheSymbolInfo> symbolInfo = [[[NSClassFromString(@"SCSymbolInfo") alloc] init] autorelease];
+    [symbolInfo setAddress:([stackFrame address] - info->symbol_offset)];
+    [symbolInfo setName:[NSString stringWithUTF8String:info->name]];
+    if (info->source_path != NULL) {
+        [symbolInfo setSourcePath:[NSString stringWithUTF8String:info->source_path]];
+        [symbolInfo setSourceLineNumber:info->source_line];
+    }
+    return symbolInfo;
+}
+
+// NOTE: Returns YES only if every stack frame was resolved from the cache (or
+//       from the symbol tables of the images), in which case there is no need
+//       to symbolicate the report.
+// NOTE: Frames of images without a UUID cannot be cached; such a frame counts
+//       as a miss (as libsymbolicate may still be able to resolve it). Frames
+//       that belong to no known image cannot be resolved at all, and are
+//       skipped.
+// NOTE: Only lookups and updates are done with the cache locked; results are
+//       copied, as entries may be evicted once the lock is released.
+static BOOL applyCachedSymbols(CRCrashReport *report) {
+    if (!canUseSymbolCache()) {
+        return NO;
+    }
+
+    symbol_cache_t *cache = symbolCache();
+    if (cache == NULL) {
+        return NO;
+    }
+
+    __block BOOL isComplete = YES;
+    NSMutableArray *resolved = [[NSMutableArray alloc] init];
+    NSMutableIndexSet *unresolved = [[NSMutableIndexSet alloc] init];
+
+    pthread_mutex_lock(&symbolCacheLock$);
+    // NOTE: Entries used by this report are more recent than those used by
+    //       earlier reports.
+    symbol_cache_next_generation(cache);
+    enumerateStackFrames(report, ^(id<CRSymbolCacheStackFrame> stackFrame, const uint8_t uuid[16], uint64_t offset, const char *imagePath, BOOL *stop) {
+        if (uuid == NULL) {
+            if (imagePath != NULL) {
+                // NOTE: The report must be symbolicated; there is no need to
+                //       look up the remaining frames.
+                isComplete = NO;
+                *stop = YES;
+            }
+            return;
+        }
+
+        symbol_cache_info_t info;
+        if (symbol_cache_lookup(cache, uuid, offset, &info)) {
+            [resolved addObject:symbolInfoForStackFrame(stackFrame, &info)];
+        } else {
+            [unresolved addIndex:[resolved count]];
+            [resolved addObject:[NSNull null]];
+        }
+    });
+    pthread_mutex_unlock(&symbolCacheLock$);
+
+    // Try the symbol tables of the images.
+    // NOTE: Frames that can be resolved are added to the cache even if others
+    //       cannot, so that the work is not repeated.
+    if (isComplete && ([unresolved count] != 0)) {
+        __block NSUInteger i = 0;
+        enumerateStackFrames(report, ^(id<CRSymbolCacheStackFrame> stackFrame, const uint8_t uuid[16], uint64_t offset, const char *imagePath, BOOL *stop) {
+            if (uuid == NULL) {
+                return;
+            }
+
+            const NSUInteger index = i++;
+            if (![unresolved containsIndex:index]) {
+                return;
+            }
+
+            NSString *name = nil;
+            uint64_t symbolOffset = 0;
+            if (!lookUpSymbolInTable(uuid, imagePath, offset, &name, &symbolOffset)) {
+                isComplete = NO;
+                return;
+            }
+
+            symbol_cache_info_t info = {[name UTF8String], NULL, 0, symbolOffset};
+            pthread_mutex_lock(&symbolCacheLock$);
+            symbol_cache_update(cache, uuid, offset, &info);
+            pthread_mutex_unlock(&symbolCacheLock$);
+            [resolved replaceObjectAtIndex:index withObject:symbolInfoForStackFrame(stackFrame, &info)];
+        });
+    }
+
+    // NOTE: Frames are only updated if all of them could be resolved, so that
+    //       a report is never left partially symbolicated.
+    if (isComplete) {
+        __block NSUInteger i = 0;
+        enumerateStackFrames(report, ^(id<CRSymbolCacheStackFrame> stackFrame, const uint8_t uuid[16], uint64_t offset, const char *imagePath, BOOL *stop) {
+            if (uuid != NULL) {
+                id symbolInfo = [resolved objectAtIndex:i++];
+                [stackFrame setSymbolInfo:((symbolInfo != [NSNull null]) ? symbolInfo : nil)];
+            }
+        });
+    }
+    [unresolved release];
+    [resolved release];
+
+    return isComplete;
+}
+
+// NOTE: -[CRCrashReport symbolicate] records that the report is symbolicated in
+//       its "symbolicated" property, which is included in the output (and is
+//       checked by fileIsSymbolicated()); reports symbolicated from the cache
+//       must be marked the same way. Returns NO if the report could not be
+//       marked.
+static BOOL markReportAsSymbolicated(CRCrashReport *report) {
+    @try {
+        [(NSMutableDictionary *)[report properties] setObject:[NSNumber numberWithBool:YES] forKey:@"symbolicated"];
+    } @catch (NSException *exception) {
+        return NO;
+    }
+    return [report isSymbolicated];
+}
+
+static void addSymbolsToCache(CRCrashReport *report) {
+    if (!canUseSymbolCache()) {
+        return;
+    }
+
+    symbol_cache_t *cache = symbolCache();
+    if (cache != NULL) {
+        pthread_mutex_lock(&symbolCacheLock$);
+        enumerateStackFrames(report, ^(id<CRSymbolCacheStackFrame> stackFrame, const uint8_t uuid[16], uint64_t offset, const char *imagePath, BOOL *stop) {
+            if (uuid != NULL) {
+                symbol_cache_info_t info = {NULL, NULL, 0, 0};
+                id<CRSymbolCacheSymbolInfo> symbolInfo = [stackFrame symbolInfo];
+                if (symbolInfo != nil) {
+                    info.name = [[symbolInfo name] UTF8String];
+                    info.source_path = [[symbolInfo sourcePath] UTF8String];
+                    info.source_line = [symbolInfo sourceLineNumber];
+                    info.symbol_offset = [stackFrame address] - [symbolInfo address];
+                }
+                symbol_cache_update(cache, uuid, offset, &info);
+            }
+        });
+        pthread_mutex_unlock(&symbolCacheLock$);
+    }
+}
+
+// NOTE: Saving merges the cache with the file (see symbol_cache_save()), and
+//       so requires the lock; files symbolicated by symbolicateFiles() are
+//       therefore not saved one by one, but once all have been processed.
+static void saveSymbolCache() {
+    if (!canUseSymbolCache()) {
+        return;
+    }
+
+    symbol_cache_t *cache = symbolCache();
+    if (cache != NULL) {
+        pthread_mutex_lock(&symbolCacheLock$);
+        const BOOL didSave = symbol_cache_save(cache);
+        pthread_mutex_unlock(&symbolCacheLock$);
+        if (didSave) {
+            fixFileOwnershipAndPermissions(@kSymbolCacheFilepath);
+        }
+    }
+}
+
+void getSymbolCacheStatistics(uint64_t *hits, uint64_t *misses) {
+    pthread_mutex_lock(&symbolCacheLock$);
+    if (symbolCache$ != NULL) {
+        symbol_cache_get_stats(symbolCache$, hits, misses);
+    } else {
+        *hits = 0;
+        *misses = 0;
+    }
+    pthread_mutex_unlock(&symbolCacheLock$);
+}
+
+static NSInteger compareBinaryImagePaths(CRBinaryImage *binaryImage1, CRBinaryImage *binaryImage2, void *context) {
+    NSString *name1 = [[binaryImage1 path] lastPathComponent];
+    NSString *name2 = [[binaryImage2 path] lastPathComponent];
+    return [name1 compare:name2];
+}
+
+// NOTE: The report must have been blamed. Suspects are in order of blame;
+//       potential suspects are sorted by name.
+void getBlameResults(CRCrashReport *report, CRBinaryImage **victim, NSArray **suspects, NSArray **potentialSuspects) {
+    // Determine path for victim.
+    NSString *victimPath = [[report processInfo] objectForKey:@"Path"];
+
+    // Collect victim and potential suspects.
+    CRBinaryImage *victimImage = nil;
+    NSMutableDictionary *blamableBinaries = [[NSMutableDictionary alloc] init];
+    for (CRBinaryImage *binaryImage in [[report binaryImages] allValues]) {
+        NSString *path = [binaryImage path];
+        if ([path isEqualToString:victimPath]) {
+            NSCAssert(victimImage == nil, @"ERROR: Two binary images have the exact same path.");
+            victimImage = binaryImage;
+        } else if ([binaryImage isBlamable]) {
+            // Filter out trusted packages.
+            NSString *identifier = binaryImage.package.identifier;
+            if (![identifier isEqualToString:@"mobilesubstrate"] && ![identifier isEqualToString:@"crash-reporter"]) {
+                [blamableBinaries setObject:binaryImage forKey:path];
+            }
+        }
+    }
+
+    // Collect suspects.
+    NSMutableArray *suspectImages = [NSMutableArray array];
+    NSArray *suspectPaths = [[report properties] objectForKey:kCrashReportBlame];
+    for (NSString *suspectPath in suspectPaths) {
+        CRBinaryImage *binaryImage = [blamableBinaries objectForKey:suspectPath];
+        if (binaryImage != nil) {
+            [suspectImages addObject:binaryImage];
+            [blamableBinaries removeObjectForKey:suspectPath];
+        }
+    }
+
+    // Collect potential suspects.
+    *potentialSuspects = [[blamableBinaries allValues] sortedArrayUsingFunction:compareBinaryImagePaths context:NULL];
+    [blamableBinaries release];
+
+    // Ensure that we at least have information for the victim.
+    // NOTE: Some reports do not contain binary image information.
+    if (victimImage == nil) {
+        victimImage = [[[CRBinaryImage alloc] initWithPath:victimPath address:0 size:0 architecture:nil uuid:nil] autorelease];
+    }
+
+    *victim = victimImage;
+    *suspects = suspectImages;
+}
+
+// NOTE: Summaries are kept in the (mobile-writable) cache directory rather
+//       than beside the logs, which may be owned by root.
+NSString *summaryDirectoryForDirectory(NSString *directory) {
+    NSString *name = [[directory stringByReplacingOccurrencesOfString:@"/" withString:@"_"] stringByAppendingPathExtension:@"summaries"];
+    return [@kCacheDirectory stringByAppendingPathComponent:name];
+}
+
+// NOTE: The summary of a compressed log (see compressFile()) is that of the
+//       original log.
+NSString *summaryPathForFile(NSString *filepath) {
+    NSString *directory = summaryDirectoryForDirectory([filepath stringByDeletingLastPathComponent]);
+    return [directory stringByAppendingPathComponent:[uncompressedPathForFile(filepath) lastPathComponent]];
+}
+
+static void setSummaryImage(report_summary_image_t *image, CRBinaryImage *binaryImage) {
+    image->path = [[binaryImage path] UTF8String];
+    image->address = [binaryImage address];
+    image->size = [binaryImage size];
+    image->architecture = [[binaryImage architecture] UTF8String];
+    image->uuid = [[binaryImage uuid] UTF8String];
+    image->package_identifier = [[[binaryImage package] identifier] UTF8String];
+}
+
+// NOTE: Packages installed by dpkg are found by identifier, which avoids
+//       searching the lists of installed files; others (e.g. App Store apps)
+//       are found by file.
+static PIPackage *packageForSummaryImage(const report_summary_image_t *image, NSString *path) {
+    NSString *identifier = [NSString stringWithUTF8String:image->package_identifier];
+    if (identifier == nil) {
+        return nil;
+    }
+
+    PIPackage *package = nil;
+    if ([PIDebianPackage respondsToSelector:@selector(packageWithIdentifier:)]) {
+        package = [PIDebianPackage packageWithIdentifier:identifier];
+    }
+    if ((package == nil) && (path != nil)) {
+        package = [PIPackage packageForFile:path];
+        if (![[package identifier] isEqualToString:identifier]) {
+            package = nil;
+        }
+    }
+    return package;
+}
+
+static CRBinaryImage *createBinaryImageForSummaryImage(const report_summary_image_t *image) {
+    NSString *path = (image->path != NULL) ? [NSString stringWithUTF8String:image->path] : nil;
+    NSString *architecture = (image->architecture != NULL) ? [NSString stringWithUTF8String:image->architecture] : nil;
+    NSString *uuid = (image->uuid != NULL) ? [NSString stringWithUTF8String:image->uuid] : nil;
+    CRBinaryImage *binaryImage = [[CRBinaryImage alloc] initWithPath:path address:image->address size:image->size architecture:architecture uuid:uuid];
+
+    // NOTE: The package is shown with the image, and is used to filter out
+    //       trusted packages; it must be restored along with the image.
+    if ((binaryImage != nil) && (image->package_identifier != NULL) &&
+            [binaryImage respondsToSelector:@selector(setPackage:)]) {
+        [binaryImage setPackage:packageForSummaryImage(image, path)];
+    }
+    return binaryImage;
+}
+
+static NSArray *binaryImagesForSummaryImages(const report_summary_image_t *images, uint32_t count) {
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+    for (uint32_t i = 0; i < count; ++i) {
+        CRBinaryImage *binaryImage = createBinaryImageForSummaryImage(&images[i]);
+        if (binaryImage != nil) {
+            [array addObject:binaryImage];
+            [binaryImage release];
+        }
+    }
+    return array;
+}
+
+BOOL writeSummaryForFile(NSString *filepath, CRBinaryImage *victim, NSArray *suspects, NSArray *potentialSuspects, NSDictionary *processInfo) {
+    struct stat st;
+    if (stat([filepath fileSystemRepresentation], &st) != 0) {
+        return NO;
+    }
+
+    const NSUInteger suspectCount = [suspects count];
+    const NSUInteger potentialSuspectCount = [potentialSuspects count];
+    const NSUInteger processInfoCount = [processInfo count];
+    report_summary_image_t images[suspectCount + potentialSuspectCount + 1];
+    report_summary_pair_t pairs[processInfoCount + 1];
+
+    report_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.log_mtime = st.st_mtime;
+    if (victim != nil) {
+        summary.has_victim = 1;
+        setSummaryImage(&summary.victim, victim);
+    }
+    summary.suspects = images;
+    for (CRBinaryImage *binaryImage in suspects) {
+        setSummaryImage(&summary.suspects[summary.suspect_count++], binaryImage);
+    }
+    summary.potential_suspects = images + suspectCount;
+    for (CRBinaryImage *binaryImage in potentialSuspects) {
+        setSummaryImage(&summary.potential_suspects[summary.potential_suspect_count++], binaryImage);
+    }
+    summary.process_info = pairs;
+    for (NSString *key in processInfo) {
+        id value = [processInfo objectForKey:key];
+        if ([key isKindOfClass:[NSString class]] && [value isKindOfClass:[NSString class]]) {
+            pairs[summary.process_info_count].key = [key UTF8String];
+            pairs[summary.process_info_count].value = [value UTF8String];
+            ++summary.process_info_count;
+        }
+    }
+
+    // NOTE: The directory is shared with the app; it must be owned by mobile.
+    NSString *summaryPath = summaryPathForFile(filepath);
+    NSDictionary *attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+        @"mobile", NSFileOwnerAccountName, @"mobile", NSFileGroupOwnerAccountName, nil];
+    [[NSFileManager defaultManager] createDirectoryAtPath:[summaryPath stringByDeletingLastPathComponent]
+        withIntermediateDirectories:YES attributes:attributes error:NULL];
+
+    const BOOL didWrite = writeStreamToFile(summaryPath, ^BOOL(FILE *stream) {
+        return report_summary_write(stream, &summary);
+    });
+    if (didWrite) {
+        fixFileOwnershipAndPermissions(summaryPath);
+    }
+    return didWrite;
+}
+
+// NOTE: Returns NO if there is no summary, or if the log has been replaced
+//       since the summary was written. Only the modification time is
+//       compared, as compression (see compressFile()) replaces the log without
+//       changing its modification time.
+BOOL readSummaryForFile(NSString *filepath, CRBinaryImage **victim, NSArray **suspects, NSArray **potentialSuspects, NSDictionary **processInfo) {
+    struct stat st;
+    if (stat([filepath fileSystemRepresentation], &st) != 0) {
+        return NO;
+    }
+
+    report_summary_t *summary = report_summary_read([summaryPathForFile(filepath) fileSystemRepresentation]);
+    if (summary == NULL) {
+        return NO;
+    }
+
+    BOOL didRead = NO;
+    if (summary->log_mtime == (int64_t)st.st_mtime) {
+        *victim = summary->has_victim ? [createBinaryImageForSummaryImage(&summary->victim) autorelease] : nil;
+        *suspects = binaryImagesForSummaryImages(summary->suspects, summary->suspect_count);
+        *potentialSuspects = binaryImagesForSummaryImages(summary->potential_suspects, summary->potential_suspect_count);
+
+        NSMutableDictionary *dictionary = [NSMutableDictionary dictionaryWithCapacity:summary->process_info_count];
+        for (uint32_t i = 0; i < summary->process_info_count; ++i) {
+            const report_summary_pair_t *pair = &summary->process_info[i];
+            if ((pair->key != NULL) && (pair->value != NULL)) {
+                NSString *key = [NSString stringWithUTF8String:pair->key];
+                NSString *value = [NSString stringWithUTF8String:pair->value];
+                if ((key != nil) && (value != nil)) {
+                    [dictionary setObject:value forKey:key];
+                }
+            }
+        }
+        *processInfo = dictionary;
+        didRead = YES;
+    }
+    report_summary_free(summary);
+
+    return didRead;
 }
 
 // NOTE: This functions expects any passed report object to have been loaded
 //       with filter type CRCrashReportFilterTypePackage.
 // FIXME: Ensure that this is the case.
-NSString *symbolicateFile(NSString *filepath, CRCrashReport *report) {
+// NOTE: The symbol cache is not saved (see saveSymbolCache()).
+static NSString *symbolicateFileWithoutSavingCache(NSString *filepath, CRCrashReport *report) {
     NSString *outputFilepath = nil;
 
     // Load crash report if necessary.
@@ -205,18 +1171,30 @@ NSString *symbolicateFile(NSString *filepath, CRCrashReport *report) {
             if (report != nil) {
                 needsRelease = YES;
             }
+            [data release];
         }
     }
 
     // Symbolicate.
+    // NOTE: If every frame has been seen before (e.g. when a process crashes
+    //       repeatedly), the results are taken from the symbol cache.
     if (!fileIsSymbolicated(filepath, report)) {
-        if ([report symbolicate]) {
+        BOOL didSymbolicate = applyCachedSymbols(report) && markReportAsSymbolicated(report);
+        if (!didSymbolicate) {
+            didSymbolicate = [report symbolicate];
+            if (didSymbolicate) {
+                addSymbolsToCache(report);
+            }
+        }
+        if (didSymbolicate) {
             // Process blame.
             if ([report blame]) {
                 // Write output to file.
-                NSString *pathExtension = [filepath pathExtension];
+                // NOTE: The output of a compressed log is not compressed.
+                NSString *sourcePath = uncompressedPathForFile(filepath);
+                NSString *pathExtension = [sourcePath pathExtension];
                 NSString *path = [NSString stringWithFormat:@"%@.symbolicated.%@",
-                        [filepath stringByDeletingPathExtension], pathExtension];
+                        [sourcePath stringByDeletingPathExtension], pathExtension];
                 if (writeToFile([report stringRepresentation], path)) {
                     // Fix any "LatestCrash-*" symbolic links for this file.
                     NSString *oldDestPath = [filepath lastPathComponent];
@@ -239,6 +1217,14 @@ NSString *symbolicateFile(NSString *filepath, CRCrashReport *report) {
                     // Update file ownership and permissions.
                     fixFileOwnershipAndPermissions(path);
 
+                    // Save results, so that the log can later be displayed
+                    // without being parsed again.
+                    CRBinaryImage *victim = nil;
+                    NSArray *suspects = nil;
+                    NSArray *potentialSuspects = nil;
+                    getBlameResults(report, &victim, &suspects, &potentialSuspects);
+                    writeSummaryForFile(path, victim, suspects, potentialSuspects, [report processInfo]);
+
                     // Save write path.
                     outputFilepath = path;
                 }
@@ -261,8 +1247,99 @@ NSString *symbolicateFile(NSString *filepath, CRCrashReport *report) {
     return outputFilepath;
 }
 
+NSString *symbolicateFile(NSString *filepath, CRCrashReport *report) {
+    NSString *outputFilepath = symbolicateFileWithoutSavingCache(filepath, report);
+    saveSymbolCache();
+    return outputFilepath;
+}
+
+// NOTE: Includes compressed logs (see compressFile()).
+BOOL isCrashLogFilename(NSString *filename) {
+    // NOTE: "LatestCrash-*" files are symbolic links to other logs.
+    if ([filename hasPrefix:@"LatestCrash"]) {
+        return NO;
+    }
+
+    NSString *name = uncompressedPathForFile(filename);
+    return [name hasSuffix:@"ips"] || [name hasSuffix:@"plist"] || [name hasSuffix:@"synced"];
+}
+
+NSArray *unsymbolicatedFilesInDirectory(NSString *directory) {
+    NSMutableArray *filepaths = [NSMutableArray array];
+
+    NSArray *contents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directory error:NULL];
+    for (NSString *filename in contents) {
+        if (isCrashLogFilename(filename)) {
+            NSString *filepath = [directory stringByAppendingPathComponent:filename];
+            if (!fileIsSymbolicated(filepath, nil)) {
+                [filepaths addObject:filepath];
+            }
+        }
+    }
+
+    return filepaths;
+}
+
+// NOTE: Each file is symbolicated on its own thread, with the number of files
+//       being processed at once (and thus the number of reports held in
+//       memory) limited to the given thread count.
+// NOTE: The progress handler is called once per file, serially, in the order
+//       in which files finish; the output filepath is nil on failure.
+NSUInteger symbolicateFiles(NSArray *filepaths, NSUInteger threadCount, void (^progress)(NSString *filepath, NSString *outputFilepath)) {
+    if (threadCount == 0) {
+        threadCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    }
+
+    __block NSUInteger symbolicatedCount = 0;
+
+    dispatch_queue_t workQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_queue_t progressQueue = dispatch_queue_create("jp.ashikase.crashreporter.symbolicate", NULL);
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(threadCount);
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSString *filepath in filepaths) {
+        // Wait for a thread to become available.
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+
+        dispatch_group_async(group, workQueue, ^{
+            NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+            NSString *outputFilepath = [symbolicateFileWithoutSavingCache(filepath, nil) retain];
+            dispatch_sync(progressQueue, ^{
+                if (outputFilepath != nil) {
+                    ++symbolicatedCount;
+                }
+                if (progress != nil) {
+                    progress(filepath, outputFilepath);
+                }
+            });
+            [outputFilepath release];
+
+            [pool drain];
+            dispatch_semaphore_signal(semaphore);
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    saveSymbolCache();
+
+    dispatch_release(group);
+    dispatch_release(semaphore);
+    dispatch_release(progressQueue);
+
+    return symbolicatedCount;
+}
+
+// NOTE: The index of a directory is shared by the app and the notifier.
+NSString *indexPathForDirectory(NSString *directory) {
+    NSString *name = [[directory stringByReplacingOccurrencesOfString:@"/" withString:@"_"] stringByAppendingPathExtension:@"index"];
+    return [@kCacheDirectory stringByAppendingPathComponent:name];
+}
+
+// NOTE: Returns the path of the compressed syslog if it exists (see
+//       compressFile()).
 NSString *syslogPathForFile(NSString *filepath) {
-    NSString *syslogPath = filepath;
+    NSString *syslogPath = uncompressedPathForFile(filepath);
 
     // Strip known path extensions.
     NSString *pathExtension = [syslogPath pathExtension];
@@ -276,7 +1353,13 @@ NSString *syslogPathForFile(NSString *filepath) {
         pathExtension = [syslogPath pathExtension];
     }
 
-    return [syslogPath stringByAppendingPathExtension:@"syslog"];
+    syslogPath = [syslogPath stringByAppendingPathExtension:@"syslog"];
+    NSString *compressedPath = [syslogPath stringByAppendingPathExtension:@kCompressedPathExtension];
+    struct stat st;
+    if (lstat([compressedPath fileSystemRepresentation], &st) == 0) {
+        syslogPath = compressedPath;
+    }
+    return syslogPath;
 }
 
 BOOL writeToFile(NSString *string, NSString *outputFilepath) {
@@ -322,4 +1405,57 @@ exit:
     return didWrite;
 }
 
+// NOTE: The output is written to a temporary file, which is then moved into
+//       place, so that a partially written file is never seen at the output
+//       path.
+BOOL writeStreamToFile(NSString *outputFilepath, BOOL (^writer)(FILE *stream)) {
+    const char *outputPath = [outputFilepath fileSystemRepresentation];
+
+    // If directory is not writable, will write to temporary file in /tmp and
+    // move it using the as_root tool.
+    const BOOL isWritable = [[NSFileManager defaultManager] isWritableFileAtPath:[outputFilepath stringByDeletingLastPathComponent]];
+    char tempPath[PATH_MAX];
+    if (isWritable) {
+        snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", outputPath);
+    } else {
+        strlcpy(tempPath, kTemporaryFilepath, sizeof(tempPath));
+    }
+    int fd = mkstemp(tempPath);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Unable to create temporary file, errno = %d.\n", errno);
+        return NO;
+    }
+    fchmod(fd, 0644);
+
+    FILE *stream = fdopen(fd, "w");
+    if (stream == NULL) {
+        fprintf(stderr, "ERROR: Unable to open temporary file, errno = %d.\n", errno);
+        close(fd);
+        unlink(tempPath);
+        return NO;
+    }
+
+    BOOL didWrite = writer(stream);
+    if (fclose(stream) != 0) {
+        didWrite = NO;
+    }
+    if (didWrite) {
+        if (isWritable) {
+            didWrite = (rename(tempPath, outputPath) == 0);
+        } else {
+            didWrite = move_as_root(tempPath, outputPath);
+        }
+        if (!didWrite) {
+            fprintf(stderr, "ERROR: Failed to move temporary file to \"%s\".\n", outputPath);
+        }
+    } else {
+        fprintf(stderr, "ERROR: Unable to write to file \"%s\".\n", outputPath);
+    }
+    if (!didWrite) {
+        unlink(tempPath);
+    }
+
+    return didWrite;
+}
+
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
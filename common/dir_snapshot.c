@@ -0,0 +1,145 @@
+/**
+ * Desc: Snapshot of the names of the entries in a directory; changes are
+ *       determined by comparing the contents of the directory against it.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "dir_snapshot.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+struct dir_snapshot {
+    char *directory;
+    // NOTE: Sorted list of the names of the entries in the directory.
+    char **names;
+    size_t count;
+};
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void free_names(char **names, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+static int list_directory(const char *directory, char ***names, size_t *count) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        fprintf(stderr, "ERROR: Unable to open directory \"%s\", errno = %d.\n", directory, errno);
+        return 0;
+    }
+
+    char **list = NULL;
+    size_t list_count = 0;
+    size_t list_capacity = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) {
+            continue;
+        }
+
+        if (list_count == list_capacity) {
+            size_t capacity = (list_capacity != 0) ? (2 * list_capacity) : 64;
+            char **new_list = realloc(list, capacity * sizeof(char *));
+            if (new_list == NULL) {
+                goto fail;
+            }
+            list = new_list;
+            list_capacity = capacity;
+        }
+
+        list[list_count] = strdup(entry->d_name);
+        if (list[list_count] == NULL) {
+            goto fail;
+        }
+        ++list_count;
+    }
+    closedir(dir);
+
+    qsort(list, list_count, sizeof(char *), compare_names);
+    *names = list;
+    *count = list_count;
+    return 1;
+
+fail:
+    closedir(dir);
+    free_names(list, list_count);
+    return 0;
+}
+
+dir_snapshot_t *dir_snapshot_create(const char *directory) {
+    dir_snapshot_t *snapshot = calloc(1, sizeof(dir_snapshot_t));
+    if (snapshot != NULL) {
+        snapshot->directory = strdup(directory);
+        if ((snapshot->directory == NULL) ||
+                !list_directory(directory, &snapshot->names, &snapshot->count)) {
+            dir_snapshot_free(snapshot);
+            return NULL;
+        }
+    }
+    return snapshot;
+}
+
+int dir_snapshot_update(dir_snapshot_t *snapshot, dir_watcher_callback_t callback, void *context) {
+    char **names;
+    size_t count;
+    if (!list_directory(snapshot->directory, &names, &count)) {
+        return -1;
+    }
+
+    // NOTE: Both lists are sorted; walk them together.
+    int event_count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while ((i < snapshot->count) || (j < count)) {
+        int result;
+        if (i == snapshot->count) {
+            result = 1;
+        } else if (j == count) {
+            result = -1;
+        } else {
+            result = strcmp(snapshot->names[i], names[j]);
+        }
+
+        if (result < 0) {
+            callback(DIR_WATCHER_EVENT_REMOVED, snapshot->names[i], context);
+            ++event_count;
+            ++i;
+        } else if (result > 0) {
+            callback(DIR_WATCHER_EVENT_ADDED, names[j], context);
+            ++event_count;
+            ++j;
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+
+    free_names(snapshot->names, snapshot->count);
+    snapshot->names = names;
+    snapshot->count = count;
+
+    return event_count;
+}
+
+void dir_snapshot_free(dir_snapshot_t *snapshot) {
+    if (snapshot != NULL) {
+        free_names(snapshot->names, snapshot->count);
+        free(snapshot->directory);
+        free(snapshot);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
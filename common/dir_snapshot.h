@@ -0,0 +1,37 @@
+/**
+ * Desc: Snapshot of the names of the entries in a directory; changes are
+ *       determined by comparing the contents of the directory against it.
+ *
+ *       Used by the kqueue back end of the directory watcher (see
+ *       dir_watcher.h), as kqueue reports only that a directory has changed.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_DIR_SNAPSHOT_H_
+#define COMMON_DIR_SNAPSHOT_H_
+
+#include "dir_watcher.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dir_snapshot dir_snapshot_t;
+
+dir_snapshot_t *dir_snapshot_create(const char *directory);
+// NOTE: Reports the entries added and removed since the snapshot was taken (or
+//       last updated), as ADDED and REMOVED events, and updates the snapshot.
+//       Returns the number of events, or -1 if the directory could not be read
+//       (in which case the snapshot is left unchanged).
+int dir_snapshot_update(dir_snapshot_t *snapshot, dir_watcher_callback_t callback, void *context);
+void dir_snapshot_free(dir_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_DIR_SNAPSHOT_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
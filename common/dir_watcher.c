@@ -0,0 +1,217 @@
+/**
+ * Desc: Watches a directory for files being added or removed.
+ *
+ *       On Linux, events are provided by inotify. Elsewhere, kqueue is used to
+ *       detect that the directory has changed, and the changes are determined
+ *       by comparing the contents of the directory against a snapshot (see
+ *       dir_snapshot.h).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "dir_watcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+
+#include <sys/inotify.h>
+
+struct dir_watcher {
+    int fd;
+};
+
+dir_watcher_t *dir_watcher_open(const char *directory) {
+    dir_watcher_t *watcher = calloc(1, sizeof(dir_watcher_t));
+    if (watcher != NULL) {
+        watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watcher->fd < 0) {
+            fprintf(stderr, "ERROR: Unable to create inotify instance, errno = %d.\n", errno);
+            free(watcher);
+            return NULL;
+        }
+
+        // NOTE: Files are reported as added once they have been closed after
+        //       writing (or moved into place), not when they are created.
+        const uint32_t mask =
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM |
+            IN_DELETE_SELF | IN_MOVE_SELF;
+        if (inotify_add_watch(watcher->fd, directory, mask) < 0) {
+            fprintf(stderr, "ERROR: Unable to watch directory \"%s\", errno = %d.\n", directory, errno);
+            dir_watcher_close(watcher);
+            return NULL;
+        }
+    }
+    return watcher;
+}
+
+int dir_watcher_poll(dir_watcher_t *watcher, dir_watcher_callback_t callback, void *context) {
+    int count = 0;
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                // No more events.
+                break;
+            }
+            fprintf(stderr, "ERROR: Failed to read directory events, errno = %d.\n", errno);
+            return -1;
+        }
+
+        for (char *p = buffer; p < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                callback(DIR_WATCHER_EVENT_OVERFLOW, NULL, context);
+                ++count;
+            } else if (event->len > 0) {
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    callback(DIR_WATCHER_EVENT_ADDED, event->name, context);
+                    ++count;
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    callback(DIR_WATCHER_EVENT_REMOVED, event->name, context);
+                    ++count;
+                }
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return count;
+}
+
+void dir_watcher_close(dir_watcher_t *watcher) {
+    if (watcher != NULL) {
+        close(watcher->fd);
+        free(watcher);
+    }
+}
+
+#else
+
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+
+#include "dir_snapshot.h"
+
+#ifndef O_EVTONLY
+#define O_EVTONLY O_RDONLY
+#endif
+
+struct dir_watcher {
+    int kq;
+    int dir_fd;
+    dir_snapshot_t *snapshot;
+};
+
+dir_watcher_t *dir_watcher_open(const char *directory) {
+    dir_watcher_t *watcher = calloc(1, sizeof(dir_watcher_t));
+    if (watcher != NULL) {
+        watcher->kq = -1;
+        watcher->dir_fd = -1;
+
+        watcher->dir_fd = open(directory, O_EVTONLY);
+        if (watcher->dir_fd < 0) {
+            fprintf(stderr, "ERROR: Unable to open directory \"%s\", errno = %d.\n", directory, errno);
+            goto fail;
+        }
+        fcntl(watcher->dir_fd, F_SETFD, FD_CLOEXEC);
+
+        watcher->kq = kqueue();
+        if (watcher->kq < 0) {
+            fprintf(stderr, "ERROR: Unable to create kqueue, errno = %d.\n", errno);
+            goto fail;
+        }
+        fcntl(watcher->kq, F_SETFD, FD_CLOEXEC);
+
+        struct kevent change;
+        EV_SET(&change, watcher->dir_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+                NOTE_WRITE | NOTE_DELETE | NOTE_RENAME | NOTE_REVOKE, 0, NULL);
+        if (kevent(watcher->kq, &change, 1, NULL, 0, NULL) < 0) {
+            fprintf(stderr, "ERROR: Unable to watch directory \"%s\", errno = %d.\n", directory, errno);
+            goto fail;
+        }
+
+        // NOTE: The snapshot is taken after the watch is registered so that no
+        //       change can be missed.
+        watcher->snapshot = dir_snapshot_create(directory);
+        if (watcher->snapshot == NULL) {
+            goto fail;
+        }
+    }
+    return watcher;
+
+fail:
+    dir_watcher_close(watcher);
+    return NULL;
+}
+
+int dir_watcher_poll(dir_watcher_t *watcher, dir_watcher_callback_t callback, void *context) {
+    // Check for changes without blocking.
+    struct kevent events[8];
+    const struct timespec timeout = {0, 0};
+    int changed = 0;
+    int needs_rescan = 0;
+    for (;;) {
+        int n = kevent(watcher->kq, NULL, 0, events, 8, &timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "ERROR: Failed to read directory events, errno = %d.\n", errno);
+            return -1;
+        } else if (n == 0) {
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].fflags & (NOTE_DELETE | NOTE_RENAME | NOTE_REVOKE)) {
+                needs_rescan = 1;
+            }
+        }
+        changed = 1;
+    }
+
+    if (needs_rescan) {
+        callback(DIR_WATCHER_EVENT_OVERFLOW, NULL, context);
+        return 1;
+    }
+    if (!changed) {
+        return 0;
+    }
+
+    // Determine changes by comparing against snapshot.
+    int event_count = dir_snapshot_update(watcher->snapshot, callback, context);
+    if (event_count < 0) {
+        callback(DIR_WATCHER_EVENT_OVERFLOW, NULL, context);
+        event_count = 1;
+    }
+    return event_count;
+}
+
+void dir_watcher_close(dir_watcher_t *watcher) {
+    if (watcher != NULL) {
+        if (watcher->kq >= 0) {
+            close(watcher->kq);
+        }
+        if (watcher->dir_fd >= 0) {
+            close(watcher->dir_fd);
+        }
+        dir_snapshot_free(watcher->snapshot);
+        free(watcher);
+    }
+}
+
+#endif
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,43 @@
+/**
+ * Desc: Watches a directory for files being added or removed.
+ *
+ *       On Linux, events are provided by inotify. Elsewhere, kqueue is used to
+ *       detect that the directory has changed, and the changes are determined
+ *       by comparing the contents of the directory against a snapshot.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_DIR_WATCHER_H_
+#define COMMON_DIR_WATCHER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DIR_WATCHER_EVENT_ADDED,
+    DIR_WATCHER_EVENT_REMOVED,
+    // Events were lost, or the directory itself was moved or deleted; the
+    // directory must be rescanned. The name is NULL.
+    DIR_WATCHER_EVENT_OVERFLOW
+} dir_watcher_event_t;
+
+// NOTE: A rename within the directory is reported as a removal of the old
+//       name followed by an addition of the new name.
+typedef void (*dir_watcher_callback_t)(dir_watcher_event_t event, const char *name, void *context);
+
+typedef struct dir_watcher dir_watcher_t;
+
+dir_watcher_t *dir_watcher_open(const char *directory);
+int dir_watcher_poll(dir_watcher_t *watcher, dir_watcher_callback_t callback, void *context);
+void dir_watcher_close(dir_watcher_t *watcher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_DIR_WATCHER_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
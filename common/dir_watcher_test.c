@@ -0,0 +1,228 @@
+/**
+ * Desc: Test of the directory watcher: the inotify back end (on Linux), and the
+ *       snapshot comparison used by the kqueue back end (see dir_snapshot.h).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "dir_snapshot.h"
+#include "dir_watcher.h"
+
+#include "test_util.h"
+
+#define kMaxEvents 512
+
+typedef struct {
+    dir_watcher_event_t event;
+    char name[256];
+} event_t;
+
+typedef struct {
+    event_t events[kMaxEvents];
+    unsigned count;
+} events_t;
+
+static void record_event(dir_watcher_event_t event, const char *name, void *context) {
+    events_t *events = context;
+    if (events->count < kMaxEvents) {
+        event_t *e = &events->events[events->count++];
+        e->event = event;
+        snprintf(e->name, sizeof(e->name), "%s", (name != NULL) ? name : "");
+    }
+}
+
+static int has_event(const events_t *events, unsigned index, dir_watcher_event_t event, const char *name) {
+    return (index < events->count) && (events->events[index].event == event) &&
+        (strcmp(events->events[index].name, name) == 0);
+}
+
+static int poll_watcher(dir_watcher_t *watcher, events_t *events) {
+    events->count = 0;
+    const int count = dir_watcher_poll(watcher, record_event, events);
+    CHECK(count == (int)events->count);
+    return count;
+}
+
+static int update_snapshot(dir_snapshot_t *snapshot, events_t *events) {
+    events->count = 0;
+    const int count = dir_snapshot_update(snapshot, record_event, events);
+    CHECK((count < 0) || (count == (int)events->count));
+    return count;
+}
+
+static void write_file(const char *directory, const char *name) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "%s", name);
+    CHECK(test_write_file(filepath, "log", 3));
+}
+
+static void rename_file(const char *from_directory, const char *from_name, const char *to_directory, const char *to_name) {
+    char from_filepath[1024];
+    char to_filepath[1024];
+    test_path(from_filepath, sizeof(from_filepath), from_directory, "%s", from_name);
+    test_path(to_filepath, sizeof(to_filepath), to_directory, "%s", to_name);
+    CHECK(rename(from_filepath, to_filepath) == 0);
+}
+
+static void remove_file(const char *directory, const char *name) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "%s", name);
+    CHECK(unlink(filepath) == 0);
+}
+
+static void test_watcher(const char *root) {
+    char directory[1024];
+    char other_directory[1024];
+    test_path(directory, sizeof(directory), root, "watched");
+    test_path(other_directory, sizeof(other_directory), root, "other");
+    CHECK(mkdir(directory, 0755) == 0);
+    CHECK(mkdir(other_directory, 0755) == 0);
+
+    dir_watcher_t *watcher = dir_watcher_open(directory);
+    CHECK(watcher != NULL);
+    events_t *events = calloc(1, sizeof(events_t));
+    CHECK(poll_watcher(watcher, events) == 0);
+
+    // Files are added once written and closed.
+    write_file(directory, "a.ips");
+    CHECK(poll_watcher(watcher, events) == 1);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_ADDED, "a.ips"));
+
+    // A rename within the directory is a removal and an addition.
+    rename_file(directory, "a.ips", directory, "b.ips");
+    CHECK(poll_watcher(watcher, events) == 2);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_REMOVED, "a.ips"));
+    CHECK(has_event(events, 1, DIR_WATCHER_EVENT_ADDED, "b.ips"));
+
+    // Moves into and out of the directory.
+    write_file(other_directory, "c.ips");
+    rename_file(other_directory, "c.ips", directory, "c.ips");
+    rename_file(directory, "b.ips", other_directory, "b.ips");
+    CHECK(poll_watcher(watcher, events) == 2);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_ADDED, "c.ips"));
+    CHECK(has_event(events, 1, DIR_WATCHER_EVENT_REMOVED, "b.ips"));
+
+    remove_file(directory, "c.ips");
+    CHECK(poll_watcher(watcher, events) == 1);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_REMOVED, "c.ips"));
+
+    // NOTE: More events than are read at once.
+    for (unsigned i = 0; i < 200; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "Process-2016-03-01-10%04u.ips", i);
+        write_file(directory, name);
+    }
+    CHECK(poll_watcher(watcher, events) == 200);
+    CHECK(has_event(events, 199, DIR_WATCHER_EVENT_ADDED, "Process-2016-03-01-100199.ips"));
+
+    // Removal of the directory itself requires a rescan.
+    char command[1100];
+    snprintf(command, sizeof(command), "rm -rf '%s'", directory);
+    CHECK(system(command) == 0);
+    CHECK(poll_watcher(watcher, events) >= 1);
+    CHECK(has_event(events, events->count - 1, DIR_WATCHER_EVENT_OVERFLOW, ""));
+
+    dir_watcher_close(watcher);
+    free(events);
+
+    // A missing directory cannot be watched.
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    CHECK(dir_watcher_open(directory) == NULL);
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    close(null_fd);
+}
+
+static void test_snapshot(const char *root) {
+    char directory[1024];
+    char other_directory[1024];
+    test_path(directory, sizeof(directory), root, "snapshot");
+    test_path(other_directory, sizeof(other_directory), root, "snapshot_other");
+    CHECK(mkdir(directory, 0755) == 0);
+    CHECK(mkdir(other_directory, 0755) == 0);
+
+    // NOTE: Entries present when the snapshot is taken are not reported.
+    write_file(directory, "a.ips");
+    write_file(directory, "m.ips");
+    dir_snapshot_t *snapshot = dir_snapshot_create(directory);
+    CHECK(snapshot != NULL);
+    events_t *events = calloc(1, sizeof(events_t));
+    CHECK(update_snapshot(snapshot, events) == 0);
+
+    // Changes are reported in order of name, removals and additions merged.
+    write_file(directory, "z.ips");
+    write_file(directory, "b.ips");
+    remove_file(directory, "m.ips");
+    CHECK(update_snapshot(snapshot, events) == 3);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_ADDED, "b.ips"));
+    CHECK(has_event(events, 1, DIR_WATCHER_EVENT_REMOVED, "m.ips"));
+    CHECK(has_event(events, 2, DIR_WATCHER_EVENT_ADDED, "z.ips"));
+    CHECK(update_snapshot(snapshot, events) == 0);
+
+    // A rename is a removal and an addition; a file replaced under the same
+    // name is not a change.
+    rename_file(directory, "a.ips", directory, "c.ips");
+    write_file(other_directory, "z.ips");
+    rename_file(other_directory, "z.ips", directory, "z.ips");
+    CHECK(update_snapshot(snapshot, events) == 2);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_REMOVED, "a.ips"));
+    CHECK(has_event(events, 1, DIR_WATCHER_EVENT_ADDED, "c.ips"));
+
+    // Directories are entries as well.
+    char subdirectory[1100];
+    snprintf(subdirectory, sizeof(subdirectory), "%s/sub", directory);
+    CHECK(mkdir(subdirectory, 0755) == 0);
+    CHECK(update_snapshot(snapshot, events) == 1);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_ADDED, "sub"));
+    CHECK(rmdir(subdirectory) == 0);
+
+    // NOTE: More entries than the initial capacity of the list.
+    for (unsigned i = 0; i < 200; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "Process-2016-03-01-10%04u.ips", 199 - i);
+        write_file(directory, name);
+    }
+    CHECK(update_snapshot(snapshot, events) == 201);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_ADDED, "Process-2016-03-01-100000.ips"));
+    CHECK(has_event(events, 199, DIR_WATCHER_EVENT_ADDED, "Process-2016-03-01-100199.ips"));
+    CHECK(has_event(events, 200, DIR_WATCHER_EVENT_REMOVED, "sub"));
+
+    // If the directory cannot be read, the snapshot is kept.
+    char moved_directory[1024];
+    test_path(moved_directory, sizeof(moved_directory), root, "snapshot_moved");
+    CHECK(rename(directory, moved_directory) == 0);
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    CHECK(update_snapshot(snapshot, events) < 0);
+    CHECK(dir_snapshot_create(directory) == NULL);
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    close(null_fd);
+    CHECK(events->count == 0);
+
+    CHECK(rename(moved_directory, directory) == 0);
+    remove_file(directory, "b.ips");
+    CHECK(update_snapshot(snapshot, events) == 1);
+    CHECK(has_event(events, 0, DIR_WATCHER_EVENT_REMOVED, "b.ips"));
+
+    dir_snapshot_free(snapshot);
+    free(events);
+}
+
+int main(void) {
+    char *directory = test_make_directory("dir_watcher_test");
+    test_watcher(directory);
+    test_snapshot(directory);
+    test_remove_directory(directory);
+    return test_result("dir_watcher_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -9,6 +9,9 @@ BOOL chmod_as_root(const char *filepath, mode_t mode);
 BOOL chown_as_root(const char *filepath, uid_t owner, gid_t group);
 BOOL copy_as_root(const char *from_filepath, const char *to_filepath);
 BOOL delete_as_root(const char *filepath);
+BOOL delete_as_root_batch(const char **filepaths, unsigned count);
+BOOL link_as_root(const char *filename, const char *link_filepath);
+int open_as_root(const char *filepath);
 BOOL move_as_root(const char *from_filepath, const char *to_filepath);
 
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
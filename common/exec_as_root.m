@@ -7,32 +7,233 @@
 
 #include "exec_as_root.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
 static NSString *as_root_path$ = nil;
 
+// NOTE: A single instance of the tool is run in server mode and kept alive for
+//       the lifetime of the calling process, so that each operation costs a
+//       round trip over a socket rather than a fork and exec.
+// NOTE: A UNIX domain socket is used (rather than a pipe) so that the server
+//       can pass open file descriptors back to the client.
+static pthread_mutex_t server_lock$ = PTHREAD_MUTEX_INITIALIZER;
+static pid_t server_pid$ = -1;
+static int server_socket$ = -1;
+
+// NOTE: May be called from multiple threads (e.g. when symbolicating files in
+//       bulk).
 static const char *as_root_path() {
-    if (as_root_path$ == nil) {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
         as_root_path$ = [[[NSBundle mainBundle] pathForResource:@"as_root" ofType:nil] retain];
         if (as_root_path$ == nil) {
             fprintf(stderr, "ERROR: Unable to determine path for \"as_root\" tool.\n");
         }
-    }
+    });
     return [as_root_path$ UTF8String];
 }
 
-static BOOL as_root(const char *action, const char *param1, const char *param2, const char *param3) {
-    BOOL succeeded = NO;
+static void stop_server() {
+    if (server_pid$ != -1) {
+        // NOTE: Closing the socket causes the server to exit.
+        close(server_socket$);
+        waitpid(server_pid$, NULL, 0);
+
+        server_socket$ = -1;
+        server_pid$ = -1;
+    }
+}
+
+static BOOL start_server() {
+    const char *path = as_root_path();
+    if (path == NULL) {
+        return NO;
+    }
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        fprintf(stderr, "ERROR: Unable to create socket for \"as_root\" server, errno = %d.\n", errno);
+        return NO;
+    }
 
     pid_t pid = fork();
+    if (pid == 0) {
+        // Execute the process, using the socket for stdin and stdout.
+        dup2(sockets[1], STDIN_FILENO);
+        dup2(sockets[1], STDOUT_FILENO);
+        close(sockets[0]);
+        close(sockets[1]);
+        execl(path, path, "serve", NULL);
+        _exit(1);
+    }
+
+    close(sockets[1]);
+
+    if (pid == -1) {
+        fprintf(stderr, "ERROR: Unable to start \"as_root\" server, errno = %d.\n", errno);
+        close(sockets[0]);
+        return NO;
+    }
+
+    // NOTE: Prevent the socket from being inherited by other child processes,
+    //       and prevent a write to a dead server from raising SIGPIPE.
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    const int value = 1;
+    setsockopt(sockets[0], SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+
+    server_pid$ = pid;
+    server_socket$ = sockets[0];
+    return YES;
+}
+
+static BOOL send_request(const char *buffer, size_t length) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    while (length > 0) {
+        ssize_t count = send(server_socket$, buffer, length, flags);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        buffer += count;
+        length -= count;
+    }
+    return YES;
+}
+
+// NOTE: Reads a single reply line. If the reply carries a file descriptor, it
+//       is stored in *fd (if fd is non-NULL) or closed.
+static BOOL receive_reply(char *reply, size_t size, int *fd) {
+    size_t length = 0;
+    while (length < (size - 1)) {
+        struct iovec iov;
+        iov.iov_base = reply + length;
+        iov.iov_len = size - 1 - length;
+
+        union {
+            struct cmsghdr header;
+            char buffer[CMSG_SPACE(sizeof(int))];
+        } control;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+
+        ssize_t count = recvmsg(server_socket$, &msg, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        } else if (count == 0) {
+            // Server has exited.
+            return NO;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+                int received_fd;
+                memcpy(&received_fd, CMSG_DATA(cmsg), sizeof(int));
+                if ((fd != NULL) && (*fd < 0)) {
+                    fcntl(received_fd, F_SETFD, FD_CLOEXEC);
+                    *fd = received_fd;
+                } else {
+                    close(received_fd);
+                }
+            }
+        }
+
+        length += count;
+        if (reply[length - 1] == '\n') {
+            reply[length] = '\0';
+            return YES;
+        }
+    }
+    return NO;
+}
+
+// NOTE: Sends a request to the server and waits for the reply. Returns NO if
+//       communication with the server failed (as opposed to the command
+//       itself failing, which is reported via *succeeded); *sent is then set
+//       if the request had been sent in full, in which case the server may
+//       have performed the command.
+static BOOL as_root_server(const char **args, unsigned argc, BOOL *succeeded, int *fd, BOOL *sent) {
+    // Determine size of request.
+    // NOTE: Each argument is NUL-terminated; request ends with an empty one.
+    size_t length = 1;
+    for (unsigned i = 0; i < argc; ++i) {
+        length += strlen(args[i]) + 1;
+    }
+
+    char *request = malloc(length);
+    if (request == NULL) {
+        return NO;
+    }
+    char *p = request;
+    for (unsigned i = 0; i < argc; ++i) {
+        size_t size = strlen(args[i]) + 1;
+        memcpy(p, args[i], size);
+        p += size;
+    }
+    *p = '\0';
+
+    BOOL communicated = NO;
+    *sent = NO;
+
+    pthread_mutex_lock(&server_lock$);
+    if ((server_pid$ != -1) || start_server()) {
+        if (send_request(request, length)) {
+            *sent = YES;
+            char reply[PATH_MAX + 16];
+            if (receive_reply(reply, sizeof(reply), fd)) {
+                *succeeded = (reply[0] == '0');
+                communicated = YES;
+            }
+        }
+
+        if (!communicated) {
+            fprintf(stderr, "WARNING: Lost connection to \"as_root\" server.\n");
+            stop_server();
+        }
+    }
+    pthread_mutex_unlock(&server_lock$);
+
+    free(request);
+    return communicated;
+}
+
+static BOOL as_root_exec(const char **args, unsigned argc) {
+    BOOL succeeded = NO;
+
     const char *path = as_root_path();
+    if (path == NULL) {
+        return NO;
+    }
+
+    const char *argv[argc + 2];
+    argv[0] = path;
+    memcpy(&argv[1], args, argc * sizeof(char *));
+    argv[argc + 1] = NULL;
+
+    pid_t pid = fork();
     if (pid == 0) {
         // Execute the process.
-        if (strcmp(action, "chown") == 0) {
-            execl(path, path, action, param1, param2, param3, NULL);
-        } else if ((strcmp(action, "chmod") == 0) || (strcmp(action, "copy") == 0) || (strcmp(action, "move") == 0)) {
-            execl(path, path, action, param1, param2, NULL);
-        } else if (strcmp(action, "delete") == 0) {
-            execl(path, path, action, param1, NULL);
-        }
+        execv(path, (char * const *)argv);
         _exit(0);
     } else if (pid != -1) {
         // Wait for process to finish.
@@ -50,10 +251,26 @@ static BOOL as_root(const char *action, const char *param1, const char *param2,
     return succeeded;
 }
 
+static BOOL as_root(const char **args, unsigned argc) {
+    // NOTE: Fall back to launching a separate process for the operation if the
+    //       server cannot be used.
+    // NOTE: If the request was sent but the reply was lost, the operation may
+    //       already have been performed; it is not performed again (a second
+    //       move, for example, would fail, or move a file that has since
+    //       replaced the original), and is reported as failed.
+    BOOL succeeded = NO;
+    BOOL sent = NO;
+    if (!as_root_server(args, argc, &succeeded, NULL, &sent) && !sent) {
+        succeeded = as_root_exec(args, argc);
+    }
+    return succeeded;
+}
+
 BOOL chmod_as_root(const char *filepath, mode_t mode) {
     char mode_buf[5];
     snprintf(mode_buf, 5, "%o", mode);
-    return as_root("chmod", filepath, mode_buf, NULL);
+    const char *args[] = {"chmod", filepath, mode_buf};
+    return as_root(args, 3);
 }
 
 BOOL chown_as_root(const char *filepath, uid_t owner, gid_t group) {
@@ -61,19 +278,61 @@ BOOL chown_as_root(const char *filepath, uid_t owner, gid_t group) {
     char group_buf[17];
     snprintf(owner_buf, 17, "%u", owner);
     snprintf(group_buf, 17, "%u", owner);
-    return as_root("chown", filepath, owner_buf, group_buf);
+    const char *args[] = {"chown", filepath, owner_buf, group_buf};
+    return as_root(args, 4);
 }
 
 BOOL copy_as_root(const char *from_filepath, const char *to_filepath) {
-    return as_root("copy", from_filepath, to_filepath, NULL);
+    const char *args[] = {"copy", from_filepath, to_filepath};
+    return as_root(args, 3);
 }
 
 BOOL delete_as_root(const char *filepath) {
-    return as_root("delete", filepath, NULL, NULL);
+    const char *args[] = {"delete", filepath};
+    return as_root(args, 2);
+}
+
+BOOL delete_as_root_batch(const char **filepaths, unsigned count) {
+    if (count == 0) {
+        return YES;
+    }
+
+    const char **args = malloc((count + 1) * sizeof(char *));
+    if (args == NULL) {
+        return NO;
+    }
+    args[0] = "delete";
+    memcpy(&args[1], filepaths, count * sizeof(char *));
+    BOOL succeeded = as_root(args, count + 1);
+    free(args);
+
+    return succeeded;
+}
+
+BOOL link_as_root(const char *filename, const char *link_filepath) {
+    const char *args[] = {"link", filename, link_filepath};
+    return as_root(args, 3);
+}
+
+int open_as_root(const char *filepath) {
+    // NOTE: Only supported in server mode, as the descriptor is passed over
+    //       the socket; there is no fallback.
+    int fd = -1;
+    BOOL succeeded = NO;
+    BOOL sent = NO;
+    const char *args[] = {"open", filepath};
+    if (!as_root_server(args, 2, &succeeded, &fd, &sent) || !succeeded) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = -1;
+    }
+    return fd;
 }
 
 BOOL move_as_root(const char *from_filepath, const char *to_filepath) {
-    return as_root("move", from_filepath, to_filepath, NULL);
+    const char *args[] = {"move", from_filepath, to_filepath};
+    return as_root(args, 3);
 }
 
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
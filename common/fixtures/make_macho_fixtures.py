@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Desc: Generates the Mach-O fixtures used by macho_test.c (see tests.mk):
+#
+#       thin_arm64.dylib  64-bit image
+#       thin_armv7.dylib  32-bit image
+#       fat.dylib         armv7, armv7s and arm64 slices
+#
+#       Each image has an LC_UUID, a __text section with two functions, a
+#       constant in __const, and a set of LC_*_DYLIB commands; the UUID and
+#       one of the libraries differ between the slices of the fat image.
+#
+#       Run from this directory to regenerate the fixtures; the output is
+#       deterministic.
+#
+# Author: Lance Fetters (aka. ashikase)
+# License: GPL v3 (See LICENSE file for details)
+
+import struct
+
+CPU_TYPE_ARM = 12
+CPU_TYPE_ARM64 = CPU_TYPE_ARM | 0x01000000
+CPU_SUBTYPE_ARM_V7 = 9
+CPU_SUBTYPE_ARM_V7S = 11
+CPU_SUBTYPE_ARM64_ALL = 0
+
+LC_SEGMENT = 0x1
+LC_SYMTAB = 0x2
+LC_LOAD_DYLIB = 0xc
+LC_ID_DYLIB = 0xd
+LC_UUID = 0x1b
+LC_SEGMENT_64 = 0x19
+LC_LOAD_WEAK_DYLIB = 0x80000018
+LC_REEXPORT_DYLIB = 0x8000001f
+
+MH_DYLIB = 6
+S_ATTR_PURE_INSTRUCTIONS = 0x80000000
+S_ATTR_SOME_INSTRUCTIONS = 0x00000400
+
+TEXT_ADDRESS = 0x4000
+TEXT_SECTION_OFFSET = 0x1000
+TEXT_SECTION_SIZE = 0x100
+CONST_SECTION_OFFSET = 0x1100
+CONST_SECTION_SIZE = 0x20
+
+# NOTE: Kept in sync with macho_test.c.
+COMMON_DYLIBS = [
+    (LC_LOAD_DYLIB, "/System/Library/Frameworks/UIKit.framework/UIKit"),
+    (LC_LOAD_WEAK_DYLIB, "/usr/lib/libsubstrate.dylib"),
+    (LC_REEXPORT_DYLIB, "/usr/lib/libSystem.B.dylib"),
+]
+
+
+def name16(name):
+    return name.encode().ljust(16, b"\0")
+
+
+def dylib_command(cmd, path):
+    name = path.encode() + b"\0"
+    size = (24 + len(name) + 7) & ~7
+    return struct.pack("<IIIIII", cmd, size, 24, 2, 0x10000, 0x10000) + name.ljust(size - 24, b"\0")
+
+
+def section(is_64, name, segment, address, size, offset, flags):
+    if is_64:
+        return (name16(name) + name16(segment) +
+                struct.pack("<QQIIIIIIII", address, size, offset, 0, 0, 0, flags, 0, 0, 0))
+    return (name16(name) + name16(segment) +
+            struct.pack("<IIIIIIIII", address, size, offset, 0, 0, 0, flags, 0, 0))
+
+
+def segment_command(is_64, file_size):
+    sections = (
+        section(is_64, "__text", "__TEXT", TEXT_ADDRESS + TEXT_SECTION_OFFSET, TEXT_SECTION_SIZE,
+                TEXT_SECTION_OFFSET, S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS) +
+        section(is_64, "__const", "__TEXT", TEXT_ADDRESS + CONST_SECTION_OFFSET, CONST_SECTION_SIZE,
+                CONST_SECTION_OFFSET, 0))
+    if is_64:
+        header = struct.pack("<II16sQQQQIIII", LC_SEGMENT_64, 72 + len(sections), name16("__TEXT"),
+                             TEXT_ADDRESS, 0x2000, 0, file_size, 5, 5, 2, 0)
+    else:
+        header = struct.pack("<II16sIIIIIIII", LC_SEGMENT, 56 + len(sections), name16("__TEXT"),
+                             TEXT_ADDRESS, 0x2000, 0, file_size, 5, 5, 2, 0)
+    return header + sections
+
+
+def image(is_64, cputype, cpusubtype, uuid, slice_dylib):
+    strings = b"\0_first\0_second\0_kConstant\0"
+    symbols = [
+        (1, 0x0f, 1, TEXT_ADDRESS + TEXT_SECTION_OFFSET),
+        (8, 0x0e, 1, TEXT_ADDRESS + TEXT_SECTION_OFFSET + 0x40),
+        (16, 0x0f, 2, TEXT_ADDRESS + CONST_SECTION_OFFSET),
+    ]
+    nlist_size = 16 if is_64 else 12
+    header_size = 32 if is_64 else 28
+    symbol_offset = CONST_SECTION_OFFSET + CONST_SECTION_SIZE
+    string_offset = symbol_offset + len(symbols) * nlist_size
+    file_size = (string_offset + len(strings) + 15) & ~15
+
+    dylibs = [(LC_ID_DYLIB, "/Library/MobileSubstrate/DynamicLibraries/Fixture.dylib")]
+    dylibs += COMMON_DYLIBS + [(LC_LOAD_DYLIB, slice_dylib)]
+    commands = [
+        segment_command(is_64, file_size),
+        struct.pack("<IIIIII", LC_SYMTAB, 24, symbol_offset, len(symbols), string_offset, len(strings)),
+        struct.pack("<II", LC_UUID, 24) + uuid,
+    ] + [dylib_command(cmd, path) for (cmd, path) in dylibs]
+    commands_bytes = b"".join(commands)
+
+    magic = 0xfeedfacf if is_64 else 0xfeedface
+    header = struct.pack("<IiiIIII", magic, cputype, cpusubtype, MH_DYLIB, len(commands), len(commands_bytes), 0)
+    if is_64:
+        header += struct.pack("<I", 0)
+    assert header_size + len(commands_bytes) <= TEXT_SECTION_OFFSET
+
+    data = bytearray(file_size)
+    data[0:header_size] = header
+    data[header_size:header_size + len(commands_bytes)] = commands_bytes
+    # NOTE: "Instructions" are filler bytes.
+    for i in range(TEXT_SECTION_SIZE):
+        data[TEXT_SECTION_OFFSET + i] = i & 0xff
+    for (i, (name_index, type_, section_index, value)) in enumerate(symbols):
+        if is_64:
+            entry = struct.pack("<IBBHQ", name_index, type_, section_index, 0, value)
+        else:
+            entry = struct.pack("<IBBHI", name_index, type_, section_index, 0, value)
+        data[symbol_offset + i * nlist_size:symbol_offset + (i + 1) * nlist_size] = entry
+    data[string_offset:string_offset + len(strings)] = strings
+    return bytes(data)
+
+
+def uuid(n):
+    return bytes([n] * 4 + [0xa0 + i for i in range(12)])
+
+
+def fat(slices):
+    align = 12
+    offset = 1 << align
+    archs = b""
+    body = b""
+    for (cputype, cpusubtype, data) in slices:
+        archs += struct.pack(">IIIII", cputype, cpusubtype, offset + len(body), len(data), align)
+        body += data
+        body += b"\0" * (-len(body) % (1 << align))
+    header = struct.pack(">II", 0xcafebabe, len(slices)) + archs
+    return header.ljust(offset, b"\0") + body
+
+
+def main():
+    outputs = {
+        "thin_arm64.dylib": image(True, CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64_ALL, uuid(1), "/usr/lib/libarm64.dylib"),
+        "thin_armv7.dylib": image(False, CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7, uuid(2), "/usr/lib/libarmv7.dylib"),
+        "fat.dylib": fat([
+            (CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7,
+                image(False, CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7, uuid(3), "/usr/lib/libarmv7.dylib")),
+            (CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7S,
+                image(False, CPU_TYPE_ARM, CPU_SUBTYPE_ARM_V7S, uuid(4), "/usr/lib/libarmv7s.dylib")),
+            (CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64_ALL,
+                image(True, CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64_ALL, uuid(5), "/usr/lib/libarm64.dylib")),
+        ]),
+    }
+    for (filename, data) in outputs.items():
+        with open(filename, "wb") as f:
+            f.write(data)
+
+
+if __name__ == "__main__":
+    main()
+
+# vim: set ft=python ff=unix sw=4 ts=4 expandtab tw=80:
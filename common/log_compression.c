@@ -0,0 +1,196 @@
+/**
+ * Desc: Compression of aged crash logs and syslogs.
+ *
+ *       Logs are compressed to a copy with the ".gz" extension added, using
+ *       the gzip format, and the original is then deleted. The reader detects
+ *       compressed contents by their magic number, so that the header and
+ *       fingerprint readers need not be told which files are compressed.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "log_compression.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const unsigned char kGzipMagic[2] = {0x1f, 0x8b};
+
+// NOTE: Adding 16 to the window size selects the gzip format (instead of the
+//       zlib format), so that compressed logs can also be read with gunzip.
+static const int kWindowBits = 16 + MAX_WBITS;
+
+// NOTE: Logs are compressed once, in the background, but may be read many
+//       times; decompression speed does not depend on the level.
+static const int kCompressionLevel = Z_BEST_COMPRESSION;
+
+#define kBufferSize (16 * 1024)
+
+struct log_reader {
+    int fd;
+    int is_compressed;
+    int is_finished;
+    z_stream stream;
+    unsigned char input[kBufferSize];
+    // NOTE: For uncompressed contents, the bytes read while checking for the
+    //       magic number, which are returned before reading any further.
+    size_t pending_offset;
+    size_t pending_length;
+};
+
+static ssize_t read_retrying(int fd, void *buffer, size_t size) {
+    ssize_t count;
+    do {
+        count = read(fd, buffer, size);
+    } while ((count < 0) && (errno == EINTR));
+    return count;
+}
+
+int log_compression_is_compressed(const void *bytes, size_t length) {
+    return (length >= sizeof(kGzipMagic)) && (memcmp(bytes, kGzipMagic, sizeof(kGzipMagic)) == 0);
+}
+
+int log_compression_compress_fd(int fd, FILE *output) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, kCompressionLevel, Z_DEFLATED, kWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "ERROR: Failed to initialize compression.\n");
+        return 0;
+    }
+
+    int succeeded = 0;
+    unsigned char *input = malloc(kBufferSize);
+    unsigned char *buffer = malloc(kBufferSize);
+    if ((input == NULL) || (buffer == NULL)) {
+        goto exit;
+    }
+
+    int flush = Z_NO_FLUSH;
+    while (flush != Z_FINISH) {
+        ssize_t count = read_retrying(fd, input, kBufferSize);
+        if (count < 0) {
+            fprintf(stderr, "ERROR: Failed to read log for compression, errno = %d.\n", errno);
+            goto exit;
+        }
+        flush = (count == 0) ? Z_FINISH : Z_NO_FLUSH;
+
+        stream.next_in = input;
+        stream.avail_in = count;
+        do {
+            stream.next_out = buffer;
+            stream.avail_out = kBufferSize;
+            const int result = deflate(&stream, flush);
+            if (result == Z_STREAM_ERROR) {
+                fprintf(stderr, "ERROR: Failed to compress log.\n");
+                goto exit;
+            }
+            const size_t length = kBufferSize - stream.avail_out;
+            if ((length != 0) && (fwrite(buffer, 1, length, output) != length)) {
+                fprintf(stderr, "ERROR: Failed to write compressed log, errno = %d.\n", errno);
+                goto exit;
+            }
+        } while (stream.avail_out == 0);
+    }
+    succeeded = 1;
+
+exit:
+    deflateEnd(&stream);
+    free(buffer);
+    free(input);
+    return succeeded;
+}
+
+log_reader_t *log_reader_open(int fd) {
+    log_reader_t *reader = calloc(1, sizeof(log_reader_t));
+    if (reader == NULL) {
+        return NULL;
+    }
+    reader->fd = fd;
+
+    // NOTE: Read a whole buffer rather than just the magic number; for
+    //       compressed contents, it is the first input to the decompressor.
+    ssize_t count = read_retrying(fd, reader->input, sizeof(reader->input));
+    if (count < 0) {
+        fprintf(stderr, "ERROR: Failed to read log, errno = %d.\n", errno);
+        free(reader);
+        return NULL;
+    }
+
+    if (log_compression_is_compressed(reader->input, count)) {
+        if (inflateInit2(&reader->stream, kWindowBits) != Z_OK) {
+            fprintf(stderr, "ERROR: Failed to initialize decompression.\n");
+            free(reader);
+            return NULL;
+        }
+        reader->is_compressed = 1;
+        reader->stream.next_in = reader->input;
+        reader->stream.avail_in = count;
+    } else {
+        reader->pending_length = count;
+    }
+
+    return reader;
+}
+
+ssize_t log_reader_read(log_reader_t *reader, void *buffer, size_t size) {
+    if (!reader->is_compressed) {
+        if (reader->pending_length != 0) {
+            if (size > reader->pending_length) {
+                size = reader->pending_length;
+            }
+            memcpy(buffer, reader->input + reader->pending_offset, size);
+            reader->pending_offset += size;
+            reader->pending_length -= size;
+            return size;
+        }
+        return read_retrying(reader->fd, buffer, size);
+    }
+
+    if (reader->is_finished || (size == 0)) {
+        return 0;
+    }
+
+    reader->stream.next_out = buffer;
+    reader->stream.avail_out = size;
+    while (reader->stream.avail_out == size) {
+        if (reader->stream.avail_in == 0) {
+            ssize_t count = read_retrying(reader->fd, reader->input, sizeof(reader->input));
+            if (count < 0) {
+                fprintf(stderr, "ERROR: Failed to read compressed log, errno = %d.\n", errno);
+                return -1;
+            } else if (count == 0) {
+                // NOTE: Truncated; return what could be decompressed.
+                reader->is_finished = 1;
+                break;
+            }
+            reader->stream.next_in = reader->input;
+            reader->stream.avail_in = count;
+        }
+
+        const int result = inflate(&reader->stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            reader->is_finished = 1;
+            break;
+        } else if ((result != Z_OK) && (result != Z_BUF_ERROR)) {
+            fprintf(stderr, "ERROR: Failed to decompress log, result = %d.\n", result);
+            return -1;
+        }
+    }
+
+    return size - reader->stream.avail_out;
+}
+
+void log_reader_close(log_reader_t *reader) {
+    if (reader != NULL) {
+        if (reader->is_compressed) {
+            inflateEnd(&reader->stream);
+        }
+        free(reader);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
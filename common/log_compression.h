@@ -0,0 +1,51 @@
+/**
+ * Desc: Compression of aged crash logs and syslogs.
+ *
+ *       Logs are compressed to a copy with the ".gz" extension added, using
+ *       the gzip format, and the original is then deleted. The reader detects
+ *       compressed contents by their magic number, so that the header and
+ *       fingerprint readers need not be told which files are compressed.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_LOG_COMPRESSION_H_
+#define COMMON_LOG_COMPRESSION_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct log_reader log_reader_t;
+
+// NOTE: Added to the filename of a compressed log.
+#define kCompressedPathExtension "gz"
+
+// NOTE: Returns non-zero if the data is gzip-compressed.
+int log_compression_is_compressed(const void *bytes, size_t length);
+
+// NOTE: Writes a compressed copy of the contents of the descriptor (from its
+//       current offset) to the output. Returns zero on error.
+int log_compression_compress_fd(int fd, FILE *output);
+
+// NOTE: Reads the contents of the descriptor (from its current offset),
+//       decompressing them if they are compressed. The descriptor is not
+//       closed by the reader.
+log_reader_t *log_reader_open(int fd);
+// NOTE: Returns the number of bytes read, zero at the end of the contents, or
+//       -1 on error.
+ssize_t log_reader_read(log_reader_t *reader, void *buffer, size_t size);
+void log_reader_close(log_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_LOG_COMPRESSION_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,243 @@
+/**
+ * Desc: Benchmark of the compression of aged logs, over synthetic crash logs
+ *       and syslogs: the space saved, and the time taken to read a log in
+ *       full and to read its header, before and after compression.
+ *
+ *       The synthetic logs contain random addresses and UUIDs, which compress
+ *       less well than those of real logs; the ratios are pessimistic.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "log_compression.h"
+
+#include <stdint.h>
+
+#include "crashlog_header.h"
+#include "test_util.h"
+
+static const unsigned kLogCount = 100;
+static const unsigned kThreadCount = 12;
+static const unsigned kFramesPerThread = 24;
+static const unsigned kImageCount = 280;
+static const unsigned kSyslogLineCount = 2500;
+
+static const char * const kImageNames[] = {
+    "libobjc.A.dylib", "CoreFoundation", "Foundation", "UIKit", "WebCore", "JavaScriptCore",
+    "libsystem_kernel.dylib", "libdispatch.dylib", "QuartzCore", "MobileSafari", "libsubstrate.dylib",
+};
+
+static const char * const kSenders[] = {
+    "MobileSafari", "SpringBoard", "backboardd", "kernel", "ReportCrash", "locationd", "mediaserverd",
+};
+
+typedef struct {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+} buffer_t;
+
+static void append(buffer_t *buffer, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        const int count = vsnprintf(buffer->bytes + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+        if ((size_t)count < buffer->capacity - buffer->length) {
+            buffer->length += count;
+            return;
+        }
+        buffer->capacity = 2 * buffer->capacity + count;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+    }
+}
+
+static uint64_t random64(void) {
+    return ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+}
+
+static void make_crash_log(buffer_t *buffer, unsigned n) {
+    buffer->length = 0;
+    append(buffer,
+        "{\"app_name\":\"MobileSafari\",\"timestamp\":\"2016-03-01 10:%02u:00.00 +0900\",\"bug_type\":\"109\","
+        "\"name\":\"MobileSafari\",\"bundleID\":\"com.apple.mobilesafari\"}\n"
+        "Incident Identifier: %08X-%04X-%04X-%04X-%012llX\n"
+        "Process:             MobileSafari [%u]\n"
+        "Path:                /Applications/MobileSafari.app/MobileSafari\n"
+        "Date/Time:           2016-03-01 10:%02u:00.00 +0900\n"
+        "Exception Type:  EXC_BAD_ACCESS (SIGSEGV)\n"
+        "Exception Subtype: KERN_INVALID_ADDRESS at 0x%016llx\n\n",
+        n % 60, rand(), rand() & 0xffff, rand() & 0xffff, rand() & 0xffff,
+        (unsigned long long)(random64() & 0xffffffffffffULL), 100 + n, n % 60,
+        (unsigned long long)random64());
+
+    const unsigned name_count = sizeof(kImageNames) / sizeof(kImageNames[0]);
+    for (unsigned t = 0; t < kThreadCount; ++t) {
+        append(buffer, (t == 0) ? "Thread %u Crashed:\n" : "Thread %u:\n", t);
+        for (unsigned f = 0; f < kFramesPerThread; ++f) {
+            const uint64_t base = 0x180000000ULL + ((uint64_t)(rand() % name_count) << 24);
+            const unsigned offset = rand() % 0x100000;
+            append(buffer, "%-3u %-30s\t0x%016llx 0x%llx + %u\n", f, kImageNames[rand() % name_count],
+                (unsigned long long)(base + offset), (unsigned long long)base, offset);
+        }
+        append(buffer, "\n");
+    }
+
+    append(buffer, "Binary Images:\n");
+    for (unsigned i = 0; i < kImageCount; ++i) {
+        const uint64_t base = 0x180000000ULL + ((uint64_t)i << 24);
+        append(buffer, "0x%llx - 0x%llx %s arm64  <%016llx%016llx> /System/Library/Frameworks/%s\n",
+            (unsigned long long)base, (unsigned long long)(base + (rand() % 0x1000000)),
+            kImageNames[i % name_count], (unsigned long long)random64(), (unsigned long long)random64(),
+            kImageNames[i % name_count]);
+    }
+}
+
+static void make_syslog(buffer_t *buffer, unsigned n) {
+    buffer->length = 0;
+    const unsigned sender_count = sizeof(kSenders) / sizeof(kSenders[0]);
+    for (unsigned i = 0; i < kSyslogLineCount; ++i) {
+        append(buffer, "Tue Mar  1 10:%02u:%02u 2016: %s (com.apple.%s): Some message that was logged (%u, 0x%x)\n",
+            (n + i / 60) % 60, i % 60, kSenders[i % sender_count], kSenders[rand() % sender_count],
+            rand() % 1000, rand());
+    }
+}
+
+static int compress_file(const char *filepath, const char *compressed_filepath) {
+    int fd = open(filepath, O_RDONLY);
+    FILE *f = fopen(compressed_filepath, "w");
+    const int did_compress = (fd >= 0) && (f != NULL) && log_compression_compress_fd(fd, f);
+    if (f != NULL) {
+        fclose(f);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return did_compress;
+}
+
+// NOTE: As dataForFile() does, for plain and compressed logs.
+static size_t read_file(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    log_reader_t *reader = log_reader_open(fd);
+    size_t length = 0;
+    char buffer[16384];
+    ssize_t count;
+    while ((reader != NULL) && ((count = log_reader_read(reader, buffer, sizeof(buffer))) > 0)) {
+        length += count;
+    }
+    log_reader_close(reader);
+    close(fd);
+    return length;
+}
+
+static off_t file_size(const char *filepath) {
+    struct stat st;
+    return (stat(filepath, &st) == 0) ? st.st_size : 0;
+}
+
+typedef struct {
+    off_t plain_size;
+    off_t compressed_size;
+    double compress_time;
+    double plain_read_time;
+    double compressed_read_time;
+    double plain_header_time;
+    double compressed_header_time;
+} results_t;
+
+static void measure(const char *directory, const char *extension, void (*make)(buffer_t *, unsigned),
+        int has_header, results_t *results) {
+    memset(results, 0, sizeof(*results));
+    buffer_t buffer = {malloc(65536), 0, 65536};
+
+    for (unsigned i = 0; i < kLogCount; ++i) {
+        char filepath[1024];
+        test_path(filepath, sizeof(filepath), directory, "MobileSafari-2016-03-01-10%04u.%s", i, extension);
+        make(&buffer, i);
+        CHECK(test_write_file(filepath, buffer.bytes, buffer.length));
+        results->plain_size += buffer.length;
+
+        char compressed_filepath[1040];
+        snprintf(compressed_filepath, sizeof(compressed_filepath), "%s." kCompressedPathExtension, filepath);
+        const double start = test_time();
+        CHECK(compress_file(filepath, compressed_filepath));
+        results->compress_time += test_time() - start;
+        results->compressed_size += file_size(compressed_filepath);
+    }
+    free(buffer.bytes);
+
+    // NOTE: Warm the cache, so that only the reading is timed.
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        results->plain_read_time = 0.0;
+        results->compressed_read_time = 0.0;
+        results->plain_header_time = 0.0;
+        results->compressed_header_time = 0.0;
+        for (unsigned i = 0; i < kLogCount; ++i) {
+            char filepath[1024];
+            test_path(filepath, sizeof(filepath), directory, "MobileSafari-2016-03-01-10%04u.%s", i, extension);
+            char compressed_filepath[1040];
+            snprintf(compressed_filepath, sizeof(compressed_filepath), "%s." kCompressedPathExtension, filepath);
+
+            double start = test_time();
+            const size_t plain_length = read_file(filepath);
+            results->plain_read_time += test_time() - start;
+            start = test_time();
+            const size_t compressed_length = read_file(compressed_filepath);
+            results->compressed_read_time += test_time() - start;
+            CHECK((plain_length > 0) && (compressed_length == plain_length));
+
+            if (has_header) {
+                crashlog_header_t header;
+                start = test_time();
+                CHECK(crashlog_header_read(filepath, &header));
+                results->plain_header_time += test_time() - start;
+                start = test_time();
+                CHECK(crashlog_header_read(compressed_filepath, &header));
+                results->compressed_header_time += test_time() - start;
+                CHECK(strcmp(header.name, "MobileSafari") == 0);
+            }
+        }
+    }
+}
+
+static void print_results(const char *title, const results_t *results, int has_header) {
+    printf("%u %s (%.1f KB each): %.2f MB -> %.2f MB (%.0f%% saved), compress %.2f ms per file\n"
+        "  full read:   %.3f ms -> %.3f ms per file\n",
+        kLogCount, title, results->plain_size / 1024.0 / kLogCount,
+        results->plain_size / 1048576.0, results->compressed_size / 1048576.0,
+        100.0 * (1.0 - (double)results->compressed_size / results->plain_size),
+        results->compress_time * 1000.0 / kLogCount,
+        results->plain_read_time * 1000.0 / kLogCount, results->compressed_read_time * 1000.0 / kLogCount);
+    if (has_header) {
+        printf("  header read: %.3f ms -> %.3f ms per file\n",
+            results->plain_header_time * 1000.0 / kLogCount, results->compressed_header_time * 1000.0 / kLogCount);
+    }
+}
+
+int main(void) {
+    char *directory = test_make_directory("log_compression_bench");
+    srand(1);
+
+    results_t logs;
+    measure(directory, "ips.synced", make_crash_log, 1, &logs);
+    results_t syslogs;
+    measure(directory, "syslog", make_syslog, 0, &syslogs);
+
+    print_results("crash logs", &logs, 1);
+    print_results("syslogs", &syslogs, 0);
+    const off_t plain_size = logs.plain_size + syslogs.plain_size;
+    const off_t compressed_size = logs.compressed_size + syslogs.compressed_size;
+    printf("Overall: %.2f MB -> %.2f MB (%.0f%% saved)\n",
+        plain_size / 1048576.0, compressed_size / 1048576.0,
+        100.0 * (1.0 - (double)compressed_size / plain_size));
+
+    test_remove_directory(directory);
+    return test_result("log_compression_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
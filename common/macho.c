@@ -0,0 +1,455 @@
+/**
+ * Desc: Minimal reader for Mach-O binaries (thin or fat), used to retrieve
+ *       the UUID, symbol table and linked libraries of a binary image without
+ *       loading it.
+ *
+ *       Only little-endian images are supported.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "macho.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+// NOTE: The definitions from <mach-o/loader.h>, <mach-o/fat.h> and
+//       <mach-o/nlist.h> are duplicated here (by value) so that this file can
+//       be built on platforms that do not provide those headers.
+#define kFatMagic           0xcafebabe
+#define kMachHeaderMagic    0xfeedface
+#define kMachHeaderMagic64  0xfeedfacf
+#define kMachHeaderSize     28
+#define kMachHeaderSize64   32
+#define kFatHeaderSize      8
+#define kFatArchSize        20
+#define kCPUSubtypeMask     0xff000000
+
+#define kLoadCommandSegment   0x1
+#define kLoadCommandSymtab    0x2
+#define kLoadCommandUUID      0x1b
+#define kLoadCommandSegment64 0x19
+#define kLoadCommandLoadDylib         0xc
+#define kLoadCommandLoadWeakDylib     0x80000018
+#define kLoadCommandReexportDylib     0x8000001f
+#define kLoadCommandLoadUpwardDylib   0x80000023
+#define kDylibCommandSize             24
+
+#define kSegmentCommandSize   56
+#define kSegmentCommandSize64 72
+#define kSectionSize          68
+#define kSectionSize64        80
+#define kSectionAttrPureInstructions 0x80000000
+#define kSectionAttrSomeInstructions 0x00000400
+#define kMaxSections          255
+
+#define kNlistSize          12
+#define kNlistSize64        16
+#define kNlistTypeStab      0xe0
+#define kNlistTypeMask      0x0e
+#define kNlistTypeSect      0x0e
+#define kNlistTypeExternal  0x01
+
+struct macho_file {
+    void *map;
+    size_t map_size;
+
+    // Selected slice.
+    const uint8_t *base;
+    size_t size;
+    int is_64;
+    const uint8_t *commands;
+    uint32_t command_count;
+
+    int has_uuid;
+    uint8_t uuid[16];
+    uint64_t text_address;
+
+    // NOTE: Symbols refer to sections by number (starting from one), in the
+    //       order in which the sections appear in the load commands.
+    uint32_t section_count;
+    struct {
+        uint64_t start;
+        uint64_t end;
+        int has_instructions;
+    } sections[kMaxSections];
+
+    uint32_t symbol_offset;
+    uint32_t symbol_count;
+    uint32_t string_offset;
+    uint32_t string_size;
+};
+
+static uint32_t read_uint32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read_uint64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t read_uint32_big(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// NOTE: Returns non-zero if the range lies within a buffer of the given size.
+static int in_bounds(uint64_t offset, uint64_t length, uint64_t size) {
+    return (offset <= size) && (length <= size - offset);
+}
+
+static void add_sections(macho_file_t *file, const uint8_t *command, uint32_t cmdsize, int is_64) {
+    const uint32_t header_size = is_64 ? kSegmentCommandSize64 : kSegmentCommandSize;
+    const uint32_t section_size = is_64 ? kSectionSize64 : kSectionSize;
+    const uint32_t section_count = read_uint32(command + (is_64 ? 64 : 48));
+    if (!in_bounds(header_size, (uint64_t)section_count * section_size, cmdsize)) {
+        return;
+    }
+
+    for (uint32_t i = 0; (i < section_count) && (file->section_count < kMaxSections); ++i) {
+        const uint8_t *section = command + header_size + i * section_size;
+        const uint64_t address = is_64 ? read_uint64(section + 32) : read_uint32(section + 32);
+        const uint64_t length = is_64 ? read_uint64(section + 40) : read_uint32(section + 36);
+        const uint32_t flags = read_uint32(section + (is_64 ? 64 : 56));
+
+        file->sections[file->section_count].start = address;
+        file->sections[file->section_count].end = address + length;
+        file->sections[file->section_count].has_instructions =
+            ((flags & (kSectionAttrPureInstructions | kSectionAttrSomeInstructions)) != 0);
+        ++file->section_count;
+    }
+}
+
+static int parse_slice(macho_file_t *file, const uint8_t *base, size_t size) {
+    if (size < kMachHeaderSize) {
+        return 0;
+    }
+
+    const uint32_t magic = read_uint32(base);
+    int is_64;
+    if (magic == kMachHeaderMagic) {
+        is_64 = 0;
+    } else if (magic == kMachHeaderMagic64) {
+        is_64 = 1;
+    } else {
+        return 0;
+    }
+
+    const size_t header_size = is_64 ? kMachHeaderSize64 : kMachHeaderSize;
+    const uint32_t command_count = read_uint32(base + 16);
+    const uint32_t commands_size = read_uint32(base + 20);
+    if (!in_bounds(header_size, commands_size, size)) {
+        return 0;
+    }
+
+    file->base = base;
+    file->size = size;
+    file->is_64 = is_64;
+    file->commands = base + header_size;
+    file->command_count = command_count;
+    file->has_uuid = 0;
+    file->text_address = 0;
+    file->section_count = 0;
+    file->symbol_count = 0;
+
+    const uint8_t *command = base + header_size;
+    const uint8_t *end = command + commands_size;
+    for (uint32_t i = 0; i < command_count; ++i) {
+        if ((end - command) < 8) {
+            return 0;
+        }
+        const uint32_t cmd = read_uint32(command);
+        const uint32_t cmdsize = read_uint32(command + 4);
+        if ((cmdsize < 8) || ((uint64_t)(end - command) < cmdsize)) {
+            return 0;
+        }
+
+        switch (cmd) {
+            case kLoadCommandSegment:
+                if (cmdsize >= kSegmentCommandSize) {
+                    if (strncmp((const char *)command + 8, "__TEXT", 16) == 0) {
+                        file->text_address = read_uint32(command + 24);
+                    }
+                    add_sections(file, command, cmdsize, 0);
+                }
+                break;
+            case kLoadCommandSegment64:
+                if (cmdsize >= kSegmentCommandSize64) {
+                    if (strncmp((const char *)command + 8, "__TEXT", 16) == 0) {
+                        file->text_address = read_uint64(command + 24);
+                    }
+                    add_sections(file, command, cmdsize, 1);
+                }
+                break;
+            case kLoadCommandSymtab:
+                if (cmdsize >= 24) {
+                    file->symbol_offset = read_uint32(command + 8);
+                    file->symbol_count = read_uint32(command + 12);
+                    file->string_offset = read_uint32(command + 16);
+                    file->string_size = read_uint32(command + 20);
+                    const uint64_t nlist_size = is_64 ? kNlistSize64 : kNlistSize;
+                    if (!in_bounds(file->symbol_offset, (uint64_t)file->symbol_count * nlist_size, size) ||
+                            !in_bounds(file->string_offset, file->string_size, size)) {
+                        return 0;
+                    }
+                }
+                break;
+            case kLoadCommandUUID:
+                if (cmdsize >= 24) {
+                    memcpy(file->uuid, command + 8, 16);
+                    file->has_uuid = 1;
+                }
+                break;
+            default:
+                break;
+        }
+        command += cmdsize;
+    }
+
+    return 1;
+}
+
+// NOTE: Mirrors the choice made by dyld: the slice for the exact CPU subtype
+//       if there is one, otherwise the newest slice that the CPU can run
+//       (for ARM, newer subtypes have larger values). Returns -1 if no slice
+//       is for the CPU type.
+static int64_t best_slice_for_cpu(const uint8_t *archs, uint32_t arch_count, uint32_t cputype, uint32_t cpusubtype) {
+    int64_t best = -1;
+    uint32_t best_subtype = 0;
+    cpusubtype &= ~kCPUSubtypeMask;
+    for (uint32_t i = 0; i < arch_count; ++i) {
+        const uint8_t *arch = archs + i * kFatArchSize;
+        const uint32_t subtype = read_uint32_big(arch + 4) & ~kCPUSubtypeMask;
+        if (read_uint32_big(arch) != cputype) {
+            continue;
+        }
+        if (subtype == cpusubtype) {
+            return i;
+        }
+        if ((subtype < cpusubtype) && ((best < 0) || (subtype > best_subtype))) {
+            best = i;
+            best_subtype = subtype;
+        }
+    }
+    return best;
+}
+
+static int slice_matches(macho_file_t *file, const uint8_t uuid[16]) {
+    return (uuid == NULL) || (file->has_uuid && (memcmp(file->uuid, uuid, 16) == 0));
+}
+
+static int select_slice(macho_file_t *file, const uint8_t uuid[16], const uint32_t *cpu) {
+    const uint8_t *map = file->map;
+    const size_t size = file->map_size;
+    if ((size >= kFatHeaderSize) && (read_uint32_big(map) == kFatMagic)) {
+        const uint32_t arch_count = read_uint32_big(map + 4);
+        if (!in_bounds(kFatHeaderSize, (uint64_t)arch_count * kFatArchSize, size)) {
+            return 0;
+        }
+        const uint8_t *archs = map + kFatHeaderSize;
+
+        if ((uuid == NULL) && (cpu != NULL)) {
+            const int64_t i = best_slice_for_cpu(archs, arch_count, cpu[0], cpu[1]);
+            if (i >= 0) {
+                const uint8_t *arch = archs + i * kFatArchSize;
+                const uint32_t offset = read_uint32_big(arch + 8);
+                const uint32_t slice_size = read_uint32_big(arch + 12);
+                if (in_bounds(offset, slice_size, size) && parse_slice(file, map + offset, slice_size)) {
+                    return 1;
+                }
+            }
+        }
+
+        // NOTE: If no slice is for the CPU, the first valid slice is used.
+        for (uint32_t i = 0; i < arch_count; ++i) {
+            const uint8_t *arch = archs + i * kFatArchSize;
+            const uint32_t offset = read_uint32_big(arch + 8);
+            const uint32_t slice_size = read_uint32_big(arch + 12);
+            if (in_bounds(offset, slice_size, size) && parse_slice(file, map + offset, slice_size)) {
+                if (slice_matches(file, uuid)) {
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    if (!parse_slice(file, map, size)) {
+        return 0;
+    }
+    return slice_matches(file, uuid);
+}
+
+static macho_file_t *open_file(const char *filepath, const uint8_t uuid[16], const uint32_t *cpu) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        // NOTE: Images in the shared cache do not exist as separate files.
+        if (errno != ENOENT) {
+            fprintf(stderr, "ERROR: Unable to open binary \"%s\", errno = %d.\n", filepath, errno);
+        }
+        return NULL;
+    }
+
+    macho_file_t *file = NULL;
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            file = calloc(1, sizeof(macho_file_t));
+            if (file != NULL) {
+                file->map = map;
+                file->map_size = st.st_size;
+                if (!select_slice(file, uuid, cpu)) {
+                    macho_close(file);
+                    file = NULL;
+                }
+            } else {
+                munmap(map, st.st_size);
+            }
+        } else {
+            fprintf(stderr, "ERROR: Unable to map binary \"%s\", errno = %d.\n", filepath, errno);
+        }
+    }
+
+    close(fd);
+    return file;
+}
+
+macho_file_t *macho_open(const char *filepath, const uint8_t uuid[16]) {
+    // NOTE: The CPU type of the running process is that of its main
+    //       executable; it is that slice of a library that would be loaded.
+#ifdef __APPLE__
+    if (uuid == NULL) {
+        const struct mach_header *header = _dyld_get_image_header(0);
+        if (header != NULL) {
+            return macho_open_for_cpu(filepath, (uint32_t)header->cputype, (uint32_t)header->cpusubtype);
+        }
+    }
+#endif
+    return open_file(filepath, uuid, NULL);
+}
+
+macho_file_t *macho_open_for_cpu(const char *filepath, uint32_t cputype, uint32_t cpusubtype) {
+    const uint32_t cpu[2] = {cputype, cpusubtype};
+    return open_file(filepath, NULL, cpu);
+}
+
+int macho_get_uuid(macho_file_t *file, uint8_t uuid[16]) {
+    if (file->has_uuid) {
+        memcpy(uuid, file->uuid, 16);
+        return 1;
+    }
+    return 0;
+}
+
+int macho_has_local_symbols(macho_file_t *file) {
+    const size_t nlist_size = file->is_64 ? kNlistSize64 : kNlistSize;
+    const uint8_t *symbols = file->base + file->symbol_offset;
+    for (uint32_t i = 0; i < file->symbol_count; ++i) {
+        const uint8_t type = symbols[i * nlist_size + 4];
+        if (((type & kNlistTypeStab) == 0) && ((type & kNlistTypeMask) == kNlistTypeSect) &&
+                ((type & kNlistTypeExternal) == 0)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int macho_enumerate_symbols(macho_file_t *file, macho_symbol_callback_t callback, void *context) {
+    int count = 0;
+
+    const size_t nlist_size = file->is_64 ? kNlistSize64 : kNlistSize;
+    const uint8_t *symbols = file->base + file->symbol_offset;
+    const char *strings = (const char *)file->base + file->string_offset;
+    for (uint32_t i = 0; i < file->symbol_count; ++i) {
+        const uint8_t *symbol = symbols + i * nlist_size;
+
+        // Only consider symbols that are defined in a section of this image
+        // that contains code.
+        const uint8_t type = symbol[4];
+        if (((type & kNlistTypeStab) != 0) || ((type & kNlistTypeMask) != kNlistTypeSect)) {
+            continue;
+        }
+        const uint8_t section_index = symbol[5];
+        if ((section_index == 0) || (section_index > file->section_count) ||
+                !file->sections[section_index - 1].has_instructions) {
+            continue;
+        }
+
+        // NOTE: The name must be terminated within the string table.
+        const uint32_t string_index = read_uint32(symbol);
+        if ((string_index == 0) || (string_index >= file->string_size) ||
+                (memchr(strings + string_index, '\0', file->string_size - string_index) == NULL)) {
+            continue;
+        }
+
+        const uint64_t value = file->is_64 ? read_uint64(symbol + 8) : read_uint32(symbol + 8);
+        const uint64_t section_end = file->sections[section_index - 1].end;
+        if ((value < file->text_address) || (value < file->sections[section_index - 1].start) ||
+                (value >= section_end)) {
+            continue;
+        }
+
+        callback(strings + string_index, value - file->text_address, section_end - file->text_address, context);
+        ++count;
+    }
+
+    return count;
+}
+
+int macho_enumerate_dylibs(macho_file_t *file, macho_dylib_callback_t callback, void *context) {
+    int count = 0;
+
+    // NOTE: The load commands were validated when the slice was parsed.
+    const uint8_t *command = file->commands;
+    for (uint32_t i = 0; i < file->command_count; ++i) {
+        const uint32_t cmd = read_uint32(command);
+        const uint32_t cmdsize = read_uint32(command + 4);
+
+        switch (cmd) {
+            case kLoadCommandLoadDylib:
+            case kLoadCommandLoadWeakDylib:
+            case kLoadCommandReexportDylib:
+            case kLoadCommandLoadUpwardDylib:
+                if (cmdsize >= kDylibCommandSize) {
+                    // NOTE: The name must be terminated within the command.
+                    const uint32_t name_offset = read_uint32(command + 8);
+                    if ((name_offset >= kDylibCommandSize) && (name_offset < cmdsize) &&
+                            (memchr(command + name_offset, '\0', cmdsize - name_offset) != NULL)) {
+                        callback((const char *)command + name_offset, context);
+                        ++count;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        command += cmdsize;
+    }
+
+    return count;
+}
+
+void macho_close(macho_file_t *file) {
+    if (file != NULL) {
+        munmap(file->map, file->map_size);
+        free(file);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,58 @@
+/**
+ * Desc: Minimal reader for Mach-O binaries (thin or fat), used to retrieve
+ *       the UUID, symbol table and linked libraries of a binary image without
+ *       loading it.
+ *
+ *       Only little-endian images are supported.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_MACHO_H_
+#define COMMON_MACHO_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct macho_file macho_file_t;
+
+// NOTE: Only symbols defined in sections that contain instructions (i.e.
+//       functions) are enumerated; the end of the containing section is given
+//       as well.
+// NOTE: Addresses are relative to the start of the __TEXT segment (i.e. to
+//       the address at which the image was loaded).
+// NOTE: The name is only valid for the duration of the callback.
+typedef void (*macho_symbol_callback_t)(const char *name, uint64_t address, uint64_t section_end, void *context);
+// NOTE: The path points into the mapped file; it is only valid until the file
+//       is closed.
+typedef void (*macho_dylib_callback_t)(const char *path, void *context);
+
+// NOTE: For fat binaries, the slice with the given UUID is used; if the UUID
+//       is NULL, the slice that the running process would load is used (on
+//       other platforms than iOS, the first slice).
+macho_file_t *macho_open(const char *filepath, const uint8_t uuid[16]);
+// NOTE: For fat binaries, the slice for the given CPU type and subtype (as in
+//       <mach/machine.h>) is used, or the newest slice that such a CPU can
+//       run; if there is none, the first slice is used.
+macho_file_t *macho_open_for_cpu(const char *filepath, uint32_t cputype, uint32_t cpusubtype);
+int macho_get_uuid(macho_file_t *file, uint8_t uuid[16]);
+// NOTE: Returns non-zero if the symbol table includes local (non-exported)
+//       symbols, i.e. if the binary has not been stripped.
+int macho_has_local_symbols(macho_file_t *file);
+int macho_enumerate_symbols(macho_file_t *file, macho_symbol_callback_t callback, void *context);
+// NOTE: Includes weakly-linked, re-exported and upward libraries, as all are
+//       loaded along with the image.
+int macho_enumerate_dylibs(macho_file_t *file, macho_dylib_callback_t callback, void *context);
+void macho_close(macho_file_t *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_MACHO_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,250 @@
+/**
+ * Desc: Test of the Mach-O reader against the checked-in fixtures (see
+ *       fixtures/make_macho_fixtures.py): thin and fat images, UUIDs, linked
+ *       libraries, symbols and the choice of slice.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "macho.h"
+
+#include <stdint.h>
+
+#include "test_util.h"
+
+#define kFixtureDirectory "common/fixtures/"
+
+// NOTE: Values from <mach/machine.h>.
+static const uint32_t kCPUTypeX86_64 = 0x01000007;
+static const uint32_t kCPUTypeARM = 12;
+static const uint32_t kCPUTypeARM64 = 0x0100000c;
+static const uint32_t kCPUSubtypeARMV6 = 6;
+static const uint32_t kCPUSubtypeARMV7 = 9;
+static const uint32_t kCPUSubtypeARMV7S = 11;
+static const uint32_t kCPUSubtypeARMV8 = 13;
+static const uint32_t kCPUSubtypeARM64All = 0;
+static const uint32_t kCPUSubtypeARM64E = 2;
+static const uint32_t kCPUSubtypeLib64 = 0x80000000;
+
+// NOTE: Kept in sync with the fixture script.
+static const char * const kCommonDylibs[] = {
+    "/System/Library/Frameworks/UIKit.framework/UIKit",
+    "/usr/lib/libsubstrate.dylib",
+    "/usr/lib/libSystem.B.dylib",
+};
+
+typedef struct {
+    char paths[8][256];
+    unsigned count;
+} dylib_list_t;
+
+static void add_dylib(const char *path, void *context) {
+    dylib_list_t *list = (dylib_list_t *)context;
+    if (list->count < 8) {
+        snprintf(list->paths[list->count], sizeof(list->paths[0]), "%s", path);
+    }
+    ++list->count;
+}
+
+typedef struct {
+    unsigned count;
+    int found_first;
+    int found_second;
+} symbol_list_t;
+
+static void add_symbol(const char *name, uint64_t address, uint64_t section_end, void *context) {
+    symbol_list_t *list = (symbol_list_t *)context;
+    ++list->count;
+    CHECK(section_end == 0x1100);
+    if (strcmp(name, "_first") == 0) {
+        CHECK(address == 0x1000);
+        list->found_first = 1;
+    } else if (strcmp(name, "_second") == 0) {
+        CHECK(address == 0x1040);
+        list->found_second = 1;
+    }
+}
+
+static void uuid_for_fixture(uint8_t uuid[16], uint8_t n) {
+    for (unsigned i = 0; i < 4; ++i) {
+        uuid[i] = n;
+    }
+    for (unsigned i = 0; i < 12; ++i) {
+        uuid[4 + i] = 0xa0 + i;
+    }
+}
+
+// NOTE: Returns the number of the fixture UUID of the selected slice, or zero.
+static uint8_t slice_number(macho_file_t *file) {
+    uint8_t uuid[16];
+    if ((file == NULL) || !macho_get_uuid(file, uuid)) {
+        return 0;
+    }
+    uint8_t expected[16];
+    uuid_for_fixture(expected, uuid[0]);
+    return (memcmp(uuid, expected, 16) == 0) ? uuid[0] : 0;
+}
+
+// NOTE: Checks the parts that every fixture image has; the last library
+//       differs between images.
+static void check_image(macho_file_t *file, const char *slice_dylib) {
+    CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+
+    // NOTE: The LC_ID_DYLIB command is not a linked library.
+    dylib_list_t dylibs;
+    memset(&dylibs, 0, sizeof(dylibs));
+    CHECK(macho_enumerate_dylibs(file, add_dylib, &dylibs) == 4);
+    CHECK(dylibs.count == 4);
+    for (unsigned i = 0; i < 3; ++i) {
+        CHECK(strcmp(dylibs.paths[i], kCommonDylibs[i]) == 0);
+    }
+    CHECK(strcmp(dylibs.paths[3], slice_dylib) == 0);
+
+    // NOTE: The constant in __const is not a function.
+    symbol_list_t symbols;
+    memset(&symbols, 0, sizeof(symbols));
+    CHECK(macho_enumerate_symbols(file, add_symbol, &symbols) == 2);
+    CHECK((symbols.count == 2) && symbols.found_first && symbols.found_second);
+    CHECK(macho_has_local_symbols(file));
+}
+
+static void test_thin(void) {
+    macho_file_t *file = macho_open(kFixtureDirectory "thin_arm64.dylib", NULL);
+    check_image(file, "/usr/lib/libarm64.dylib");
+    CHECK(slice_number(file) == 1);
+    macho_close(file);
+
+    file = macho_open(kFixtureDirectory "thin_armv7.dylib", NULL);
+    check_image(file, "/usr/lib/libarmv7.dylib");
+    CHECK(slice_number(file) == 2);
+    macho_close(file);
+
+    // A thin image is used whatever the CPU, but only if its UUID matches.
+    file = macho_open_for_cpu(kFixtureDirectory "thin_armv7.dylib", kCPUTypeARM64, kCPUSubtypeARM64All);
+    CHECK(slice_number(file) == 2);
+    macho_close(file);
+
+    uint8_t uuid[16];
+    uuid_for_fixture(uuid, 1);
+    file = macho_open(kFixtureDirectory "thin_arm64.dylib", uuid);
+    CHECK(slice_number(file) == 1);
+    macho_close(file);
+    uuid_for_fixture(uuid, 2);
+    CHECK(macho_open(kFixtureDirectory "thin_arm64.dylib", uuid) == NULL);
+}
+
+static void test_fat(void) {
+    // Slices are selected by UUID.
+    static const char * const kSliceDylibs[] = {
+        "/usr/lib/libarmv7.dylib", "/usr/lib/libarmv7s.dylib", "/usr/lib/libarm64.dylib"
+    };
+    for (uint8_t n = 3; n <= 5; ++n) {
+        uint8_t uuid[16];
+        uuid_for_fixture(uuid, n);
+        macho_file_t *file = macho_open(kFixtureDirectory "fat.dylib", uuid);
+        check_image(file, kSliceDylibs[n - 3]);
+        CHECK(slice_number(file) == n);
+        macho_close(file);
+    }
+    uint8_t uuid[16];
+    uuid_for_fixture(uuid, 1);
+    CHECK(macho_open(kFixtureDirectory "fat.dylib", uuid) == NULL);
+
+    // Slices are selected by CPU: the exact subtype if present, otherwise the
+    // newest that the CPU can run, otherwise the first.
+    static const struct {
+        uint32_t cputype;
+        uint32_t cpusubtype;
+        uint8_t expected;
+    } kCases[] = {
+        {kCPUTypeARM64, kCPUSubtypeARM64All, 5},
+        {kCPUTypeARM64, kCPUSubtypeARM64E, 5},
+        {kCPUTypeARM64, kCPUSubtypeARM64All | kCPUSubtypeLib64, 5},
+        {kCPUTypeARM, kCPUSubtypeARMV7S, 4},
+        {kCPUTypeARM, kCPUSubtypeARMV7, 3},
+        {kCPUTypeARM, kCPUSubtypeARMV8, 4},
+        {kCPUTypeARM, kCPUSubtypeARMV6, 3},
+        {kCPUTypeX86_64, 3, 3},
+    };
+    for (unsigned i = 0; i < sizeof(kCases) / sizeof(kCases[0]); ++i) {
+        macho_file_t *file = macho_open_for_cpu(kFixtureDirectory "fat.dylib", kCases[i].cputype, kCases[i].cpusubtype);
+        if (slice_number(file) != kCases[i].expected) {
+            fprintf(stderr, "Wrong slice for CPU %#x/%#x: %u\n", kCases[i].cputype, kCases[i].cpusubtype,
+                slice_number(file));
+        }
+        CHECK(slice_number(file) == kCases[i].expected);
+        macho_close(file);
+    }
+
+    // NOTE: On Linux, there is no running slice; the first is used.
+    macho_file_t *file = macho_open(kFixtureDirectory "fat.dylib", NULL);
+    CHECK(slice_number(file) != 0);
+    macho_close(file);
+}
+
+static void ignore_symbol(const char *name, uint64_t address, uint64_t section_end, void *context) {
+    (void)name;
+    (void)address;
+    (void)section_end;
+    (void)context;
+}
+
+// NOTE: Truncated and corrupted copies must be rejected (or read within
+//       bounds), never crash.
+static void test_corrupt(const char *directory) {
+    static const char * const kFixtures[] = {"thin_arm64.dylib", "thin_armv7.dylib", "fat.dylib"};
+    for (unsigned f = 0; f < 3; ++f) {
+        char source[1024];
+        snprintf(source, sizeof(source), kFixtureDirectory "%s", kFixtures[f]);
+        FILE *in = fopen(source, "rb");
+        CHECK(in != NULL);
+        if (in == NULL) {
+            continue;
+        }
+        uint8_t bytes[32768];
+        const size_t length = fread(bytes, 1, sizeof(bytes), in);
+        fclose(in);
+
+        char filepath[1024];
+        test_path(filepath, sizeof(filepath), directory, "corrupt.dylib");
+        for (unsigned i = 0; i < 2000; ++i) {
+            uint8_t copy[32768];
+            memcpy(copy, bytes, length);
+            size_t copy_length = length;
+            if (i % 2 == 0) {
+                copy_length = rand() % length;
+            } else {
+                for (unsigned j = 0; j < 4; ++j) {
+                    copy[rand() % 4096] = (uint8_t)rand();
+                }
+            }
+            CHECK(test_write_file(filepath, copy, copy_length));
+
+            macho_file_t *file = macho_open(filepath, NULL);
+            if (file != NULL) {
+                dylib_list_t dylibs;
+                memset(&dylibs, 0, sizeof(dylibs));
+                macho_enumerate_dylibs(file, add_dylib, &dylibs);
+                macho_enumerate_symbols(file, ignore_symbol, NULL);
+                macho_has_local_symbols(file);
+                macho_close(file);
+            }
+        }
+    }
+}
+
+int main(void) {
+    char *directory = test_make_directory("macho_test");
+    srand(1);
+    test_thin();
+    test_fat();
+    test_corrupt(directory);
+    test_remove_directory(directory);
+    return test_result("macho_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
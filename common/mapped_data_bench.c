@@ -0,0 +1,256 @@
+/**
+ * Desc: Benchmark of loading large crash logs: a C mirror of
+ *       createDataForFileDescriptor(), comparing the reading of each file into
+ *       memory with the mapping of files whose modification time has settled
+ *       (recently modified files are still read). Reports the latency of a
+ *       load (to the first byte, and with every byte scanned, as when parsing)
+ *       and the peak resident memory of a process that keeps every loaded
+ *       report, split into anonymous memory and (discardable) file pages.
+ *
+ *       Each mode is run in a separate process, so that peaks do not mix.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <utime.h>
+
+#include "test_util.h"
+
+static const unsigned kFileCount = 48;
+static const size_t kFileSize = 1024 * 1024;
+static const off_t kMappedDataThreshold = 64 * 1024;
+static const time_t kMappedDataSettleInterval = 30;
+
+typedef enum {
+    kLoadRead,
+    kLoadMapSettled
+} load_mode_t;
+
+typedef struct {
+    void *bytes;
+    size_t length;
+    int mapped;
+} loaded_t;
+
+typedef struct {
+    double first_byte_time;
+    double scan_time;
+    unsigned mapped_count;
+    long peak_rss_kb;
+    long anon_kb;
+    long file_kb;
+} result_t;
+
+static int load(int fd, load_mode_t mode, loaded_t *loaded) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return 0;
+    }
+
+    const int is_settled = (time(NULL) - st.st_mtime >= kMappedDataSettleInterval);
+    if ((mode == kLoadMapSettled) && (st.st_size >= kMappedDataThreshold) && is_settled) {
+        void *bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (bytes != MAP_FAILED) {
+            madvise(bytes, st.st_size, MADV_SEQUENTIAL);
+            loaded->bytes = bytes;
+            loaded->length = st.st_size;
+            loaded->mapped = 1;
+            return 1;
+        }
+    }
+
+    // NOTE: As NSMutableData, grown from the size of the file.
+    size_t capacity = st.st_size;
+    size_t length = 0;
+    char *bytes = malloc(capacity);
+    char buffer[16384];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (length + count > capacity) {
+            capacity = 2 * (length + count);
+            bytes = realloc(bytes, capacity);
+        }
+        memcpy(bytes + length, buffer, count);
+        length += count;
+    }
+    loaded->bytes = bytes;
+    loaded->length = length;
+    loaded->mapped = 0;
+    return count == 0;
+}
+
+static unsigned count_lines(const loaded_t *loaded) {
+    unsigned count = 0;
+    const char *p = loaded->bytes;
+    const char *end = p + loaded->length;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+static long status_kb(const char *key) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL) {
+        return -1;
+    }
+    long value = -1;
+    char line[256];
+    const size_t key_length = strlen(key);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if ((strncmp(line, key, key_length) == 0) && (line[key_length] == ':')) {
+            value = atol(line + key_length + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+static void run_mode(const char *directory, load_mode_t mode, result_t *result) {
+    loaded_t *loaded = calloc(kFileCount, sizeof(loaded_t));
+    memset(result, 0, sizeof(*result));
+
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char filepath[1024];
+        test_path(filepath, sizeof(filepath), directory, "Process-%02u.ips", i);
+
+        double start = test_time();
+        int fd = open(filepath, O_RDONLY);
+        CHECK(fd >= 0);
+        CHECK(load(fd, mode, &loaded[i]));
+        close(fd);
+        volatile char first = ((const char *)loaded[i].bytes)[0];
+        (void)first;
+        result->first_byte_time += test_time() - start;
+
+        start = test_time();
+        CHECK(count_lines(&loaded[i]) == kFileSize / 64);
+        result->scan_time += test_time() - start;
+        result->mapped_count += loaded[i].mapped;
+    }
+
+    // NOTE: Every report is still held.
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result->peak_rss_kb = usage.ru_maxrss;
+    result->anon_kb = status_kb("RssAnon");
+    result->file_kb = status_kb("RssFile");
+
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        if (loaded[i].mapped) {
+            munmap(loaded[i].bytes, loaded[i].length);
+        } else {
+            free(loaded[i].bytes);
+        }
+    }
+    free(loaded);
+}
+
+// NOTE: Runs the mode in a child process, whose results are passed back via a
+//       pipe.
+static int run_mode_in_child(const char *directory, load_mode_t mode, result_t *result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        run_mode(directory, mode, result);
+        const ssize_t count = write(fds[1], result, sizeof(*result));
+        _exit(((count == sizeof(*result)) && (test_failures == 0)) ? 0 : 1);
+    }
+    close(fds[1]);
+    const ssize_t count = (pid > 0) ? read(fds[0], result, sizeof(*result)) : -1;
+    close(fds[0]);
+    int stat_loc = 0;
+    if (pid > 0) {
+        waitpid(pid, &stat_loc, 0);
+    }
+    return (count == sizeof(*result)) && WIFEXITED(stat_loc) && (WEXITSTATUS(stat_loc) == 0);
+}
+
+static void make_file(const char *filepath, time_t mtime) {
+    char *bytes = malloc(kFileSize);
+    for (size_t i = 0; i < kFileSize; i += 64) {
+        memset(bytes + i, 'a' + (i / 64) % 26, 63);
+        bytes[i + 63] = '\n';
+    }
+    CHECK(test_write_file(filepath, bytes, kFileSize));
+    free(bytes);
+
+    struct utimbuf times = {mtime, mtime};
+    CHECK(utime(filepath, &times) == 0);
+}
+
+// NOTE: A file that is still being written is truncated after it is loaded; it
+//       must have been read (a mapping would raise SIGBUS).
+static int survives_truncation(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "Writing.ips");
+    make_file(filepath, time(NULL));
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(filepath, O_RDONLY);
+        loaded_t loaded;
+        if ((fd < 0) || !load(fd, kLoadMapSettled, &loaded)) {
+            _exit(1);
+        }
+        close(fd);
+        if (truncate(filepath, 0) != 0) {
+            _exit(1);
+        }
+        _exit(count_lines(&loaded) == kFileSize / 64 ? 0 : 1);
+    }
+    int stat_loc = 0;
+    waitpid(pid, &stat_loc, 0);
+    return WIFEXITED(stat_loc) && (WEXITSTATUS(stat_loc) == 0);
+}
+
+static void print_result(const char *label, const result_t *result) {
+    printf("  %-16s %6.3f ms to first byte, %6.3f ms scanned per file; peak RSS %5.1f MB (anonymous %5.1f MB, file %5.1f MB)\n",
+        label, result->first_byte_time * 1000.0 / kFileCount, result->scan_time * 1000.0 / kFileCount,
+        result->peak_rss_kb / 1024.0, result->anon_kb / 1024.0, result->file_kb / 1024.0);
+}
+
+int main(void) {
+    char *directory = test_make_directory("mapped_data_bench");
+
+    // NOTE: Half of the files were written long ago; the rest just now.
+    const time_t now = time(NULL);
+    for (unsigned i = 0; i < kFileCount; ++i) {
+        char filepath[1024];
+        test_path(filepath, sizeof(filepath), directory, "Process-%02u.ips", i);
+        make_file(filepath, (i % 2) ? now : now - 3600);
+    }
+
+    // NOTE: Warm the page cache, so that both modes read from memory.
+    result_t result;
+    CHECK(run_mode_in_child(directory, kLoadRead, &result));
+
+    printf("Load %u crash logs of %zu KB (half of them recently modified) and keep them:\n",
+        kFileCount, kFileSize / 1024);
+    CHECK(run_mode_in_child(directory, kLoadRead, &result));
+    CHECK(result.mapped_count == 0);
+    print_result("read:", &result);
+    CHECK(run_mode_in_child(directory, kLoadMapSettled, &result));
+    CHECK(result.mapped_count == kFileCount / 2);
+    print_result("map if settled:", &result);
+
+    CHECK(survives_truncation(directory));
+
+    test_remove_directory(directory);
+    return test_result("mapped_data_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
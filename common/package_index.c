@@ -0,0 +1,676 @@
+/**
+ * Desc: Index of the files installed by dpkg packages, mapping each file path
+ *       to the identifier of the package that installed it.
+ *
+ *       The index is built from dpkg's database (the status file and the
+ *       info/<package>.list files) and then memory-mapped (read-only). When
+ *       the database changes, the index is rebuilt, reading only the lists
+ *       of packages that have been installed or updated since.
+ *
+ *       Lookups do not allocate memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "package_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: The index is a local cache; values are stored in native byte order. If
+//       the format changes, the version must be bumped, which causes any
+//       existing index to be rebuilt.
+// NOTE: Layout is the header, followed by the array of packages, the array of
+//       paths (sorted by hash), and the string pool.
+static const char kIndexMagic[4] = {'C', 'R', 'P', 'K'};
+static const uint32_t kIndexVersion = 1;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // NOTE: Identity of dpkg's status file when the index was built; dpkg
+    //       rewrites the file whenever a package is installed or removed.
+    uint64_t status_inode;
+    uint64_t status_size;
+    int64_t status_mtime;
+    uint32_t package_count;
+    uint32_t path_count;
+    uint32_t string_size;
+    uint32_t reserved;
+} index_header_t;
+
+typedef struct {
+    // NOTE: Identity of the list file of the package, used to determine
+    //       whether the list must be read again when the index is rebuilt.
+    uint64_t list_inode;
+    uint64_t list_size;
+    int64_t list_mtime;
+    uint32_t name_offset;
+    uint32_t reserved;
+} index_package_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t path_offset;
+    uint32_t package;
+} index_path_t;
+
+struct package_index {
+    char *status_filepath;
+    void *map;
+    size_t map_size;
+    const index_header_t *header;
+    const index_package_t *packages;
+    const index_path_t *paths;
+    const char *strings;
+};
+
+typedef struct {
+    index_path_t record;
+    // NOTE: Set once all paths have been added (the pool is no longer
+    //       reallocated), for sorting.
+    const char *string;
+    // NOTE: Used to keep the packages of a path in the order they were added.
+    uint32_t order;
+} builder_path_t;
+
+typedef struct {
+    index_package_t *packages;
+    size_t package_count;
+    size_t package_capacity;
+    builder_path_t *paths;
+    size_t path_count;
+    size_t path_capacity;
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+    int failed;
+} builder_t;
+
+static uint32_t hash_string(const char *string) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)string; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int identity_matches(uint64_t inode, uint64_t size, int64_t mtime, const struct stat *st) {
+    return (inode == (uint64_t)st->st_ino) && (size == (uint64_t)st->st_size) && (mtime == (int64_t)st->st_mtime);
+}
+
+static uint32_t builder_add_string(builder_t *builder, const char *string, size_t length) {
+    if (builder->string_size + length + 1 >= UINT32_MAX) {
+        builder->failed = 1;
+    }
+    if (builder->failed) {
+        return 0;
+    }
+
+    if (builder->string_size + length + 1 > builder->string_capacity) {
+        size_t capacity = (builder->string_capacity != 0) ? builder->string_capacity : 65536;
+        while (builder->string_size + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        char *strings = realloc(builder->strings, capacity);
+        if (strings == NULL) {
+            builder->failed = 1;
+            return 0;
+        }
+        builder->strings = strings;
+        builder->string_capacity = capacity;
+    }
+
+    const uint32_t offset = builder->string_size;
+    memcpy(builder->strings + offset, string, length);
+    builder->strings[offset + length] = '\0';
+    builder->string_size += length + 1;
+    return offset;
+}
+
+static uint32_t builder_add_package(builder_t *builder, const char *name, const struct stat *st) {
+    if (builder->package_count == builder->package_capacity) {
+        size_t capacity = (builder->package_capacity != 0) ? (2 * builder->package_capacity) : 256;
+        index_package_t *packages = realloc(builder->packages, capacity * sizeof(index_package_t));
+        if (packages == NULL) {
+            builder->failed = 1;
+            return 0;
+        }
+        builder->packages = packages;
+        builder->package_capacity = capacity;
+    }
+
+    index_package_t *package = &builder->packages[builder->package_count];
+    memset(package, 0, sizeof(*package));
+    package->list_inode = st->st_ino;
+    package->list_size = st->st_size;
+    package->list_mtime = st->st_mtime;
+    package->name_offset = builder_add_string(builder, name, strlen(name));
+    return builder->package_count++;
+}
+
+static void builder_add_path(builder_t *builder, const char *path, size_t length, uint32_t package) {
+    if (builder->path_count >= UINT32_MAX) {
+        builder->failed = 1;
+    }
+    if (builder->failed) {
+        return;
+    }
+
+    if (builder->path_count == builder->path_capacity) {
+        size_t capacity = (builder->path_capacity != 0) ? (2 * builder->path_capacity) : 16384;
+        builder_path_t *paths = realloc(builder->paths, capacity * sizeof(builder_path_t));
+        if (paths == NULL) {
+            builder->failed = 1;
+            return;
+        }
+        builder->paths = paths;
+        builder->path_capacity = capacity;
+    }
+
+    const uint32_t offset = builder_add_string(builder, path, length);
+    if (!builder->failed) {
+        builder_path_t *entry = &builder->paths[builder->path_count];
+        entry->record.hash = hash_string(builder->strings + offset);
+        entry->record.path_offset = offset;
+        entry->record.package = package;
+        entry->order = builder->path_count;
+        ++builder->path_count;
+    }
+}
+
+static void builder_free(builder_t *builder) {
+    free(builder->packages);
+    free(builder->paths);
+    free(builder->strings);
+}
+
+static int read_list(builder_t *builder, const char *filepath, uint32_t package) {
+    FILE *f = fopen(filepath, "r");
+    if (f == NULL) {
+        fprintf(stderr, "WARNING: Unable to open package list \"%s\", errno = %d.\n", filepath, errno);
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, f)) > 0) {
+        if (line[length - 1] == '\n') {
+            --length;
+        }
+        if (length > 0) {
+            builder_add_path(builder, line, length, package);
+        }
+    }
+    free(line);
+    fclose(f);
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    uint32_t number;
+} previous_package_t;
+
+typedef struct {
+    builder_t *builder;
+    const package_index_t *previous;
+    // NOTE: The packages of the previous index, sorted by name.
+    previous_package_t *previous_packages;
+    size_t previous_package_count;
+    // NOTE: For each package of the previous index, the number of the same
+    //       package in the new index, if its list has not changed.
+    uint32_t *reused;
+    const char *dpkg_directory;
+} build_context_t;
+
+static int compare_previous_packages(const void *a, const void *b) {
+    const previous_package_t *package_a = a;
+    const previous_package_t *package_b = b;
+    const int result = strcmp(package_a->name, package_b->name);
+    if (result != 0) {
+        return result;
+    }
+    return (package_a->number < package_b->number) ? -1 : (package_a->number > package_b->number);
+}
+
+// NOTE: Returns the package of the previous index with the same name and an
+//       unchanged list, if any.
+// NOTE: The packages of the previous index are sorted once, rather than
+//       searched for each package of the status file. A name may appear more
+//       than once, for packages of several architectures (multiarch).
+static int find_unchanged_package(const build_context_t *context, const char *name, const struct stat *st,
+        uint32_t *number) {
+    size_t low = 0;
+    size_t high = context->previous_package_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (strcmp(context->previous_packages[middle].name, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (size_t i = low; (i < context->previous_package_count) &&
+            (strcmp(context->previous_packages[i].name, name) == 0); ++i) {
+        const uint32_t n = context->previous_packages[i].number;
+        const index_package_t *package = &context->previous->packages[n];
+        if ((context->reused[n] == UINT32_MAX) &&
+                identity_matches(package->list_inode, package->list_size, package->list_mtime, st)) {
+            *number = n;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void add_package(build_context_t *context, const char *name, const char *architecture) {
+    // NOTE: For packages of a foreign architecture (multiarch), the name of
+    //       the list includes the architecture.
+    const size_t length = strlen(context->dpkg_directory) + strlen(name) + strlen(architecture) + 16;
+    char filepath[length];
+    snprintf(filepath, length, "%s/info/%s.list", context->dpkg_directory, name);
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        snprintf(filepath, length, "%s/info/%s:%s.list", context->dpkg_directory, name, architecture);
+        if (stat(filepath, &st) != 0) {
+            // Package does not install any files.
+            return;
+        }
+    }
+
+    builder_t *builder = context->builder;
+    const uint32_t package = builder_add_package(builder, name, &st);
+    if (builder->failed) {
+        return;
+    }
+
+    uint32_t number;
+    if (find_unchanged_package(context, name, &st, &number)) {
+        // Paths are copied from the previous index.
+        context->reused[number] = package;
+    } else {
+        read_list(builder, filepath, package);
+    }
+}
+
+static int has_files(const char *status) {
+    // NOTE: The status field is "<want> <flag> <status>"; packages that have
+    //       been removed (but not purged) only have configuration files.
+    const char *state = strrchr(status, ' ');
+    state = (state != NULL) ? (state + 1) : status;
+    return (strcmp(state, "not-installed") != 0) && (strcmp(state, "config-files") != 0);
+}
+
+static int read_status(build_context_t *context, const char *filepath) {
+    FILE *f = fopen(filepath, "r");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to open dpkg status file \"%s\", errno = %d.\n", filepath, errno);
+        return 0;
+    }
+
+    char *name = NULL;
+    char *architecture = NULL;
+    char *status = NULL;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    do {
+        length = getline(&line, &capacity, f);
+        if ((length > 0) && (line[length - 1] == '\n')) {
+            line[--length] = '\0';
+        }
+
+        if (length <= 0) {
+            // End of paragraph (or of file).
+            if ((name != NULL) && (status != NULL) && has_files(status)) {
+                add_package(context, name, (architecture != NULL) ? architecture : "");
+            }
+            free(name);
+            free(architecture);
+            free(status);
+            name = architecture = status = NULL;
+        } else if (strncmp(line, "Package: ", 9) == 0) {
+            free(name);
+            name = strdup(line + 9);
+        } else if (strncmp(line, "Architecture: ", 14) == 0) {
+            free(architecture);
+            architecture = strdup(line + 14);
+        } else if (strncmp(line, "Status: ", 8) == 0) {
+            free(status);
+            status = strdup(line + 8);
+        }
+    } while (length >= 0);
+
+    free(line);
+    fclose(f);
+    return 1;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    const builder_path_t *path_a = a;
+    const builder_path_t *path_b = b;
+    if (path_a->record.hash != path_b->record.hash) {
+        return (path_a->record.hash < path_b->record.hash) ? -1 : 1;
+    }
+    const int result = strcmp(path_a->string, path_b->string);
+    if (result != 0) {
+        return result;
+    }
+    return (path_a->order < path_b->order) ? -1 : (path_a->order > path_b->order);
+}
+
+static int write_index(builder_t *builder, const struct stat *status_st, const char *filepath) {
+    // Sort by hash; paths listed by several packages (i.e. directories) are
+    // kept in the order that they were added.
+    // NOTE: All records are kept, so that the paths of a package can be copied
+    //       from the index when it is next rebuilt.
+    for (size_t i = 0; i < builder->path_count; ++i) {
+        builder->paths[i].string = builder->strings + builder->paths[i].record.path_offset;
+    }
+    qsort(builder->paths, builder->path_count, sizeof(builder_path_t), compare_paths);
+
+    // Determine the offsets of the strings in the index.
+    // NOTE: The string pool is written anew, with package names first; each
+    //       distinct path is written only once.
+    uint32_t *offsets = malloc((builder->path_count + 1) * sizeof(uint32_t));
+    if (offsets == NULL) {
+        return 0;
+    }
+    uint64_t string_size = 0;
+    for (size_t i = 0; i < builder->package_count; ++i) {
+        string_size += strlen(builder->strings + builder->packages[i].name_offset) + 1;
+    }
+    for (size_t i = 0; (i < builder->path_count) && (string_size < UINT32_MAX); ++i) {
+        const builder_path_t *path = &builder->paths[i];
+        if ((i != 0) && (path->record.hash == path[-1].record.hash) && (strcmp(path->string, path[-1].string) == 0)) {
+            offsets[i] = offsets[i - 1];
+        } else {
+            offsets[i] = string_size;
+            string_size += strlen(path->string) + 1;
+        }
+    }
+    if (string_size >= UINT32_MAX) {
+        free(offsets);
+        return 0;
+    }
+
+    // NOTE: Write to a temporary file and rename so that readers never see a
+    //       partially written index.
+    const size_t length = strlen(filepath) + 16;
+    char temp_filepath[length];
+    snprintf(temp_filepath, length, "%s.%d", filepath, (int)getpid());
+
+    FILE *f = fopen(temp_filepath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to write package index \"%s\", errno = %d.\n", temp_filepath, errno);
+        free(offsets);
+        return 0;
+    }
+
+    index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.status_inode = status_st->st_ino;
+    header.status_size = status_st->st_size;
+    header.status_mtime = status_st->st_mtime;
+    header.package_count = builder->package_count;
+    header.path_count = builder->path_count;
+    header.string_size = string_size;
+    int succeeded = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    uint32_t offset = 0;
+    for (size_t i = 0; succeeded && (i < builder->package_count); ++i) {
+        index_package_t record = builder->packages[i];
+        const char *name = builder->strings + record.name_offset;
+        record.name_offset = offset;
+        offset += strlen(name) + 1;
+        succeeded = (fwrite(&record, sizeof(record), 1, f) == 1);
+    }
+    for (size_t i = 0; succeeded && (i < builder->path_count); ++i) {
+        index_path_t record = builder->paths[i].record;
+        record.path_offset = offsets[i];
+        succeeded = (fwrite(&record, sizeof(record), 1, f) == 1);
+    }
+    for (size_t i = 0; succeeded && (i < builder->package_count); ++i) {
+        const char *name = builder->strings + builder->packages[i].name_offset;
+        succeeded = (fputs(name, f) >= 0) && (fputc('\0', f) != EOF);
+    }
+    for (size_t i = 0; succeeded && (i < builder->path_count); ++i) {
+        if ((i == 0) || (offsets[i] != offsets[i - 1])) {
+            const char *path = builder->paths[i].string;
+            succeeded = (fputs(path, f) >= 0) && (fputc('\0', f) != EOF);
+        }
+    }
+    free(offsets);
+
+    if (fclose(f) != 0) {
+        succeeded = 0;
+    }
+    if (succeeded && (rename(temp_filepath, filepath) != 0)) {
+        succeeded = 0;
+    }
+    if (!succeeded) {
+        fprintf(stderr, "ERROR: Failed to save package index \"%s\", errno = %d.\n", filepath, errno);
+        unlink(temp_filepath);
+    }
+    return succeeded;
+}
+
+static int build(const char *filepath, const char *dpkg_directory, const char *status_filepath,
+        const struct stat *status_st, const package_index_t *previous) {
+    builder_t builder;
+    memset(&builder, 0, sizeof(builder));
+
+    build_context_t context;
+    context.builder = &builder;
+    context.previous = previous;
+    context.previous_packages = NULL;
+    context.previous_package_count = 0;
+    context.reused = NULL;
+    context.dpkg_directory = dpkg_directory;
+
+    int succeeded = 0;
+    if (previous != NULL) {
+        const uint32_t count = previous->header->package_count;
+        context.reused = malloc((count + 1) * sizeof(uint32_t));
+        if (context.reused == NULL) {
+            goto exit;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            context.reused[i] = UINT32_MAX;
+        }
+
+        context.previous_packages = malloc((count + 1) * sizeof(previous_package_t));
+        if (context.previous_packages == NULL) {
+            goto exit;
+        }
+        const uint32_t string_size = previous->header->string_size;
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t name_offset = previous->packages[i].name_offset;
+            if (name_offset < string_size) {
+                previous_package_t *package = &context.previous_packages[context.previous_package_count++];
+                package->name = previous->strings + name_offset;
+                package->number = i;
+            }
+        }
+        qsort(context.previous_packages, context.previous_package_count, sizeof(previous_package_t),
+            compare_previous_packages);
+    }
+
+    if (!read_status(&context, status_filepath)) {
+        goto exit;
+    }
+
+    // Copy the paths of packages whose lists have not changed.
+    if (previous != NULL) {
+        const uint32_t string_size = previous->header->string_size;
+        for (uint32_t i = 0; i < previous->header->path_count; ++i) {
+            const index_path_t *path = &previous->paths[i];
+            if ((path->package < previous->header->package_count) && (context.reused[path->package] != UINT32_MAX) &&
+                    (path->path_offset < string_size)) {
+                const char *string = previous->strings + path->path_offset;
+                builder_add_path(&builder, string, strlen(string), context.reused[path->package]);
+            }
+        }
+    }
+
+    if (builder.failed) {
+        fprintf(stderr, "ERROR: Failed to build package index.\n");
+        goto exit;
+    }
+    succeeded = write_index(&builder, status_st, filepath);
+
+exit:
+    free(context.previous_packages);
+    free(context.reused);
+    builder_free(&builder);
+    return succeeded;
+}
+
+static package_index_t *map_index(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        // NOTE: A missing index is not an error; it has not been built yet.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open package index \"%s\", errno = %d.\n", filepath, errno);
+        }
+        return NULL;
+    }
+
+    package_index_t *index = NULL;
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= sizeof(index_header_t))) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            const index_header_t *header = map;
+            const uint64_t size =
+                sizeof(index_header_t) +
+                (uint64_t)header->package_count * sizeof(index_package_t) +
+                (uint64_t)header->path_count * sizeof(index_path_t) +
+                header->string_size;
+            if ((memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) == 0) &&
+                    (header->version == kIndexVersion) &&
+                    (size == (uint64_t)st.st_size) &&
+                    ((header->string_size == 0) || (((const char *)map)[st.st_size - 1] == '\0'))) {
+                index = calloc(1, sizeof(package_index_t));
+            }
+
+            if (index != NULL) {
+                index->map = map;
+                index->map_size = st.st_size;
+                index->header = header;
+                index->packages = (const index_package_t *)(header + 1);
+                index->paths = (const index_path_t *)(index->packages + header->package_count);
+                index->strings = (const char *)(index->paths + header->path_count);
+            } else {
+                fprintf(stderr, "WARNING: Package index \"%s\" is invalid or outdated.\n", filepath);
+                munmap(map, st.st_size);
+            }
+        }
+    }
+
+    close(fd);
+    return index;
+}
+
+static void unmap_index(package_index_t *index) {
+    if (index != NULL) {
+        munmap(index->map, index->map_size);
+        free(index->status_filepath);
+        free(index);
+    }
+}
+
+static int status_matches(const package_index_t *index, const struct stat *st) {
+    const index_header_t *header = index->header;
+    return identity_matches(header->status_inode, header->status_size, header->status_mtime, st);
+}
+
+package_index_t *package_index_open(const char *filepath, const char *dpkg_directory) {
+    const size_t length = strlen(dpkg_directory) + 8;
+    char status_filepath[length];
+    snprintf(status_filepath, length, "%s/status", dpkg_directory);
+
+    struct stat st;
+    if (stat(status_filepath, &st) != 0) {
+        fprintf(stderr, "ERROR: Unable to access dpkg status file \"%s\", errno = %d.\n", status_filepath, errno);
+        return NULL;
+    }
+
+    package_index_t *index = map_index(filepath);
+    if ((index == NULL) || !status_matches(index, &st)) {
+        // NOTE: The previous index (if any) provides the paths of packages
+        //       that have not changed.
+        const int succeeded = build(filepath, dpkg_directory, status_filepath, &st, index);
+        unmap_index(index);
+        index = succeeded ? map_index(filepath) : NULL;
+    }
+
+    if (index != NULL) {
+        index->status_filepath = strdup(status_filepath);
+        if (index->status_filepath == NULL) {
+            unmap_index(index);
+            index = NULL;
+        }
+    }
+    return index;
+}
+
+int package_index_is_stale(package_index_t *index) {
+    struct stat st;
+    return (stat(index->status_filepath, &st) != 0) || !status_matches(index, &st);
+}
+
+const char *package_index_lookup(package_index_t *index, const char *filepath) {
+    const index_header_t *header = index->header;
+    const uint32_t hash = hash_string(filepath);
+
+    // Find the first path with the hash.
+    uint32_t low = 0;
+    uint32_t high = header->path_count;
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        if (index->paths[middle].hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (uint32_t i = low; (i < header->path_count) && (index->paths[i].hash == hash); ++i) {
+        const index_path_t *path = &index->paths[i];
+        if ((path->path_offset < header->string_size) &&
+                (strcmp(index->strings + path->path_offset, filepath) == 0)) {
+            if (path->package < header->package_count) {
+                const uint32_t name_offset = index->packages[path->package].name_offset;
+                if (name_offset < header->string_size) {
+                    return index->strings + name_offset;
+                }
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+void package_index_close(package_index_t *index) {
+    unmap_index(index);
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,44 @@
+/**
+ * Desc: Index of the files installed by dpkg packages, mapping each file path
+ *       to the identifier of the package that installed it.
+ *
+ *       The index is built from dpkg's database (the status file and the
+ *       info/<package>.list files) and then memory-mapped (read-only). When
+ *       the database changes, the index is rebuilt, reading only the lists
+ *       of packages that have been installed or updated since.
+ *
+ *       Lookups do not allocate memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_PACKAGE_INDEX_H_
+#define COMMON_PACKAGE_INDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct package_index package_index_t;
+
+// NOTE: Rebuilds the index first if it is missing or outdated. Returns NULL if
+//       the database cannot be read, or the index cannot be written.
+package_index_t *package_index_open(const char *filepath, const char *dpkg_directory);
+// NOTE: Returns non-zero if the database has changed since the index was built.
+int package_index_is_stale(package_index_t *index);
+// NOTE: Returns NULL if the file was not installed by any package. The returned
+//       identifier points into the mapped index and remains valid until the
+//       index is closed.
+// NOTE: Directories may be shared by several packages; for these, one of the
+//       packages is returned.
+const char *package_index_lookup(package_index_t *index, const char *filepath);
+void package_index_close(package_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_PACKAGE_INDEX_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
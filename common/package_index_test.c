@@ -0,0 +1,330 @@
+/**
+ * Desc: Test of the package index: lookups in a small fake dpkg database
+ *       (multiarch lists, shared directories, removed packages), incremental
+ *       rebuilds when the database changes, and rejection of corrupted
+ *       indexes; then, if this system uses dpkg, lookups of every file of
+ *       its database and the times taken to build and rebuild the index.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "package_index.h"
+
+#include <dirent.h>
+#include <sys/time.h>
+
+#include "test_util.h"
+
+#define kSystemDpkgDirectory "/var/lib/dpkg"
+
+static const char * const kStatus =
+    "Package: tweak\n"
+    "Status: install ok installed\n"
+    "Architecture: iphoneos-arm\n"
+    "\n"
+    "Package: library\n"
+    "Status: install ok installed\n"
+    "Architecture: arm64\n"
+    "\n"
+    "Package: removed\n"
+    "Status: deinstall ok config-files\n"
+    "Architecture: iphoneos-arm\n"
+    "\n"
+    "Package: meta\n"
+    "Status: install ok installed\n"
+    "Architecture: all\n";
+
+static const char * const kTweakList =
+    "/.\n"
+    "/Library\n"
+    "/Library/MobileSubstrate/DynamicLibraries/Tweak.dylib\n"
+    "/Library/MobileSubstrate/DynamicLibraries/Tweak.plist\n";
+
+static const char * const kLibraryList =
+    "/.\n"
+    "/usr/lib/libexample.dylib\n";
+
+static int write_string(const char *directory, const char *filename, const char *string) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "%s", filename);
+    return test_write_file(filepath, string, strlen(string));
+}
+
+static int lookup_is(package_index_t *index, const char *filepath, const char *expected) {
+    const char *identifier = package_index_lookup(index, filepath);
+    if ((identifier == NULL) || (expected == NULL)) {
+        return (identifier == expected);
+    }
+    return (strcmp(identifier, expected) == 0);
+}
+
+// NOTE: Changes the contents of a list without changing its identity (inode,
+//       size and mtime), as if it had not been touched; paths of such a list
+//       are copied from the previous index rather than read again.
+static void rewrite_keeping_identity(const char *filepath, const char *string) {
+    struct stat st;
+    CHECK(stat(filepath, &st) == 0);
+    CHECK(strlen(string) == (size_t)st.st_size);
+    CHECK(test_write_file(filepath, string, strlen(string)));
+    struct timeval times[2] = {{st.st_atime, 0}, {st.st_mtime, 0}};
+    CHECK(utimes(filepath, times) == 0);
+}
+
+static void test_fake_database(const char *directory) {
+    char dpkg_directory[1024];
+    test_path(dpkg_directory, sizeof(dpkg_directory), directory, "dpkg");
+    char info_directory[1024];
+    test_path(info_directory, sizeof(info_directory), directory, "dpkg/info");
+    CHECK(mkdir(dpkg_directory, 0755) == 0);
+    CHECK(mkdir(info_directory, 0755) == 0);
+    char index_filepath[1024];
+    test_path(index_filepath, sizeof(index_filepath), directory, "packages.index");
+
+    CHECK(write_string(info_directory, "tweak.list", kTweakList));
+    // NOTE: A package of a foreign architecture.
+    CHECK(write_string(info_directory, "library:arm64.list", kLibraryList));
+    // NOTE: The list of a removed package may remain; it must be ignored.
+    CHECK(write_string(info_directory, "removed.list", "/usr/bin/removed\n"));
+    CHECK(write_string(dpkg_directory, "status", kStatus));
+
+    package_index_t *index = package_index_open(index_filepath, dpkg_directory);
+    CHECK(index != NULL);
+    if (index == NULL) {
+        return;
+    }
+    CHECK(lookup_is(index, "/Library/MobileSubstrate/DynamicLibraries/Tweak.dylib", "tweak"));
+    CHECK(lookup_is(index, "/Library/MobileSubstrate/DynamicLibraries/Tweak.plist", "tweak"));
+    CHECK(lookup_is(index, "/usr/lib/libexample.dylib", "library"));
+    CHECK(lookup_is(index, "/usr/bin/removed", NULL));
+    CHECK(lookup_is(index, "/Library/MobileSubstrate/DynamicLibraries", NULL));
+    CHECK(lookup_is(index, "", NULL));
+    // NOTE: Shared directories belong to the first package that listed them.
+    CHECK(lookup_is(index, "/.", "tweak"));
+    CHECK(!package_index_is_stale(index));
+
+    // Reopening an up-to-date index does not rebuild it.
+    struct stat index_st;
+    CHECK(stat(index_filepath, &index_st) == 0);
+    package_index_t *reopened = package_index_open(index_filepath, dpkg_directory);
+    CHECK(reopened != NULL);
+    struct stat reopened_st;
+    CHECK(stat(index_filepath, &reopened_st) == 0);
+    CHECK(reopened_st.st_ino == index_st.st_ino);
+    package_index_close(reopened);
+
+    // The library is updated, the tweak is removed, and a package is added;
+    // the list of the meta package has not changed.
+    CHECK(write_string(info_directory, "meta.list", "/usr/share/doc/meta\n"));
+    CHECK(write_string(dpkg_directory, "status",
+        "Package: meta\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"
+        "\n"
+        "Package: library\n"
+        "Status: install ok installed\n"
+        "Architecture: arm64\n"));
+    CHECK(package_index_is_stale(index));
+    package_index_close(index);
+
+    index = package_index_open(index_filepath, dpkg_directory);
+    CHECK(index != NULL);
+    if (index == NULL) {
+        return;
+    }
+    CHECK(lookup_is(index, "/usr/share/doc/meta", "meta"));
+    CHECK(lookup_is(index, "/usr/lib/libexample.dylib", "library"));
+    CHECK(lookup_is(index, "/Library/MobileSubstrate/DynamicLibraries/Tweak.dylib", NULL));
+    CHECK(lookup_is(index, "/.", "library"));
+    CHECK(!package_index_is_stale(index));
+    package_index_close(index);
+
+    // The paths of unchanged lists are copied from the previous index.
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), info_directory, "meta.list");
+    rewrite_keeping_identity(filepath, "/usr/share/doc/xxxx\n");
+    CHECK(write_string(info_directory, "library:arm64.list", "/usr/lib/libexample2.dylib\n"));
+    CHECK(write_string(dpkg_directory, "status",
+        "Package: library\n"
+        "Status: install ok installed\n"
+        "Architecture: arm64\n"
+        "Version: 2.0\n"
+        "\n"
+        "Package: meta\n"
+        "Status: install ok installed\n"
+        "Architecture: all\n"));
+    index = package_index_open(index_filepath, dpkg_directory);
+    CHECK(index != NULL);
+    if (index == NULL) {
+        return;
+    }
+    CHECK(lookup_is(index, "/usr/share/doc/meta", "meta"));
+    CHECK(lookup_is(index, "/usr/share/doc/xxxx", NULL));
+    CHECK(lookup_is(index, "/usr/lib/libexample2.dylib", "library"));
+    CHECK(lookup_is(index, "/usr/lib/libexample.dylib", NULL));
+    package_index_close(index);
+
+    // Truncated or corrupted indexes are rebuilt.
+    // NOTE: Each rejected index is reported; the warnings are silenced.
+    fflush(stderr);
+    const int saved_stderr = dup(STDERR_FILENO);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+
+    // NOTE: Without a status file, there is no index.
+    CHECK(package_index_open(index_filepath, directory) == NULL);
+
+    CHECK(stat(index_filepath, &index_st) == 0);
+    for (off_t size = 0; size < index_st.st_size; size += 7) {
+        CHECK(truncate(index_filepath, size) == 0);
+        index = package_index_open(index_filepath, dpkg_directory);
+        CHECK(index != NULL);
+        if (index != NULL) {
+            CHECK(lookup_is(index, "/usr/lib/libexample2.dylib", "library"));
+            package_index_close(index);
+        }
+    }
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+}
+
+typedef struct {
+    unsigned path_count;
+    unsigned missing_count;
+} check_results_t;
+
+// NOTE: Every path listed by an installed package must resolve to a package,
+//       though not necessarily to that package: files may be diverted, and
+//       directories are shared.
+static void check_list(package_index_t *index, const char *filepath, check_results_t *results) {
+    FILE *f = fopen(filepath, "r");
+    if (f == NULL) {
+        return;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const size_t length = strlen(line);
+        if ((length > 0) && (line[length - 1] == '\n')) {
+            line[length - 1] = '\0';
+        }
+        if (line[0] != '\0') {
+            ++results->path_count;
+            if (package_index_lookup(index, line) == NULL) {
+                ++results->missing_count;
+            }
+        }
+    }
+    fclose(f);
+}
+
+static int is_installed(const char *name) {
+    char command[512];
+    snprintf(command, sizeof(command),
+        "dpkg-query -W -f='${db:Status-Status}' '%s' 2>/dev/null | grep -q '^installed$'", name);
+    return (system(command) == 0);
+}
+
+static void test_system_database(const char *directory) {
+    char status_filepath[] = kSystemDpkgDirectory "/status";
+    if (access(status_filepath, R_OK) != 0) {
+        printf("No dpkg database; skipping the test of the system database.\n");
+        return;
+    }
+
+    char index_filepath[1024];
+    test_path(index_filepath, sizeof(index_filepath), directory, "system.index");
+
+    package_index_t *index = package_index_open(index_filepath, kSystemDpkgDirectory);
+    CHECK(index != NULL);
+    if (index == NULL) {
+        return;
+    }
+
+    // NOTE: Only the lists of a sample of installed packages are checked, as
+    //       each check runs dpkg-query.
+    check_results_t results = {0, 0};
+    unsigned package_count = 0;
+    DIR *dir = opendir(kSystemDpkgDirectory "/info");
+    CHECK(dir != NULL);
+    struct dirent *entry;
+    while ((dir != NULL) && ((entry = readdir(dir)) != NULL) && (package_count < 50)) {
+        const size_t length = strlen(entry->d_name);
+        if ((length > 5) && (strcmp(entry->d_name + length - 5, ".list") == 0)) {
+            char name[256];
+            snprintf(name, sizeof(name), "%.*s", (int)(length - 5), entry->d_name);
+            if (is_installed(name)) {
+                char filepath[1024];
+                snprintf(filepath, sizeof(filepath), kSystemDpkgDirectory "/info/%s", entry->d_name);
+                check_list(index, filepath, &results);
+                ++package_count;
+            }
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    CHECK(results.missing_count == 0);
+
+    static const unsigned kLookupCount = 100000;
+    double start = test_time();
+    unsigned found_count = 0;
+    for (unsigned i = 0; i < kLookupCount; ++i) {
+        found_count += (package_index_lookup(index, (i % 2) ? "/usr/bin/dpkg" : "/nonexistent") != NULL);
+    }
+    const double lookup_time = test_time() - start;
+    CHECK(found_count == kLookupCount / 2);
+    package_index_close(index);
+
+    start = test_time();
+    index = package_index_open(index_filepath, kSystemDpkgDirectory);
+    const double reopen_time = test_time() - start;
+    CHECK(index != NULL);
+    package_index_close(index);
+
+    // NOTE: The index of a copy of the database, with a changed status file,
+    //       is rebuilt from the previous index; the lists are unchanged.
+    char copy_directory[1024];
+    test_path(copy_directory, sizeof(copy_directory), directory, "system_dpkg");
+    char command[4096];
+    snprintf(command, sizeof(command), "cp -a " kSystemDpkgDirectory "/status '%s' && "
+        "ln -s " kSystemDpkgDirectory "/info '%s/info'", copy_directory, copy_directory);
+    CHECK(mkdir(copy_directory, 0755) == 0);
+    CHECK(system(command) == 0);
+    char copy_index_filepath[1024];
+    test_path(copy_index_filepath, sizeof(copy_index_filepath), directory, "copy.index");
+
+    start = test_time();
+    index = package_index_open(copy_index_filepath, copy_directory);
+    const double copy_build_time = test_time() - start;
+    CHECK(index != NULL);
+    package_index_close(index);
+
+    snprintf(command, sizeof(command), "echo >> '%s/status'", copy_directory);
+    CHECK(system(command) == 0);
+    start = test_time();
+    index = package_index_open(copy_index_filepath, copy_directory);
+    const double rebuild_time = test_time() - start;
+    CHECK(index != NULL);
+    if (index != NULL) {
+        CHECK(package_index_lookup(index, "/usr/bin/dpkg") != NULL);
+        package_index_close(index);
+    }
+
+    printf("System dpkg database (%u paths of %u packages checked): build %.1f ms, incremental rebuild %.1f ms,"
+        " reopen %.3f ms, lookup %.3f us\n",
+        results.path_count, package_count, copy_build_time * 1000.0, rebuild_time * 1000.0,
+        reopen_time * 1000.0, lookup_time * 1000000.0 / kLookupCount);
+}
+
+int main(void) {
+    char *directory = test_make_directory("package_index_test");
+    test_fake_database(directory);
+    test_system_database(directory);
+    test_remove_directory(directory);
+    return test_result("package_index_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
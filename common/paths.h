@@ -10,7 +10,23 @@
 #define kCrashLogDirectoryForRoot   "/Library/Logs/CrashReporter"
 #define kTemporaryPath              "/tmp/"
 
+// NOTE: The system may purge the contents of Caches (e.g. when storage is
+//       low); only files that can be rebuilt are kept there. State that
+//       cannot, such as which logs have been viewed, is kept in the data
+//       directory instead.
+#define kCacheDirectory             "/var/mobile/Library/Caches/crash-reporter"
+#define kDataDirectory              "/var/mobile/Library/Application Support/crash-reporter"
+#define kViewedStateFilepath        kDataDirectory "/viewed.journal"
+#define kSymbolCacheFilepath        kCacheDirectory "/symbols.cache"
+#define kSymbolTableDirectory       kCacheDirectory "/symbols"
+#define kCrashRateFilepath          kCacheDirectory "/crash_rate"
+#define kProcessTypeCacheFilepath   kCacheDirectory "/process_types.cache"
+#define kPackageIndexFilepath       kCacheDirectory "/packages.index"
+
+#define kDpkgDirectory              "/var/lib/dpkg"
+
 #define kIsRunningFilepath          "/tmp/crashreporter_is_running"
+#define kNotifierSocketFilepath     "/tmp/crashreporter_notifier.socket"
 
 #endif // COMMON_PATHS_H_
 
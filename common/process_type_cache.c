@@ -0,0 +1,344 @@
+/**
+ * Desc: Persistent cache of the type (app, app extension or service) of
+ *       crashed processes, keyed by process path and validated against the
+ *       identity (inode, size, mtime) of the Info.plist of the bundle, so that
+ *       bundles need only be examined when installed or updated.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "process_type_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// NOTE: The cache is local; records are stored in native byte order. If the
+//       format changes, the version must be bumped, which causes any existing
+//       cache to be discarded and rebuilt.
+static const char kCacheMagic[4] = {'C', 'R', 'P', 'T'};
+static const uint32_t kCacheVersion = 1;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} cache_header_t;
+
+typedef struct {
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t type;
+    uint16_t process_path_length;
+    uint16_t info_path_length;
+} cache_record_t;
+
+typedef struct {
+    cache_record_t record;
+    char *process_path;
+    char *info_path;
+} cache_entry_t;
+
+struct process_type_cache {
+    char *filepath;
+    cache_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    // NOTE: Open-addressed hash table of (entry index + 1); zero marks an
+    //       empty slot.
+    size_t *slots;
+    size_t slot_count;
+    int dirty;
+};
+
+static uint32_t hash_string(const char *string) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)string; *p != '\0'; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t *find_slot(process_type_cache_t *cache, const char *process_path) {
+    const size_t mask = cache->slot_count - 1;
+    size_t i = hash_string(process_path) & mask;
+    while (cache->slots[i] != 0) {
+        if (strcmp(cache->entries[cache->slots[i] - 1].process_path, process_path) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &cache->slots[i];
+}
+
+static int rehash(process_type_cache_t *cache, size_t slot_count) {
+    size_t *slots = calloc(slot_count, sizeof(size_t));
+    if (slots == NULL) {
+        return 0;
+    }
+
+    free(cache->slots);
+    cache->slots = slots;
+    cache->slot_count = slot_count;
+    for (size_t i = 0; i < cache->count; ++i) {
+        *find_slot(cache, cache->entries[i].process_path) = i + 1;
+    }
+    return 1;
+}
+
+// NOTE: Takes ownership of the strings, even on failure.
+static cache_entry_t *add_entry(process_type_cache_t *cache, char *process_path, char *info_path) {
+    // Keep load factor of hash table below one half.
+    if (2 * (cache->count + 1) > cache->slot_count) {
+        if (!rehash(cache, 2 * cache->slot_count)) {
+            goto fail;
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        size_t capacity = (cache->capacity != 0) ? (2 * cache->capacity) : 32;
+        cache_entry_t *entries = realloc(cache->entries, capacity * sizeof(cache_entry_t));
+        if (entries == NULL) {
+            goto fail;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    cache_entry_t *entry = &cache->entries[cache->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->process_path = process_path;
+    entry->info_path = info_path;
+    ++cache->count;
+    *find_slot(cache, process_path) = cache->count;
+    return entry;
+
+fail:
+    free(process_path);
+    free(info_path);
+    return NULL;
+}
+
+static int identity_matches(const cache_record_t *record, const struct stat *st) {
+    return
+        (record->inode == (uint64_t)st->st_ino) &&
+        (record->size == (uint64_t)st->st_size) &&
+        (record->mtime == (int64_t)st->st_mtime);
+}
+
+static char *read_string(FILE *f, uint16_t length) {
+    char *string = malloc(length + 1);
+    if (string != NULL) {
+        if (fread(string, 1, length, f) == length) {
+            string[length] = '\0';
+        } else {
+            free(string);
+            string = NULL;
+        }
+    }
+    return string;
+}
+
+static void load(process_type_cache_t *cache) {
+    FILE *f = fopen(cache->filepath, "r");
+    if (f == NULL) {
+        // NOTE: A missing cache is not an error; it is created on save.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open process type cache \"%s\", errno = %d.\n", cache->filepath, errno);
+        }
+        return;
+    }
+
+    cache_header_t header;
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+            (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0) ||
+            (header.version != kCacheVersion)) {
+        // Unknown or outdated format; cache will be rebuilt.
+        cache->dirty = 1;
+        goto exit;
+    }
+
+    for (uint32_t i = 0; i < header.count; ++i) {
+        cache_record_t record;
+        if (fread(&record, sizeof(record), 1, f) != 1) {
+            goto corrupt;
+        }
+
+        char *process_path = read_string(f, record.process_path_length);
+        char *info_path = read_string(f, record.info_path_length);
+        if ((process_path == NULL) || (info_path == NULL) || (*find_slot(cache, process_path) != 0)) {
+            free(process_path);
+            free(info_path);
+            goto corrupt;
+        }
+
+        cache_entry_t *entry = add_entry(cache, process_path, info_path);
+        if (entry == NULL) {
+            goto corrupt;
+        }
+        entry->record = record;
+    }
+    goto exit;
+
+corrupt:
+    fprintf(stderr, "WARNING: Process type cache \"%s\" is truncated or corrupt; discarding.\n", cache->filepath);
+    cache->dirty = 1;
+
+exit:
+    fclose(f);
+}
+
+process_type_cache_t *process_type_cache_open(const char *filepath) {
+    process_type_cache_t *cache = calloc(1, sizeof(process_type_cache_t));
+    if (cache != NULL) {
+        cache->filepath = strdup(filepath);
+        if ((cache->filepath == NULL) || !rehash(cache, 64)) {
+            process_type_cache_close(cache);
+            return NULL;
+        }
+        load(cache);
+    }
+    return cache;
+}
+
+int process_type_cache_lookup(process_type_cache_t *cache, const char *process_path, const struct stat *st, uint32_t *type) {
+    const size_t slot = *find_slot(cache, process_path);
+    if (slot != 0) {
+        const cache_entry_t *entry = &cache->entries[slot - 1];
+        if (identity_matches(&entry->record, st)) {
+            *type = entry->record.type;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int process_type_cache_update(process_type_cache_t *cache, const char *process_path, const char *info_path, const struct stat *st, uint32_t type) {
+    const size_t process_path_length = strlen(process_path);
+    const size_t info_path_length = strlen(info_path);
+    if ((process_path_length > UINT16_MAX) || (info_path_length > UINT16_MAX)) {
+        return 0;
+    }
+
+    char *info_path_copy = strdup(info_path);
+    if (info_path_copy == NULL) {
+        return 0;
+    }
+
+    cache_entry_t *entry;
+    const size_t slot = *find_slot(cache, process_path);
+    if (slot != 0) {
+        entry = &cache->entries[slot - 1];
+        free(entry->info_path);
+        entry->info_path = info_path_copy;
+    } else {
+        char *process_path_copy = strdup(process_path);
+        if (process_path_copy == NULL) {
+            free(info_path_copy);
+            return 0;
+        }
+        entry = add_entry(cache, process_path_copy, info_path_copy);
+        if (entry == NULL) {
+            return 0;
+        }
+    }
+
+    entry->record.inode = st->st_ino;
+    entry->record.size = st->st_size;
+    entry->record.mtime = st->st_mtime;
+    entry->record.type = type;
+    entry->record.process_path_length = process_path_length;
+    entry->record.info_path_length = info_path_length;
+    cache->dirty = 1;
+    return 1;
+}
+
+int process_type_cache_save(process_type_cache_t *cache) {
+    if (!cache->dirty) {
+        // Nothing has changed.
+        return 1;
+    }
+
+    // Determine which entries are still valid.
+    // NOTE: The cache is only saved after it has been updated (i.e. after an
+    //       app has been installed or updated), so this is rarely done.
+    char *valid = calloc(cache->count + 1, 1);
+    if (valid == NULL) {
+        return 0;
+    }
+    uint32_t count = 0;
+    for (size_t i = 0; i < cache->count; ++i) {
+        struct stat st;
+        if ((stat(cache->entries[i].info_path, &st) == 0) && identity_matches(&cache->entries[i].record, &st)) {
+            valid[i] = 1;
+            ++count;
+        }
+    }
+
+    // NOTE: Write to a temporary file and rename so that readers never see a
+    //       partially written cache.
+    const size_t length = strlen(cache->filepath) + 16;
+    char temp_filepath[length];
+    snprintf(temp_filepath, length, "%s.%d", cache->filepath, (int)getpid());
+
+    FILE *f = fopen(temp_filepath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to write process type cache \"%s\", errno = %d.\n", temp_filepath, errno);
+        free(valid);
+        return 0;
+    }
+
+    cache_header_t header;
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.count = count;
+    header.reserved = 0;
+    int succeeded = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    for (size_t i = 0; succeeded && (i < cache->count); ++i) {
+        const cache_entry_t *entry = &cache->entries[i];
+        if (valid[i]) {
+            succeeded =
+                (fwrite(&entry->record, sizeof(entry->record), 1, f) == 1) &&
+                (fwrite(entry->process_path, 1, entry->record.process_path_length, f) == entry->record.process_path_length) &&
+                (fwrite(entry->info_path, 1, entry->record.info_path_length, f) == entry->record.info_path_length);
+        }
+    }
+    free(valid);
+
+    if (fclose(f) != 0) {
+        succeeded = 0;
+    }
+    if (succeeded && (rename(temp_filepath, cache->filepath) != 0)) {
+        succeeded = 0;
+    }
+    if (succeeded) {
+        cache->dirty = 0;
+    } else {
+        fprintf(stderr, "ERROR: Failed to save process type cache \"%s\", errno = %d.\n", cache->filepath, errno);
+        unlink(temp_filepath);
+    }
+    return succeeded;
+}
+
+void process_type_cache_close(process_type_cache_t *cache) {
+    if (cache != NULL) {
+        for (size_t i = 0; i < cache->count; ++i) {
+            free(cache->entries[i].process_path);
+            free(cache->entries[i].info_path);
+        }
+        free(cache->entries);
+        free(cache->slots);
+        free(cache->filepath);
+        free(cache);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
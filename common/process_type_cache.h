@@ -0,0 +1,41 @@
+/**
+ * Desc: Persistent cache of the type (app, app extension or service) of
+ *       crashed processes, keyed by process path and validated against the
+ *       identity (inode, size, mtime) of the Info.plist of the bundle, so that
+ *       bundles need only be examined when installed or updated.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_PROCESS_TYPE_CACHE_H_
+#define COMMON_PROCESS_TYPE_CACHE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct process_type_cache process_type_cache_t;
+
+process_type_cache_t *process_type_cache_open(const char *filepath);
+// NOTE: The stat is that of the Info.plist of the bundle containing the
+//       process; returns zero if there is no entry, or if the Info.plist has
+//       changed since the entry was added.
+int process_type_cache_lookup(process_type_cache_t *cache, const char *process_path, const struct stat *st, uint32_t *type);
+int process_type_cache_update(process_type_cache_t *cache, const char *process_path, const char *info_path, const struct stat *st, uint32_t type);
+// NOTE: Entries for bundles whose Info.plist has since changed or been removed
+//       (e.g. updated or uninstalled apps) are dropped when the cache is saved.
+int process_type_cache_save(process_type_cache_t *cache);
+void process_type_cache_close(process_type_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_PROCESS_TYPE_CACHE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
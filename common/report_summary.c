@@ -0,0 +1,304 @@
+/**
+ * Desc: Compact binary summary of the results of processing a crash report
+ *       (victim, suspects, potential suspects and process information), so
+ *       that a symbolicated log can be displayed without parsing it again.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "report_summary.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NOTE: The summary is a local cache; records are stored in native byte
+//       order. If the format (or the way that the results are determined)
+//       changes, the version must be bumped, which causes existing summaries
+//       to be ignored and rewritten.
+static const char kSummaryMagic[4] = {'C', 'R', 'S', 'M'};
+static const uint32_t kSummaryVersion = 1;
+
+// NOTE: Summaries are a few kilobytes; anything much larger is not a summary.
+static const off_t kSummaryMaxSize = 4 * 1024 * 1024;
+
+// NOTE: Marks a NULL string.
+#define kNoString UINT32_MAX
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int64_t log_mtime;
+    uint32_t has_victim;
+    uint32_t suspect_count;
+    uint32_t potential_suspect_count;
+    uint32_t process_info_count;
+    // NOTE: Size of the table of NUL-terminated strings that follows the
+    //       records; strings are referenced by offset into the table.
+    uint32_t strings_size;
+    uint32_t reserved;
+} summary_header_t;
+
+typedef struct {
+    uint64_t address;
+    uint64_t size;
+    uint32_t path;
+    uint32_t architecture;
+    uint32_t uuid;
+    uint32_t package_identifier;
+} summary_image_t;
+
+typedef struct {
+    uint32_t key;
+    uint32_t value;
+} summary_pair_t;
+
+typedef struct {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+    int failed;
+} string_table_t;
+
+static uint32_t add_string(string_table_t *table, const char *string) {
+    if (string == NULL) {
+        return kNoString;
+    }
+
+    const size_t length = strlen(string) + 1;
+    if (table->length + length >= kNoString) {
+        table->failed = 1;
+    }
+    if (table->failed) {
+        return kNoString;
+    }
+
+    if (table->length + length > table->capacity) {
+        size_t capacity = (table->capacity != 0) ? table->capacity : 1024;
+        while (capacity < table->length + length) {
+            capacity *= 2;
+        }
+        char *bytes = realloc(table->bytes, capacity);
+        if (bytes == NULL) {
+            table->failed = 1;
+            return kNoString;
+        }
+        table->bytes = bytes;
+        table->capacity = capacity;
+    }
+
+    const uint32_t offset = table->length;
+    memcpy(table->bytes + offset, string, length);
+    table->length += length;
+    return offset;
+}
+
+static void encode_image(string_table_t *table, const report_summary_image_t *image, summary_image_t *record) {
+    record->address = image->address;
+    record->size = image->size;
+    record->path = add_string(table, image->path);
+    record->architecture = add_string(table, image->architecture);
+    record->uuid = add_string(table, image->uuid);
+    record->package_identifier = add_string(table, image->package_identifier);
+}
+
+int report_summary_write(FILE *output, const report_summary_t *summary) {
+    const uint32_t image_count = 1 + summary->suspect_count + summary->potential_suspect_count;
+    summary_image_t *images = calloc(image_count, sizeof(summary_image_t));
+    summary_pair_t *pairs = calloc(summary->process_info_count + 1, sizeof(summary_pair_t));
+    string_table_t table;
+    memset(&table, 0, sizeof(table));
+
+    int succeeded = 0;
+    if ((images == NULL) || (pairs == NULL)) {
+        goto exit;
+    }
+
+    // NOTE: The record for the victim is always present, so that the records
+    //       have fixed positions.
+    report_summary_image_t empty;
+    memset(&empty, 0, sizeof(empty));
+    encode_image(&table, (summary->has_victim ? &summary->victim : &empty), &images[0]);
+    for (uint32_t i = 0; i < summary->suspect_count; ++i) {
+        encode_image(&table, &summary->suspects[i], &images[1 + i]);
+    }
+    for (uint32_t i = 0; i < summary->potential_suspect_count; ++i) {
+        encode_image(&table, &summary->potential_suspects[i], &images[1 + summary->suspect_count + i]);
+    }
+    for (uint32_t i = 0; i < summary->process_info_count; ++i) {
+        pairs[i].key = add_string(&table, summary->process_info[i].key);
+        pairs[i].value = add_string(&table, summary->process_info[i].value);
+    }
+    if (table.failed) {
+        fprintf(stderr, "ERROR: Failed to encode report summary.\n");
+        goto exit;
+    }
+
+    summary_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSummaryMagic, sizeof(kSummaryMagic));
+    header.version = kSummaryVersion;
+    header.log_mtime = summary->log_mtime;
+    header.has_victim = (summary->has_victim != 0);
+    header.suspect_count = summary->suspect_count;
+    header.potential_suspect_count = summary->potential_suspect_count;
+    header.process_info_count = summary->process_info_count;
+    header.strings_size = table.length;
+
+    succeeded =
+        (fwrite(&header, sizeof(header), 1, output) == 1) &&
+        (fwrite(images, sizeof(summary_image_t), image_count, output) == image_count) &&
+        (fwrite(pairs, sizeof(summary_pair_t), summary->process_info_count, output) == summary->process_info_count) &&
+        ((table.length == 0) || (fwrite(table.bytes, 1, table.length, output) == table.length));
+    if (!succeeded) {
+        fprintf(stderr, "ERROR: Failed to write report summary, errno = %d.\n", errno);
+    }
+
+exit:
+    free(table.bytes);
+    free(pairs);
+    free(images);
+    return succeeded;
+}
+
+static int read_all(int fd, void *buffer, size_t size) {
+    char *p = buffer;
+    while (size > 0) {
+        ssize_t count = read(fd, p, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        } else if (count == 0) {
+            return 0;
+        }
+        p += count;
+        size -= count;
+    }
+    return 1;
+}
+
+// NOTE: The last byte of the table is checked to be NUL, so any string that
+//       starts within the table is terminated within it.
+static int decode_string(const char *strings, uint32_t size, uint32_t offset, const char **string) {
+    if (offset == kNoString) {
+        *string = NULL;
+        return 1;
+    } else if (offset < size) {
+        *string = strings + offset;
+        return 1;
+    }
+    return 0;
+}
+
+static int decode_image(const char *strings, uint32_t size, const summary_image_t *record, report_summary_image_t *image) {
+    image->address = record->address;
+    image->size = record->size;
+    return
+        decode_string(strings, size, record->path, &image->path) &&
+        decode_string(strings, size, record->architecture, &image->architecture) &&
+        decode_string(strings, size, record->uuid, &image->uuid) &&
+        decode_string(strings, size, record->package_identifier, &image->package_identifier);
+}
+
+report_summary_t *report_summary_read(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        // NOTE: A missing summary is not an error; the report is parsed.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open report summary \"%s\", errno = %d.\n", filepath, errno);
+        }
+        return NULL;
+    }
+
+    report_summary_t *summary = NULL;
+    char *buffer = NULL;
+
+    struct stat st;
+    summary_header_t header;
+    if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(header)) || (st.st_size > kSummaryMaxSize) ||
+            !read_all(fd, &header, sizeof(header)) ||
+            (memcmp(header.magic, kSummaryMagic, sizeof(kSummaryMagic)) != 0) ||
+            (header.version != kSummaryVersion)) {
+        // Unknown or outdated format; summary will be rewritten.
+        goto exit;
+    }
+
+    // NOTE: Counts are checked against the size of the file before any of
+    //       them are used, so that the arithmetic below cannot overflow.
+    const uint64_t image_count = 1 + (uint64_t)header.suspect_count + header.potential_suspect_count;
+    const uint64_t records_size = image_count * sizeof(summary_image_t) +
+        (uint64_t)header.process_info_count * sizeof(summary_pair_t);
+    if ((uint64_t)st.st_size != sizeof(header) + records_size + header.strings_size) {
+        goto corrupt;
+    }
+
+    // NOTE: The summary, its arrays and the string table are allocated as a
+    //       single block.
+    const size_t size = sizeof(report_summary_t) +
+        (image_count - 1) * sizeof(report_summary_image_t) +
+        header.process_info_count * sizeof(report_summary_pair_t) +
+        records_size + header.strings_size;
+    buffer = malloc(size);
+    if (buffer == NULL) {
+        goto exit;
+    }
+
+    summary = (report_summary_t *)buffer;
+    memset(summary, 0, sizeof(*summary));
+    report_summary_image_t *images = (report_summary_image_t *)(buffer + sizeof(report_summary_t));
+    report_summary_pair_t *pairs = (report_summary_pair_t *)(images + (image_count - 1));
+    summary_image_t *image_records = (summary_image_t *)(pairs + header.process_info_count);
+    summary_pair_t *pair_records = (summary_pair_t *)(image_records + image_count);
+    char *strings = (char *)(pair_records + header.process_info_count);
+
+    if (!read_all(fd, image_records, records_size + header.strings_size) ||
+            ((header.strings_size != 0) && (strings[header.strings_size - 1] != '\0'))) {
+        goto corrupt;
+    }
+
+    summary->log_mtime = header.log_mtime;
+    summary->has_victim = (header.has_victim != 0);
+    summary->suspects = images;
+    summary->suspect_count = header.suspect_count;
+    summary->potential_suspects = images + header.suspect_count;
+    summary->potential_suspect_count = header.potential_suspect_count;
+    summary->process_info = pairs;
+    summary->process_info_count = header.process_info_count;
+
+    if (!decode_image(strings, header.strings_size, &image_records[0], &summary->victim)) {
+        goto corrupt;
+    }
+    for (uint64_t i = 1; i < image_count; ++i) {
+        if (!decode_image(strings, header.strings_size, &image_records[i], &images[i - 1])) {
+            goto corrupt;
+        }
+    }
+    for (uint32_t i = 0; i < header.process_info_count; ++i) {
+        if (!decode_string(strings, header.strings_size, pair_records[i].key, &pairs[i].key) ||
+                !decode_string(strings, header.strings_size, pair_records[i].value, &pairs[i].value)) {
+            goto corrupt;
+        }
+    }
+    goto exit;
+
+corrupt:
+    fprintf(stderr, "WARNING: Report summary \"%s\" is truncated or corrupt; ignoring.\n", filepath);
+    free(buffer);
+    summary = NULL;
+
+exit:
+    close(fd);
+    return summary;
+}
+
+void report_summary_free(report_summary_t *summary) {
+    free(summary);
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
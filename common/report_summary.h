@@ -0,0 +1,63 @@
+/**
+ * Desc: Compact binary summary of the results of processing a crash report
+ *       (victim, suspects, potential suspects and process information), so
+ *       that a symbolicated log can be displayed without parsing it again.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_REPORT_SUMMARY_H_
+#define COMMON_REPORT_SUMMARY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOTE: Any of the strings may be NULL.
+typedef struct {
+    const char *path;
+    uint64_t address;
+    uint64_t size;
+    const char *architecture;
+    const char *uuid;
+    const char *package_identifier;
+} report_summary_image_t;
+
+typedef struct {
+    const char *key;
+    const char *value;
+} report_summary_pair_t;
+
+typedef struct {
+    // NOTE: Modification time of the log file that was summarized; the summary
+    //       is stale if the log has been replaced since.
+    int64_t log_mtime;
+    int has_victim;
+    report_summary_image_t victim;
+    report_summary_image_t *suspects;
+    uint32_t suspect_count;
+    report_summary_image_t *potential_suspects;
+    uint32_t potential_suspect_count;
+    report_summary_pair_t *process_info;
+    uint32_t process_info_count;
+} report_summary_t;
+
+// NOTE: Returns zero on error.
+int report_summary_write(FILE *output, const report_summary_t *summary);
+// NOTE: Returns NULL if the file does not exist, or is truncated, corrupt or
+//       of an older version. The result is a single allocation, and must be
+//       freed with report_summary_free().
+report_summary_t *report_summary_read(const char *filepath);
+void report_summary_free(report_summary_t *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_REPORT_SUMMARY_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,189 @@
+/**
+ * Desc: Test of the report summary: round trips of summaries with and without
+ *       optional strings (including the package identifiers of images), and
+ *       rejection of truncated and corrupted files.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "report_summary.h"
+
+#include "test_util.h"
+
+static int strings_equal(const char *a, const char *b) {
+    return ((a == NULL) && (b == NULL)) || ((a != NULL) && (b != NULL) && (strcmp(a, b) == 0));
+}
+
+static int images_equal(const report_summary_image_t *a, const report_summary_image_t *b) {
+    return
+        strings_equal(a->path, b->path) &&
+        (a->address == b->address) &&
+        (a->size == b->size) &&
+        strings_equal(a->architecture, b->architecture) &&
+        strings_equal(a->uuid, b->uuid) &&
+        strings_equal(a->package_identifier, b->package_identifier);
+}
+
+static void check_summary(const report_summary_t *expected, const report_summary_t *actual) {
+    CHECK(actual != NULL);
+    if (actual == NULL) {
+        return;
+    }
+
+    CHECK(actual->log_mtime == expected->log_mtime);
+    CHECK(actual->has_victim == expected->has_victim);
+    if (expected->has_victim) {
+        CHECK(images_equal(&actual->victim, &expected->victim));
+    }
+    CHECK(actual->suspect_count == expected->suspect_count);
+    for (uint32_t i = 0; (i < expected->suspect_count) && (i < actual->suspect_count); ++i) {
+        CHECK(images_equal(&actual->suspects[i], &expected->suspects[i]));
+    }
+    CHECK(actual->potential_suspect_count == expected->potential_suspect_count);
+    for (uint32_t i = 0; (i < expected->potential_suspect_count) && (i < actual->potential_suspect_count); ++i) {
+        CHECK(images_equal(&actual->potential_suspects[i], &expected->potential_suspects[i]));
+    }
+    CHECK(actual->process_info_count == expected->process_info_count);
+    for (uint32_t i = 0; (i < expected->process_info_count) && (i < actual->process_info_count); ++i) {
+        CHECK(strings_equal(actual->process_info[i].key, expected->process_info[i].key));
+        CHECK(strings_equal(actual->process_info[i].value, expected->process_info[i].value));
+    }
+}
+
+static int write_summary(const char *filepath, const report_summary_t *summary) {
+    FILE *f = fopen(filepath, "w");
+    if (f == NULL) {
+        return 0;
+    }
+    const int did_write = report_summary_write(f, summary);
+    return (fclose(f) == 0) && did_write;
+}
+
+static void test_round_trip(const char *filepath) {
+    report_summary_image_t suspects[] = {
+        {"/Library/MobileSubstrate/DynamicLibraries/Tweak.dylib", 0x100000, 0x4000, "arm64",
+            "0123456789abcdef0123456789abcdef", "com.example.tweak"},
+        // NOTE: Not installed by a package.
+        {"/usr/lib/libfoo.dylib", 0x200000, 0x8000, "arm64", "fedcba9876543210fedcba9876543210", NULL},
+    };
+    report_summary_image_t potential_suspects[] = {
+        {"/Library/MobileSubstrate/DynamicLibraries/Other.dylib", 0x300000, 0x1000, "armv7", NULL,
+            "com.example.other"},
+        {NULL, 0, 0, NULL, NULL, NULL},
+    };
+    report_summary_pair_t process_info[] = {
+        {"Path", "/Applications/MobileSafari.app/MobileSafari"},
+        {"Version", ""},
+    };
+
+    report_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.log_mtime = 1456794123;
+    summary.has_victim = 1;
+    summary.victim = (report_summary_image_t){"/Applications/MobileSafari.app/MobileSafari", 0x4000, 0x100000,
+        "arm64", "00112233445566778899aabbccddeeff", "com.apple.mobilesafari"};
+    summary.suspects = suspects;
+    summary.suspect_count = 2;
+    summary.potential_suspects = potential_suspects;
+    summary.potential_suspect_count = 2;
+    summary.process_info = process_info;
+    summary.process_info_count = 2;
+
+    CHECK(write_summary(filepath, &summary));
+    report_summary_t *read = report_summary_read(filepath);
+    check_summary(&summary, read);
+    if (read != NULL) {
+        // NOTE: The package identifier is what lets the app show the package
+        //       of an image without looking it up again.
+        CHECK(strcmp(read->victim.package_identifier, "com.apple.mobilesafari") == 0);
+        CHECK(strcmp(read->suspects[0].package_identifier, "com.example.tweak") == 0);
+        CHECK(read->suspects[1].package_identifier == NULL);
+    }
+    report_summary_free(read);
+
+    // An empty summary.
+    memset(&summary, 0, sizeof(summary));
+    summary.log_mtime = -1;
+    CHECK(write_summary(filepath, &summary));
+    read = report_summary_read(filepath);
+    check_summary(&summary, read);
+    report_summary_free(read);
+
+    CHECK(report_summary_read("/nonexistent") == NULL);
+}
+
+// NOTE: Truncated and corrupted summaries must be rejected (or decoded within
+//       bounds), never crash.
+static void test_corrupt(const char *filepath) {
+    report_summary_image_t images[] = {
+        {"/usr/lib/a.dylib", 1, 2, "arm64", "uuid-a", "com.example.a"},
+        {"/usr/lib/b.dylib", 3, 4, "arm64", "uuid-b", NULL},
+    };
+    report_summary_pair_t process_info[] = {{"Key", "Value"}};
+    report_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.has_victim = 1;
+    summary.victim = images[0];
+    summary.suspects = images;
+    summary.suspect_count = 2;
+    summary.process_info = process_info;
+    summary.process_info_count = 1;
+    CHECK(write_summary(filepath, &summary));
+
+    unsigned char bytes[4096];
+    FILE *f = fopen(filepath, "rb");
+    CHECK(f != NULL);
+    const size_t length = (f != NULL) ? fread(bytes, 1, sizeof(bytes), f) : 0;
+    if (f != NULL) {
+        fclose(f);
+    }
+    CHECK((length > 0) && (length < sizeof(bytes)));
+
+    // NOTE: Each rejected summary is reported; the warnings are silenced.
+    fflush(stderr);
+    const int saved_stderr = dup(STDERR_FILENO);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+
+    for (size_t i = 0; i < length; ++i) {
+        CHECK(test_write_file(filepath, bytes, i));
+        CHECK(report_summary_read(filepath) == NULL);
+    }
+
+    for (unsigned i = 0; i < 3000; ++i) {
+        unsigned char copy[4096];
+        memcpy(copy, bytes, length);
+        copy[rand() % length] = (unsigned char)rand();
+        CHECK(test_write_file(filepath, copy, length));
+        report_summary_t *read = report_summary_read(filepath);
+        if (read != NULL) {
+            for (uint32_t j = 0; j < read->suspect_count; ++j) {
+                if (read->suspects[j].package_identifier != NULL) {
+                    CHECK(strlen(read->suspects[j].package_identifier) < length);
+                }
+            }
+        }
+        report_summary_free(read);
+    }
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+}
+
+int main(void) {
+    char *directory = test_make_directory("report_summary_test");
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "summary");
+    srand(1);
+
+    test_round_trip(filepath);
+    test_corrupt(filepath);
+
+    test_remove_directory(directory);
+    return test_result("report_summary_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,528 @@
+/**
+ * Desc: Persistent cache of symbolication results, keyed by binary image UUID
+ *       and image-relative address, so that frames that have been resolved
+ *       before (e.g. in earlier crashes of the same process) do not need to
+ *       be looked up again.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "symbol_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+// NOTE: The cache is local; records are stored in native byte order. If the
+//       format changes, the version must be bumped, which causes any existing
+//       cache to be discarded.
+static const char kCacheMagic[4] = {'C', 'R', 'S', 'C'};
+static const uint32_t kCacheVersion = 1;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    // NOTE: Advanced for each use of the cache (e.g. for each report); used
+    //       to determine which entries were used most recently.
+    uint32_t generation;
+} cache_header_t;
+
+typedef struct {
+    uint8_t uuid[16];
+    uint64_t offset;
+    uint64_t symbol_offset;
+    uint32_t source_line;
+    uint32_t last_used;
+    uint16_t name_length;
+    uint16_t source_path_length;
+    uint32_t reserved;
+} cache_record_t;
+
+typedef struct {
+    cache_record_t record;
+    char *name;
+    char *source_path;
+    // NOTE: Set if the entry has been used since the cache was last loaded or
+    //       saved; its last-used generation is then relative to that time.
+    int touched;
+} cache_entry_t;
+
+struct symbol_cache {
+    char *filepath;
+    size_t max_entries;
+    uint32_t generation;
+    // NOTE: The generation when the cache was last loaded or saved.
+    uint32_t base_generation;
+    cache_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    // NOTE: Open-addressed hash table of (entry index + 1); zero marks an
+    //       empty slot.
+    size_t *slots;
+    size_t slot_count;
+    uint64_t hits;
+    uint64_t misses;
+    int dirty;
+};
+
+static uint32_t hash_key(const uint8_t uuid[16], uint64_t offset) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < 16; ++i) {
+        hash ^= uuid[i];
+        hash *= 16777619u;
+    }
+    for (unsigned i = 0; i < 8; ++i) {
+        hash ^= (uint8_t)(offset >> (8 * i));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t *find_slot(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset) {
+    const size_t mask = cache->slot_count - 1;
+    size_t i = hash_key(uuid, offset) & mask;
+    while (cache->slots[i] != 0) {
+        const cache_record_t *record = &cache->entries[cache->slots[i] - 1].record;
+        if ((record->offset == offset) && (memcmp(record->uuid, uuid, 16) == 0)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &cache->slots[i];
+}
+
+static int rehash(symbol_cache_t *cache, size_t slot_count) {
+    size_t *slots = calloc(slot_count, sizeof(size_t));
+    if (slots == NULL) {
+        return 0;
+    }
+
+    free(cache->slots);
+    cache->slots = slots;
+    cache->slot_count = slot_count;
+    for (size_t i = 0; i < cache->count; ++i) {
+        const cache_record_t *record = &cache->entries[i].record;
+        *find_slot(cache, record->uuid, record->offset) = i + 1;
+    }
+    return 1;
+}
+
+static cache_entry_t *add_entry(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset) {
+    // Keep load factor of hash table below one half.
+    if (2 * (cache->count + 1) > cache->slot_count) {
+        if (!rehash(cache, (cache->slot_count != 0) ? (2 * cache->slot_count) : 256)) {
+            return NULL;
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        size_t capacity = (cache->capacity != 0) ? (2 * cache->capacity) : 128;
+        cache_entry_t *entries = realloc(cache->entries, capacity * sizeof(cache_entry_t));
+        if (entries == NULL) {
+            return NULL;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    cache_entry_t *entry = &cache->entries[cache->count];
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->record.uuid, uuid, 16);
+    entry->record.offset = offset;
+    ++cache->count;
+    *find_slot(cache, uuid, offset) = cache->count;
+    return entry;
+}
+
+static char *read_string(FILE *f, uint16_t length) {
+    char *string = malloc(length + 1);
+    if (string != NULL) {
+        if (fread(string, 1, length, f) == length) {
+            string[length] = '\0';
+        } else {
+            free(string);
+            string = NULL;
+        }
+    }
+    return string;
+}
+
+// NOTE: Adds the entries of the file that are not in memory; for entries that
+//       are, the more recent last-used generation is kept. Entries that have
+//       been touched since the last load or save are kept as they are.
+// NOTE: Returns the generation of the file, or zero if it does not exist or
+//       cannot be read.
+static uint32_t merge(symbol_cache_t *cache) {
+    FILE *f = fopen(cache->filepath, "r");
+    if (f == NULL) {
+        // NOTE: A missing cache is not an error; it is created on save.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open symbol cache \"%s\", errno = %d.\n", cache->filepath, errno);
+        }
+        return 0;
+    }
+
+    cache_header_t header;
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+            (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0) ||
+            (header.version != kCacheVersion)) {
+        // Unknown or outdated format; cache will be rebuilt.
+        cache->dirty = 1;
+        header.generation = 0;
+        goto exit;
+    }
+
+    for (uint32_t i = 0; i < header.count; ++i) {
+        cache_record_t record;
+        if (fread(&record, sizeof(record), 1, f) != 1) {
+            goto corrupt;
+        }
+
+        char *name = read_string(f, record.name_length);
+        char *source_path = read_string(f, record.source_path_length);
+        if ((name == NULL) || (source_path == NULL)) {
+            free(name);
+            free(source_path);
+            goto corrupt;
+        }
+
+        const size_t slot = *find_slot(cache, record.uuid, record.offset);
+        if (slot != 0) {
+            cache_entry_t *entry = &cache->entries[slot - 1];
+            if (!entry->touched && (record.last_used > entry->record.last_used)) {
+                entry->record.last_used = record.last_used;
+            }
+            free(name);
+            free(source_path);
+            continue;
+        }
+
+        cache_entry_t *entry = add_entry(cache, record.uuid, record.offset);
+        if (entry == NULL) {
+            free(name);
+            free(source_path);
+            goto corrupt;
+        }
+        entry->record = record;
+        entry->name = name;
+        entry->source_path = source_path;
+    }
+    goto exit;
+
+corrupt:
+    fprintf(stderr, "WARNING: Symbol cache \"%s\" is truncated or corrupt; discarding.\n", cache->filepath);
+    cache->dirty = 1;
+
+exit:
+    fclose(f);
+    return header.generation;
+}
+
+// NOTE: The cache file is shared by several processes (the app and notifier),
+//       each of which merges its entries with those of the file when saving;
+//       the lock prevents entries from being lost to concurrent saves.
+static int lock_file(const char *filepath) {
+    const size_t length = strlen(filepath) + 8;
+    char lock_filepath[length];
+    snprintf(lock_filepath, length, "%s.lock", filepath);
+
+    int fd = open(lock_filepath, O_RDONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Unable to open symbol cache lock \"%s\", errno = %d.\n", lock_filepath, errno);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int result;
+    do {
+        result = flock(fd, LOCK_EX);
+    } while ((result != 0) && (errno == EINTR));
+    if (result != 0) {
+        fprintf(stderr, "ERROR: Unable to lock symbol cache \"%s\", errno = %d.\n", filepath, errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void unlock_file(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+symbol_cache_t *symbol_cache_open(const char *filepath, size_t max_entries) {
+    symbol_cache_t *cache = calloc(1, sizeof(symbol_cache_t));
+    if (cache != NULL) {
+        cache->max_entries = max_entries;
+        cache->filepath = strdup(filepath);
+        if ((cache->filepath == NULL) || !rehash(cache, 256)) {
+            symbol_cache_close(cache);
+            return NULL;
+        }
+        cache->generation = merge(cache) + 1;
+        cache->base_generation = cache->generation;
+    }
+    return cache;
+}
+
+static int hex_value(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// NOTE: Accepts UUIDs both with and without dashes.
+int symbol_cache_parse_uuid(const char *string, uint8_t uuid[16]) {
+    unsigned count = 0;
+    for (const char *p = string; *p != '\0'; ++p) {
+        if (*p == '-') {
+            continue;
+        }
+        const int value = hex_value(*p);
+        if ((value < 0) || (count == 32)) {
+            return 0;
+        }
+        if ((count & 1) == 0) {
+            uuid[count / 2] = value << 4;
+        } else {
+            uuid[count / 2] |= value;
+        }
+        ++count;
+    }
+    return (count == 32);
+}
+
+void symbol_cache_next_generation(symbol_cache_t *cache) {
+    ++cache->generation;
+}
+
+// NOTE: A lookup does not by itself cause the cache to be saved; the time of
+//       use is saved along with the next change.
+int symbol_cache_lookup(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset, symbol_cache_info_t *info) {
+    const size_t slot = *find_slot(cache, uuid, offset);
+    if (slot != 0) {
+        cache_entry_t *entry = &cache->entries[slot - 1];
+        entry->record.last_used = cache->generation;
+        entry->touched = 1;
+        if (info != NULL) {
+            info->name = (entry->record.name_length != 0) ? entry->name : NULL;
+            info->source_path = (entry->record.source_path_length != 0) ? entry->source_path : NULL;
+            info->source_line = entry->record.source_line;
+            info->symbol_offset = entry->record.symbol_offset;
+        }
+        ++cache->hits;
+        return 1;
+    }
+    ++cache->misses;
+    return 0;
+}
+
+int symbol_cache_update(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset, const symbol_cache_info_t *info) {
+    const size_t name_length = (info->name != NULL) ? strlen(info->name) : 0;
+    const size_t source_path_length = (info->source_path != NULL) ? strlen(info->source_path) : 0;
+    if ((name_length > UINT16_MAX) || (source_path_length > UINT16_MAX)) {
+        return 0;
+    }
+
+    char *name = strdup((info->name != NULL) ? info->name : "");
+    char *source_path = strdup((info->source_path != NULL) ? info->source_path : "");
+    if ((name == NULL) || (source_path == NULL)) {
+        free(name);
+        free(source_path);
+        return 0;
+    }
+
+    const size_t slot = *find_slot(cache, uuid, offset);
+    cache_entry_t *entry = (slot != 0) ? &cache->entries[slot - 1] : add_entry(cache, uuid, offset);
+    if (entry == NULL) {
+        free(name);
+        free(source_path);
+        return 0;
+    }
+
+    free(entry->name);
+    free(entry->source_path);
+    entry->name = name;
+    entry->source_path = source_path;
+    entry->record.symbol_offset = info->symbol_offset;
+    entry->record.source_line = info->source_line;
+    entry->record.last_used = cache->generation;
+    entry->record.name_length = name_length;
+    entry->record.source_path_length = source_path_length;
+    entry->touched = 1;
+    cache->dirty = 1;
+    return 1;
+}
+
+void symbol_cache_get_stats(symbol_cache_t *cache, uint64_t *hits, uint64_t *misses) {
+    if (hits != NULL) {
+        *hits = cache->hits;
+    }
+    if (misses != NULL) {
+        *misses = cache->misses;
+    }
+}
+
+typedef struct {
+    uint32_t last_used;
+    uint32_t index;
+} entry_order_t;
+
+static int compare_last_used(const void *a, const void *b) {
+    const uint32_t a_last_used = ((const entry_order_t *)a)->last_used;
+    const uint32_t b_last_used = ((const entry_order_t *)b)->last_used;
+    // NOTE: Most recently used first.
+    return (a_last_used < b_last_used) - (a_last_used > b_last_used);
+}
+
+// NOTE: Entries used since the last load or save were used after any entry of
+//       the file, which may have been saved by another process since; they are
+//       moved after the generation of the file, keeping their order.
+static void rebase_generations(symbol_cache_t *cache, uint32_t file_generation) {
+    if (file_generation >= cache->base_generation) {
+        const uint32_t shift = file_generation + 1 - cache->base_generation;
+        for (size_t i = 0; i < cache->count; ++i) {
+            if (cache->entries[i].touched) {
+                cache->entries[i].record.last_used += shift;
+            }
+        }
+        cache->generation += shift;
+    }
+    for (size_t i = 0; i < cache->count; ++i) {
+        cache->entries[i].touched = 0;
+    }
+}
+
+// Keep only the most recently used entries, in memory as well as in the file.
+// NOTE: Entries for binaries that have since been updated (and thus have a new
+//       UUID) are no longer looked up, and so are evicted.
+static int prune(symbol_cache_t *cache) {
+    if ((cache->max_entries == 0) || (cache->count <= cache->max_entries)) {
+        return 1;
+    }
+
+    entry_order_t *order = malloc(cache->count * sizeof(entry_order_t));
+    cache_entry_t *entries = malloc(cache->max_entries * sizeof(cache_entry_t));
+    if ((order == NULL) || (entries == NULL)) {
+        free(order);
+        free(entries);
+        return 0;
+    }
+    for (size_t i = 0; i < cache->count; ++i) {
+        order[i].last_used = cache->entries[i].record.last_used;
+        order[i].index = i;
+    }
+    qsort(order, cache->count, sizeof(entry_order_t), compare_last_used);
+
+    for (size_t i = 0; i < cache->count; ++i) {
+        cache_entry_t *entry = &cache->entries[order[i].index];
+        if (i < cache->max_entries) {
+            entries[i] = *entry;
+        } else {
+            free(entry->name);
+            free(entry->source_path);
+        }
+    }
+    free(order);
+
+    free(cache->entries);
+    cache->entries = entries;
+    cache->count = cache->max_entries;
+    cache->capacity = cache->max_entries;
+    // NOTE: Cannot fail, as the table is not being enlarged.
+    return rehash(cache, cache->slot_count);
+}
+
+static int write_entries(symbol_cache_t *cache) {
+    // NOTE: Write to a temporary file and rename so that readers never see a
+    //       partially written cache.
+    const size_t length = strlen(cache->filepath) + 16;
+    char temp_filepath[length];
+    snprintf(temp_filepath, length, "%s.%d", cache->filepath, (int)getpid());
+
+    FILE *f = fopen(temp_filepath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to write symbol cache \"%s\", errno = %d.\n", temp_filepath, errno);
+        return 0;
+    }
+
+    cache_header_t header;
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.count = cache->count;
+    header.generation = cache->generation;
+    int succeeded = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    for (size_t i = 0; succeeded && (i < cache->count); ++i) {
+        const cache_entry_t *entry = &cache->entries[i];
+        succeeded =
+            (fwrite(&entry->record, sizeof(entry->record), 1, f) == 1) &&
+            (fwrite(entry->name, 1, entry->record.name_length, f) == entry->record.name_length) &&
+            (fwrite(entry->source_path, 1, entry->record.source_path_length, f) == entry->record.source_path_length);
+    }
+
+    if (fclose(f) != 0) {
+        succeeded = 0;
+    }
+    if (succeeded && (rename(temp_filepath, cache->filepath) != 0)) {
+        succeeded = 0;
+    }
+    if (!succeeded) {
+        fprintf(stderr, "ERROR: Failed to save symbol cache \"%s\", errno = %d.\n", cache->filepath, errno);
+        unlink(temp_filepath);
+    }
+    return succeeded;
+}
+
+// NOTE: Entries saved by other processes since the cache was loaded are
+//       merged in first, so that they are not lost.
+int symbol_cache_save(symbol_cache_t *cache) {
+    if (!cache->dirty) {
+        // Nothing has changed.
+        return 1;
+    }
+
+    const int lock_fd = lock_file(cache->filepath);
+    if (lock_fd < 0) {
+        return 0;
+    }
+
+    rebase_generations(cache, merge(cache));
+    int succeeded = prune(cache) && write_entries(cache);
+    if (succeeded) {
+        cache->dirty = 0;
+    }
+    unlock_file(lock_fd);
+
+    // NOTE: Entries used from now on are more recent than any saved.
+    ++cache->generation;
+    cache->base_generation = cache->generation;
+    return succeeded;
+}
+
+void symbol_cache_close(symbol_cache_t *cache) {
+    if (cache != NULL) {
+        for (size_t i = 0; i < cache->count; ++i) {
+            free(cache->entries[i].name);
+            free(cache->entries[i].source_path);
+        }
+        free(cache->entries);
+        free(cache->slots);
+        free(cache->filepath);
+        free(cache);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
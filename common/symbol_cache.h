@@ -0,0 +1,55 @@
+/**
+ * Desc: Persistent cache of symbolication results, keyed by binary image UUID
+ *       and image-relative address, so that frames that have been resolved
+ *       before (e.g. in earlier crashes of the same process) do not need to
+ *       be looked up again.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_SYMBOL_CACHE_H_
+#define COMMON_SYMBOL_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct symbol_cache symbol_cache_t;
+
+typedef struct {
+    // NOTE: NULL if the address could not be symbolicated; such results are
+    //       cached as well, as the lookup would fail again.
+    const char *name;
+    // NOTE: NULL if source information is not available.
+    const char *source_path;
+    uint32_t source_line;
+    // Offset of the address from the start of the symbol.
+    uint64_t symbol_offset;
+} symbol_cache_info_t;
+
+// NOTE: When saved, only the most recently used entries are kept (in memory as
+//       well as in the file).
+symbol_cache_t *symbol_cache_open(const char *filepath, size_t max_entries);
+int symbol_cache_parse_uuid(const char *string, uint8_t uuid[16]);
+// NOTE: Marks the start of a new use of the cache (e.g. for a report); entries
+//       used after this are considered more recent than those used before.
+void symbol_cache_next_generation(symbol_cache_t *cache);
+int symbol_cache_lookup(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset, symbol_cache_info_t *info);
+int symbol_cache_update(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset, const symbol_cache_info_t *info);
+void symbol_cache_get_stats(symbol_cache_t *cache, uint64_t *hits, uint64_t *misses);
+// NOTE: The file may be shared by several processes; entries saved by others
+//       are merged with those of this cache, rather than replaced.
+int symbol_cache_save(symbol_cache_t *cache);
+void symbol_cache_close(symbol_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_SYMBOL_CACHE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
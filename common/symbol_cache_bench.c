@@ -0,0 +1,275 @@
+/**
+ * Desc: Benchmark of symbolicating crash reports from the symbol cache with
+ *       several threads (as symbolicateFiles() does): a C mirror of
+ *       applyCachedSymbols(), comparing the lock being held for the whole of
+ *       each report (including the building of symbol tables and the saving of
+ *       the cache, as it used to be) with it being held for lookups and
+ *       updates only (the cache then being saved once, at the end).
+ *
+ *       Reading a binary to build its table, and the rest of the processing of
+ *       a report (parsing, writing the output), are modelled with sleeps, as on
+ *       a device they mostly wait for flash storage.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "symbol_cache.h"
+#include "symbol_table.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "test_util.h"
+
+static const unsigned kReportCount = 96;
+static const unsigned kReportsPerImage = 4;
+static const unsigned kSharedFrameCount = 50;
+static const unsigned kImageFrameCount = 10;
+static const unsigned kImageSymbolCount = 2000;
+static const unsigned kCachedEntryCount = 20000;
+static const size_t kMaxEntries = 32768;
+static const useconds_t kReadBinaryTime = 4000;
+static const useconds_t kReportTime = 3000;
+
+typedef struct {
+    const char *directory;
+    symbol_cache_t *cache;
+    int narrow_lock;
+    unsigned next_report;
+
+    pthread_mutex_t cache_lock;
+    pthread_mutex_t tables_lock;
+    pthread_cond_t tables_condition;
+    // NOTE: Indexed by image; zero if not opened, one while being opened.
+    symbol_table_t **tables;
+    int *table_states;
+    unsigned table_build_count;
+} bench_t;
+
+static void image_uuid(unsigned image, uint8_t uuid[16]) {
+    memset(uuid, 0, 16);
+    memcpy(uuid, &image, sizeof(image));
+    uuid[15] = 0xaa;
+}
+
+static void shared_uuid(uint8_t uuid[16]) {
+    memset(uuid, 0x55, 16);
+}
+
+static symbol_table_t *build_table(bench_t *bench, unsigned image) {
+    uint8_t uuid[16];
+    image_uuid(image, uuid);
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), bench->directory, "%08x.symtab", image);
+
+    usleep(kReadBinaryTime);
+    symbol_table_builder_t *builder = symbol_table_builder_create();
+    for (unsigned i = 0; i < kImageSymbolCount; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "-[Image%u method%u:withArgument:]", image, i);
+        symbol_table_builder_add(builder, 0x1000 + 0x40 * i, 0x1000 + 0x40 * kImageSymbolCount, name);
+    }
+    CHECK(symbol_table_builder_write(builder, uuid, filepath));
+    symbol_table_builder_free(builder);
+    return symbol_table_open(filepath, uuid);
+}
+
+// NOTE: As lookUpSymbolInTable(): the table is opened (and built) without the
+//       lock; other threads that need the same table wait for it.
+static int look_up_in_table(bench_t *bench, unsigned image, uint64_t offset, char *name, size_t size) {
+    symbol_table_t *table;
+    if (bench->narrow_lock) {
+        pthread_mutex_lock(&bench->tables_lock);
+        while (bench->table_states[image] == 1) {
+            pthread_cond_wait(&bench->tables_condition, &bench->tables_lock);
+        }
+        if (bench->table_states[image] == 0) {
+            bench->table_states[image] = 1;
+            pthread_mutex_unlock(&bench->tables_lock);
+            table = build_table(bench, image);
+            pthread_mutex_lock(&bench->tables_lock);
+            bench->tables[image] = table;
+            bench->table_states[image] = 2;
+            ++bench->table_build_count;
+            pthread_cond_broadcast(&bench->tables_condition);
+        }
+    } else {
+        // NOTE: The cache lock is held.
+        if (bench->table_states[image] == 0) {
+            bench->tables[image] = build_table(bench, image);
+            bench->table_states[image] = 2;
+            ++bench->table_build_count;
+        }
+    }
+    table = bench->tables[image];
+
+    const char *symbol_name;
+    uint64_t symbol_offset;
+    const int found = (table != NULL) && symbol_table_lookup(table, offset, &symbol_name, &symbol_offset);
+    if (found) {
+        snprintf(name, size, "%s", symbol_name);
+    }
+    if (bench->narrow_lock) {
+        pthread_mutex_unlock(&bench->tables_lock);
+    }
+    return found;
+}
+
+static unsigned symbolicate_report(bench_t *bench, unsigned report) {
+    const unsigned image = report / kReportsPerImage;
+    uint8_t uuid[16];
+    unsigned resolved_count = 0;
+
+    pthread_mutex_lock(&bench->cache_lock);
+    symbol_cache_next_generation(bench->cache);
+    int missed[kImageFrameCount];
+    shared_uuid(uuid);
+    for (unsigned i = 0; i < kSharedFrameCount; ++i) {
+        const uint64_t offset = 0x1000 + 0x40 * ((report * 7 + i * 13) % kCachedEntryCount);
+        symbol_cache_info_t info;
+        if (symbol_cache_lookup(bench->cache, uuid, offset, &info)) {
+            ++resolved_count;
+        }
+    }
+    image_uuid(image, uuid);
+    for (unsigned i = 0; i < kImageFrameCount; ++i) {
+        symbol_cache_info_t info;
+        missed[i] = !symbol_cache_lookup(bench->cache, uuid, 0x1000 + 0x40 * i + 4, &info);
+        if (!missed[i]) {
+            ++resolved_count;
+        }
+    }
+    if (bench->narrow_lock) {
+        pthread_mutex_unlock(&bench->cache_lock);
+    }
+
+    for (unsigned i = 0; i < kImageFrameCount; ++i) {
+        if (!missed[i]) {
+            continue;
+        }
+        const uint64_t offset = 0x1000 + 0x40 * i + 4;
+        char name[128];
+        if (look_up_in_table(bench, image, offset, name, sizeof(name))) {
+            symbol_cache_info_t info = {name, NULL, 0, 4};
+            if (bench->narrow_lock) {
+                pthread_mutex_lock(&bench->cache_lock);
+            }
+            CHECK(symbol_cache_update(bench->cache, uuid, offset, &info));
+            if (bench->narrow_lock) {
+                pthread_mutex_unlock(&bench->cache_lock);
+            }
+            ++resolved_count;
+        }
+    }
+
+    if (!bench->narrow_lock) {
+        CHECK(symbol_cache_save(bench->cache));
+        pthread_mutex_unlock(&bench->cache_lock);
+    }
+    return resolved_count;
+}
+
+static void *worker(void *context) {
+    bench_t *bench = context;
+    for (;;) {
+        // NOTE: The next report is taken under the tables lock, as that is
+        //       held only briefly in either case.
+        pthread_mutex_lock(&bench->tables_lock);
+        const unsigned report = bench->next_report++;
+        pthread_mutex_unlock(&bench->tables_lock);
+        if (report >= kReportCount) {
+            break;
+        }
+
+        CHECK(symbolicate_report(bench, report) == kSharedFrameCount + kImageFrameCount);
+        // The rest of the processing of the report.
+        usleep(kReportTime);
+    }
+    return NULL;
+}
+
+static void make_cache(const char *filepath) {
+    symbol_cache_t *cache = symbol_cache_open(filepath, kMaxEntries);
+    uint8_t uuid[16];
+    shared_uuid(uuid);
+    for (unsigned i = 0; i < kCachedEntryCount; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "-[SharedClass method%u:withArgument:]", i);
+        symbol_cache_info_t info = {name, NULL, 0, 0};
+        CHECK(symbol_cache_update(cache, uuid, 0x1000 + 0x40 * i, &info));
+    }
+    CHECK(symbol_cache_save(cache));
+    symbol_cache_close(cache);
+}
+
+static double run(unsigned thread_count, int narrow_lock) {
+    char *directory = test_make_directory("symbol_cache_bench");
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "symbols.cache");
+    make_cache(filepath);
+
+    const unsigned image_count = kReportCount / kReportsPerImage;
+    bench_t bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.directory = directory;
+    bench.narrow_lock = narrow_lock;
+    pthread_mutex_init(&bench.cache_lock, NULL);
+    pthread_mutex_init(&bench.tables_lock, NULL);
+    pthread_cond_init(&bench.tables_condition, NULL);
+    bench.tables = calloc(image_count, sizeof(symbol_table_t *));
+    bench.table_states = calloc(image_count, sizeof(int));
+
+    const double start = test_time();
+    bench.cache = symbol_cache_open(filepath, kMaxEntries);
+    CHECK(bench.cache != NULL);
+    pthread_t threads[thread_count];
+    for (unsigned i = 0; i < thread_count; ++i) {
+        CHECK(pthread_create(&threads[i], NULL, worker, &bench) == 0);
+    }
+    for (unsigned i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    if (narrow_lock) {
+        // NOTE: As symbolicateFiles(): saved once all reports are processed.
+        CHECK(symbol_cache_save(bench.cache));
+    }
+    const double elapsed = test_time() - start;
+    CHECK(bench.table_build_count == image_count);
+
+    // Both save the same entries.
+    symbol_cache_close(bench.cache);
+    symbol_cache_t *cache = symbol_cache_open(filepath, 0);
+    uint8_t uuid[16];
+    image_uuid(image_count - 1, uuid);
+    symbol_cache_info_t info;
+    CHECK(symbol_cache_lookup(cache, uuid, 0x1000 + 4, &info));
+    symbol_cache_close(cache);
+
+    for (unsigned i = 0; i < image_count; ++i) {
+        symbol_table_close(bench.tables[i]);
+    }
+    free(bench.tables);
+    free(bench.table_states);
+    pthread_cond_destroy(&bench.tables_condition);
+    pthread_mutex_destroy(&bench.tables_lock);
+    pthread_mutex_destroy(&bench.cache_lock);
+    test_remove_directory(directory);
+    return elapsed;
+}
+
+int main(void) {
+    printf("Symbolicate %u reports from the symbol cache (%u frames each; a new image every %u reports):\n",
+        kReportCount, kSharedFrameCount + kImageFrameCount, kReportsPerImage);
+    const unsigned thread_counts[] = {1, 2, 4, 8};
+    for (unsigned i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i) {
+        const double wide_time = run(thread_counts[i], 0);
+        const double narrow_time = run(thread_counts[i], 1);
+        printf("  %u %-8s %7.1f ms locked throughout, %7.1f ms locked for lookups only\n",
+            thread_counts[i], (thread_counts[i] == 1) ? "thread:" : "threads:",
+            wide_time * 1000.0, narrow_time * 1000.0);
+    }
+    return test_result("symbol_cache_bench");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
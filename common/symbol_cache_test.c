@@ -0,0 +1,276 @@
+/**
+ * Desc: Test of the symbol cache: saving and loading, eviction of the least
+ *       recently used entries (one generation per report), and saves of the
+ *       same file by more than one process.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "symbol_cache.h"
+
+#include <stdint.h>
+
+#include "test_util.h"
+
+static const uint8_t kUUID[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const uint8_t kOtherUUID[16] = {0x01};
+
+static void add_symbol(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset) {
+    char name[32];
+    snprintf(name, sizeof(name), "symbol_%llx", (unsigned long long)offset);
+    symbol_cache_info_t info = {name, "main.c", (uint32_t)offset, offset % 16};
+    CHECK(symbol_cache_update(cache, uuid, offset, &info));
+}
+
+static int has_symbol(symbol_cache_t *cache, const uint8_t uuid[16], uint64_t offset) {
+    symbol_cache_info_t info;
+    if (!symbol_cache_lookup(cache, uuid, offset, &info)) {
+        return 0;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "symbol_%llx", (unsigned long long)offset);
+    return (info.name != NULL) && (strcmp(info.name, name) == 0) &&
+        (info.source_path != NULL) && (strcmp(info.source_path, "main.c") == 0) &&
+        (info.source_line == (uint32_t)offset) && (info.symbol_offset == offset % 16);
+}
+
+static void test_round_trip(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "round_trip.cache");
+
+    symbol_cache_t *cache = symbol_cache_open(filepath, 0);
+    CHECK(cache != NULL);
+    add_symbol(cache, kUUID, 0x1000);
+    add_symbol(cache, kOtherUUID, 0x1000);
+    // NOTE: Frames without a symbol are cached as well.
+    symbol_cache_info_t info = {NULL, NULL, 0, 0};
+    CHECK(symbol_cache_update(cache, kUUID, 0x2000, &info));
+    CHECK(symbol_cache_save(cache));
+    symbol_cache_close(cache);
+
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(cache != NULL);
+    CHECK(has_symbol(cache, kUUID, 0x1000));
+    CHECK(has_symbol(cache, kOtherUUID, 0x1000));
+    CHECK(symbol_cache_lookup(cache, kUUID, 0x2000, &info));
+    CHECK((info.name == NULL) && (info.source_path == NULL));
+    CHECK(!symbol_cache_lookup(cache, kUUID, 0x3000, &info));
+
+    uint64_t hits;
+    uint64_t misses;
+    symbol_cache_get_stats(cache, &hits, &misses);
+    CHECK((hits == 3) && (misses == 1));
+    symbol_cache_close(cache);
+}
+
+// NOTE: A long-lived process (the notifier) opens the cache once; entries of
+//       recent reports must not be evicted in favour of older ones.
+static void test_eviction(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "eviction.cache");
+
+    const unsigned max_entries = 100;
+    symbol_cache_t *cache = symbol_cache_open(filepath, max_entries);
+    CHECK(cache != NULL);
+
+    // Each report adds 10 frames; the frames of the last 10 reports are kept.
+    for (unsigned report = 0; report < 20; ++report) {
+        symbol_cache_next_generation(cache);
+        for (unsigned i = 0; i < 10; ++i) {
+            add_symbol(cache, kUUID, 0x1000 * (report + 1) + i);
+        }
+        CHECK(symbol_cache_save(cache));
+    }
+
+    // NOTE: Evicted entries are removed from memory as well.
+    for (unsigned report = 0; report < 20; ++report) {
+        for (unsigned i = 0; i < 10; ++i) {
+            symbol_cache_info_t info;
+            const int found = symbol_cache_lookup(cache, kUUID, 0x1000 * (report + 1) + i, &info);
+            CHECK(found == (report >= 10));
+        }
+    }
+    symbol_cache_close(cache);
+
+    cache = symbol_cache_open(filepath, max_entries);
+    CHECK(cache != NULL);
+    for (unsigned report = 10; report < 20; ++report) {
+        for (unsigned i = 0; i < 10; ++i) {
+            CHECK(has_symbol(cache, kUUID, 0x1000 * (report + 1) + i));
+        }
+    }
+    symbol_cache_close(cache);
+}
+
+// NOTE: The frames of the first report are looked up in each report, and so
+//       are kept.
+static void test_eviction_keeps_used(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "used.cache");
+
+    symbol_cache_t *cache = symbol_cache_open(filepath, 50);
+    CHECK(cache != NULL);
+    for (unsigned report = 0; report < 20; ++report) {
+        symbol_cache_next_generation(cache);
+        for (unsigned i = 0; i < 10; ++i) {
+            if (report != 0) {
+                CHECK(has_symbol(cache, kOtherUUID, i));
+            } else {
+                add_symbol(cache, kOtherUUID, i);
+            }
+            add_symbol(cache, kUUID, 0x1000 * (report + 1) + i);
+        }
+        CHECK(symbol_cache_save(cache));
+    }
+    symbol_cache_close(cache);
+
+    cache = symbol_cache_open(filepath, 50);
+    CHECK(cache != NULL);
+    for (unsigned i = 0; i < 10; ++i) {
+        CHECK(has_symbol(cache, kOtherUUID, i));
+        CHECK(has_symbol(cache, kUUID, 0x1000 * 20 + i));
+    }
+    symbol_cache_close(cache);
+}
+
+// NOTE: The app and the notifier each keep the cache open; the entries saved
+//       by one must not be lost when the other saves.
+static void test_shared_file(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "shared.cache");
+
+    symbol_cache_t *app = symbol_cache_open(filepath, 0);
+    symbol_cache_t *notifier = symbol_cache_open(filepath, 0);
+    CHECK((app != NULL) && (notifier != NULL));
+
+    add_symbol(app, kUUID, 0x1000);
+    CHECK(symbol_cache_save(app));
+    add_symbol(notifier, kOtherUUID, 0x2000);
+    CHECK(symbol_cache_save(notifier));
+    add_symbol(app, kUUID, 0x3000);
+    CHECK(symbol_cache_save(app));
+    symbol_cache_close(app);
+    symbol_cache_close(notifier);
+
+    symbol_cache_t *cache = symbol_cache_open(filepath, 0);
+    CHECK(cache != NULL);
+    CHECK(has_symbol(cache, kUUID, 0x1000));
+    CHECK(has_symbol(cache, kOtherUUID, 0x2000));
+    CHECK(has_symbol(cache, kUUID, 0x3000));
+    symbol_cache_close(cache);
+
+    // Entries used by either process since are kept over older ones.
+    app = symbol_cache_open(filepath, 4);
+    notifier = symbol_cache_open(filepath, 4);
+    symbol_cache_next_generation(app);
+    CHECK(has_symbol(app, kOtherUUID, 0x2000));
+    CHECK(has_symbol(app, kUUID, 0x3000));
+    add_symbol(app, kUUID, 0x4000);
+    CHECK(symbol_cache_save(app));
+    symbol_cache_next_generation(notifier);
+    add_symbol(notifier, kUUID, 0x5000);
+    CHECK(symbol_cache_save(notifier));
+    symbol_cache_close(app);
+
+    // NOTE: The notifier loaded the entries of the app when saving.
+    CHECK(has_symbol(notifier, kUUID, 0x4000));
+    CHECK(has_symbol(notifier, kUUID, 0x5000));
+    symbol_cache_close(notifier);
+
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(has_symbol(cache, kOtherUUID, 0x2000));
+    CHECK(has_symbol(cache, kUUID, 0x3000));
+    CHECK(has_symbol(cache, kUUID, 0x4000));
+    CHECK(has_symbol(cache, kUUID, 0x5000));
+    CHECK(!has_symbol(cache, kUUID, 0x1000));
+    symbol_cache_close(cache);
+}
+
+// NOTE: Reports that are resolved entirely from the cache do not rewrite it.
+static void test_lookups_do_not_save(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "lookups.cache");
+
+    symbol_cache_t *cache = symbol_cache_open(filepath, 0);
+    add_symbol(cache, kUUID, 0x1000);
+    CHECK(symbol_cache_save(cache));
+    struct stat before;
+    CHECK(stat(filepath, &before) == 0);
+
+    symbol_cache_next_generation(cache);
+    CHECK(has_symbol(cache, kUUID, 0x1000));
+    CHECK(symbol_cache_save(cache));
+    struct stat after;
+    CHECK(stat(filepath, &after) == 0);
+    CHECK(before.st_ino == after.st_ino);
+    symbol_cache_close(cache);
+}
+
+static void test_corrupt_file(const char *directory) {
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "corrupt.cache");
+
+    symbol_cache_t *cache = symbol_cache_open(filepath, 0);
+    for (unsigned i = 0; i < 10; ++i) {
+        add_symbol(cache, kUUID, i);
+    }
+    CHECK(symbol_cache_save(cache));
+    symbol_cache_close(cache);
+
+    // Truncate within the last record; the preceding ones are still read.
+    struct stat st;
+    CHECK(stat(filepath, &st) == 0);
+    CHECK(truncate(filepath, st.st_size - 4) == 0);
+
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    // NOTE: The file is rewritten, as it is corrupt.
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(cache != NULL);
+    CHECK(symbol_cache_save(cache));
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    close(null_fd);
+
+    for (unsigned i = 0; i < 9; ++i) {
+        CHECK(has_symbol(cache, kUUID, i));
+    }
+    CHECK(!has_symbol(cache, kUUID, 9));
+    symbol_cache_close(cache);
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(has_symbol(cache, kUUID, 8));
+    symbol_cache_close(cache);
+
+    // Unknown format.
+    CHECK(test_write_file(filepath, "XXXXXXXXXXXXXXXX", 16));
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(cache != NULL);
+    CHECK(!has_symbol(cache, kUUID, 0));
+    add_symbol(cache, kUUID, 0);
+    CHECK(symbol_cache_save(cache));
+    symbol_cache_close(cache);
+    cache = symbol_cache_open(filepath, 0);
+    CHECK(has_symbol(cache, kUUID, 0));
+    symbol_cache_close(cache);
+}
+
+int main(void) {
+    char *directory = test_make_directory("symbol_cache_test");
+    test_round_trip(directory);
+    test_eviction(directory);
+    test_eviction_keeps_used(directory);
+    test_shared_file(directory);
+    test_lookups_do_not_save(directory);
+    test_corrupt_file(directory);
+    test_remove_directory(directory);
+    return test_result("symbol_cache_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,322 @@
+/**
+ * Desc: Compact on-disk symbol table for a single binary image, identified by
+ *       its UUID. Tables are built once and then memory-mapped (read-only) by
+ *       each process that needs them.
+ *
+ *       Lookups do not allocate memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "symbol_table.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "macho.h"
+
+// NOTE: Tables are a local cache; values are stored in native byte order. If
+//       the format changes, the version must be bumped, which causes existing
+//       tables to be rebuilt.
+// NOTE: Layout is the header, followed by the sorted array of addresses, the
+//       array of end addresses, the array of name offsets (one per address),
+//       and the string pool.
+static const char kTableMagic[4] = {'C', 'R', 'S', 'T'};
+static const uint32_t kTableVersion = 2;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint8_t uuid[16];
+    uint32_t count;
+    uint32_t string_size;
+} table_header_t;
+
+typedef struct {
+    uint64_t address;
+    uint64_t end;
+    uint32_t name_offset;
+    // NOTE: Used to keep the first name added for an address.
+    uint32_t order;
+} builder_symbol_t;
+
+struct symbol_table_builder {
+    builder_symbol_t *symbols;
+    size_t count;
+    size_t capacity;
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+};
+
+struct symbol_table {
+    void *map;
+    size_t map_size;
+    const uint64_t *addresses;
+    const uint64_t *ends;
+    const uint32_t *name_offsets;
+    const char *strings;
+    uint32_t count;
+    uint32_t string_size;
+};
+
+symbol_table_builder_t *symbol_table_builder_create(void) {
+    return calloc(1, sizeof(symbol_table_builder_t));
+}
+
+int symbol_table_builder_add(symbol_table_builder_t *builder, uint64_t address, uint64_t section_end, const char *name) {
+    if (address >= section_end) {
+        return 0;
+    }
+
+    const size_t length = strlen(name) + 1;
+    if ((builder->count >= UINT32_MAX) || (builder->string_size + length > UINT32_MAX)) {
+        return 0;
+    }
+
+    if (builder->count == builder->capacity) {
+        size_t capacity = (builder->capacity != 0) ? (2 * builder->capacity) : 1024;
+        builder_symbol_t *symbols = realloc(builder->symbols, capacity * sizeof(builder_symbol_t));
+        if (symbols == NULL) {
+            return 0;
+        }
+        builder->symbols = symbols;
+        builder->capacity = capacity;
+    }
+
+    if (builder->string_size + length > builder->string_capacity) {
+        size_t capacity = (builder->string_capacity != 0) ? builder->string_capacity : 16384;
+        while (builder->string_size + length > capacity) {
+            capacity *= 2;
+        }
+        char *strings = realloc(builder->strings, capacity);
+        if (strings == NULL) {
+            return 0;
+        }
+        builder->strings = strings;
+        builder->string_capacity = capacity;
+    }
+
+    builder_symbol_t *symbol = &builder->symbols[builder->count];
+    symbol->address = address;
+    symbol->end = section_end;
+    symbol->name_offset = builder->string_size;
+    symbol->order = builder->count;
+    memcpy(builder->strings + builder->string_size, name, length);
+    builder->string_size += length;
+    ++builder->count;
+    return 1;
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const builder_symbol_t *symbol_a = a;
+    const builder_symbol_t *symbol_b = b;
+    if (symbol_a->address != symbol_b->address) {
+        return (symbol_a->address < symbol_b->address) ? -1 : 1;
+    }
+    return (symbol_a->order < symbol_b->order) ? -1 : (symbol_a->order > symbol_b->order);
+}
+
+int symbol_table_builder_write(symbol_table_builder_t *builder, const uint8_t uuid[16], const char *filepath) {
+    // Sort by address, keeping only one symbol per address.
+    qsort(builder->symbols, builder->count, sizeof(builder_symbol_t), compare_symbols);
+    size_t count = 0;
+    for (size_t i = 0; i < builder->count; ++i) {
+        if ((count == 0) || (builder->symbols[count - 1].address != builder->symbols[i].address)) {
+            builder->symbols[count++] = builder->symbols[i];
+        }
+    }
+    builder->count = count;
+
+    // A symbol ends where the next one starts, or at the end of its section.
+    for (size_t i = 0; i + 1 < count; ++i) {
+        if (builder->symbols[i + 1].address < builder->symbols[i].end) {
+            builder->symbols[i].end = builder->symbols[i + 1].address;
+        }
+    }
+
+    // NOTE: Write to a temporary file and rename so that readers never see a
+    //       partially written table.
+    const size_t length = strlen(filepath) + 16;
+    char temp_filepath[length];
+    snprintf(temp_filepath, length, "%s.%d", filepath, (int)getpid());
+
+    FILE *f = fopen(temp_filepath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: Unable to write symbol table \"%s\", errno = %d.\n", temp_filepath, errno);
+        return 0;
+    }
+
+    table_header_t header;
+    memcpy(header.magic, kTableMagic, sizeof(kTableMagic));
+    header.version = kTableVersion;
+    memcpy(header.uuid, uuid, 16);
+    header.count = count;
+    header.string_size = builder->string_size;
+    int succeeded = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    for (size_t i = 0; succeeded && (i < count); ++i) {
+        succeeded = (fwrite(&builder->symbols[i].address, sizeof(uint64_t), 1, f) == 1);
+    }
+    for (size_t i = 0; succeeded && (i < count); ++i) {
+        succeeded = (fwrite(&builder->symbols[i].end, sizeof(uint64_t), 1, f) == 1);
+    }
+    for (size_t i = 0; succeeded && (i < count); ++i) {
+        succeeded = (fwrite(&builder->symbols[i].name_offset, sizeof(uint32_t), 1, f) == 1);
+    }
+    if (succeeded) {
+        succeeded = (fwrite(builder->strings, 1, builder->string_size, f) == builder->string_size);
+    }
+
+    if (fclose(f) != 0) {
+        succeeded = 0;
+    }
+    if (succeeded && (rename(temp_filepath, filepath) != 0)) {
+        succeeded = 0;
+    }
+    if (!succeeded) {
+        fprintf(stderr, "ERROR: Failed to save symbol table \"%s\", errno = %d.\n", filepath, errno);
+        unlink(temp_filepath);
+    }
+    return succeeded;
+}
+
+void symbol_table_builder_free(symbol_table_builder_t *builder) {
+    if (builder != NULL) {
+        free(builder->symbols);
+        free(builder->strings);
+        free(builder);
+    }
+}
+
+static void add_symbol(const char *name, uint64_t address, uint64_t section_end, void *context) {
+    symbol_table_builder_t *builder = context;
+
+    // NOTE: C symbols are prefixed with an underscore.
+    if (name[0] == '_') {
+        ++name;
+    }
+    if (name[0] != '\0') {
+        symbol_table_builder_add(builder, address, section_end, name);
+    }
+}
+
+int symbol_table_build_for_binary(const char *binary_filepath, const uint8_t uuid[16], const char *filepath) {
+    int succeeded = 0;
+
+    macho_file_t *file = macho_open(binary_filepath, uuid);
+    if (file != NULL) {
+        // NOTE: The symbol table of a stripped binary only contains exported
+        //       symbols; addresses within other functions would be attributed
+        //       to the wrong symbol.
+        if (macho_has_local_symbols(file)) {
+            symbol_table_builder_t *builder = symbol_table_builder_create();
+            if (builder != NULL) {
+                macho_enumerate_symbols(file, add_symbol, builder);
+                succeeded = (builder->count != 0) && symbol_table_builder_write(builder, uuid, filepath);
+                symbol_table_builder_free(builder);
+            }
+        }
+        macho_close(file);
+    }
+
+    return succeeded;
+}
+
+symbol_table_t *symbol_table_open(const char *filepath, const uint8_t uuid[16]) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        // NOTE: A missing table is not an error; it has not been built yet.
+        if (errno != ENOENT) {
+            fprintf(stderr, "WARNING: Unable to open symbol table \"%s\", errno = %d.\n", filepath, errno);
+        }
+        return NULL;
+    }
+
+    symbol_table_t *table = NULL;
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= sizeof(table_header_t))) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            const table_header_t *header = map;
+            const uint64_t size =
+                sizeof(table_header_t) +
+                (uint64_t)header->count * (2 * sizeof(uint64_t) + sizeof(uint32_t)) +
+                header->string_size;
+            if ((memcmp(header->magic, kTableMagic, sizeof(kTableMagic)) == 0) &&
+                    (header->version == kTableVersion) &&
+                    (memcmp(header->uuid, uuid, 16) == 0) &&
+                    (size == (uint64_t)st.st_size) &&
+                    ((header->string_size == 0) || (((const char *)map)[st.st_size - 1] == '\0'))) {
+                table = calloc(1, sizeof(symbol_table_t));
+            }
+
+            if (table != NULL) {
+                table->map = map;
+                table->map_size = st.st_size;
+                table->count = header->count;
+                table->string_size = header->string_size;
+                table->addresses = (const uint64_t *)((const uint8_t *)map + sizeof(table_header_t));
+                table->ends = table->addresses + table->count;
+                table->name_offsets = (const uint32_t *)(table->ends + table->count);
+                table->strings = (const char *)(table->name_offsets + table->count);
+            } else {
+                fprintf(stderr, "WARNING: Symbol table \"%s\" is invalid or outdated.\n", filepath);
+                munmap(map, st.st_size);
+            }
+        }
+    }
+
+    close(fd);
+    return table;
+}
+
+int symbol_table_lookup(symbol_table_t *table, uint64_t address, const char **name, uint64_t *symbol_offset) {
+    // Find the last symbol at or before the address.
+    uint32_t low = 0;
+    uint32_t high = table->count;
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        if (table->addresses[middle] <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        // Address precedes the first symbol.
+        return 0;
+    }
+
+    const uint32_t i = low - 1;
+    if (address >= table->ends[i]) {
+        // Address follows the end of the function (e.g. is in padding, or in
+        // code that has no symbol).
+        return 0;
+    }
+
+    const uint32_t name_offset = table->name_offsets[i];
+    if (name_offset >= table->string_size) {
+        return 0;
+    }
+    *name = table->strings + name_offset;
+    *symbol_offset = address - table->addresses[i];
+    return 1;
+}
+
+void symbol_table_close(symbol_table_t *table) {
+    if (table != NULL) {
+        munmap(table->map, table->map_size);
+        free(table);
+    }
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
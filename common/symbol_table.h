@@ -0,0 +1,49 @@
+/**
+ * Desc: Compact on-disk symbol table for a single binary image, identified by
+ *       its UUID. Tables are built once and then memory-mapped (read-only) by
+ *       each process that needs them.
+ *
+ *       Lookups do not allocate memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_SYMBOL_TABLE_H_
+#define COMMON_SYMBOL_TABLE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct symbol_table symbol_table_t;
+typedef struct symbol_table_builder symbol_table_builder_t;
+
+// NOTE: Addresses are relative to the start of the image.
+// NOTE: A symbol extends to the next symbol, or to the end of the section that
+//       contains it, whichever comes first; addresses beyond are not matched.
+symbol_table_builder_t *symbol_table_builder_create(void);
+int symbol_table_builder_add(symbol_table_builder_t *builder, uint64_t address, uint64_t section_end, const char *name);
+int symbol_table_builder_write(symbol_table_builder_t *builder, const uint8_t uuid[16], const char *filepath);
+void symbol_table_builder_free(symbol_table_builder_t *builder);
+
+// NOTE: Fails if the binary is not a Mach-O file with the given UUID, or if it
+//       has been stripped of local symbols.
+int symbol_table_build_for_binary(const char *binary_filepath, const uint8_t uuid[16], const char *filepath);
+
+// NOTE: Fails if the table is not for the given UUID.
+symbol_table_t *symbol_table_open(const char *filepath, const uint8_t uuid[16]);
+// NOTE: The returned name points into the mapped table and remains valid until
+//       the table is closed.
+int symbol_table_lookup(symbol_table_t *table, uint64_t address, const char **name, uint64_t *symbol_offset);
+void symbol_table_close(symbol_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_SYMBOL_TABLE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,243 @@
+/**
+ * Desc: Test of the symbol tables: building from a synthetic Mach-O image,
+ *       and lookups against a brute-force search.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "symbol_table.h"
+
+#include <stdint.h>
+
+#include "test_util.h"
+
+static const uint8_t kUUID[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const uint8_t kOtherUUID[16] = {0x01};
+
+static const uint64_t kTextAddress = 0x100000000ULL;
+
+typedef struct {
+    uint8_t bytes[4096];
+    size_t length;
+} buffer_t;
+
+static void append(buffer_t *buffer, const void *bytes, size_t length) {
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void append_uint32(buffer_t *buffer, uint32_t value) {
+    append(buffer, &value, sizeof(value));
+}
+
+static void append_uint64(buffer_t *buffer, uint64_t value) {
+    append(buffer, &value, sizeof(value));
+}
+
+static void append_name(buffer_t *buffer, const char *name) {
+    char padded[16] = {0};
+    memcpy(padded, name, strnlen(name, sizeof(padded)));
+    append(buffer, padded, sizeof(padded));
+}
+
+static void append_segment(buffer_t *buffer, const char *name, uint64_t address, uint32_t section_count) {
+    append_uint32(buffer, 0x19);
+    append_uint32(buffer, 72 + section_count * 80);
+    append_name(buffer, name);
+    append_uint64(buffer, address);
+    append_uint64(buffer, 0x4000);
+    append_uint64(buffer, 0);
+    append_uint64(buffer, 0);
+    append_uint32(buffer, 5);
+    append_uint32(buffer, 5);
+    append_uint32(buffer, section_count);
+    append_uint32(buffer, 0);
+}
+
+static void append_section(buffer_t *buffer, const char *name, const char *segment, uint64_t address, uint64_t size, uint32_t flags) {
+    append_name(buffer, name);
+    append_name(buffer, segment);
+    append_uint64(buffer, address);
+    append_uint64(buffer, size);
+    for (unsigned i = 0; i < 4; ++i) {
+        append_uint32(buffer, 0);
+    }
+    append_uint32(buffer, flags);
+    for (unsigned i = 0; i < 3; ++i) {
+        append_uint32(buffer, 0);
+    }
+}
+
+static void append_symbol(buffer_t *buffer, uint32_t name_index, uint8_t type, uint8_t section, uint64_t value) {
+    append_uint32(buffer, name_index);
+    append(buffer, &type, 1);
+    append(buffer, &section, 1);
+    const uint16_t desc = 0;
+    append(buffer, &desc, sizeof(desc));
+    append_uint64(buffer, value);
+}
+
+// NOTE: A 64-bit image with code (__TEXT,__text), constants (__TEXT,__const)
+//       and data (__DATA,__data); only the symbols in __text are functions.
+static void write_image(const char *filepath) {
+    static const char kStrings[] = "\0_first\0_local\0_last\0_kConst\0_gData\0_undefined\0";
+    static const uint32_t kSymbolCount = 7;
+
+    buffer_t buffer = {{0}, 0};
+    const uint32_t commands_size = (72 + 2 * 80) + (72 + 80) + 24 + 24;
+    const uint32_t symbol_offset = 32 + commands_size;
+    const uint32_t string_offset = symbol_offset + kSymbolCount * 16;
+
+    append_uint32(&buffer, 0xfeedfacf);
+    append_uint32(&buffer, 0x0100000c);
+    append_uint32(&buffer, 0);
+    append_uint32(&buffer, 6);
+    append_uint32(&buffer, 4);
+    append_uint32(&buffer, commands_size);
+    append_uint32(&buffer, 0);
+    append_uint32(&buffer, 0);
+
+    append_segment(&buffer, "__TEXT", kTextAddress, 2);
+    append_section(&buffer, "__text", "__TEXT", kTextAddress + 0x1000, 0x1000, 0x80000400);
+    append_section(&buffer, "__const", "__TEXT", kTextAddress + 0x2000, 0x100, 0);
+    append_segment(&buffer, "__DATA", kTextAddress + 0x4000, 1);
+    append_section(&buffer, "__data", "__DATA", kTextAddress + 0x4000, 0x100, 0);
+
+    append_uint32(&buffer, 0x2);
+    append_uint32(&buffer, 24);
+    append_uint32(&buffer, symbol_offset);
+    append_uint32(&buffer, kSymbolCount);
+    append_uint32(&buffer, string_offset);
+    append_uint32(&buffer, sizeof(kStrings));
+
+    append_uint32(&buffer, 0x1b);
+    append_uint32(&buffer, 24);
+    append(&buffer, kUUID, sizeof(kUUID));
+
+    append_symbol(&buffer, 1, 0x0f, 1, kTextAddress + 0x1000);
+    append_symbol(&buffer, 8, 0x0e, 1, kTextAddress + 0x1100);
+    append_symbol(&buffer, 15, 0x0e, 1, kTextAddress + 0x1f00);
+    append_symbol(&buffer, 21, 0x0e, 2, kTextAddress + 0x2000);
+    append_symbol(&buffer, 29, 0x0f, 3, kTextAddress + 0x4000);
+    append_symbol(&buffer, 36, 0x01, 0, 0);
+    // NOTE: Debugging (stab) entry.
+    append_symbol(&buffer, 1, 0x24, 1, kTextAddress + 0x1000);
+    append(&buffer, kStrings, sizeof(kStrings));
+
+    CHECK(test_write_file(filepath, buffer.bytes, buffer.length));
+}
+
+static int lookup(symbol_table_t *table, uint64_t address, const char *expected_name, uint64_t expected_offset) {
+    const char *name;
+    uint64_t offset;
+    if (!symbol_table_lookup(table, address, &name, &offset)) {
+        return (expected_name == NULL);
+    }
+    return (expected_name != NULL) && (strcmp(name, expected_name) == 0) && (offset == expected_offset);
+}
+
+static void test_binary(const char *directory) {
+    char binary_filepath[1024];
+    test_path(binary_filepath, sizeof(binary_filepath), directory, "image.dylib");
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "image.symtab");
+    write_image(binary_filepath);
+
+    CHECK(!symbol_table_build_for_binary(binary_filepath, kOtherUUID, filepath));
+    CHECK(symbol_table_build_for_binary(binary_filepath, kUUID, filepath));
+    CHECK(symbol_table_open(filepath, kOtherUUID) == NULL);
+    symbol_table_t *table = symbol_table_open(filepath, kUUID);
+    CHECK(table != NULL);
+    if (table == NULL) {
+        return;
+    }
+
+    CHECK(lookup(table, 0x500, NULL, 0));
+    CHECK(lookup(table, 0x1000, "first", 0));
+    CHECK(lookup(table, 0x10ff, "first", 0xff));
+    CHECK(lookup(table, 0x1100, "local", 0));
+    CHECK(lookup(table, 0x1f10, "last", 0x10));
+    CHECK(lookup(table, 0x1fff, "last", 0xff));
+    // NOTE: Past the end of __text; constants and data are not functions.
+    CHECK(lookup(table, 0x2000, NULL, 0));
+    CHECK(lookup(table, 0x2010, NULL, 0));
+    CHECK(lookup(table, 0x4000, NULL, 0));
+    symbol_table_close(table);
+
+    // Tables of another format version are rejected.
+    struct stat st;
+    CHECK(stat(filepath, &st) == 0);
+    int fd = open(filepath, O_WRONLY);
+    const uint32_t version = 1;
+    CHECK(pwrite(fd, &version, sizeof(version), 4) == sizeof(version));
+    close(fd);
+    CHECK(symbol_table_open(filepath, kUUID) == NULL);
+
+    // Truncated tables are rejected.
+    CHECK(symbol_table_build_for_binary(binary_filepath, kUUID, filepath));
+    CHECK(truncate(filepath, st.st_size - 1) == 0);
+    CHECK(symbol_table_open(filepath, kUUID) == NULL);
+}
+
+// NOTE: Random symbols, checked against a linear search.
+static void test_builder(const char *directory) {
+    static const unsigned kSymbolCount = 5000;
+    static const uint64_t kSectionEnd = 4000000;
+
+    char filepath[1024];
+    test_path(filepath, sizeof(filepath), directory, "random.symtab");
+
+    uint64_t *addresses = malloc(kSymbolCount * sizeof(uint64_t));
+    symbol_table_builder_t *builder = symbol_table_builder_create();
+    srand(1);
+    for (unsigned i = 0; i < kSymbolCount; ++i) {
+        addresses[i] = (uint64_t)(rand() % 1000000) * 4;
+        char name[32];
+        snprintf(name, sizeof(name), "f%llu", (unsigned long long)addresses[i]);
+        CHECK(symbol_table_builder_add(builder, addresses[i], kSectionEnd, name));
+    }
+    // NOTE: The first name added for an address is kept.
+    CHECK(symbol_table_builder_add(builder, addresses[0], kSectionEnd, "duplicate"));
+    CHECK(!symbol_table_builder_add(builder, kSectionEnd, kSectionEnd, "outside"));
+    CHECK(symbol_table_builder_write(builder, kUUID, filepath));
+    symbol_table_builder_free(builder);
+
+    symbol_table_t *table = symbol_table_open(filepath, kUUID);
+    CHECK(table != NULL);
+    if (table != NULL) {
+        for (unsigned k = 0; k < 20000; ++k) {
+            const uint64_t address = (uint64_t)(rand() % (kSectionEnd + 100));
+            int found = 0;
+            uint64_t best = 0;
+            for (unsigned i = 0; i < kSymbolCount; ++i) {
+                if ((addresses[i] <= address) && (!found || (addresses[i] > best))) {
+                    best = addresses[i];
+                    found = 1;
+                }
+            }
+            if (address >= kSectionEnd) {
+                found = 0;
+            }
+
+            char name[32];
+            snprintf(name, sizeof(name), "f%llu", (unsigned long long)best);
+            CHECK(lookup(table, address, found ? name : NULL, address - best));
+        }
+        symbol_table_close(table);
+    }
+    free(addresses);
+}
+
+int main(void) {
+    char *directory = test_make_directory("symbol_table_test");
+    test_binary(directory);
+    test_builder(directory);
+    test_remove_directory(directory);
+    return test_result("symbol_table_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
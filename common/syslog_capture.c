@@ -0,0 +1,96 @@
+/**
+ * Desc: Capture of the system log messages related to a crash.
+ *
+ *       Messages are read from an abstract source (ASL on iOS), filtered by
+ *       time and by sender/facility, and written to the output as they are
+ *       read, so that the log is never held in memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "syslog_capture.h"
+
+#include <string.h>
+
+static const char * const kCrashReporterFacility = "Crash Reporter";
+
+static int init_key(syslog_key_t *key, const char *string) {
+    if ((string == NULL) || (string[0] == '\0')) {
+        return 0;
+    }
+    key->string = string;
+    return 1;
+}
+
+// NOTE: Nearly all strings differ from the key in their first few characters;
+//       a plain comparison rejects them sooner than hashing the whole string
+//       would (see syslog_capture_test.c).
+static int key_matches(const syslog_key_t *key, const char *string) {
+    return (key->string[0] == string[0]) && (strcmp(key->string, string) == 0);
+}
+
+void syslog_filter_init(syslog_filter_t *filter, const char *process_name, const char *bundle_id,
+        time_t start_time, time_t end_time) {
+    memset(filter, 0, sizeof(*filter));
+    filter->start_time = start_time;
+    filter->end_time = end_time;
+    if (init_key(&filter->facilities[filter->facility_count], kCrashReporterFacility)) {
+        ++filter->facility_count;
+    }
+    if (init_key(&filter->facilities[filter->facility_count], bundle_id)) {
+        ++filter->facility_count;
+    }
+    filter->has_sender = init_key(&filter->sender, process_name);
+}
+
+int syslog_filter_matches(const syslog_filter_t *filter, const syslog_message_t *message) {
+    if ((message->time < filter->start_time) || (message->time > filter->end_time)) {
+        return 0;
+    }
+
+    if (message->facility != NULL) {
+        for (unsigned i = 0; i < filter->facility_count; ++i) {
+            if (key_matches(&filter->facilities[i], message->facility)) {
+                return 1;
+            }
+        }
+    }
+    if (filter->has_sender && (message->sender != NULL)) {
+        if (key_matches(&filter->sender, message->sender)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const char *string_or_null(const char *string) {
+    return (string != NULL) ? string : "(null)";
+}
+
+long syslog_capture(const syslog_source_t *source, const syslog_filter_t *filter, FILE *output) {
+    long count = 0;
+
+    syslog_message_t message;
+    while (source->next(source->context, &message)) {
+        if (syslog_filter_matches(filter, &message)) {
+            char time[25];
+            struct tm tm;
+            if (localtime_r(&message.time, &tm) == NULL) {
+                time[0] = '\0';
+            } else {
+                strftime(time, sizeof(time), "%c", &tm);
+            }
+
+            if (fprintf(output, "%s: %s (%s): %s\n", time, string_or_null(message.sender),
+                        string_or_null(message.facility), string_or_null(message.message)) < 0) {
+                return -1;
+            }
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
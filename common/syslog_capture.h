@@ -0,0 +1,69 @@
+/**
+ * Desc: Capture of the system log messages related to a crash.
+ *
+ *       Messages are read from an abstract source (ASL on iOS), filtered by
+ *       time and by sender/facility, and written to the output as they are
+ *       read, so that the log is never held in memory.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_SYSLOG_CAPTURE_H_
+#define COMMON_SYSLOG_CAPTURE_H_
+
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    time_t time;
+    // NOTE: Any of the strings may be NULL.
+    const char *facility;
+    const char *sender;
+    const char *message;
+} syslog_message_t;
+
+typedef struct {
+    // NOTE: Returns zero when there are no more messages. The strings of the
+    //       message need only remain valid until the next call.
+    int (*next)(void *context, syslog_message_t *message);
+    void *context;
+} syslog_source_t;
+
+typedef struct {
+    const char *string;
+} syslog_key_t;
+
+#define SYSLOG_FILTER_MAX_FACILITIES 2
+
+typedef struct {
+    time_t start_time;
+    time_t end_time;
+    syslog_key_t facilities[SYSLOG_FILTER_MAX_FACILITIES];
+    unsigned facility_count;
+    syslog_key_t sender;
+    int has_sender;
+} syslog_filter_t;
+
+// NOTE: Matches messages between the given times (inclusive) that were either
+//       sent by the process or logged with the facility of crash reporting or
+//       of the bundle identifier. Either string may be NULL.
+//       The strings must remain valid for the life of the filter.
+void syslog_filter_init(syslog_filter_t *filter, const char *process_name, const char *bundle_id,
+    time_t start_time, time_t end_time);
+int syslog_filter_matches(const syslog_filter_t *filter, const syslog_message_t *message);
+
+// NOTE: Returns the number of messages written, or -1 if writing failed.
+long syslog_capture(const syslog_source_t *source, const syslog_filter_t *filter, FILE *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_SYSLOG_CAPTURE_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,211 @@
+/**
+ * Desc: Test and benchmark of the syslog capture, with synthetic system logs:
+ *       the filter is checked against a plain string comparison, and the
+ *       output of a small log is checked line by line.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "syslog_capture.h"
+
+#include <stdint.h>
+
+#include "test_util.h"
+
+static const unsigned kLogLength = 500000;
+
+static const time_t kCrashTime = 1456794123;
+
+typedef struct {
+    const syslog_message_t *messages;
+    unsigned count;
+    unsigned index;
+} array_source_t;
+
+static int next_message(void *context, syslog_message_t *message) {
+    array_source_t *source = (array_source_t *)context;
+    if (source->index == source->count) {
+        return 0;
+    }
+    *message = source->messages[source->index++];
+    return 1;
+}
+
+static long capture(const syslog_message_t *messages, unsigned count, const syslog_filter_t *filter, FILE *output) {
+    array_source_t array = {messages, count, 0};
+    syslog_source_t source = {next_message, &array};
+    return syslog_capture(&source, filter, output);
+}
+
+static int equals(const char *a, const char *b) {
+    return (a != NULL) && (b != NULL) && (strcmp(a, b) == 0);
+}
+
+// NOTE: The filter, written plainly, for reference.
+static int reference_matches(const syslog_message_t *message, const char *process_name, const char *bundle_id,
+        time_t start_time, time_t end_time) {
+    if ((message->time < start_time) || (message->time > end_time)) {
+        return 0;
+    }
+    if (equals(message->facility, "Crash Reporter")) {
+        return 1;
+    }
+    if ((bundle_id != NULL) && (bundle_id[0] != '\0') && equals(message->facility, bundle_id)) {
+        return 1;
+    }
+    return (process_name != NULL) && (process_name[0] != '\0') && equals(message->sender, process_name);
+}
+
+static void test_output(void) {
+    const syslog_message_t messages[] = {
+        {kCrashTime - 700, "Crash Reporter", "ReportCrash", "Too early"},
+        {kCrashTime - 10, "com.apple.mobilesafari", "MobileSafari", "Loading page"},
+        {kCrashTime - 5, "com.apple.springboard", "SpringBoard", "Unrelated"},
+        {kCrashTime - 1, NULL, "MobileSafari", NULL},
+        {kCrashTime, "Crash Reporter", "ReportCrash", "Saved crash report"},
+        {kCrashTime + 1, "user", "MobileSafariHelper", "Similar sender"},
+        {kCrashTime + 60, "com.apple.mobilesafari", NULL, "Relaunched"},
+        {kCrashTime + 200, "Crash Reporter", "ReportCrash", "Too late"},
+    };
+    const unsigned count = sizeof(messages) / sizeof(messages[0]);
+
+    syslog_filter_t filter;
+    syslog_filter_init(&filter, "MobileSafari", "com.apple.mobilesafari", kCrashTime - 600, kCrashTime + 120);
+
+    FILE *output = tmpfile();
+    CHECK(output != NULL);
+    CHECK(capture(messages, count, &filter, output) == 4);
+
+    char expected[1024];
+    size_t expected_length = 0;
+    const unsigned matching[] = {1, 3, 4, 6};
+    for (unsigned i = 0; i < 4; ++i) {
+        const syslog_message_t *message = &messages[matching[i]];
+        char time[25];
+        struct tm tm;
+        localtime_r(&message->time, &tm);
+        strftime(time, sizeof(time), "%c", &tm);
+        expected_length += snprintf(expected + expected_length, sizeof(expected) - expected_length,
+            "%s: %s (%s): %s\n", time,
+            (message->sender != NULL) ? message->sender : "(null)",
+            (message->facility != NULL) ? message->facility : "(null)",
+            (message->message != NULL) ? message->message : "(null)");
+    }
+
+    char actual[1024];
+    rewind(output);
+    const size_t actual_length = fread(actual, 1, sizeof(actual), output);
+    CHECK(actual_length == expected_length);
+    CHECK(memcmp(actual, expected, expected_length) == 0);
+    fclose(output);
+
+    // Without a process name or bundle identifier, only messages of the crash
+    // reporting facility are captured.
+    syslog_filter_init(&filter, NULL, "", kCrashTime - 600, kCrashTime + 120);
+    output = fopen("/dev/null", "w");
+    CHECK(capture(messages, count, &filter, output) == 1);
+    fclose(output);
+
+    // Write failures are reported.
+    syslog_filter_init(&filter, "MobileSafari", NULL, kCrashTime - 600, kCrashTime + 120);
+    output = fopen("/dev/null", "r");
+    CHECK(capture(messages, count, &filter, output) == -1);
+    fclose(output);
+}
+
+// NOTE: A busy system log: many senders and facilities, some of which share a
+//       prefix with, or have the same length as, the ones being matched.
+static syslog_message_t *make_log(unsigned count, char ***strings_out, unsigned *string_count) {
+    static const char * const kBaseNames[] = {
+        "MobileSafari", "MobileSafarI", "MobileSafari2", "SpringBoard", "backboardd", "kernel",
+        "com.apple.mobilesafari", "com.apple.mobilesafarj", "Crash Reporter", "Crash ReporteR", "user",
+    };
+    const unsigned base_count = sizeof(kBaseNames) / sizeof(kBaseNames[0]);
+
+    // NOTE: Plus a few hundred other daemons.
+    const unsigned total = base_count + 300;
+    char **strings = malloc(total * sizeof(char *));
+    for (unsigned i = 0; i < base_count; ++i) {
+        strings[i] = strdup(kBaseNames[i]);
+    }
+    for (unsigned i = base_count; i < total; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "com.apple.daemon%u", i);
+        strings[i] = strdup(name);
+    }
+
+    syslog_message_t *messages = malloc(count * sizeof(syslog_message_t));
+    for (unsigned i = 0; i < count; ++i) {
+        messages[i].time = kCrashTime - 900 + (time_t)((uint64_t)i * 1200 / count);
+        messages[i].facility = (rand() % 16 == 0) ? NULL : strings[rand() % total];
+        messages[i].sender = (rand() % 16 == 0) ? NULL : strings[rand() % total];
+        messages[i].message = "Some message that was logged";
+    }
+    *strings_out = strings;
+    *string_count = total;
+    return messages;
+}
+
+static void test_synthetic(void) {
+    char **strings;
+    unsigned string_count;
+    syslog_message_t *messages = make_log(kLogLength, &strings, &string_count);
+
+    const char *process_name = "MobileSafari";
+    const char *bundle_id = "com.apple.mobilesafari";
+    const time_t start_time = kCrashTime - 600;
+    const time_t end_time = kCrashTime + 120;
+
+    syslog_filter_t filter;
+    syslog_filter_init(&filter, process_name, bundle_id, start_time, end_time);
+
+    long expected_count = 0;
+    for (unsigned i = 0; i < kLogLength; ++i) {
+        const int expected = reference_matches(&messages[i], process_name, bundle_id, start_time, end_time);
+        CHECK(syslog_filter_matches(&filter, &messages[i]) == expected);
+        expected_count += expected;
+    }
+    CHECK(expected_count > 0);
+
+    FILE *output = fopen("/dev/null", "w");
+    CHECK(output != NULL);
+    double start = test_time();
+    CHECK(capture(messages, kLogLength, &filter, output) == expected_count);
+    const double capture_time = test_time() - start;
+    fclose(output);
+
+    start = test_time();
+    long reference_count = 0;
+    for (unsigned i = 0; i < kLogLength; ++i) {
+        reference_count += reference_matches(&messages[i], process_name, bundle_id, start_time, end_time);
+    }
+    const double reference_time = test_time() - start;
+    CHECK(reference_count == expected_count);
+
+    start = test_time();
+    long filter_count = 0;
+    for (unsigned i = 0; i < kLogLength; ++i) {
+        filter_count += syslog_filter_matches(&filter, &messages[i]);
+    }
+    const double filter_time = test_time() - start;
+    CHECK(filter_count == expected_count);
+
+    printf("Syslog of %u messages (%ld captured): capture %.1f ms; filter %.1f ms, string comparison %.1f ms\n",
+        kLogLength, expected_count, capture_time * 1000.0, filter_time * 1000.0, reference_time * 1000.0);
+
+    for (unsigned i = 0; i < string_count; ++i) {
+        free(strings[i]);
+    }
+    free(strings);
+    free(messages);
+}
+
+int main(void) {
+    srand(1);
+    test_output();
+    test_synthetic();
+    return test_result("syslog_capture_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
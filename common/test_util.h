@@ -0,0 +1,90 @@
+/**
+ * Desc: Helpers for the Linux tests and benchmarks of the portable (C) code
+ *       (see tests.mk).
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef COMMON_TEST_UTIL_H_
+#define COMMON_TEST_UTIL_H_
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static int test_failures = 0;
+
+// NOTE: Failures are reported and counted; the test continues, so that a
+//       single run shows every failure.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+static inline int test_result(const char *name) {
+    if (test_failures == 0) {
+        printf("PASS: %s\n", name);
+        return 0;
+    }
+    printf("FAIL: %s (%d failures)\n", name, test_failures);
+    return 1;
+}
+
+static inline double test_time(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (tv.tv_usec / 1e6);
+}
+
+// NOTE: Returns a newly created directory; the caller should remove it with
+//       test_remove_directory().
+static inline char *test_make_directory(const char *name) {
+    char template_path[256];
+    snprintf(template_path, sizeof(template_path), "/tmp/%s.XXXXXX", name);
+    char *directory = mkdtemp(template_path);
+    if (directory == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    return strdup(directory);
+}
+
+static inline void test_remove_directory(char *directory) {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf '%s'", directory);
+    if (system(command) != 0) {
+        fprintf(stderr, "WARNING: Failed to remove \"%s\".\n", directory);
+    }
+    free(directory);
+}
+
+static inline void test_path(char *buffer, size_t size, const char *directory, const char *format, ...) {
+    const int length = snprintf(buffer, size, "%s/", directory);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+}
+
+static inline int test_write_file(const char *filepath, const void *bytes, size_t length) {
+    int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+    const int succeeded = (write(fd, bytes, length) == (ssize_t)length);
+    close(fd);
+    return succeeded;
+}
+
+#endif // COMMON_TEST_UTIL_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,187 @@
+/**
+ * Name: monitor
+ * Type: iOS extension
+ * Desc: Table of crash log files that are being written by ReportCrash,
+ *       updated from the open/write/close hooks.
+ *
+ *       Calls for files that are not crash logs are rejected without locking
+ *       or allocating; tracked files are updated with atomic operations, so
+ *       the hooks may be called from any number of threads.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "tracker.h"
+
+#include <string.h>
+
+// NOTE: A slot is claimed (with compare-and-swap) before it is filled in or
+//       released, so that it is only ever modified by one thread at a time.
+static const int kSlotStateFree = 0;
+static const int kSlotStateClaimed = 1;
+static const int kSlotStateOpen = 2;
+static const int kSlotStateClosed = 3;
+
+static int has_suffix(const char *string, size_t length, const char *suffix) {
+    const size_t suffix_length = strlen(suffix);
+    return (suffix_length <= length) && (memcmp(string + length - suffix_length, suffix, suffix_length) == 0);
+}
+
+void tracker_init(tracker_t *tracker, const char *const *directories, unsigned count) {
+    memset(tracker, 0, sizeof(*tracker));
+    if (count > TRACKER_MAX_DIRECTORIES) {
+        count = TRACKER_MAX_DIRECTORIES;
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        tracker->directories[i] = directories[i];
+        tracker->directory_lengths[i] = strlen(directories[i]);
+    }
+    tracker->directory_count = count;
+    for (unsigned i = 0; i < TRACKER_MAX_FILES; ++i) {
+        tracker->slots[i].fd = -1;
+    }
+}
+
+int tracker_is_crash_log_path(const tracker_t *tracker, const char *path) {
+    if ((path == NULL) || (path[0] != '/')) {
+        return 0;
+    }
+
+    // NOTE: Nearly all paths are rejected by the comparison of the second
+    //       character; the rest of the prefix is only compared on a match.
+    for (unsigned i = 0; i < tracker->directory_count; ++i) {
+        const char *directory = tracker->directories[i];
+        const size_t length = tracker->directory_lengths[i];
+        if ((path[1] == directory[1]) && (strncmp(path, directory, length) == 0) && (path[length] == '/')) {
+            const size_t path_length = length + strlen(path + length);
+            return has_suffix(path, path_length, "plist") || has_suffix(path, path_length, "ips");
+        }
+    }
+    return 0;
+}
+
+static tracker_slot_t *claim_slot(tracker_t *tracker) {
+    for (unsigned i = 0; i < TRACKER_MAX_FILES; ++i) {
+        tracker_slot_t *slot = &tracker->slots[i];
+        if (__sync_bool_compare_and_swap(&slot->state, kSlotStateFree, kSlotStateClaimed)) {
+            __sync_fetch_and_add(&tracker->active_count, 1);
+            return slot;
+        }
+    }
+
+    // NOTE: If the table is full, reuse the slot of a file that was closed but
+    //       never renamed (e.g. if ReportCrash failed to move it). Slots are
+    //       reused in turn, so that the oldest such file is dropped first.
+    const unsigned start = __sync_fetch_and_add(&tracker->eviction_count, 1);
+    for (unsigned i = 0; i < TRACKER_MAX_FILES; ++i) {
+        tracker_slot_t *slot = &tracker->slots[(start + i) % TRACKER_MAX_FILES];
+        if (__sync_bool_compare_and_swap(&slot->state, kSlotStateClosed, kSlotStateClaimed)) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static void release_slot(tracker_t *tracker, tracker_slot_t *slot) {
+    slot->fd = -1;
+    __sync_synchronize();
+    slot->state = kSlotStateFree;
+    __sync_fetch_and_sub(&tracker->active_count, 1);
+}
+
+static tracker_slot_t *find_open_slot(tracker_t *tracker, int fd) {
+    for (unsigned i = 0; i < TRACKER_MAX_FILES; ++i) {
+        tracker_slot_t *slot = &tracker->slots[i];
+        if ((slot->fd == fd) && (slot->state == kSlotStateOpen)) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+int tracker_open(tracker_t *tracker, int fd, const char *path) {
+    if ((fd < 0) || !tracker_is_crash_log_path(tracker, path)) {
+        return 0;
+    }
+
+    const size_t length = strlen(path);
+    if (length >= TRACKER_PATH_MAX) {
+        return 0;
+    }
+
+    tracker_slot_t *slot = claim_slot(tracker);
+    if (slot == NULL) {
+        return 0;
+    }
+    memcpy(slot->filepath, path, length + 1);
+    slot->written = 0;
+    slot->fd = fd;
+    __sync_synchronize();
+    slot->state = kSlotStateOpen;
+    return 1;
+}
+
+void tracker_write(tracker_t *tracker, int fd, ssize_t bytes_written, size_t bytes_requested) {
+    if (tracker->active_count == 0) {
+        return;
+    }
+
+    tracker_slot_t *slot = find_open_slot(tracker, fd);
+    if ((slot != NULL) && (bytes_written >= 0) && ((size_t)bytes_written == bytes_requested)) {
+        slot->written = 1;
+    }
+}
+
+int tracker_close(tracker_t *tracker, int fd, int keep_for_rename, char *filepath, size_t filepath_size, int *written) {
+    if (tracker->active_count == 0) {
+        return 0;
+    }
+
+    tracker_slot_t *slot = find_open_slot(tracker, fd);
+    if ((slot == NULL) || !__sync_bool_compare_and_swap(&slot->state, kSlotStateOpen, kSlotStateClaimed)) {
+        return 0;
+    }
+
+    if (filepath_size > 0) {
+        strncpy(filepath, slot->filepath, filepath_size - 1);
+        filepath[filepath_size - 1] = '\0';
+    }
+    if (written != NULL) {
+        *written = slot->written;
+    }
+
+    if (keep_for_rename) {
+        slot->fd = -1;
+        __sync_synchronize();
+        slot->state = kSlotStateClosed;
+    } else {
+        release_slot(tracker, slot);
+    }
+    return 1;
+}
+
+int tracker_rename(tracker_t *tracker, const char *path) {
+    if ((tracker->active_count == 0) || (path == NULL)) {
+        return 0;
+    }
+
+    for (unsigned i = 0; i < TRACKER_MAX_FILES; ++i) {
+        tracker_slot_t *slot = &tracker->slots[i];
+        if ((slot->state == kSlotStateClosed) && (strcmp(slot->filepath, path) == 0)) {
+            if (__sync_bool_compare_and_swap(&slot->state, kSlotStateClosed, kSlotStateClaimed)) {
+                // NOTE: The slot may have been reused between the comparison
+                //       and the claim.
+                if (strcmp(slot->filepath, path) == 0) {
+                    release_slot(tracker, slot);
+                    return 1;
+                }
+                slot->state = kSlotStateClosed;
+            }
+        }
+    }
+    return 0;
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -0,0 +1,73 @@
+/**
+ * Name: monitor
+ * Type: iOS extension
+ * Desc: Table of crash log files that are being written by ReportCrash,
+ *       updated from the open/write/close hooks.
+ *
+ *       Calls for files that are not crash logs are rejected without locking
+ *       or allocating; tracked files are updated with atomic operations, so
+ *       the hooks may be called from any number of threads.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#ifndef MONITOR_TRACKER_H_
+#define MONITOR_TRACKER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACKER_MAX_DIRECTORIES 2
+#define TRACKER_MAX_FILES       8
+#define TRACKER_PATH_MAX        1024
+
+typedef struct {
+    // NOTE: One of the kSlotState* values (see tracker.c).
+    volatile int state;
+    volatile int fd;
+    volatile int written;
+    char filepath[TRACKER_PATH_MAX];
+} tracker_slot_t;
+
+typedef struct {
+    const char *directories[TRACKER_MAX_DIRECTORIES];
+    size_t directory_lengths[TRACKER_MAX_DIRECTORIES];
+    unsigned directory_count;
+    // NOTE: Number of slots in use; lets write() and close() return early in
+    //       the common case of no crash log being written.
+    volatile int active_count;
+    // NOTE: Used to pick the slot to reuse when the table is full.
+    volatile unsigned eviction_count;
+    tracker_slot_t slots[TRACKER_MAX_FILES];
+} tracker_t;
+
+// NOTE: The directory strings must remain valid for the life of the tracker.
+void tracker_init(tracker_t *tracker, const char *const *directories, unsigned count);
+int tracker_is_crash_log_path(const tracker_t *tracker, const char *path);
+
+// NOTE: Returns non-zero if the file is now being tracked.
+int tracker_open(tracker_t *tracker, int fd, const char *path);
+void tracker_write(tracker_t *tracker, int fd, ssize_t bytes_written, size_t bytes_requested);
+// NOTE: Returns non-zero if the descriptor belonged to a tracked file, in which
+//       case the path of the file and whether it was fully written are
+//       returned. If keep_for_rename is set, the path remains tracked until
+//       passed to tracker_rename().
+// NOTE: Must be called before the descriptor is closed, as it may be reused
+//       (by another thread) as soon as it is.
+int tracker_close(tracker_t *tracker, int fd, int keep_for_rename, char *filepath, size_t filepath_size, int *written);
+// NOTE: Returns non-zero (and stops tracking the path) if the path belonged to
+//       a tracked file that has been closed.
+int tracker_rename(tracker_t *tracker, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MONITOR_TRACKER_H_
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
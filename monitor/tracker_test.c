@@ -0,0 +1,263 @@
+/**
+ * Name: monitor
+ * Type: iOS extension
+ * Desc: Test of the table of crash log files being written, driven by a
+ *       simulation of ReportCrash: real files are written, closed and (as of
+ *       iOS 9.3) renamed through wrappers that mirror the hooks in Tweak.xm.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#include "tracker.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test_util.h"
+
+static const unsigned kThreadCount = 4;
+static const unsigned kLogsPerThread = 2000;
+
+static tracker_t tracker;
+static int logs_are_renamed;
+static char *directories[TRACKER_MAX_DIRECTORIES];
+
+// NOTE: Stands in for launching notifier.
+static pthread_mutex_t notified_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned notified_count;
+static char last_notified[TRACKER_PATH_MAX];
+
+static void notify(const char *filepath) {
+    pthread_mutex_lock(&notified_lock);
+    ++notified_count;
+    snprintf(last_notified, sizeof(last_notified), "%s", filepath);
+    pthread_mutex_unlock(&notified_lock);
+}
+
+static int hooked_open(const char *path, int oflag) {
+    int fd = open(path, oflag, 0644);
+    if (fd >= 0) {
+        tracker_open(&tracker, fd, path);
+    }
+    return fd;
+}
+
+static ssize_t hooked_write(int fildes, const void *buf, size_t nbyte) {
+    ssize_t bytes_written = write(fildes, buf, nbyte);
+    tracker_write(&tracker, fildes, bytes_written, nbyte);
+    return bytes_written;
+}
+
+static int hooked_close(int fildes) {
+    char filepath[TRACKER_PATH_MAX];
+    int written;
+    const int is_tracked = tracker_close(&tracker, fildes, logs_are_renamed, filepath, sizeof(filepath), &written);
+    int result = close(fildes);
+    if ((result != -1) && is_tracked && !logs_are_renamed && written) {
+        notify(filepath);
+    }
+    return result;
+}
+
+// NOTE: Mirrors the hook of -[NSFileManager moveItemAtURL:toURL:error:].
+static int hooked_rename(const char *from, const char *to) {
+    const int moved = (rename(from, to) == 0);
+    if (tracker_rename(&tracker, from)) {
+        if (moved) {
+            notify(to);
+        }
+    }
+    return moved;
+}
+
+// NOTE: ReportCrash writes a log in several chunks.
+static void write_log(int fd) {
+    static const char kChunk[] = "Thread 0 Crashed:\n0   libobjc.A.dylib  0x3a0c5b66 0x3a0c2000 + 15206\n";
+    for (unsigned i = 0; i < 4; ++i) {
+        CHECK(hooked_write(fd, kChunk, sizeof(kChunk) - 1) == sizeof(kChunk) - 1);
+    }
+}
+
+static unsigned reset_notified(void) {
+    pthread_mutex_lock(&notified_lock);
+    const unsigned count = notified_count;
+    notified_count = 0;
+    last_notified[0] = '\0';
+    pthread_mutex_unlock(&notified_lock);
+    return count;
+}
+
+static void test_paths(void) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/A.ips", directories[0]);
+    CHECK(tracker_is_crash_log_path(&tracker, path));
+    snprintf(path, sizeof(path), "%s/A.plist", directories[1]);
+    CHECK(tracker_is_crash_log_path(&tracker, path));
+    snprintf(path, sizeof(path), "%s/A.log", directories[0]);
+    CHECK(!tracker_is_crash_log_path(&tracker, path));
+    snprintf(path, sizeof(path), "%sX/A.ips", directories[0]);
+    CHECK(!tracker_is_crash_log_path(&tracker, path));
+    CHECK(!tracker_is_crash_log_path(&tracker, "/usr/lib/A.ips"));
+    CHECK(!tracker_is_crash_log_path(&tracker, "A.ips"));
+    CHECK(!tracker_is_crash_log_path(&tracker, NULL));
+}
+
+// NOTE: Before iOS 9.3, logs are written in place.
+static void test_in_place(void) {
+    logs_are_renamed = 0;
+    reset_notified();
+
+    // Two logs written at the same time, along with unrelated files.
+    char path_a[1024];
+    char path_b[1024];
+    char path_other[1024];
+    snprintf(path_a, sizeof(path_a), "%s/MobileMail_2012-03-01-100203_iPhone.plist", directories[1]);
+    snprintf(path_b, sizeof(path_b), "%s/SpringBoard_2012-03-01-100204_iPhone.plist", directories[0]);
+    snprintf(path_other, sizeof(path_other), "%s/stacks.log", directories[0]);
+    int fd_a = hooked_open(path_a, O_WRONLY | O_CREAT | O_TRUNC);
+    int fd_other = hooked_open(path_other, O_WRONLY | O_CREAT | O_TRUNC);
+    int fd_b = hooked_open(path_b, O_WRONLY | O_CREAT | O_TRUNC);
+    CHECK((fd_a >= 0) && (fd_b >= 0) && (fd_other >= 0));
+    write_log(fd_a);
+    write_log(fd_other);
+    write_log(fd_b);
+    CHECK(tracker.active_count == 2);
+
+    CHECK(hooked_close(fd_other) == 0);
+    CHECK(reset_notified() == 0);
+    CHECK(hooked_close(fd_b) == 0);
+    CHECK(strcmp(last_notified, path_b) == 0);
+    CHECK(reset_notified() == 1);
+    CHECK(hooked_close(fd_a) == 0);
+    CHECK(strcmp(last_notified, path_a) == 0);
+    CHECK(reset_notified() == 1);
+    CHECK(tracker.active_count == 0);
+
+    // A log that failed to be written is not reported.
+    int fd = hooked_open(path_a, O_RDONLY);
+    CHECK(fd >= 0);
+    CHECK(hooked_write(fd, "x", 1) < 0);
+    CHECK(hooked_close(fd) == 0);
+    CHECK(reset_notified() == 0);
+
+    // A descriptor that is reused for another file after being closed is not
+    // mistaken for the log.
+    fd = hooked_open(path_a, O_WRONLY | O_TRUNC);
+    write_log(fd);
+    CHECK(hooked_close(fd) == 0);
+    CHECK(reset_notified() == 1);
+    fd = hooked_open(path_other, O_WRONLY | O_TRUNC);
+    write_log(fd);
+    CHECK(hooked_close(fd) == 0);
+    CHECK(reset_notified() == 0);
+    CHECK(tracker.active_count == 0);
+}
+
+// NOTE: As of iOS 9.3, logs are written to a temporary file, which is renamed
+//       once it has been closed.
+static void test_renamed(void) {
+    logs_are_renamed = 1;
+    reset_notified();
+
+    char temp_path[1024];
+    char path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s/.dat.nosync123.ips", directories[0]);
+    snprintf(path, sizeof(path), "%s/MobileSafari-2016-03-01-100203.ips", directories[0]);
+
+    int fd = hooked_open(temp_path, O_WRONLY | O_CREAT | O_TRUNC);
+    CHECK(fd >= 0);
+    write_log(fd);
+    CHECK(hooked_close(fd) == 0);
+    CHECK(reset_notified() == 0);
+    CHECK(tracker.active_count == 1);
+
+    // Renames of other files are ignored.
+    char other_path[1024];
+    snprintf(other_path, sizeof(other_path), "%s/other.ips", directories[0]);
+    CHECK(test_write_file(other_path, "x", 1));
+    CHECK(hooked_rename(other_path, path));
+    CHECK(reset_notified() == 0);
+
+    CHECK(hooked_rename(temp_path, path));
+    CHECK(strcmp(last_notified, path) == 0);
+    CHECK(reset_notified() == 1);
+    CHECK(tracker.active_count == 0);
+
+    // A failed move is not reported.
+    fd = hooked_open(temp_path, O_WRONLY | O_CREAT | O_TRUNC);
+    write_log(fd);
+    CHECK(hooked_close(fd) == 0);
+    unlink(temp_path);
+    CHECK(!hooked_rename(temp_path, path));
+    CHECK(reset_notified() == 0);
+    CHECK(tracker.active_count == 0);
+
+    // Files that are never renamed do not prevent later logs from being
+    // tracked; the oldest are dropped.
+    for (unsigned i = 0; i < 3 * TRACKER_MAX_FILES; ++i) {
+        snprintf(temp_path, sizeof(temp_path), "%s/.dat.nosync%u.ips", directories[1], i);
+        fd = hooked_open(temp_path, O_WRONLY | O_CREAT | O_TRUNC);
+        write_log(fd);
+        CHECK(hooked_close(fd) == 0);
+    }
+    for (unsigned i = 0; i < 3 * TRACKER_MAX_FILES; ++i) {
+        snprintf(temp_path, sizeof(temp_path), "%s/.dat.nosync%u.ips", directories[1], i);
+        snprintf(path, sizeof(path), "%s/Process%u-2016-03-01-100203.ips", directories[1], i);
+        hooked_rename(temp_path, path);
+    }
+    CHECK(reset_notified() == TRACKER_MAX_FILES);
+    CHECK(tracker.active_count == 0);
+}
+
+// NOTE: ReportCrash may write several logs at once, from different threads.
+static void *write_logs(void *context) {
+    const unsigned thread = (unsigned)(uintptr_t)context;
+    for (unsigned i = 0; i < kLogsPerThread; ++i) {
+        char temp_path[1024];
+        char path[1024];
+        snprintf(temp_path, sizeof(temp_path), "%s/.dat.nosync%u-%u.ips", directories[thread % 2], thread, i);
+        snprintf(path, sizeof(path), "%s/Process%u-%u.ips", directories[thread % 2], thread, i);
+
+        int fd = hooked_open(temp_path, O_WRONLY | O_CREAT | O_TRUNC);
+        CHECK(fd >= 0);
+        write_log(fd);
+        CHECK(hooked_close(fd) == 0);
+        CHECK(hooked_rename(temp_path, path));
+        unlink(path);
+    }
+    return NULL;
+}
+
+static void test_concurrent(void) {
+    logs_are_renamed = 1;
+    reset_notified();
+
+    pthread_t threads[kThreadCount];
+    for (unsigned i = 0; i < kThreadCount; ++i) {
+        pthread_create(&threads[i], NULL, write_logs, (void *)(uintptr_t)i);
+    }
+    for (unsigned i = 0; i < kThreadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(reset_notified() == kThreadCount * kLogsPerThread);
+    CHECK(tracker.active_count == 0);
+}
+
+int main(void) {
+    directories[0] = test_make_directory("tracker_test_mobile");
+    directories[1] = test_make_directory("tracker_test_root");
+    tracker_init(&tracker, (const char *const *)directories, 2);
+
+    test_paths();
+    test_in_place();
+    test_renamed();
+    test_concurrent();
+
+    test_remove_directory(directories[0]);
+    test_remove_directory(directories[1]);
+    return test_result("tracker_test");
+}
+
+/* vim: set ft=c ff=unix sw=4 ts=4 expandtab tw=80: */
@@ -4,6 +4,13 @@
  * Desc: Given a crash log filepath, will send a local notification stating
  *       what has crashed and what might be to blame.
  *
+ *       With "-b", will instead symbolicate all unsymbolicated crash logs in
+ *       the given directories (or in the standard log directories).
+ *
+ *       With "-D", will run as a service, receiving the filepaths of new crash
+ *       logs from the monitor (see crash_queue.h), and periodically
+ *       compressing aged logs (if enabled).
+ *
  * Author: Lance Fetters (aka. ashikase)
  * License: GPL v3 (See LICENSE file for details)
  */
@@ -15,11 +22,20 @@
 #include <errno.h>
 #include <notify.h>
 #include <objc/runtime.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #import "crashlog_util.h"
+#include "crash_queue.h"
+#include "crash_rate.h"
+#include "crashlog_index.h"
+#include "crashlog_name.h"
+#include "paths.h"
 #include "preferences.h"
+#include "syslog_capture.h"
 
 #define kNotifyExcessiveCPU "notifyExcessiveCPU"
 #define kNotifyExcessiveMemory "notifyExcessiveMemory"
@@ -28,7 +44,20 @@
 #define kNotifyLowMemory "notifyLowMemory"
 #define kNotifySandboxViolations "notifySandboxViolations"
 
+// NOTE: A process that crashes this many times within the window (in seconds)
+//       is considered to be crash-looping; a threshold of zero disables this.
+#define kCrashLoopThreshold "crashLoopThreshold"
+#define kCrashLoopWindow "crashLoopWindow"
+static const unsigned kDefaultCrashLoopThreshold = 3;
+static const unsigned kDefaultCrashLoopWindow = 5 * 60;
+
+// NOTE: Synced logs (and their syslogs) older than this many days are
+//       compressed by the service; zero disables compression.
+#define kCompressLogsAfterDays "compressLogsAfterDays"
+static const unsigned kDefaultCompressLogsAfterDays = 0;
+
 extern mach_port_t SBSSpringBoardServerPort();
+extern int pthread_setugid_np(uid_t uid, gid_t gid);
 
 // Firmware < 9.0
 @interface SBSLocalNotificationClient : NSObject
@@ -41,35 +70,319 @@ extern mach_port_t SBSSpringBoardServerPort();
 - (void)addScheduledLocalNotifications:(NSArray *)notifications waitUntilDone:(BOOL)waitUntilDone;
 @end
 
-int main(int argc, char **argv, char **envp) {
-    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+static NSDate *dateForDateTime(NSString *dateTime) {
+    NSDate *date = nil;
+    if (dateTime != nil) {
+        NSDateFormatter *formatter = [NSDateFormatter new];
+        [formatter setDateFormat:@"yyyy-MM-dd HH:mm:ss.SSS Z"];
+        date = [formatter dateFromString:dateTime];
+        [formatter release];
+    }
+    return date;
+}
 
-    if (IOS_LT(5_0)) {
-        fprintf(stderr, "WARNING: CrashReporter notifications require iOS 5.0 or higher.\n");
+// NOTE: This tool is only meant to be used with newly created crash log files;
+//       symbolication of older files should be done with the "symbolicate"
+//       tool.
+static BOOL isTooOld(NSString *filepath, CRCrashReport *report, NSString *dateTime) {
+    // Check if already symbolicated.
+    BOOL isTooOld = fileIsSymbolicated(filepath, report);
+    if (!isTooOld) {
+        // Check the date and time that the crash occurred.
+        if (dateTime != nil) {
+            NSDate *date = dateForDateTime(dateTime);
+            if ([date timeIntervalSinceNow] < -(2 * 60)) {
+                // Occurred more than two minutes ago.
+                isTooOld = YES;
+            }
+        }
+    }
+    return isTooOld;
+}
+
+// NOTE: Bulk mode symbolicates all unsymbolicated logs (e.g. after a series of
+//       crashes, or after restoring from a backup) without sending any
+//       notifications.
+// NOTE: The elapsed time, throughput and symbol cache hit rate are reported so
+//       that the effect of the thread count (and of the cache) can be measured.
+static int symbolicateAll(int argc, char **argv) {
+    NSUInteger threadCount = 0;
+    NSMutableArray *directories = [NSMutableArray array];
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if ((i + 1 == argc) || ((threadCount = strtoul(argv[i + 1], NULL, 10)) == 0)) {
+                fprintf(stderr, "ERROR: Must specify number of threads.\n");
+                return 1;
+            }
+            ++i;
+        } else {
+            [directories addObject:[NSString stringWithUTF8String:argv[i]]];
+        }
+    }
+    if ([directories count] == 0) {
+        [directories addObject:@kCrashLogDirectoryForMobile];
+        [directories addObject:@kCrashLogDirectoryForRoot];
+    }
+
+    // Collect unsymbolicated logs.
+    NSMutableArray *filepaths = [NSMutableArray array];
+    for (NSString *directory in directories) {
+        [filepaths addObjectsFromArray:unsymbolicatedFilesInDirectory(directory)];
+    }
+    const NSUInteger total = [filepaths count];
+
+    // Symbolicate.
+    __block NSUInteger completed = 0;
+    const CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    const NSUInteger symbolicatedCount = symbolicateFiles(filepaths, threadCount, ^(NSString *filepath, NSString *outputFilepath) {
+        ++completed;
+        fprintf(stdout, "[%lu/%lu] %s: %s\n", (unsigned long)completed, (unsigned long)total,
+            [[filepath lastPathComponent] UTF8String], (outputFilepath != nil) ? "symbolicated" : "failed");
+        fflush(stdout);
+    });
+    const CFAbsoluteTime elapsedTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    if (threadCount == 0) {
+        threadCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    }
+    fprintf(stdout, "Symbolicated %lu of %lu files in %.2f seconds using %lu threads (%.2f files/second).\n",
+        (unsigned long)symbolicatedCount, (unsigned long)total, elapsedTime, (unsigned long)threadCount,
+        (elapsedTime > 0.0) ? (total / elapsedTime) : 0.0);
+
+    uint64_t hits;
+    uint64_t misses;
+    getSymbolCacheStatistics(&hits, &misses);
+    fprintf(stdout, "Symbol cache: %llu hits, %llu misses (%.1f%% hit rate).\n",
+        (unsigned long long)hits, (unsigned long long)misses,
+        ((hits + misses) != 0) ? (100.0 * hits / (hits + misses)) : 0.0);
+
+    return (symbolicatedCount == total) ? 0 : 1;
+}
+
+// NOTE: Only messages logged shortly before and after the crash are captured.
+static const time_t kSyslogSecondsBeforeCrash = 10 * 60;
+static const time_t kSyslogSecondsAfterCrash = 2 * 60;
+
+static int nextASLMessage(void *context, syslog_message_t *message) {
+    aslmsg msg = aslresponse_next((aslresponse)context);
+    if (msg == NULL) {
         return 0;
     }
 
-    // Get arguments.
-    BOOL isDebugMode = NO;
-    if (argc < 2) {
-        fprintf(stderr, "ERROR: Must specify path to crash log.\n");
-        return 1;
+    const char *time = asl_get(msg, ASL_KEY_TIME);
+    message->time = (time != NULL) ? atol(time) : 0;
+    message->facility = asl_get(msg, ASL_KEY_FACILITY);
+    message->sender = asl_get(msg, ASL_KEY_SENDER);
+    message->message = asl_get(msg, ASL_KEY_MSG);
+    return 1;
+}
+
+static BOOL captureSyslog(FILE *stream, NSString *processName, NSString *bundleID, time_t crashTime) {
+    syslog_filter_t filter;
+    syslog_filter_init(&filter, [processName UTF8String], [bundleID UTF8String],
+        crashTime - kSyslogSecondsBeforeCrash, crashTime + kSyslogSecondsAfterCrash);
+
+    // NOTE: We could use asl_set_query() to filter the results with a regular
+    //       expression, but it seems that ASL_QUERY_OP_REGEX does not work
+    //       properly on older versions of iOS. Only the (numeric) start time is
+    //       passed to ASL; the rest of the filtering is done while reading.
+    aslmsg query = asl_new(ASL_TYPE_QUERY);
+    char startTime[32];
+    snprintf(startTime, sizeof(startTime), "%ld", (long)filter.start_time);
+    asl_set_query(query, ASL_KEY_TIME, startTime, ASL_QUERY_OP_GREATER_EQUAL | ASL_QUERY_OP_NUMERIC);
+    aslresponse response = asl_search(NULL, query);
+
+    long count = 0;
+    if (response != NULL) {
+        syslog_source_t source = {nextASLMessage, response};
+        count = syslog_capture(&source, &filter, stream);
+        aslresponse_free(response);
     }
-    if ((argc > 2)) {
-        if (strcmp(argv[1], "-d") == 0) {
-            isDebugMode = YES;
-        } else {
-            fprintf(stderr, "ERROR: Unknown parameter.\n");
-            return 1;
+    asl_free(query);
+
+    // If no syslog data is available, add a message stating such.
+    if (count == 0) {
+        fputs("Syslog did not contain any relevant information.", stream);
+    }
+    return (count >= 0);
+}
+
+static unsigned unsignedPreference(CFStringRef key, unsigned defaultValue) {
+    // NOTE: Read mobile's settings explicitly, as this is called before the
+    //       effective user is switched to mobile (see below).
+    unsigned value = defaultValue;
+    CFPropertyListRef object = CFPreferencesCopyValue(key, CFSTR("crash-reporter"), CFSTR("mobile"), kCFPreferencesAnyHost);
+    if (object != NULL) {
+        if (CFGetTypeID(object) == CFNumberGetTypeID()) {
+            int number;
+            if (CFNumberGetValue((CFNumberRef)object, kCFNumberIntType, &number) && (number >= 0)) {
+                value = number;
+            }
+        }
+        CFRelease(object);
+    }
+    return value;
+}
+
+// NOTE: Processes are identified by the name used in the filename of the log
+//       (as the app does) and by bundle identifier.
+static crash_rate_state_t crashRateStateForFile(NSString *filepath, NSString *bundleID, unsigned *count, unsigned *window) {
+    crash_rate_state_t state = CRASH_RATE_STATE_NORMAL;
+    *count = 1;
+    *window = unsignedPreference(CFSTR(kCrashLoopWindow), kDefaultCrashLoopWindow);
+
+    const crashlog_name_format_t format = IOS_LT(9_3) ? CRASHLOG_NAME_FORMAT_PRE_9_3 : CRASHLOG_NAME_FORMAT_9_3;
+    const char *filename = [[filepath lastPathComponent] UTF8String];
+    crashlog_name_t parsed;
+    if ((filename != NULL) && crashlog_name_parse(filename, format, &parsed)) {
+        char name[parsed.name_length + 1];
+        memcpy(name, filename, parsed.name_length);
+        name[parsed.name_length] = '\0';
+
+        // NOTE: The file is shared with the app; the directory must be owned
+        //       by mobile.
+        NSDictionary *attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+            @"mobile", NSFileOwnerAccountName, @"mobile", NSFileGroupOwnerAccountName, nil];
+        [[NSFileManager defaultManager] createDirectoryAtPath:@kCacheDirectory withIntermediateDirectories:YES attributes:attributes error:NULL];
+
+        const unsigned threshold = unsignedPreference(CFSTR(kCrashLoopThreshold), kDefaultCrashLoopThreshold);
+        if (crash_rate_record(kCrashRateFilepath, name, [bundleID UTF8String], time(NULL), *window, threshold, &state, count)) {
+            fixFileOwnershipAndPermissions(@kCrashRateFilepath);
+        }
+    }
+    return state;
+}
+
+// NOTE: Both the service (see its launchd plist) and the single-shot tool
+//       (launched by the monitor) run as root, so that all of the syslog can be
+//       read (ASL restricts some messages to root) and so that the logs of
+//       root can be accessed without the as_root tool. Preferences and
+//       notifications are handled as mobile: the single-shot tool switches its
+//       effective user once the log has been processed; the service runs its
+//       main thread as mobile (see runService()), and handles them there.
+static BOOL isService$ = NO;
+
+// NOTE: Loaded once, and never unloaded, as the classes are used from the main
+//       thread while workers are processing other logs.
+static void loadNotificationFrameworks() {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        if (dlopen("/System/Library/Frameworks/UIKit.framework/UIKit", RTLD_LAZY) == NULL) {
+            fprintf(stderr, "ERROR: Unable to load UIKit.\n");
+        }
+        if (!IOS_LT(9_0)) {
+            if (dlopen("/System/Library/PrivateFrameworks/UserNotificationServices.framework/UserNotificationServices", RTLD_LAZY) == NULL) {
+                fprintf(stderr, "ERROR: Unable to load UserNotificationServices.\n");
+            }
+        }
+    });
+}
+
+// NOTE: When running as a service, the main thread runs its run loop while
+//       workers process logs.
+static void performOnMainThread(void (^block)(void)) {
+    if ([NSThread isMainThread]) {
+        block();
+    } else {
+        dispatch_sync(dispatch_get_main_queue(), block);
+    }
+}
+
+// Make sure that SpringBoard's local notification server is up.
+// NOTE: If SpringBoard is not running (i.e. it is what crashed), will not be
+//       able to register a local notification.
+// FIXME: Even if port is non-zero, it does not mean that SpringBoard is ready
+//        to handle notifications.
+static void waitForSpringBoard() {
+    BOOL shouldDelay = NO;
+    mach_port_t port;
+    while ((port = SBSSpringBoardServerPort()) == 0) {
+        [NSThread sleepForTimeInterval:1.0];
+        shouldDelay = YES;
+    }
+
+    if (shouldDelay) {
+        // Wait serveral seconds to give time for SpringBoard to finish launching.
+        // FIXME: This is needed due to issue mentioned above. The time
+        //        interval was chosen arbitrarily and may not be long enough
+        //        in some cases.
+        [NSThread sleepForTimeInterval:20.0];
+    }
+}
+
+// NOTE: Must be called on the main thread; as a result, the badge count is
+//       read and updated by one log at a time.
+static void sendNotification(NSString *body, NSString *filepath) {
+    loadNotificationFrameworks();
+
+    // Send the notification.
+    UILocalNotification *notification = [objc_getClass("UILocalNotification") new];
+    if (notification == nil) {
+        return;
+    }
+    [notification setAlertBody:body];
+    [notification setUserInfo:[NSDictionary dictionaryWithObjectsAndKeys:filepath, @"filepath", nil]];
+
+    // Increment and request update of icon badge number.
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    NSInteger crashesSinceLastLaunch = 1 + [defaults integerForKey:@kCrashesSinceLastLaunch];
+    [defaults setInteger:crashesSinceLastLaunch forKey:@kCrashesSinceLastLaunch];
+    [defaults synchronize];
+    [notification setApplicationIconBadgeNumber:crashesSinceLastLaunch];
+
+    // NOTE: Passing nil as the action will cause iOS to display "View" (localized).
+    [notification setHasAction:YES];
+    [notification setAlertAction:nil];
+
+    // NOTE: Notification will be shown immediately as no fire date was set.
+    if (IOS_LT(9_0)) {
+        [objc_getClass("SBSLocalNotificationClient") scheduleLocalNotification:notification bundleIdentifier:@"crash-reporter"];
+    } else {
+        UNSNotificationScheduler *scheduler = [[objc_getClass("UNSNotificationScheduler") alloc] initWithBundleIdentifier:@"crash-reporter"];
+        [scheduler addScheduledLocalNotifications:@[notification] waitUntilDone:YES];
+        [scheduler release];
+    }
+    [notification release];
+}
+
+static NSMutableString *crashLoopBody(NSString *bundleName, unsigned crashCount, unsigned crashWindow) {
+    NSString *format = NSLocalizedStringWithDefaultValue(@"NOTIFY_CRASH_LOOP", nil, [NSBundle mainBundle],
+        @"%@ has crashed %u times in %u minutes.", nil);
+    return [NSMutableString stringWithFormat:format, bundleName, crashCount, (crashWindow + 59) / 60];
+}
+
+static int processCrashLog(NSString *filepath, BOOL isDebugMode) {
+    BOOL hasCheckedFreshness = NO;
+
+    if (!isDebugMode) {
+        // Check freshness of crash log.
+        // NOTE: Only the header of the log file is needed for this check,
+        //       which allows stale logs to be rejected without parsing the
+        //       full report.
+        // NOTE: If the header does not show whether the log is symbolicated,
+        //       the check is done once the full report has been parsed.
+        crashlog_header_t header;
+        if (headerForFile(filepath, &header) && (header.symbolicated || header.symbolicated_is_known)) {
+            NSString *dateTime = nil;
+            if (header.date_time[0] != '\0') {
+                dateTime = [NSString stringWithUTF8String:header.date_time];
+            } else if (header.timestamp[0] != '\0') {
+                dateTime = [NSString stringWithUTF8String:header.timestamp];
+            }
+            if (isTooOld(filepath, nil, dateTime)) {
+                fprintf(stderr, "ERROR: This tool is only meant for use with recently-created, unsymbolicated crash reports.\n");
+                return 1;
+            }
+            hasCheckedFreshness = YES;
         }
     }
-    NSString *filepath = [NSString stringWithFormat:@"%s", (isDebugMode ? argv[2] : argv[1])];
 
     // Load and parse the crash log.
     CRCrashReport *report = nil;
     NSData *data = dataForFile(filepath);
     if (data != nil) {
         report = [[CRCrashReport alloc] initWithData:data filterType:CRCrashReportFilterTypePackage];
+        [data release];
         if (report == nil) {
             fprintf(stderr, "ERROR: Could not parse crash log file \"%s\".\n", [filepath UTF8String]);
             return 1;
@@ -79,29 +392,12 @@ int main(int argc, char **argv, char **envp) {
         return 1;
     }
 
-    if (!isDebugMode) {
-        // Check freshness of crash log.
-        // NOTE: This tool is only meant to be used with newly created crash log
-        //       files; symbolication of older files should be done with the
-        //       "symbolicate" tool.
-        BOOL isTooOld = fileIsSymbolicated(filepath, report);
-        if (!isTooOld) {
-            // Check the date and time that the crash occurred.
-            NSString *dateTime = [[report processInfo] objectForKey:@"Date/Time"];
-            if (dateTime != nil) {
-                NSDateFormatter *formatter = [NSDateFormatter new];
-                [formatter setDateFormat:@"yyyy-MM-dd HH:mm:ss.SSS Z"];
-                NSDate *date = [formatter dateFromString:dateTime];
-                [formatter release];
-                if ([date timeIntervalSinceNow] < -(2 * 60)) {
-                    // Occurred more than two minutes ago.
-                    isTooOld = YES;
-                }
-            }
-        }
-        if (isTooOld) {
-            // Is already symbolicated or occurred too long ago.
+    if (!isDebugMode && !hasCheckedFreshness) {
+        // Check freshness of crash log using the full report.
+        NSString *dateTime = [[report processInfo] objectForKey:@"Date/Time"];
+        if (isTooOld(filepath, report, dateTime)) {
             fprintf(stderr, "ERROR: This tool is only meant for use with recently-created, unsymbolicated crash reports.\n");
+            [report release];
             return 1;
         }
     }
@@ -118,61 +414,39 @@ int main(int argc, char **argv, char **envp) {
     // NOTE: Make sure not to overwrite file if it already exists.
     // NOTE: This should only be a concern if someone were to later manually
     //       call notifier on the same crash log file.
-    NSFileManager *fileMan = [NSFileManager defaultManager];
     NSString *syslogPath = syslogPathForFile(filepath);
-    if (![fileMan fileExistsAtPath:syslogPath]) {
+    if (![[NSFileManager defaultManager] fileExistsAtPath:syslogPath]) {
         // NOTE: Do this here as the following symbolication may take some time,
         //       during which the syslog could change.
-        NSMutableString *syslog = [NSMutableString new];
-        aslmsg query = asl_new(ASL_TYPE_QUERY);
-        aslresponse response = asl_search(NULL, query);
-        aslmsg msg;
-        while ((msg = aslresponse_next(response)) != NULL) {
-            // NOTE: We could use asl_set_query() to filter the results with a
-            //       regular expression, but it seems that ASL_QUERY_OP_REGEX does
-            //       not work properly on older versions of iOS.
-            const char *facility = asl_get(msg, ASL_KEY_FACILITY);
-            const char *sender = asl_get(msg, ASL_KEY_SENDER);
-            const char *bundleIDStr = (bundleID != nil) ? [bundleID UTF8String] : "";
-            const char *processNameStr = (processName != nil) ? [processName UTF8String] : "";
-            if (
-                ((facility != NULL) && ((strcmp(facility, "Crash Reporter") == 0) || (strcmp(facility, bundleIDStr) == 0))) ||
-                ((sender != NULL) && (strcmp(sender, processNameStr) == 0))
-            ) {
-                char time[25];
-                time_t clock = atol(asl_get(msg, ASL_KEY_TIME));
-                struct tm *timeptr = localtime(&clock);
-                strftime(time, 25, "%c", timeptr);
-
-                const char *message = asl_get(msg, ASL_KEY_MSG);
-                [syslog appendFormat:@"%s: %s (%s): %s\n", time, sender, facility, message];
-            }
-        }
-        aslresponse_free(response);
-        asl_free(query);
-
-        // If no syslog data is available, add a message stating such.
-        if ([syslog length] == 0) {
-            [syslog appendString:@"Syslog did not contain any relevant information."];
-        }
-
-        // Write syslog to file (if syslog data exists).
-        NSError *error = nil;
-        if (writeToFile(syslog, syslogPath)) {
-            fixFileOwnershipAndPermissions(syslogPath);
+        NSDate *crashDate = dateForDateTime([[report processInfo] objectForKey:@"Date/Time"]);
+        const time_t crashTime = (crashDate != nil) ? (time_t)[crashDate timeIntervalSince1970] : time(NULL);
+        if (!writeStreamToFile(syslogPath, ^BOOL(FILE *stream) {
+            return captureSyslog(stream, processName, bundleID, crashTime);
+        })) {
+            fprintf(stderr, "WARNING: Failed to save syslog information to file.\n");
         } else {
-            fprintf(stderr, "WARNING: Failed to save syslog information to file: %s.\n", [[error localizedDescription] UTF8String]);
+            fixFileOwnershipAndPermissions(syslogPath);
         }
-        [syslog release];
     }
 
     // Determine the type of crash.
     NSDictionary *processInfo = [report processInfo];
     BOOL isSandboxViolation = ([processInfo objectForKey:@"Sandbox Violation"] != nil);
 
+    // Check for a crash loop.
+    // NOTE: While a crash-loop notification is outstanding, further crashes of
+    //       the same process are neither symbolicated nor notified; the app
+    //       symbolicates logs when they are opened.
+    crash_rate_state_t crashRateState = CRASH_RATE_STATE_NORMAL;
+    unsigned crashCount = 1;
+    unsigned crashWindow = 0;
+    if (!isDebugMode && ([[properties objectForKey:@"bug_type"] integerValue] == 109)) {
+        crashRateState = crashRateStateForFile(filepath, bundleID, &crashCount, &crashWindow);
+    }
+
     // Symbolicate and determine blame.
     NSArray *suspects = nil;
-    if (!isSandboxViolation) {
+    if (!isSandboxViolation && (crashRateState != CRASH_RATE_STATE_SUPPRESSED)) {
         NSString *outputFilepath = symbolicateFile(filepath, report);
         if (outputFilepath != nil) {
             // Update path for this crash log instance.
@@ -188,8 +462,12 @@ int main(int argc, char **argv, char **envp) {
 
     // Switch effective user to mobile (if not already mobile).
     // NOTE: Must do this in order to access mobile's preference settings.
-    // TODO: Consider running all of notifier as mobile.
-    seteuid(501);
+    // NOTE: The service handles preferences on its main thread, which already
+    //       runs as mobile; changing the effective user of the process would
+    //       affect every thread.
+    if (!isService$) {
+        seteuid(501);
+    }
 
     // Determine the bundle name.
     NSString *bundleName = [properties objectForKey:@"app_name"];
@@ -203,135 +481,464 @@ int main(int argc, char **argv, char **envp) {
     }
 
     // Create notification message, based on crash type.
-    NSMutableString *body = nil;
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-    if (isSandboxViolation) {
-        if ([defaults boolForKey:@kNotifySandboxViolations]) {
-            body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_SANDBOX_VIOLATION", nil), bundleName];
-        }
-    } else {
-        // Determine exception type.
-        NSString *exceptionType = [processInfo objectForKey:@"Exception Type"];
-        NSString *exceptionCode = [processInfo objectForKey:@"Exception Code"];
-        if (exceptionCode == nil) {
-            exceptionCode = [processInfo objectForKey:@"Exception Codes"];
-        }
-        if ([exceptionType isEqualToString:@"EXC_RESOURCE"]) {
-            NSString *exceptionSubtype = [processInfo objectForKey:@"Exception Subtype"];
-            if ([exceptionSubtype isEqualToString:@"CPU"]) {
-                if ([defaults boolForKey:@kNotifyExcessiveCPU]) {
-                    body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_CPU", nil), bundleName];
-                }
-            } else if ([exceptionSubtype isEqualToString:@"MEMORY"]) {
-                if ([defaults boolForKey:@kNotifyExcessiveMemory]) {
-                    body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_MEMORY", nil), bundleName];
-                }
-            } else if ([exceptionSubtype isEqualToString:@"WAKEUPS"]) {
-                if ([defaults boolForKey:@kNotifyExcessiveWakeups]) {
-                    body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_WAKEUPS", nil), bundleName];
-                }
-            }
-        } else if ((exceptionCode != nil) && [exceptionCode rangeOfString:@"8badf00d"].location != NSNotFound) {
-            // Execution timeout.
-            if ([defaults boolForKey:@kNotifyExecutionTimeouts]) {
-                body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXECUTION_TIMEOUT_TASK", nil), bundleName];
+    // NOTE: Preferences are read on the main thread, which runs as mobile.
+    __block NSMutableString *body = nil;
+    performOnMainThread(^{
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        // NOTE: The service is long-lived; pick up changes made in Settings.
+        [defaults synchronize];
+        if (isSandboxViolation) {
+            if ([defaults boolForKey:@kNotifySandboxViolations]) {
+                body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_SANDBOX_VIOLATION", nil), bundleName];
             }
         } else {
-            NSInteger bugType = [[properties objectForKey:@"bug_type"] integerValue];
-            switch (bugType) {
-                case 198:
-                    // Low memory.
-                    if ([defaults boolForKey:@kNotifyLowMemory]) {
-                        body = [NSMutableString stringWithString:NSLocalizedString(@"NOTIFY_LOW_MEMORY", nil)];
-                        NSString *largestProcess = [processInfo objectForKey:@"Largest process"];
-                        if (largestProcess != nil) {
-                            [body appendString:@"\n"];
-                            [body appendFormat:NSLocalizedString(@"NOTIFY_LARGEST_PROCESS", nil), largestProcess];
-                        }
+            // Determine exception type.
+            NSString *exceptionType = [processInfo objectForKey:@"Exception Type"];
+            NSString *exceptionCode = [processInfo objectForKey:@"Exception Code"];
+            if (exceptionCode == nil) {
+                exceptionCode = [processInfo objectForKey:@"Exception Codes"];
+            }
+            if ([exceptionType isEqualToString:@"EXC_RESOURCE"]) {
+                NSString *exceptionSubtype = [processInfo objectForKey:@"Exception Subtype"];
+                if ([exceptionSubtype isEqualToString:@"CPU"]) {
+                    if ([defaults boolForKey:@kNotifyExcessiveCPU]) {
+                        body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_CPU", nil), bundleName];
+                    }
+                } else if ([exceptionSubtype isEqualToString:@"MEMORY"]) {
+                    if ([defaults boolForKey:@kNotifyExcessiveMemory]) {
+                        body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_MEMORY", nil), bundleName];
                     }
-                    break;
-                case 109:
-                    // Crash.
-                    body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_CRASHED", nil), bundleName];
-                    [body appendString:@"\n"];
-                    if ([suspects count] > 0) {
-                        [body appendFormat:NSLocalizedString(@"NOTIFY_MAIN_SUSPECT", nil), [[suspects objectAtIndex:0] lastPathComponent]];
-                    } else {
-                        [body appendString:NSLocalizedString(@"NOTIFY_NO_SUSPECTS", nil)];
+                } else if ([exceptionSubtype isEqualToString:@"WAKEUPS"]) {
+                    if ([defaults boolForKey:@kNotifyExcessiveWakeups]) {
+                        body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXCESS_WAKEUPS", nil), bundleName];
                     }
-                    break;
-                default:
-                    break;
+                }
+            } else if ((exceptionCode != nil) && [exceptionCode rangeOfString:@"8badf00d"].location != NSNotFound) {
+                // Execution timeout.
+                if ([defaults boolForKey:@kNotifyExecutionTimeouts]) {
+                    body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_EXECUTION_TIMEOUT_TASK", nil), bundleName];
+                }
+            } else {
+                NSInteger bugType = [[properties objectForKey:@"bug_type"] integerValue];
+                switch (bugType) {
+                    case 198:
+                        // Low memory.
+                        if ([defaults boolForKey:@kNotifyLowMemory]) {
+                            body = [NSMutableString stringWithString:NSLocalizedString(@"NOTIFY_LOW_MEMORY", nil)];
+                            NSString *largestProcess = [processInfo objectForKey:@"Largest process"];
+                            if (largestProcess != nil) {
+                                [body appendString:@"\n"];
+                                [body appendFormat:NSLocalizedString(@"NOTIFY_LARGEST_PROCESS", nil), largestProcess];
+                            }
+                        }
+                        break;
+                    case 109:
+                        // Crash.
+                        body = [NSMutableString stringWithFormat:NSLocalizedString(@"NOTIFY_CRASHED", nil), bundleName];
+                        [body appendString:@"\n"];
+                        if ([suspects count] > 0) {
+                            [body appendFormat:NSLocalizedString(@"NOTIFY_MAIN_SUSPECT", nil), [[suspects objectAtIndex:0] lastPathComponent]];
+                        } else {
+                            [body appendString:NSLocalizedString(@"NOTIFY_NO_SUSPECTS", nil)];
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        // NOTE: Objects autoreleased on the main thread may be released before
+        //       this thread is done with them.
+        [body retain];
+    });
+    [body autorelease];
+
+    if (body != nil) {
+        if (crashRateState == CRASH_RATE_STATE_SUPPRESSED) {
+            body = nil;
+        } else if (crashRateState == CRASH_RATE_STATE_LOOP) {
+            // NOTE: Sent in place of the notification for this crash.
+            body = crashLoopBody(bundleName, crashCount, crashWindow);
+            if ([suspects count] > 0) {
+                [body appendString:@"\n"];
+                [body appendFormat:NSLocalizedString(@"NOTIFY_MAIN_SUSPECT", nil), [[suspects objectAtIndex:0] lastPathComponent]];
             }
         }
     }
 
     if (body != nil) {
-        // Make sure that SpringBoard's local notification server is up.
-        // NOTE: If SpringBoard is not running (i.e. it is what crashed), will
-        //       not be able to register a local notification.
-        // FIXME: Even if port is non-zero, it does not mean that SpringBoard is
-        //        ready to handle notifications.
-        BOOL shouldDelay = NO;
-        mach_port_t port;
-        while ((port = SBSSpringBoardServerPort()) == 0) {
-            [NSThread sleepForTimeInterval:1.0];
-            shouldDelay = YES;
+        waitForSpringBoard();
+        performOnMainThread(^{
+            sendNotification(body, filepath);
+        });
+    }
+
+    // Post a Darwin notification.
+    notify_post("jp.ashikase.crashreporter.notifier.crash");
+
+    [report release];
+    return 0;
+}
+
+// NOTE: Used by the service for logs that are submitted while its queue is
+//       full: only the header of the log is read; the log is neither
+//       symbolicated (the app does so when it is opened) nor is its syslog
+//       captured. Only crashes are notified.
+static void processCrashLogLightweight(NSString *filepath) {
+    crashlog_header_t header;
+    if (headerForFile(filepath, &header) && !header.symbolicated &&
+            (header.bug_type == CRASHLOG_HEADER_BUG_TYPE_CRASH)) {
+        NSString *bundleID = (header.bundle_id[0] != '\0') ? [NSString stringWithUTF8String:header.bundle_id] : nil;
+        unsigned crashCount = 1;
+        unsigned crashWindow = 0;
+        const crash_rate_state_t crashRateState = crashRateStateForFile(filepath, bundleID, &crashCount, &crashWindow);
+
+        NSString *bundleName = (header.process_path[0] != '\0') ?
+            [[NSString stringWithUTF8String:header.process_path] lastPathComponent] :
+            [NSString stringWithUTF8String:header.name];
+        NSString *body = nil;
+        if (crashRateState == CRASH_RATE_STATE_LOOP) {
+            body = crashLoopBody(bundleName, crashCount, crashWindow);
+        } else if (crashRateState == CRASH_RATE_STATE_NORMAL) {
+            body = [NSString stringWithFormat:NSLocalizedString(@"NOTIFY_CRASHED", nil), bundleName];
+        }
+        if (body != nil) {
+            waitForSpringBoard();
+            performOnMainThread(^{
+                sendNotification(body, filepath);
+            });
+        }
+    }
+
+    // Post a Darwin notification.
+    notify_post("jp.ashikase.crashreporter.notifier.crash");
+}
+
+// NOTE: Number of logs that may be waiting to be processed; logs submitted
+//       while the queue remains full are processed without symbolication (see
+//       processCrashLogLightweight()), as a crash storm would otherwise only get
+//       worse. Such logs are counted and reported by the queue.
+static const unsigned kServiceQueueCapacity = 32;
+static const unsigned kServiceWorkerCount = 2;
+
+// NOTE: The service runs as root, and the socket is open to mobile; only
+//       regular files (not symbolic links) in the log directories are
+//       accepted.
+static int isCrashLogPath(const char *filepath) {
+    const char *directories[] = {kCrashLogDirectoryForMobile, kCrashLogDirectoryForRoot};
+    for (unsigned i = 0; i < 2; ++i) {
+        const size_t length = strlen(directories[i]);
+        if ((strncmp(filepath, directories[i], length) == 0) && (filepath[length] == '/') &&
+                (strstr(filepath + length, "/..") == NULL)) {
+            struct stat st;
+            return (lstat(filepath, &st) == 0) && S_ISREG(st.st_mode);
         }
+    }
+    return 0;
+}
+
+static dispatch_queue_t overflowQueue$ = NULL;
+
+// NOTE: Called on the server thread; the log is processed in the background,
+//       one at a time.
+static void handleOverflow(const char *path) {
+    NSString *filepath = [[NSString alloc] initWithUTF8String:path];
+    if (filepath != nil) {
+        dispatch_async(overflowQueue$, ^{
+            NSAutoreleasePool *pool = [NSAutoreleasePool new];
+            processCrashLogLightweight(filepath);
+            [pool release];
+        });
+        [filepath release];
+    }
+}
 
-        if (shouldDelay) {
-            // Wait serveral seconds to give time for SpringBoard to finish launching.
-            // FIXME: This is needed due to issue mentioned above. The time
-            //        interval was chosen arbitrarily and may not be long enough
-            //        in some cases.
-            [NSThread sleepForTimeInterval:20.0];
+static pthread_mutex_t serviceLock$ = PTHREAD_MUTEX_INITIALIZER;
+static unsigned activeWorkerCount$ = 0;
+static BOOL serviceHasStopped$ = NO;
+
+static void *serviceWorker(void *context) {
+    crash_queue_t *queue = (crash_queue_t *)context;
+    char *path;
+    while ((path = crash_queue_pop(queue)) != NULL) {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSString *filepath = [[NSString alloc] initWithUTF8String:path];
+        if (filepath != nil) {
+            processCrashLog(filepath, NO);
+            [filepath release];
         }
+        [pool release];
+        free(path);
+    }
 
-        // Load UIKit framework.
-        void *handle = dlopen("/System/Library/Frameworks/UIKit.framework/UIKit", RTLD_LAZY);
-        if (handle != NULL) {
-            // Send the notification.
-            UILocalNotification *notification = [objc_getClass("UILocalNotification") new];
-            [notification setAlertBody:body];
-            [notification setUserInfo:[NSDictionary dictionaryWithObjectsAndKeys:filepath, @"filepath", nil]];
-
-            // Increment and request update of icon badge number.
-            NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-            NSInteger crashesSinceLastLaunch = 1 + [defaults integerForKey:@kCrashesSinceLastLaunch];
-            [defaults setInteger:crashesSinceLastLaunch forKey:@kCrashesSinceLastLaunch];
-            [defaults synchronize];
-            [notification setApplicationIconBadgeNumber:crashesSinceLastLaunch];
-
-            // NOTE: Passing nil as the action will cause iOS to display "View" (localized).
-            [notification setHasAction:YES];
-            [notification setAlertAction:nil];
-
-            // NOTE: Notification will be shown immediately as no fire date was set.
-            if (IOS_LT(9_0)) {
-                [objc_getClass("SBSLocalNotificationClient") scheduleLocalNotification:notification bundleIdentifier:@"crash-reporter"];
-            } else {
-                void *handle = dlopen("/System/Library/PrivateFrameworks/UserNotificationServices.framework/UserNotificationServices", RTLD_LAZY);
-                if (handle != NULL) {
-                    UNSNotificationScheduler *scheduler = [[objc_getClass("UNSNotificationScheduler") alloc] initWithBundleIdentifier:@"crash-reporter"];
-                    [scheduler addScheduledLocalNotifications:@[notification] waitUntilDone:YES];
-                    dlclose(handle);
+    pthread_mutex_lock(&serviceLock$);
+    --activeWorkerCount$;
+    pthread_mutex_unlock(&serviceLock$);
+    return NULL;
+}
+
+typedef struct {
+    int fd;
+    crash_queue_t *queue;
+} service_context_t;
+
+static void *serviceServer(void *context) {
+    service_context_t *service = (service_context_t *)context;
+    crash_queue_serve(service->fd, service->queue, isCrashLogPath, handleOverflow);
+
+    pthread_mutex_lock(&serviceLock$);
+    serviceHasStopped$ = YES;
+    pthread_mutex_unlock(&serviceLock$);
+    return NULL;
+}
+
+// NOTE: Notifications are sent from the main thread (see sendNotification()),
+//       so the main run loop must keep running for as long as any worker is.
+static void runMainRunLoopWhile(BOOL (^condition)(void)) {
+    for (;;) {
+        pthread_mutex_lock(&serviceLock$);
+        const BOOL shouldRun = condition();
+        pthread_mutex_unlock(&serviceLock$);
+        if (!shouldRun) {
+            break;
+        }
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 1.0, false);
+        [pool release];
+    }
+}
+
+// NOTE: The first pass is delayed so as not to compete with the rest of the
+//       system at boot.
+static const unsigned kCompressionDelay = 5 * 60;
+static const unsigned kCompressionInterval = 6 * 60 * 60;
+
+// NOTE: Logs that have not yet been synced (i.e. that do not yet have the
+//       "synced" extension) are never compressed, as the sync looks for them
+//       by name; nor are their syslogs.
+static NSSet *unsyncedSyslogPathsForDirectory(NSString *directory, NSArray *contents) {
+    NSMutableSet *syslogPaths = [NSMutableSet set];
+    for (NSString *filename in contents) {
+        if (isCrashLogFilename(filename) && !fileIsCompressed(filename) && ![filename hasSuffix:@"synced"]) {
+            NSString *filepath = [directory stringByAppendingPathComponent:filename];
+            [syslogPaths addObject:uncompressedPathForFile(syslogPathForFile(filepath))];
+        }
+    }
+    return syslogPaths;
+}
+
+static BOOL isCompressibleFile(NSString *filepath, NSSet *unsyncedSyslogPaths) {
+    NSString *filename = [filepath lastPathComponent];
+    if (fileIsCompressed(filename)) {
+        return NO;
+    }
+    if (isCrashLogFilename(filename)) {
+        return [filename hasSuffix:@"synced"];
+    }
+    return [filename hasSuffix:@"syslog"] && ![unsyncedSyslogPaths containsObject:filepath];
+}
+
+// NOTE: Maps the filename of each log that a "LatestCrash-*" link points to,
+//       to the paths of the links.
+static NSDictionary *latestCrashLinksForDirectory(NSString *directory, NSArray *contents) {
+    NSFileManager *fileMan = [NSFileManager defaultManager];
+    NSMutableDictionary *links = [NSMutableDictionary dictionary];
+    for (NSString *filename in contents) {
+        if ([filename hasPrefix:@"LatestCrash"]) {
+            NSString *linkPath = [directory stringByAppendingPathComponent:filename];
+            NSString *destPath = [fileMan destinationOfSymbolicLinkAtPath:linkPath error:NULL];
+            if (destPath != nil) {
+                NSMutableArray *linkPaths = [links objectForKey:destPath];
+                if (linkPaths == nil) {
+                    linkPaths = [NSMutableArray array];
+                    [links setObject:linkPaths forKey:destPath];
                 }
+                [linkPaths addObject:linkPath];
             }
-            [notification release];
+        }
+    }
+    return links;
+}
+
+static void compressLogsInDirectory(NSString *directory, time_t cutoff) {
+    NSArray *contents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directory error:NULL];
+    NSSet *unsyncedSyslogPaths = unsyncedSyslogPathsForDirectory(directory, contents);
+    NSDictionary *links = nil;
+    crashlog_index_t *index = NULL;
+    for (NSString *filename in contents) {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSString *filepath = [directory stringByAppendingPathComponent:filename];
+        struct stat st;
+        if (isCompressibleFile(filepath, unsyncedSyslogPaths) &&
+                (lstat([filepath fileSystemRepresentation], &st) == 0) && S_ISREG(st.st_mode) &&
+                (st.st_mtime < cutoff)) {
+            NSString *compressedPath = compressFile(filepath);
+            struct stat newSt;
+            if ((compressedPath != nil) && isCrashLogFilename(filename) &&
+                    (stat([compressedPath fileSystemRepresentation], &newSt) == 0)) {
+                // Move the entry of the log in the index of the app, so that
+                // the app does not parse it again.
+                if (index == NULL) {
+                    index = crashlog_index_open([indexPathForDirectory(directory) fileSystemRepresentation]);
+                }
+                if (index != NULL) {
+                    crashlog_index_rename(index, [filename UTF8String], [[compressedPath lastPathComponent] UTF8String], &st, &newSt);
+                }
 
-            dlclose(handle);
+                // Fix any "LatestCrash-*" symbolic links for this log.
+                if (links == nil) {
+                    links = latestCrashLinksForDirectory(directory, contents);
+                }
+                for (NSString *linkPath in [links objectForKey:filename]) {
+                    replaceSymbolicLink(linkPath, filename, [compressedPath lastPathComponent]);
+                }
+            }
         }
+        [pool release];
     }
 
-    // Post a Darwin notification.
-    notify_post("jp.ashikase.crashreporter.notifier.crash");
+    if (index != NULL) {
+        crashlog_index_keep_all(index);
+        crashlog_index_save(index);
+        crashlog_index_close(index);
+    }
+}
+
+static void *compressionWorker(void *context) {
+    sleep(kCompressionDelay);
+    for (;;) {
+        const unsigned days = unsignedPreference(CFSTR(kCompressLogsAfterDays), kDefaultCompressLogsAfterDays);
+        if (days != 0) {
+            NSAutoreleasePool *pool = [NSAutoreleasePool new];
+            const time_t cutoff = time(NULL) - (time_t)days * 24 * 60 * 60;
+            compressLogsInDirectory(@kCrashLogDirectoryForMobile, cutoff);
+            compressLogsInDirectory(@kCrashLogDirectoryForRoot, cutoff);
+            [pool release];
+        }
+        sleep(kCompressionInterval);
+    }
+    return NULL;
+}
+
+// NOTE: Service mode avoids launching a new process for each crash log. The
+//       symbol cache and tables, the as_root server and UIKit remain loaded
+//       between logs, and at most kServiceWorkerCount logs are processed at a
+//       time, however many are written.
+static int runService() {
+    isService$ = YES;
+
+    // Run the main thread as mobile, leaving the workers as root.
+    // NOTE: Unlike seteuid(), this affects only the calling thread.
+    if ((getuid() == 0) && (pthread_setugid_np(501, 501) != 0)) {
+        fprintf(stderr, "WARNING: Unable to switch main thread to mobile, errno = %d.\n", errno);
+    }
+    loadNotificationFrameworks();
+    overflowQueue$ = dispatch_queue_create("jp.ashikase.crashreporter.notifier.overflow", NULL);
+
+    int fd = crash_queue_listen(kNotifierSocketFilepath);
+    if (fd < 0) {
+        return 1;
+    }
+
+    crash_queue_t *queue = crash_queue_create(kServiceQueueCapacity);
+    if (queue == NULL) {
+        close(fd);
+        return 1;
+    }
+
+    pthread_t threads[kServiceWorkerCount];
+    unsigned threadCount = 0;
+    for (unsigned i = 0; i < kServiceWorkerCount; ++i) {
+        pthread_mutex_lock(&serviceLock$);
+        ++activeWorkerCount$;
+        pthread_mutex_unlock(&serviceLock$);
+        if (pthread_create(&threads[threadCount], NULL, serviceWorker, queue) == 0) {
+            ++threadCount;
+        } else {
+            pthread_mutex_lock(&serviceLock$);
+            --activeWorkerCount$;
+            pthread_mutex_unlock(&serviceLock$);
+        }
+    }
+
+    pthread_t compressionThread;
+    if (pthread_create(&compressionThread, NULL, compressionWorker, NULL) == 0) {
+        pthread_detach(compressionThread);
+    } else {
+        fprintf(stderr, "WARNING: Unable to start compression thread; aged logs will not be compressed.\n");
+    }
+
+    service_context_t service = {fd, queue};
+    pthread_t serverThread;
+    if (threadCount == 0) {
+        fprintf(stderr, "ERROR: Unable to start worker threads.\n");
+    } else if (pthread_create(&serverThread, NULL, serviceServer, &service) != 0) {
+        fprintf(stderr, "ERROR: Unable to start server thread.\n");
+    } else {
+        runMainRunLoopWhile(^BOOL{
+            return !serviceHasStopped$;
+        });
+        pthread_join(serverThread, NULL);
+    }
+
+    // NOTE: Only reached on error; logs already queued are still processed.
+    close(fd);
+    unlink(kNotifierSocketFilepath);
+    crash_queue_shutdown(queue);
+    runMainRunLoopWhile(^BOOL{
+        return (activeWorkerCount$ != 0);
+    });
+    for (unsigned i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    crash_queue_destroy(queue);
+    return 1;
+}
+
+int main(int argc, char **argv, char **envp) {
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+
+    if ((argc > 1) && (strcmp(argv[1], "-b") == 0)) {
+        int status = symbolicateAll(argc - 2, argv + 2);
+        [pool release];
+        return status;
+    }
+
+    if (IOS_LT(5_0)) {
+        fprintf(stderr, "WARNING: CrashReporter notifications require iOS 5.0 or higher.\n");
+        return 0;
+    }
 
-    // Must execute the run loop once so the above is processed.
+    if ((argc > 1) && (strcmp(argv[1], "-D") == 0)) {
+        int status = runService();
+        [pool release];
+        return status;
+    }
+
+    // Get arguments.
+    BOOL isDebugMode = NO;
+    if (argc < 2) {
+        fprintf(stderr, "ERROR: Must specify path to crash log.\n");
+        return 1;
+    }
+    if ((argc > 2)) {
+        if (strcmp(argv[1], "-d") == 0) {
+            isDebugMode = YES;
+        } else {
+            fprintf(stderr, "ERROR: Unknown parameter.\n");
+            return 1;
+        }
+    }
+    NSString *filepath = [NSString stringWithFormat:@"%s", (isDebugMode ? argv[2] : argv[1])];
+
+    int status = processCrashLog(filepath, isDebugMode);
+
+    // Must execute the run loop once so that the notification is processed.
     CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0, true);
 
-    [report release];
     [pool release];
-    return 0;
+    return status;
 }
 
 /* vim: set ft=objc ff=unix sw=4 ts=4 tw=80 expandtab: */
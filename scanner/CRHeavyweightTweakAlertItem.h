@@ -0,0 +1,16 @@
+/**
+ * Name: scanner
+ * Type: iOS extension
+ * Desc: Scans tweaks for known issues.
+ *
+ * Author: Lance Fetters (aka. ashikase)
+ * License: GPL v3 (See LICENSE file for details)
+ */
+
+#import "CRAlertItem.h"
+
+@interface CRHeavyweightTweakAlertItem : CRAlertItem
++ (void)showForPath:(NSString *)path framework:(NSString *)framework target:(NSString *)target;
+@end
+
+/* vim: set ft=logos ff=unix sw=4 ts=4 expandtab tw=80: */
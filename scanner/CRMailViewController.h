@@ -10,7 +10,8 @@
 #import <UIKit/UIKit.h>
 
 typedef enum : NSUInteger {
-    CRMailReasonMissingFilter
+    CRMailReasonMissingFilter,
+    CRMailReasonHeavyweightTweak
 } CRMailReason;
 
 @class PIPackage;
@@ -113,6 +113,9 @@ static NSString *addressFromString(NSString *string) {
         case CRMailReasonMissingFilter:
             string = @"Missing Filter File";
             break;
+        case CRMailReasonHeavyweightTweak:
+            string = @"Heavyweight Framework Loaded Into Daemons";
+            break;
         default:
             string = @"";
             break;
@@ -131,6 +134,13 @@ static NSString *addressFromString(NSString *string) {
                 "Note that even if your tweak operates properly when loaded into daemons, it may cause other tweaks to also be loaded, and those other tweaks may *not* be designed to work with daemons. This is especially a problem if your tweak links to UIKit. If your tweak uses UIKit, be sure to either avoid targetting non-apps (e.g. daemons), or avoid directly linking to UIKit (use dlopen() instead, making sure to do so outside of the tweak's constructor).",
                 package_.name, package_.identifier, package_.version];
             break;
+        case CRMailReasonHeavyweightTweak:
+            string = [NSString stringWithFormat:
+                @"Your tweak, \"%@\" (%@, version %@) links to UIKit (or another heavyweight framework), and its filter file causes it to be loaded into processes that are not apps (e.g. daemons).\n\n"
+                "Linking to a framework causes that framework to be loaded into every process that your tweak is loaded into. Frameworks such as UIKit are expensive to load, and are not designed for use in daemons; this increases the memory usage of those processes and can lead to crashing and other issues. It may also cause other tweaks to be loaded, and those other tweaks may *not* be designed to work with daemons.\n\n"
+                "Please either avoid targetting non-apps (e.g. daemons) in your filter file, or avoid directly linking to the framework (use dlopen() instead, making sure to do so outside of the tweak's constructor, and only in processes that need it).",
+                package_.name, package_.identifier, package_.version];
+            break;
         default:
             string = @"";
             break;
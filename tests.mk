@@ -0,0 +1,88 @@
+# Linux build of the tests and benchmarks of the portable (C) parts of
+# CrashReporter (in common/ and monitor/); the rest of the project is built
+# with Theos (see Makefile).
+#
+#   make check   Build and run the tests.
+#   make bench   Build and run the benchmarks.
+
+CC ?= cc
+CFLAGS ?= -O2 -g
+CFLAGS += -std=gnu99 -Wall -Wextra -Icommon
+LDLIBS += -lz -lpthread
+
+BUILD_DIR := _tests
+
+TESTS := \
+    as_root_test \
+    crash_queue_test \
+    crashlog_header_test \
+    crashlog_index_test \
+    crashlog_name_test \
+    dir_watcher_test \
+    macho_test \
+    package_index_test \
+    report_summary_test \
+    symbol_cache_test \
+    symbol_table_test \
+    syslog_capture_test \
+    tracker_test
+
+BENCHMARKS := \
+    as_root_bench \
+    chunked_read_bench \
+    crashlog_deletion_bench \
+    crashlog_group_bench \
+    log_compression_bench \
+    mapped_data_bench \
+    symbol_cache_bench
+
+# NOTE: Built (without setuid) for use by the tests and benchmarks; not run
+#       itself.
+TOOLS := \
+    as_root
+
+as_root_SOURCES := as_root/as_root.c
+as_root_bench_SOURCES := common/as_root_bench.c
+as_root_test_SOURCES := as_root/as_root_test.c
+chunked_read_bench_SOURCES := common/chunked_read_bench.c common/chunked_read.c
+crashlog_deletion_bench_SOURCES := common/crashlog_deletion_bench.c
+crashlog_group_bench_SOURCES := common/crashlog_group_bench.c
+crash_queue_test_SOURCES := common/crash_queue_test.c common/crash_queue.c
+crashlog_header_test_SOURCES := common/crashlog_header_test.c common/crashlog_header.c common/log_compression.c
+crashlog_index_test_SOURCES := common/crashlog_index_test.c common/crashlog_index.c common/crashlog_header.c common/log_compression.c
+crashlog_name_test_SOURCES := common/crashlog_name_test.c common/crashlog_name.c
+dir_watcher_test_SOURCES := common/dir_watcher_test.c common/dir_watcher.c common/dir_snapshot.c
+log_compression_bench_SOURCES := common/log_compression_bench.c common/log_compression.c common/crashlog_header.c
+mapped_data_bench_SOURCES := common/mapped_data_bench.c
+macho_test_SOURCES := common/macho_test.c common/macho.c
+package_index_test_SOURCES := common/package_index_test.c common/package_index.c
+report_summary_test_SOURCES := common/report_summary_test.c common/report_summary.c
+symbol_cache_bench_SOURCES := common/symbol_cache_bench.c common/symbol_cache.c common/symbol_table.c common/macho.c
+symbol_cache_test_SOURCES := common/symbol_cache_test.c common/symbol_cache.c
+symbol_table_test_SOURCES := common/symbol_table_test.c common/symbol_table.c common/macho.c
+syslog_capture_test_SOURCES := common/syslog_capture_test.c common/syslog_capture.c
+tracker_test_SOURCES := monitor/tracker_test.c monitor/tracker.c
+
+.PHONY: check bench clean-tests
+
+check: $(addprefix $(BUILD_DIR)/,$(TESTS)) | $(addprefix $(BUILD_DIR)/,$(TOOLS))
+	@failed=0; \
+	for test in $^; do \
+	    $$test || failed=1; \
+	done; \
+	exit $$failed
+
+bench: $(addprefix $(BUILD_DIR)/,$(BENCHMARKS)) | $(addprefix $(BUILD_DIR)/,$(TOOLS))
+	@for benchmark in $^; do \
+	    $$benchmark || exit 1; \
+	done
+
+clean-tests:
+	rm -rf $(BUILD_DIR)
+
+$(BUILD_DIR):
+	mkdir -p $@
+
+.SECONDEXPANSION:
+$(BUILD_DIR)/%: $$(%_SOURCES) $$(wildcard common/*.h monitor/*.h) | $(BUILD_DIR)
+	$(CC) $(CFLAGS) -o $@ $(filter %.c,$^) $(LDLIBS)